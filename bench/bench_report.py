@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Aggregate the raw iperf3 output written by lotspeed_bench.sh.
+
+Layout of WORKDIR:
+    meta.json
+    <subject>/run<N>/bulk.json           iperf3 -J, -P parallel streams
+    <subject>/run<N>/bulk_cpu.json       host busy CPU seconds during the bulk run
+    <subject>/run<N>/short/flow-<i>.json iperf3 -J -n SIZE, one per flow
+
+Prints one JSON report (default) or a human-readable table (--table).
+"""
+
+import json
+import math
+import os
+import sys
+
+
+def percentile(values, pct):
+    if not values:
+        return None
+    values = sorted(values)
+    idx = max(0, math.ceil(pct / 100.0 * len(values)) - 1)
+    return values[idx]
+
+
+def jain(values):
+    values = [v for v in values if v is not None]
+    if not values:
+        return None
+    sq = sum(v * v for v in values)
+    return (sum(values) ** 2) / (len(values) * sq) if sq else None
+
+
+def load(path):
+    try:
+        with open(path) as f:
+            data = json.load(f)
+    except (OSError, ValueError) as e:
+        return None, str(e)
+    if "error" in data:
+        return None, data["error"]
+    return data, None
+
+
+def sender_rtts_ms(data):
+    rtts = []
+    for interval in data.get("intervals", []):
+        for stream in interval.get("streams", []):
+            if stream.get("rtt"):
+                rtts.append(stream["rtt"] / 1000.0)
+    return rtts
+
+
+def mss_of(data):
+    return data.get("start", {}).get("tcp_mss_default") or 1448
+
+
+def cpu_per_gb(cpu_seconds, nbytes):
+    if cpu_seconds is None or not nbytes:
+        return None
+    return cpu_seconds / (nbytes / 1e9)
+
+
+def bulk_result(path):
+    data, err = load(path)
+    if err:
+        return {"error": err}
+
+    end = data["end"]
+    sent = end["sum_sent"]
+    received = end["sum_received"]
+    segments = sent["bytes"] / mss_of(data)
+    retrans = sent.get("retransmits", 0)
+    rtts = sender_rtts_ms(data)
+    per_stream = [s["sender"]["bytes"] for s in end.get("streams", [])]
+
+    # iperf3 只统计自身进程；bulk_cpu.json 是整机（含软中断）的忙碌时间
+    util = end.get("cpu_utilization_percent", {})
+    sender_cpu_s = util["host_total"] / 100.0 * sent["seconds"] if "host_total" in util else None
+    host, _ = load(os.path.join(os.path.dirname(path), "bulk_cpu.json"))
+
+    return {
+        "throughput_mbps": received["bits_per_second"] / 1e6,
+        "bytes": received["bytes"],
+        "retransmits": retrans,
+        "retrans_rate": retrans / segments if segments else 0.0,
+        "rtt_p50_ms": percentile(rtts, 50),
+        "rtt_p99_ms": percentile(rtts, 99),
+        "streams": len(per_stream),
+        "stream_mbps": [b * 8 / sent["seconds"] / 1e6 for b in per_stream],
+        "jain": jain(per_stream),
+        "cpu_s_per_gb": cpu_per_gb(host.get("busy_s") if host else None, sent["bytes"]),
+        "sender_cpu_s_per_gb": cpu_per_gb(sender_cpu_s, sent["bytes"]),
+    }
+
+
+def short_result(directory):
+    fcts, rtts, errors = [], [], []
+    total_bytes = total_seconds = retrans = segments = 0
+
+    for name in sorted(os.listdir(directory)):
+        data, err = load(os.path.join(directory, name))
+        if err:
+            errors.append(err)
+            continue
+        end = data["end"]
+        seconds = end["sum_received"]["seconds"]
+        fcts.append(seconds * 1000.0)
+        total_bytes += end["sum_received"]["bytes"]
+        total_seconds += seconds
+        retrans += end["sum_sent"].get("retransmits", 0)
+        segments += end["sum_sent"]["bytes"] / mss_of(data)
+        rtts.extend(sender_rtts_ms(data))
+
+    result = {
+        "flows": len(fcts),
+        "failed": len(errors),
+        "fct_p50_ms": percentile(fcts, 50),
+        "fct_p99_ms": percentile(fcts, 99),
+        "throughput_mbps": total_bytes * 8 / total_seconds / 1e6 if total_seconds else 0.0,
+        "retransmits": retrans,
+        "retrans_rate": retrans / segments if segments else 0.0,
+        "rtt_p50_ms": percentile(rtts, 50),
+        "rtt_p99_ms": percentile(rtts, 99),
+    }
+    if errors:
+        result["errors"] = sorted(set(errors))
+    return result
+
+
+def subject_info(name):
+    if name.startswith("lotspeed-"):
+        return {"algo": "lotspeed", "preset": name[len("lotspeed-"):]}
+    return {"algo": name, "preset": None}
+
+
+def collect(workdir):
+    with open(os.path.join(workdir, "meta.json")) as f:
+        meta = json.load(f)
+
+    results = []
+    for subject in sorted(os.listdir(workdir)):
+        sdir = os.path.join(workdir, subject)
+        if not os.path.isdir(sdir):
+            continue
+        for run in sorted(os.listdir(sdir)):
+            rdir = os.path.join(sdir, run)
+            base = dict(subject_info(subject), run=int(run[3:]))
+            if os.path.exists(os.path.join(rdir, "bulk.json")):
+                results.append(dict(base, workload="bulk",
+                                    **bulk_result(os.path.join(rdir, "bulk.json"))))
+            if os.path.isdir(os.path.join(rdir, "short")):
+                results.append(dict(base, workload="short",
+                                    **short_result(os.path.join(rdir, "short"))))
+    return {"meta": meta, "results": results}
+
+
+def fmt(value, spec):
+    return format(value, spec) if isinstance(value, (int, float)) else "-"
+
+
+def print_table(report, out):
+    out.write("%-24s %-6s %4s %10s %9s %9s %8s %6s %9s %9s %7s\n" % (
+        "subject", "load", "run", "Mbps", "rtt_p50", "rtt_p99",
+        "retx%", "jain", "fct_p50", "fct_p99", "cpu/GB"))
+    for r in report["results"]:
+        subject = r["algo"] + ("/" + r["preset"] if r["preset"] else "")
+        if "error" in r:
+            out.write("%-24s %-6s %4d  error: %s\n" % (subject, r["workload"], r["run"], r["error"]))
+            continue
+        out.write("%-24s %-6s %4d %10s %9s %9s %8s %6s %9s %9s %7s\n" % (
+            subject, r["workload"], r["run"],
+            fmt(r.get("throughput_mbps"), ".1f"),
+            fmt(r.get("rtt_p50_ms"), ".2f"),
+            fmt(r.get("rtt_p99_ms"), ".2f"),
+            fmt(r.get("retrans_rate", 0) * 100, ".3f"),
+            fmt(r.get("jain"), ".3f"),
+            fmt(r.get("fct_p50_ms"), ".1f"),
+            fmt(r.get("fct_p99_ms"), ".1f"),
+            fmt(r.get("cpu_s_per_gb"), ".3f")))
+
+
+def main(argv):
+    table = "--table" in argv
+    args = [a for a in argv if a != "--table"]
+    if len(args) != 1:
+        sys.stderr.write("usage: bench_report.py [--table] WORKDIR\n")
+        return 2
+
+    report = collect(args[0])
+    if table:
+        print_table(report, sys.stdout)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        sys.stdout.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
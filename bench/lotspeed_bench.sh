@@ -0,0 +1,412 @@
+#!/bin/bash
+#
+# LotSpeed v2.0 - 网络命名空间基准测试
+#
+# 在本机搭建  lsb-snd ──veth──> lsb-rcv  拓扑：
+#   发送端出口: netem (随机丢包) + tbf (瓶颈带宽 / 缓冲深度)
+#   接收端出口: netem (往返时延，加在 ACK 路径上)
+# 然后分别用 cubic / bbr / lotspeed(各预设) 跑 iperf3 长流与短流，
+# 输出 JSON 报告：吞吐、RTT p50/p99、重传率、Jain 公平性、短流完成时间。
+#
+# Usage:
+#   sudo ./bench/lotspeed_bench.sh [options]
+#   make bench BENCH_ARGS="--rate 1gbit --rtt 50"
+#
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+REPO_DIR="$(dirname "$SCRIPT_DIR")"
+PARAM_DIR="/sys/module/lotspeed/parameters"
+
+NS_SND="lsb-snd"
+NS_RCV="lsb-rcv"
+VETH_SND="lsb-veth-s"
+VETH_RCV="lsb-veth-r"
+ADDR_SND="10.201.0.1"
+ADDR_RCV="10.201.0.2"
+IPERF_PORT=5201
+
+# 默认场景
+RATE="1gbit"
+RTT_MS=50
+LOSS_PCT=0
+BUFFER_BDP=1
+DURATION=20
+PARALLEL=4
+SHORT_SIZE="256K"
+SHORT_COUNT=30
+REPEAT=1
+ALGOS="cubic bbr lotspeed"
+PRESETS="conservative balanced aggressive extreme"
+TSO_BURST_US=""
+TUNE_ARGS="--interval 4 --sample 1"
+TUNE_PID=""
+WORKLOADS="bulk short"
+OUTPUT=""
+KEEP_WORKDIR=0
+
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+CYAN='\033[0;36m'
+NC='\033[0m'
+
+log_info() {
+    echo -e "${GREEN}[INFO]${NC} $1" >&2
+}
+
+log_warn() {
+    echo -e "${YELLOW}[WARN]${NC} $1" >&2
+}
+
+log_error() {
+    echo -e "${RED}[ERROR]${NC} $1" >&2
+}
+
+usage() {
+    cat << EOF
+Usage: $0 [options]
+
+Topology:
+  --rate RATE          bottleneck rate, tc syntax (default: $RATE)
+  --rtt MS             round-trip delay in ms (default: $RTT_MS)
+  --loss PCT           random loss on the data path in percent (default: $LOSS_PCT)
+  --buffer BDP         bottleneck buffer as a multiple of BDP (default: $BUFFER_BDP)
+
+Workloads:
+  --workloads LIST     any of: bulk short (default: "$WORKLOADS")
+  --duration SEC       bulk run length (default: $DURATION)
+  --parallel N         parallel bulk streams, used for Jain fairness (default: $PARALLEL)
+  --short-size SIZE    bytes per short flow, iperf3 syntax (default: $SHORT_SIZE)
+  --short-count N      short flows per run (default: $SHORT_COUNT)
+  --repeat N           repetitions of every run (default: $REPEAT)
+
+Algorithms:
+  --algos LIST         any of: cubic bbr reno lotspeed (default: "$ALGOS")
+  --presets LIST       lotspeed presets to test (default: "$PRESETS")
+  --tso-burst US       lotserver_tso_burst_us for lotspeed runs (default: keep current)
+                       preset "tuned" starts from balanced and runs tools/lotspeed_tune.py
+                       (global scope) in the sender namespace during the runs
+  --tune-args ARGS     extra lotspeed_tune.py arguments (default: "$TUNE_ARGS")
+
+Output:
+  --output FILE        JSON report path (default: lotspeed_bench_<time>.json)
+  --keep               keep the raw iperf3 output directory
+EOF
+}
+
+while [[ $# -gt 0 ]]; do
+    case "$1" in
+        --rate)        RATE="$2"; shift 2 ;;
+        --rtt)         RTT_MS="$2"; shift 2 ;;
+        --loss)        LOSS_PCT="$2"; shift 2 ;;
+        --buffer)      BUFFER_BDP="$2"; shift 2 ;;
+        --workloads)   WORKLOADS="$2"; shift 2 ;;
+        --duration)    DURATION="$2"; shift 2 ;;
+        --parallel)    PARALLEL="$2"; shift 2 ;;
+        --short-size)  SHORT_SIZE="$2"; shift 2 ;;
+        --short-count) SHORT_COUNT="$2"; shift 2 ;;
+        --repeat)      REPEAT="$2"; shift 2 ;;
+        --algos)       ALGOS="$2"; shift 2 ;;
+        --presets)     PRESETS="$2"; shift 2 ;;
+        --tso-burst)   TSO_BURST_US="$2"; shift 2 ;;
+        --tune-args)   TUNE_ARGS="$2"; shift 2 ;;
+        --output)      OUTPUT="$2"; shift 2 ;;
+        --keep)        KEEP_WORKDIR=1; shift ;;
+        -h|--help)     usage; exit 0 ;;
+        *)             log_error "Unknown option: $1"; usage >&2; exit 1 ;;
+    esac
+done
+
+[[ -z "$OUTPUT" ]] && OUTPUT="lotspeed_bench_$(date '+%Y%m%d_%H%M%S').json"
+
+# 预设与 install.sh 中 apply_preset 保持一致
+preset_values() {
+    case $1 in
+        conservative) echo "125000000 15 1 0 125,75,100 110,100,100 1,1,8" ;;
+        balanced)     echo "625000000 25 1 0 125,75,100 110,100,100 1,1,6" ;;
+        aggressive)   echo "1250000000 40 1 0 150,75,100 125,100,100 1,1,4" ;;
+        extreme)      echo "2500000000 50 0 1 150,90,110 125,100,100 1,1,2" ;;
+        tuned)        preset_values balanced ;;
+        *)            return 1 ;;
+    esac
+}
+
+check_env() {
+    if [[ $EUID -ne 0 ]]; then
+        log_error "This script must be run as root (network namespaces and tc)"
+        exit 1
+    fi
+
+    for cmd in ip tc iperf3 python3; do
+        if ! command -v $cmd >/dev/null 2>&1; then
+            log_error "Missing dependency: $cmd"
+            exit 1
+        fi
+    done
+
+    for algo in $ALGOS; do
+        case $algo in
+            lotspeed)
+                if ! lsmod | grep -q '^lotspeed'; then
+                    if [[ -f "$REPO_DIR/lotspeed.ko" ]]; then
+                        log_info "Loading $REPO_DIR/lotspeed.ko"
+                        insmod "$REPO_DIR/lotspeed.ko"
+                    else
+                        modprobe lotspeed 2>/dev/null || {
+                            log_error "lotspeed module not loaded and lotspeed.ko not built (run make)"
+                            exit 1
+                        }
+                    fi
+                fi
+                for preset in $PRESETS; do
+                    preset_values $preset >/dev/null || {
+                        log_error "Unknown preset: $preset"
+                        exit 1
+                    }
+                    if [[ $preset == tuned && ! -x "$REPO_DIR/tools/lotspeed_diag" ]]; then
+                        log_error "Preset tuned needs tools/lotspeed_diag (run make tools)"
+                        exit 1
+                    fi
+                done
+                ;;
+            *)
+                modprobe tcp_$algo 2>/dev/null || true
+                if ! grep -qw "$algo" /proc/sys/net/ipv4/tcp_available_congestion_control; then
+                    log_error "Congestion control $algo is not available"
+                    exit 1
+                fi
+                ;;
+        esac
+    done
+}
+
+# 保存 lotspeed 参数，结束后恢复
+SAVED_PARAMS=()
+
+save_params() {
+    [[ -d $PARAM_DIR ]] || return 0
+    for p in lotserver_rate lotserver_gain lotserver_adaptive lotserver_turbo lotserver_tso_burst_us \
+             lotserver_cycle_pacing lotserver_cycle_cwnd lotserver_cycle_rtts; do
+        [[ -f $PARAM_DIR/$p ]] && SAVED_PARAMS+=("$p=$(cat $PARAM_DIR/$p)")
+    done
+}
+
+restore_params() {
+    local kv
+    for kv in "${SAVED_PARAMS[@]}"; do
+        echo "${kv#*=}" > "$PARAM_DIR/${kv%%=*}" 2>/dev/null || true
+    done
+}
+
+apply_preset() {
+    local rate gain adaptive turbo cycle_pacing cycle_cwnd cycle_rtts
+    read rate gain adaptive turbo cycle_pacing cycle_cwnd cycle_rtts <<< "$(preset_values $1)"
+    echo $rate > $PARAM_DIR/lotserver_rate
+    echo $gain > $PARAM_DIR/lotserver_gain
+    echo $adaptive > $PARAM_DIR/lotserver_adaptive
+    echo $turbo > $PARAM_DIR/lotserver_turbo
+    echo $cycle_pacing > $PARAM_DIR/lotserver_cycle_pacing
+    echo $cycle_cwnd > $PARAM_DIR/lotserver_cycle_cwnd
+    echo $cycle_rtts > $PARAM_DIR/lotserver_cycle_rtts
+    [[ -n "$TSO_BURST_US" ]] && echo $TSO_BURST_US > $PARAM_DIR/lotserver_tso_burst_us
+    return 0
+}
+
+teardown() {
+    ip netns del $NS_SND 2>/dev/null || true
+    ip netns del $NS_RCV 2>/dev/null || true
+}
+
+# 调参器在发送端命名空间里运行：INET_DIAG 只能看到本命名空间的连接
+start_tuner() {
+    ip netns exec $NS_SND python3 "$REPO_DIR/tools/lotspeed_tune.py" --scope global \
+        --diag "$REPO_DIR/tools/lotspeed_diag" $TUNE_ARGS > "$1" 2>&1 &
+    TUNE_PID=$!
+}
+
+stop_tuner() {
+    if [[ -n "$TUNE_PID" ]]; then
+        kill $TUNE_PID 2>/dev/null || true
+        wait $TUNE_PID 2>/dev/null || true
+        TUNE_PID=""
+    fi
+}
+
+cleanup() {
+    stop_tuner
+    teardown
+    restore_params
+    if [[ $KEEP_WORKDIR -eq 0 && -n "$WORKDIR" ]]; then
+        rm -rf "$WORKDIR"
+    fi
+}
+
+# tc 速率（如 1gbit / 500mbit）转换为 bit/s
+rate_to_bps() {
+    python3 - "$1" << 'EOF'
+import re, sys
+m = re.fullmatch(r'([0-9.]+)\s*([kmgt]?)(bit|bps)?', sys.argv[1].lower())
+if not m:
+    sys.exit(1)
+scale = {'': 1, 'k': 1e3, 'm': 1e6, 'g': 1e9, 't': 1e12}[m.group(2)]
+unit = 8 if m.group(3) == 'bps' else 1
+print(int(float(m.group(1)) * scale * unit))
+EOF
+}
+
+setup_topology() {
+    local rate_bps bdp limit burst
+
+    teardown
+    ip netns add $NS_SND
+    ip netns add $NS_RCV
+    ip link add $VETH_SND netns $NS_SND type veth peer name $VETH_RCV netns $NS_RCV
+
+    ip -n $NS_SND addr add $ADDR_SND/24 dev $VETH_SND
+    ip -n $NS_RCV addr add $ADDR_RCV/24 dev $VETH_RCV
+    ip -n $NS_SND link set lo up
+    ip -n $NS_RCV link set lo up
+    ip -n $NS_SND link set $VETH_SND up
+    ip -n $NS_RCV link set $VETH_RCV up
+
+    rate_bps=$(rate_to_bps "$RATE") || {
+        log_error "Cannot parse rate: $RATE"
+        exit 1
+    }
+    bdp=$(( rate_bps / 8 * RTT_MS / 1000 ))
+    limit=$(python3 -c "print(max(int($bdp * $BUFFER_BDP), 16 * 1514))")
+    burst=$(( rate_bps / 8 / 250 ))
+    [[ $burst -lt 32768 ]] && burst=32768
+
+    # 数据方向：随机丢包 -> 瓶颈 tbf
+    ip netns exec $NS_SND tc qdisc add dev $VETH_SND root handle 1: \
+        netem loss ${LOSS_PCT}% limit 1000000
+    ip netns exec $NS_SND tc qdisc add dev $VETH_SND parent 1: handle 2: \
+        tbf rate $RATE burst $burst limit $limit
+
+    # ACK 方向：整段往返时延
+    ip netns exec $NS_RCV tc qdisc add dev $VETH_RCV root \
+        netem delay ${RTT_MS}ms limit 1000000
+
+    # 与 switch_lot.sh 一致，避免上一轮的路由缓存影响下一轮
+    ip netns exec $NS_SND sysctl -qw net.ipv4.tcp_no_metrics_save=1
+
+    BOTTLENECK_BPS=$rate_bps
+    BUFFER_BYTES=$limit
+}
+
+start_server() {
+    ip netns exec $NS_RCV iperf3 -s -D -B $ADDR_RCV -p $IPERF_PORT \
+        --pidfile "$WORKDIR/iperf3.pid" >/dev/null
+    sleep 0.5
+}
+
+stop_server() {
+    if [[ -f "$WORKDIR/iperf3.pid" ]]; then
+        kill "$(cat "$WORKDIR/iperf3.pid")" 2>/dev/null || true
+        rm -f "$WORKDIR/iperf3.pid"
+    fi
+}
+
+# 全机忙碌 CPU 时间（user + nice + system + irq + softirq，单位 tick）
+# 两端都在本机，软中断里的收发包开销也算在内，比 iperf3 自身的进程 CPU 更接近真实成本
+cpu_busy_ticks() {
+    awk '/^cpu / { print $2 + $3 + $4 + $7 + $8 }' /proc/stat
+}
+
+run_bulk() {
+    local cc=$1 out=$2 before after
+    before=$(cpu_busy_ticks)
+    ip netns exec $NS_SND iperf3 -c $ADDR_RCV -p $IPERF_PORT -C $cc \
+        -t $DURATION -P $PARALLEL -i 0.2 -J > "$out" 2>/dev/null || true
+    after=$(cpu_busy_ticks)
+    echo "{\"busy_s\": $(python3 -c "print(($after - $before) / $(getconf CLK_TCK))")}" \
+        > "$(dirname "$out")/bulk_cpu.json"
+}
+
+run_short() {
+    local cc=$1 dir=$2 i
+    mkdir -p "$dir"
+    for i in $(seq 1 $SHORT_COUNT); do
+        ip netns exec $NS_SND iperf3 -c $ADDR_RCV -p $IPERF_PORT -C $cc \
+            -n $SHORT_SIZE -i 0.05 -J > "$dir/flow-$i.json" 2>/dev/null || true
+    done
+}
+
+# 一个被测对象 = 拥塞控制算法 (+ lotspeed 预设)
+run_subject() {
+    local name=$1 cc=$2 run workload
+
+    for run in $(seq 1 $REPEAT); do
+        for workload in $WORKLOADS; do
+            local dir="$WORKDIR/$name/run$run"
+            mkdir -p "$dir"
+            log_info "  $name / $workload / run $run"
+            case $workload in
+                bulk)  run_bulk $cc "$dir/bulk.json" ;;
+                short) run_short $cc "$dir/short" ;;
+                *)     log_error "Unknown workload: $workload"; exit 1 ;;
+            esac
+        done
+    done
+}
+
+main() {
+    check_env
+
+    WORKDIR=$(mktemp -d /tmp/lotspeed_bench.XXXXXX)
+    save_params
+    trap cleanup EXIT
+
+    log_info "Building topology: rate=$RATE rtt=${RTT_MS}ms loss=${LOSS_PCT}% buffer=${BUFFER_BDP}xBDP"
+    setup_topology
+    start_server
+
+    for algo in $ALGOS; do
+        if [[ $algo == lotspeed ]]; then
+            for preset in $PRESETS; do
+                apply_preset $preset
+                log_info "Testing lotspeed ($preset)"
+                if [[ $preset == tuned ]]; then
+                    mkdir -p "$WORKDIR/lotspeed-$preset"
+                    start_tuner "$WORKDIR/lotspeed-$preset/tune.log"
+                fi
+                run_subject "lotspeed-$preset" lotspeed
+                stop_tuner
+            done
+        else
+            log_info "Testing $algo"
+            run_subject "$algo" $algo
+        fi
+    done
+
+    stop_server
+
+    cat > "$WORKDIR/meta.json" << EOF
+{
+  "kernel": "$(uname -r)",
+  "timestamp": "$(date -u '+%Y-%m-%dT%H:%M:%SZ')",
+  "rate": "$RATE",
+  "bottleneck_bps": $BOTTLENECK_BPS,
+  "rtt_ms": $RTT_MS,
+  "loss_pct": $LOSS_PCT,
+  "buffer_bdp": $BUFFER_BDP,
+  "buffer_bytes": $BUFFER_BYTES,
+  "duration_s": $DURATION,
+  "parallel": $PARALLEL,
+  "short_size": "$SHORT_SIZE",
+  "short_count": $SHORT_COUNT,
+  "repeat": $REPEAT,
+  "tso_burst_us": "${TSO_BURST_US:-$(cat $PARAM_DIR/lotserver_tso_burst_us 2>/dev/null)}"
+}
+EOF
+
+    python3 "$SCRIPT_DIR/bench_report.py" "$WORKDIR" > "$OUTPUT"
+    log_info "Report written to $OUTPUT"
+    [[ $KEEP_WORKDIR -eq 1 ]] && log_info "Raw iperf3 output kept in $WORKDIR"
+    python3 "$SCRIPT_DIR/bench_report.py" --table "$WORKDIR" >&2
+}
+
+main
@@ -149,9 +149,43 @@ download_source() {
         exit 1
     }
 
+    # 跟踪点定义（lotspeed.c 编译依赖）
+    curl -fsSL "https://raw.githubusercontent.com/$GITHUB_REPO/$GITHUB_BRANCH/lotspeed_trace.h" -o lotspeed_trace.h || {
+        log_error "Failed to download lotspeed_trace.h"
+        exit 1
+    }
+
+    # 采集环布局（lotspeed.c 编译依赖，lotspeed_capture 工具共用）
+    curl -fsSL "https://raw.githubusercontent.com/$GITHUB_REPO/$GITHUB_BRANCH/lotspeed_capture.h" -o lotspeed_capture.h || {
+        log_error "Failed to download lotspeed_capture.h"
+        exit 1
+    }
+
+    # INET_DIAG 每连接状态布局（lotspeed.c 编译依赖，lotspeed_diag 工具共用）
+    curl -fsSL "https://raw.githubusercontent.com/$GITHUB_REPO/$GITHUB_BRANCH/lotspeed_diag.h" -o lotspeed_diag.h || {
+        log_error "Failed to download lotspeed_diag.h"
+        exit 1
+    }
+
+    # 下载连接诊断工具（可选）
+    curl -fsSL "https://raw.githubusercontent.com/$GITHUB_REPO/$GITHUB_BRANCH/tools/lotspeed_diag.c" -o lotspeed_diag.c || {
+        log_warn "Failed to download lotspeed_diag.c, 'lotspeed connections' will fall back to ss"
+    }
+
+    # 下载闭环调参器（可选，依赖 python3 与 lotspeed_diag）
+    curl -fsSL "https://raw.githubusercontent.com/$GITHUB_REPO/$GITHUB_BRANCH/tools/lotspeed_tune.py" -o lotspeed_tune.py || {
+        log_warn "Failed to download lotspeed_tune.py, 'lotspeed tune' will be unavailable"
+    }
+
+    # 下载逐 ACK 采集工具（可选）
+    curl -fsSL "https://raw.githubusercontent.com/$GITHUB_REPO/$GITHUB_BRANCH/tools/lotspeed_capture.c" -o lotspeed_capture.c || {
+        log_warn "Failed to download lotspeed_capture.c, 'lotspeed capture' will be unavailable"
+    }
+
     # 创建 Makefile
     cat > Makefile << 'EOF'
 obj-m += lotspeed.o
+ccflags-y := -I$(src)
 
 KERNELDIR ?= /lib/modules/$(shell uname -r)/build
 PWD := $(shell pwd)
@@ -197,6 +231,22 @@ compile_module() {
     fi
 
     log_success "Module compiled successfully"
+
+    # 编译连接诊断工具（失败不影响模块安装）
+    if [[ -f lotspeed_diag.c ]]; then
+        if gcc -O2 -std=gnu99 -I. -o lotspeed_diag lotspeed_diag.c >/dev/null 2>&1; then
+            log_success "Diagnostic tool compiled"
+        else
+            log_warn "Failed to compile lotspeed_diag, 'lotspeed connections' will fall back to ss"
+        fi
+    fi
+    if [[ -f lotspeed_capture.c ]]; then
+        if gcc -O2 -std=gnu99 -I. -o lotspeed_capture lotspeed_capture.c >/dev/null 2>&1; then
+            log_success "Capture tool compiled"
+        else
+            log_warn "Failed to compile lotspeed_capture, 'lotspeed capture' will be unavailable"
+        fi
+    fi
 }
 
 # 加载模块
@@ -278,11 +328,6 @@ safe_stop() {
     echo -e "${CYAN}Step 1: Switching to default algorithm: $DEFAULT_ALGO${NC}"
     sysctl -w net.ipv4.tcp_congestion_control=$DEFAULT_ALGO >/dev/null 2>&1
 
-    # 设置强制卸载标志（如果参数存在）
-    if [ -f /sys/module/lotspeed/parameters/force_unload ]; then
-        echo 1 > /sys/module/lotspeed/parameters/force_unload 2>/dev/null || true
-    fi
-
     # 2. 检查活动连接
     echo -e "${CYAN}Step 2: Checking active connections${NC}"
     ACTIVE_CONNS=$(ss -tin 2>/dev/null | grep -c lotspeed 2>/dev/null || echo "0")
@@ -450,9 +495,14 @@ show_status() {
             value=$(cat $param 2>/dev/null)
             case $name in
                 lotserver_rate)
-                    gbps=$((value / 125000000))
-                    gbps_frac=$(((value % 125000000) * 100 / 125000000))
-                    printf "  %-20s: %s (%d.%02d Gbps Zero=Auto Detection)\n" "$name" "$value" "$gbps" "$gbps_frac"
+                    if [[ "$value" == "0" ]]; then
+                        printf "  %-20s: %s (auto, %s%% of link speed)\n" "$name" "$value" \
+                            "$(cat /sys/module/lotspeed/parameters/lotserver_link_pct 2>/dev/null)"
+                    else
+                        gbps=$((value / 125000000))
+                        gbps_frac=$(((value % 125000000) * 100 / 125000000))
+                        printf "  %-20s: %s (%d.%02d Gbps)\n" "$name" "$value" "$gbps" "$gbps_frac"
+                    fi
                     ;;
                 lotserver_gain)
                     gain_x=$((value / 10))
@@ -473,12 +523,28 @@ apply_preset() {
 
     echo -e "${CYAN}Applying preset: $PRESET${NC}"
 
+    # 先暂存全部写入，最后一次性发布，连接不会看到半套预设
+    echo 1 > /sys/module/lotspeed/parameters/lotserver_hold
+
     case $PRESET in
+        auto)
+            echo 0 > /sys/module/lotspeed/parameters/lotserver_rate
+            echo 25 > /sys/module/lotspeed/parameters/lotserver_gain
+            echo 1 > /sys/module/lotspeed/parameters/lotserver_adaptive
+            echo 0 > /sys/module/lotspeed/parameters/lotserver_turbo
+            echo 125,75,100 > /sys/module/lotspeed/parameters/lotserver_cycle_pacing
+            echo 110,100,100 > /sys/module/lotspeed/parameters/lotserver_cycle_cwnd
+            echo 1,1,6 > /sys/module/lotspeed/parameters/lotserver_cycle_rtts
+            echo -e "${GREEN}Applied auto preset ($(cat /sys/module/lotspeed/parameters/lotserver_link_pct)% of link speed, 2.5x)${NC}"
+            ;;
         conservative)
             echo 125000000 > /sys/module/lotspeed/parameters/lotserver_rate
             echo 15 > /sys/module/lotspeed/parameters/lotserver_gain
             echo 1 > /sys/module/lotspeed/parameters/lotserver_adaptive
             echo 0 > /sys/module/lotspeed/parameters/lotserver_turbo
+            echo 125,75,100 > /sys/module/lotspeed/parameters/lotserver_cycle_pacing
+            echo 110,100,100 > /sys/module/lotspeed/parameters/lotserver_cycle_cwnd
+            echo 1,1,8 > /sys/module/lotspeed/parameters/lotserver_cycle_rtts
             echo -e "${GREEN}Applied conservative preset (1Gbps, 1.5x)${NC}"
             ;;
         balanced)
@@ -486,6 +552,9 @@ apply_preset() {
             echo 25 > /sys/module/lotspeed/parameters/lotserver_gain
             echo 1 > /sys/module/lotspeed/parameters/lotserver_adaptive
             echo 0 > /sys/module/lotspeed/parameters/lotserver_turbo
+            echo 125,75,100 > /sys/module/lotspeed/parameters/lotserver_cycle_pacing
+            echo 110,100,100 > /sys/module/lotspeed/parameters/lotserver_cycle_cwnd
+            echo 1,1,6 > /sys/module/lotspeed/parameters/lotserver_cycle_rtts
             echo -e "${GREEN}Applied balanced preset (5Gbps, 2.5x)${NC}"
             ;;
         aggressive)
@@ -493,6 +562,9 @@ apply_preset() {
             echo 40 > /sys/module/lotspeed/parameters/lotserver_gain
             echo 1 > /sys/module/lotspeed/parameters/lotserver_adaptive
             echo 0 > /sys/module/lotspeed/parameters/lotserver_turbo
+            echo 150,75,100 > /sys/module/lotspeed/parameters/lotserver_cycle_pacing
+            echo 125,100,100 > /sys/module/lotspeed/parameters/lotserver_cycle_cwnd
+            echo 1,1,4 > /sys/module/lotspeed/parameters/lotserver_cycle_rtts
             echo -e "${GREEN}Applied aggressive preset (10Gbps, 4.0x)${NC}"
             ;;
         extreme)
@@ -500,11 +572,16 @@ apply_preset() {
             echo 50 > /sys/module/lotspeed/parameters/lotserver_gain
             echo 0 > /sys/module/lotspeed/parameters/lotserver_adaptive
             echo 1 > /sys/module/lotspeed/parameters/lotserver_turbo
+            echo 150,90,110 > /sys/module/lotspeed/parameters/lotserver_cycle_pacing
+            echo 125,100,100 > /sys/module/lotspeed/parameters/lotserver_cycle_cwnd
+            echo 1,1,2 > /sys/module/lotspeed/parameters/lotserver_cycle_rtts
             echo -e "${YELLOW}⚡ Applied EXTREME preset (20Gbps, 5.0x, TURBO)${NC}"
             echo -e "${RED}WARNING: This may cause network congestion!${NC}"
             ;;
         *)
+            echo 0 > /sys/module/lotspeed/parameters/lotserver_hold
             echo "Available presets:"
+            echo "  auto        - Rate from each flow's egress NIC speed (2.5x)"
             echo "  conservative - Safe for shared networks (1G, 1.5x)"
             echo "  balanced    - Good performance (5G, 2.5x) [RECOMMENDED]"
             echo "  aggressive  - High performance (10G, 4.0x)"
@@ -512,6 +589,8 @@ apply_preset() {
             exit 1
             ;;
     esac
+
+    echo 0 > /sys/module/lotspeed/parameters/lotserver_hold
 }
 
 set_param() {
@@ -522,21 +601,48 @@ set_param() {
         echo "Usage: lotspeed set <parameter> <value>"
         echo ""
         echo "Available parameters:"
-        echo "  lotserver_rate     - Target rate in bytes/sec"
+        echo "  lotserver_rate     - Target rate in bytes/sec (0 = from egress NIC speed)"
+        echo "  lotserver_link_pct - Auto rate as % of the egress NIC speed when lotserver_rate is 0"
         echo "  lotserver_gain     - Gain multiplier x10 (30 = 3.0x)"
         echo "  lotserver_min_cwnd - Minimum congestion window"
         echo "  lotserver_max_cwnd - Maximum congestion window"
         echo "  lotserver_adaptive - Enable adaptive mode (0/1)"
         echo "  lotserver_turbo    - Enable turbo mode (0/1)"
         echo "  lotserver_verbose  - Enable verbose logging (0/1)"
-        echo "  force_unload       - Force module unload (0/1)"
+        echo "  lotserver_histograms - Collect RTT/cwnd/rate histograms (0/1)"
+        echo "  lotserver_profiles - Policy profiles, e.g. 'dc:rate=2500000000,gain=20;mobile:rate=6250000'"
+        echo "  lotserver_rules    - Policy rules, e.g. 'dst=10.0.0.0/8 profile=dc;dport=443 profile=mobile'"
+        echo "  lotserver_egress_pct - Per egress NIC budget as % of its link speed, shared by weight (0 = off)"
+        echo "  lotserver_tso_burst_us - Max TSO burst in usec of pacing rate (0 = kernel default)"
+        echo "  lotserver_min_rtt_win_ms - rtt_min lifetime in ms before it is re-measured (0 = never)"
+        echo "  lotserver_probe_rtt_ms - Drain phase length in ms when rtt_min expires (0 = no drain)"
+        echo "  lotserver_cycle_pacing - Pacing gain % for probe,drain,cruise (e.g. 125,75,100)"
+        echo "  lotserver_cycle_cwnd   - Cwnd gain % for probe,drain,cruise (e.g. 110,100,100)"
+        echo "  lotserver_cycle_rtts   - Phase lengths in round trips for probe,drain,cruise (e.g. 1,1,6)"
+        echo "  lotserver_ecn      - DCTCP-style ECN mode, cut rate by marked fraction (0/1, load time, needs restart)"
+        echo "  lotserver_couple   - Coupled groups sharing one rate: 0 off, 1 by destination, 2 by mark (new connections)"
+        echo "  lotserver_hold     - 1 = stage writes, 0 = publish all staged writes at once"
+        echo "  force_unload       - Deprecated, no effect"
         exit 1
     fi
 
+    # 只能在加载时设置的参数：写入 modprobe 配置，下次加载生效
+    if [[ "$PARAM" == "lotserver_ecn" ]]; then
+        sed -i "/^options lotspeed $PARAM=/d" /etc/modprobe.d/lotspeed.conf 2>/dev/null
+        echo "options lotspeed $PARAM=$VALUE" >> /etc/modprobe.d/lotspeed.conf
+        echo -e "${GREEN}✓ $PARAM = $VALUE saved to /etc/modprobe.d/lotspeed.conf${NC}"
+        echo -e "${YELLOW}  Takes effect on next load: lotspeed restart${NC}"
+        return
+    fi
+
     PARAM_FILE="/sys/module/lotspeed/parameters/$PARAM"
     if [[ -f "$PARAM_FILE" ]]; then
         OLD_VALUE=$(cat $PARAM_FILE)
-        echo $VALUE > $PARAM_FILE
+        # 策略表等参数带空格和分号，需原样写入；解析失败时内核返回 EINVAL
+        if ! echo "$VALUE" > "$PARAM_FILE" 2>/dev/null; then
+            echo -e "${RED}Error: invalid value for $PARAM: $VALUE${NC}"
+            exit 1
+        fi
         echo -e "${GREEN}✓ Set $PARAM = $VALUE (was: $OLD_VALUE)${NC}"
     else
         echo -e "${RED}Error: Parameter $PARAM not found${NC}"
@@ -587,7 +693,31 @@ case "$ACTION" in
         ;;
     connections|conns)
         echo -e "${CYAN}Active connections using LotSpeed:${NC}"
-        ss -tin | grep lotspeed || echo "No active connections"
+        if [[ -x $INSTALL_DIR/lotspeed_diag ]]; then
+            shift
+            $INSTALL_DIR/lotspeed_diag "$@"
+        else
+            # 没有 lotspeed_diag 时用 ss：能看到目标速率、rtt_min 与增益（显示为 bbr:(...)），
+            # 丢包计数与涡轮预算只有 lotspeed_diag 能取
+            echo -e "${YELLOW}lotspeed_diag not installed, listing lotspeed connections via ss${NC}"
+            ss -tin | grep -B1 --no-group-separator lotspeed || echo "No active lotspeed connections"
+        fi
+        ;;
+    tune)
+        if [[ ! -f $INSTALL_DIR/lotspeed_tune.py || ! -x $INSTALL_DIR/lotspeed_diag ]]; then
+            echo -e "${RED}Error: lotspeed_tune.py and lotspeed_diag are required (reinstall)${NC}"
+            exit 1
+        fi
+        shift
+        exec python3 $INSTALL_DIR/lotspeed_tune.py --diag $INSTALL_DIR/lotspeed_diag "$@"
+        ;;
+    capture)
+        if [[ ! -x $INSTALL_DIR/lotspeed_capture ]]; then
+            echo -e "${RED}Error: lotspeed_capture is not installed (reinstall)${NC}"
+            exit 1
+        fi
+        shift
+        exec $INSTALL_DIR/lotspeed_capture "$@"
         ;;
     *)
         echo "╔════════════════════════════════════════════════════════╗"
@@ -604,12 +734,15 @@ case "$ACTION" in
         echo "  status      - Show current status and parameters"
         echo "  preset      - Apply preset configuration"
         echo "  set         - Set parameter value"
-        echo "  connections - Show active connections"
+        echo "  connections - Show active connections (per-destination summary)"
+        echo "  tune        - Auto-tune gain/rate per path class (--dry-run to only log)"
+        echo "  capture     - Record per-ACK decisions for offline replay (-o FILE -d SEC)"
         echo "  log         - Show recent logs"
         echo "  monitor     - Monitor logs in real-time"
         echo "  uninstall   - Completely uninstall LotSpeed"
         echo ""
         echo "Presets:"
+        echo "  lotspeed preset auto          - 90% of link speed, 2.5x gain"
         echo "  lotspeed preset conservative  - 1Gbps, 1.5x gain"
         echo "  lotspeed preset balanced      - 5Gbps, 2.5x gain [RECOMMENDED]"
         echo "  lotspeed preset aggressive    - 10Gbps, 4.0x gain"
@@ -620,6 +753,9 @@ case "$ACTION" in
         echo "  lotspeed preset balanced"
         echo "  lotspeed set lotserver_turbo 1 #无视网络环境尽可能的发包"
         echo "  lotspeed set lotserver_verbose 0 #关闭日志"
+        echo "  lotspeed connections -p 24 -H    #按 /24 汇总速率与增益分布"
+        echo "  lotspeed tune --dry-run          #只打印调参建议"
+        echo "  lotspeed capture -o a.cap -d 30 -p 443  #采集 30 秒 443 端口连接，供模拟器回放"
         echo "  lotspeed monitor"
         exit 1
         ;;
@@ -0,0 +1,47 @@
+#!/bin/bash
+# run_uml.sh  ——  在 UML 内核中用 kunit.py 运行 lotspeed 的 KUnit 用例（无需硬件 / root）
+#
+# 用法：./kunit/run_uml.sh /path/to/linux [kunit.py run 的其他参数]
+#
+# 把 lotspeed.c 等源文件放到内核源码树的 net/ipv4/lotspeed/ 下（每次运行都会覆盖），
+# 并在 net/ipv4/Kconfig、net/ipv4/Makefile 中挂上该目录（只追加一次）。
+
+set -e
+
+if [ $# -lt 1 ] || [ ! -x "$1/tools/testing/kunit/kunit.py" ]; then
+    echo "usage: $0 /path/to/linux [kunit.py args...]" >&2
+    exit 1
+fi
+
+KSRC=$(cd "$1" && pwd)
+shift
+HERE=$(cd "$(dirname "$0")/.." && pwd)
+DST="$KSRC/net/ipv4/lotspeed"
+
+mkdir -p "$DST"
+cp "$HERE/lotspeed.c" "$HERE/lotspeed_trace.h" "$HERE/lotspeed_capture.h" "$HERE/lotspeed_kunit.c" "$DST/"
+
+cat > "$DST/Kconfig" <<'EOF'
+config TCP_CONG_LOTSPEED
+	tristate "LotSpeed TCP congestion control"
+	depends on INET
+
+config LOTSPEED_KUNIT_TEST
+	bool "KUnit tests for LotSpeed" if !KUNIT_ALL_TESTS
+	depends on TCP_CONG_LOTSPEED && KUNIT=y
+	default KUNIT_ALL_TESTS
+EOF
+
+# lotspeed_trace.h 由 <trace/define_trace.h> 按 TRACE_INCLUDE_PATH 重新包含
+cat > "$DST/Makefile" <<'EOF'
+obj-$(CONFIG_TCP_CONG_LOTSPEED) += lotspeed.o
+ccflags-y := -I$(src)
+EOF
+
+grep -q 'net/ipv4/lotspeed/Kconfig' "$KSRC/net/ipv4/Kconfig" ||
+    echo 'source "net/ipv4/lotspeed/Kconfig"' >> "$KSRC/net/ipv4/Kconfig"
+grep -q 'lotspeed/' "$KSRC/net/ipv4/Makefile" ||
+    echo 'obj-$(CONFIG_TCP_CONG_LOTSPEED) += lotspeed/' >> "$KSRC/net/ipv4/Makefile"
+
+cd "$KSRC"
+exec ./tools/testing/kunit/kunit.py run --kunitconfig="$HERE/kunit/.kunitconfig" "$@"
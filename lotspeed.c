@@ -11,6 +11,40 @@
 #include <linux/ktime.h>
 #include <linux/kernel.h>
 #include <linux/timer.h>
+#include <linux/inet_diag.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jump_label.h>
+#include <linux/bitops.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/jhash.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/refcount.h>
+#include <linux/inet.h>
+#include <linux/cgroup.h>
+#include <linux/win_minmax.h>
+#include <linux/netdevice.h>
+#include <linux/ethtool.h>
+#include <linux/rtnetlink.h>
+#include <linux/vmalloc.h>
+#include <net/ipv6.h>
+#include <net/dst.h>
+
+#define CREATE_TRACE_POINTS
+#include "lotspeed_trace.h"
+#include "lotspeed_capture.h"
+#include "lotspeed_diag.h"
+
+// 用例用静态桩替换会真正发包的函数（见 lotspeed_send_ack()）
+#if IS_ENABLED(CONFIG_LOTSPEED_KUNIT_TEST) && LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+#include <kunit/static_stub.h>
+#else
+#define KUNIT_STATIC_STUB_REDIRECT(real_fn_name, args...) do { } while (0)
+#endif
 
 // 版本兼容性检测 - 修正版本判断逻辑
 // 根据实际测试：6.8.0 使用旧API，6.17+ 使用新API
@@ -30,76 +64,584 @@
 
 // 滤波与探测常量
 #define LOTSPEED_BW_EMA_SHIFT        3     // 1/8 EMA
-#define LOTSPEED_BW_DECAY_SHIFT      3     // 窗口最大值衰减 1/8
-#define LOTSPEED_BW_WINDOW_MS        200   // 200ms 窗口更新
-#define LOTSPEED_PROBE_BASE          10000 // BDP 自适应探测基数
-#define LOTSPEED_PROBE_MIN           8
-#define LOTSPEED_PROBE_MAX           80
+#define LOTSPEED_BW_SHIFT            10    // 交付速率以 u32 存储，单位 1024 字节/秒（上限约 4TB/s）
+#define LOTSPEED_PKT_SHIFT           8     // pkt_rate 单位：1/256 包/秒
+#define LOTSPEED_BW_RTTS             10    // 交付速率窗口最大值覆盖的往返数
 #define LOTSPEED_MIN_GAIN            10
-#define LOTSPEED_TURBO_IGNORE_SPAN   3
+#define LOTSPEED_FULL_BW_PCT         125   // 启动：交付速率每个往返至少增长 25% 才算还没到瓶颈
+#define LOTSPEED_FULL_BW_RTTS        3     // 连续这么多个往返增长不足即认为管道已满
+#define LOTSPEED_STARTUP_RTT_SLACK   1000  // 启动的 RTT 膨胀阈值至少为 1ms，低 RTT 路径上不被抖动误触发
+#define LOTSPEED_PATH_HASH_BITS      10    // 路径缓存 1024 个桶
+#define LOTSPEED_PATH_DEPTH          4     // 每桶最多 4 项，总量上限 4096
+#define LOTSPEED_MAX_PROFILES        16
+#define LOTSPEED_MAX_RULES           64
+#define LOTSPEED_PROFILE_NAME_LEN    16
+#define LOTSPEED_BUDGET_REFRESH_MS   10    // 出口预算汇总周期
+#define LOTSPEED_BUDGET_SLOTS        64    // 出口预算按网卡分槽，槽 0 留给出口网卡未知的连接
+#define LOTSPEED_PACING_SHIFT_DEF    10    // 内核默认 sk_pacing_shift（约 1ms）
+#define LOTSPEED_PACING_SHIFT_MIN    7     // 突发上限约 8ms
+#define LOTSPEED_PACING_SHIFT_MAX    14    // 突发下限约 61us
+#define LOTSPEED_TSO_LOW_RATE        150000 // 低于 1.2Mbps 时每个 TSO 包 1 段
+#define LOTSPEED_TSO_MAX_SEGS        64
+#define LOTSPEED_ECN_SHIFT           10    // ecn_alpha 单位：1/1024
+#define LOTSPEED_ECN_G               4     // 标记比例 EWMA 系数 g = 1/16（同 DCTCP）
+#define LOTSPEED_GROUP_BITS          10    // 耦合组表 1024 个槽位
+#define LOTSPEED_GROUP_PROBE         8     // 线性探测步数，找不到槽位的连接不耦合
+#define LOTSPEED_LINK_HASH_BITS      8     // 网卡速率缓存 256 个桶
+#define LOTSPEED_RATE_FALLBACK       125000000ULL   // 取不到网卡速率时的目标速率（1Gbps）
+
+// flags 标志位
+#define LOTSPEED_ECN_CE              BIT(0) // 接收端：最近收到的报文带 CE
+#define LOTSPEED_LOSS_STARTUP        BIT(1) // 当前丢包片段结束了启动，误判恢复时回到启动
+#define LOTSPEED_ECN_MARKED          BIT(2) // 发送端：上一个往返出现过标记
+#define LOTSPEED_ROUND_LOSS          BIT(3) // 本往返内有丢包
+#define LOTSPEED_LOSS_RANDOM         BIT(4) // 当前丢包片段被判定为随机丢包，见 lotspeed_loss_is_random()
+#define LOTSPEED_LOSS_EPISODE        BIT(5) // 拥塞丢包片段进行中，loss_prior_gain 有效，见 lotspeed_loss_episode()
+#define LOTSPEED_LOSS_CUT            BIT(6) // 本往返已按丢包退让过
+#define LOTSPEED_LOSS_PREV           BIT(7) // 上一个往返有拥塞丢包
 
 // 可调参数（通过 sysfs 动态修改）
-static unsigned long lotserver_rate = 125000000ULL;   // 默认 1Gbps
+static unsigned long lotserver_rate = 0;              // 0 = 按出口网卡速率推算
+static unsigned int lotserver_link_pct = 90;          // 自动速率占网卡协商速率的百分比
 static unsigned int lotserver_gain = 15;              // 1.5x 默认增益
 static unsigned int lotserver_min_cwnd = 50;          // 最小拥塞窗口
 static unsigned int lotserver_max_cwnd = 10000;       // 最大拥塞窗口
 static bool lotserver_adaptive = true;                // 自适应模式
 static bool lotserver_turbo = false;                  // 涡轮模式
 static bool lotserver_soft_turbo = true;              // 软涡轮（丢包预算）
-static unsigned int lotserver_soft_turbo_budget = 2;  // 可忽略的连续丢包数
+static unsigned int lotserver_soft_turbo_budget = 2;  // 可忽略的连续丢包片段数
+static bool lotserver_loss_classify = true;           // 区分随机丢包与拥塞丢包，只有拥塞丢包降速
+static unsigned int lotserver_loss_rtt_pct = 5;       // RTT 高出 rtt_min 超过此百分比即视为有排队
+static unsigned int lotserver_loss_bw_pct = 90;       // 交付速率低于目标速率的此百分比即视为瓶颈已满
+static unsigned int lotserver_loss_beta = 80;         // 每个有丢包的往返 cwnd_gain 保留的百分比
+static unsigned int lotserver_startup_gain = 277;     // 启动阶段的 pacing / cwnd 增益（%，约 2/ln2）
+static unsigned int lotserver_startup_rtt_pct = 25;   // 启动中 RTT 高出 rtt_min 超过此百分比即结束，0 = 不按时延
+static unsigned int lotserver_idle_halflife_ms = 10000; // 空闲重启时目标速率按空闲时长衰减的半衰期，0 = 沿用空闲前的速率
 static bool lotserver_verbose = false;                // 详细日志模式
-static bool force_unload = false;
+static bool lotserver_histograms = false;             // 采集 RTT/cwnd/速率直方图
+static bool lotserver_path_cache = true;              // 按目的网段缓存学习结果
+static unsigned int lotserver_path_ttl = 600;         // 路径缓存有效期（秒）
+static unsigned int lotserver_path_prefix4 = 24;      // IPv4 聚合前缀长度
+static unsigned int lotserver_path_prefix6 = 48;      // IPv6 聚合前缀长度
+static unsigned int lotserver_egress_pct = 0;         // 每块出口网卡上全部连接合计速率占协商速率的百分比，0 = 不限
+static unsigned int lotserver_tso_burst_us = 1000;    // 单个 TSO 突发的时长上限（微秒），0 = 交给内核
+static unsigned int lotserver_min_rtt_win_ms = 10000; // rtt_min 有效期（毫秒），0 = 永不过期
+static unsigned int lotserver_probe_rtt_ms = 200;     // rtt_min 过期后的排空时长（毫秒），0 = 不排空
+static bool lotserver_ecn = false;                    // DCTCP 式 ECN 模式（按被标记比例降速），加载时设置
+static unsigned int lotserver_couple = 0;             // 耦合组：0 = 关闭，1 = 按目的地址，2 = 按 sk_mark
+static unsigned int lotserver_capture = 0;            // 逐 ACK 采集：0 = 关闭，N = 每 N 条连接采集 1 条
+static unsigned int lotserver_capture_port = 0;       // 只采集本地或远端端口为此值的连接，0 = 不限
+
+enum lotspeed_couple_mode {
+    LOTSPEED_COUPLE_OFF,
+    LOTSPEED_COUPLE_DST,
+    LOTSPEED_COUPLE_MARK,
+};
+
+// 增益循环：探测 -> 排空 -> 巡航，下标为 enum lotspeed_phase
+enum lotspeed_phase {
+    LOTSPEED_PHASE_PROBE,       // 以高于估计带宽的速率发送，寻找额外带宽
+    LOTSPEED_PHASE_DRAIN,       // 以低于估计带宽的速率发送，排掉探测造成的排队
+    LOTSPEED_PHASE_CRUISE,      // 按估计带宽匀速发送
+    LOTSPEED_PHASE_NR,
+};
 
-static inline u8 lotspeed_get_turbo_budget(void)
+static unsigned int lotserver_cycle_pacing[LOTSPEED_PHASE_NR] = { 125, 75, 100 };   // pacing 增益（%）
+static unsigned int lotserver_cycle_cwnd[LOTSPEED_PHASE_NR] = { 110, 100, 100 };    // cwnd 增益（%）
+static unsigned int lotserver_cycle_rtts[LOTSPEED_PHASE_NR] = { 1, 1, 6 };          // 持续的往返数，0 = 跳过
+static bool lotserver_hold = false;                   // 1 = 参数写入只暂存，回到 0 时一次性发布
+static bool force_unload = false;                   // 已废弃，保留参数名以兼容旧脚本
+
+// 控制律参数快照。sysfs 写的是上面的 lotserver_* 变量，每次写入后由 lotspeed_config_commit()
+// 整体复制成新快照并以 RCU 发布，连接只从快照读参数：用 lotserver_hold 包起来的一组写入
+// （如 preset 切换）要么全部可见，要么全部不可见。gen 每发布一次加 1，
+// 连接在下一个 ACK 发现代号变化后按变化了的参数重新对齐（lotspeed_config_rebase）。
+// 逐 ACK 读取的字段放在前面；日志 / 直方图 / ECN 开关由 static key 承载，不在快照里
+struct lotspeed_config {
+    u64 rate;
+    u32 gen;
+    u32 gain_gen;       // gain 最近一次改动时的 gen
+    u32 rate_gen;       // rate / link_pct / egress_pct / adaptive 最近一次改动时的 gen
+    u32 turbo_gen;      // turbo / soft_turbo / soft_turbo_budget 最近一次改动时的 gen
+    u32 gain;
+    u32 min_cwnd;
+    u32 max_cwnd;
+    u32 tso_burst_us;
+    u32 min_rtt_win_ms;
+    u32 probe_rtt_ms;
+    u32 soft_turbo_budget;
+    u32 loss_rtt_pct;
+    u32 loss_bw_pct;
+    u32 loss_beta;
+    u32 startup_gain;
+    u32 startup_rtt_pct;
+    u32 idle_halflife_ms;
+    u32 cycle_pacing[LOTSPEED_PHASE_NR];
+    u32 cycle_cwnd[LOTSPEED_PHASE_NR];
+    u32 cycle_rtts[LOTSPEED_PHASE_NR];
+    bool adaptive;
+    bool turbo;
+    bool soft_turbo;
+    bool loss_classify;
+    bool path_cache;
+    // 以下只在建连 / 断连或往返结束时读取
+    u32 egress_pct;
+    u32 link_pct;
+    u32 path_ttl;
+    u32 path_prefix4;
+    u32 path_prefix6;
+    u32 couple;
+    struct rcu_head rcu;
+} ____cacheline_aligned;
+
+static struct lotspeed_config __rcu *lotspeed_cfg;
+static DEFINE_MUTEX(lotspeed_cfg_mutex);
+
+// 拥塞控制回调在入口取一次快照（lotspeed_cfg_get），整个回调内的参数都来自这一份，
+// 逐 ACK 只做一次 rcu_dereference。调用方持有 rcu_read_lock：进程上下文的回调
+//（connect、backlog 中处理 ACK）不在 RCU 读侧临界区内，回调入口统一加锁
+static inline const struct lotspeed_config *lotspeed_cfg_get(void)
 {
-    return lotserver_soft_turbo ?
-           (u8)clamp_t(unsigned int, lotserver_soft_turbo_budget, 1U, 8U) : 0;
+    return rcu_dereference(lotspeed_cfg);
 }
 
-static inline void lotspeed_reset_turbo_budget(struct lotspeed *ca)
+// 回调之外（debugfs）读单个字段
+#define lotspeed_cfg_read(field) ({                                     \
+    typeof(((struct lotspeed_config *)NULL)->field) __val;              \
+    rcu_read_lock();                                                    \
+    __val = rcu_dereference(lotspeed_cfg)->field;                       \
+    rcu_read_unlock();                                                  \
+    __val; })
+
+static int lotspeed_config_commit(void)
 {
-    if (ca) {
-        ca->turbo_budget = lotspeed_get_turbo_budget();
-        ca->turbo_ignore_ref = 0;
-    }
+    struct lotspeed_config *cfg, *old;
+
+    if (READ_ONCE(lotserver_hold))
+        return 0;
+
+    cfg = kzalloc(sizeof(*cfg), GFP_KERNEL);
+    if (!cfg)
+        return -ENOMEM;
+
+    cfg->rate = lotserver_rate;
+    cfg->gain = lotserver_gain;
+    cfg->min_cwnd = lotserver_min_cwnd;
+    cfg->max_cwnd = lotserver_max_cwnd;
+    cfg->tso_burst_us = lotserver_tso_burst_us;
+    cfg->min_rtt_win_ms = lotserver_min_rtt_win_ms;
+    cfg->probe_rtt_ms = lotserver_probe_rtt_ms;
+    cfg->soft_turbo_budget = lotserver_soft_turbo_budget;
+    cfg->loss_rtt_pct = lotserver_loss_rtt_pct;
+    cfg->loss_bw_pct = lotserver_loss_bw_pct;
+    cfg->loss_beta = lotserver_loss_beta;
+    cfg->startup_gain = lotserver_startup_gain;
+    cfg->startup_rtt_pct = lotserver_startup_rtt_pct;
+    cfg->idle_halflife_ms = lotserver_idle_halflife_ms;
+    memcpy(cfg->cycle_pacing, lotserver_cycle_pacing, sizeof(cfg->cycle_pacing));
+    memcpy(cfg->cycle_cwnd, lotserver_cycle_cwnd, sizeof(cfg->cycle_cwnd));
+    memcpy(cfg->cycle_rtts, lotserver_cycle_rtts, sizeof(cfg->cycle_rtts));
+    cfg->adaptive = lotserver_adaptive;
+    cfg->turbo = lotserver_turbo;
+    cfg->soft_turbo = lotserver_soft_turbo;
+    cfg->loss_classify = lotserver_loss_classify;
+    cfg->path_cache = lotserver_path_cache;
+    cfg->egress_pct = lotserver_egress_pct;
+    cfg->link_pct = lotserver_link_pct;
+    cfg->path_ttl = lotserver_path_ttl;
+    cfg->path_prefix4 = lotserver_path_prefix4;
+    cfg->path_prefix6 = lotserver_path_prefix6;
+    cfg->couple = lotserver_couple;
+
+    mutex_lock(&lotspeed_cfg_mutex);
+    old = rcu_dereference_protected(lotspeed_cfg, lockdep_is_held(&lotspeed_cfg_mutex));
+    cfg->gen = old ? old->gen + 1 : 1;
+    // 各组参数最近一次改动时的代号，连接只重新对齐变化了的那组
+    if (old && cfg->gain == old->gain)
+        cfg->gain_gen = old->gain_gen;
+    else
+        cfg->gain_gen = cfg->gen;
+    if (old && cfg->rate == old->rate && cfg->link_pct == old->link_pct &&
+        cfg->egress_pct == old->egress_pct && cfg->adaptive == old->adaptive)
+        cfg->rate_gen = old->rate_gen;
+    else
+        cfg->rate_gen = cfg->gen;
+    if (old && cfg->turbo == old->turbo && cfg->soft_turbo == old->soft_turbo &&
+        cfg->soft_turbo_budget == old->soft_turbo_budget)
+        cfg->turbo_gen = old->turbo_gen;
+    else
+        cfg->turbo_gen = cfg->gen;
+    rcu_assign_pointer(lotspeed_cfg, cfg);
+    mutex_unlock(&lotspeed_cfg_mutex);
+
+    if (old)
+        kfree_rcu(old, rcu);
+    return 0;
+}
+
+// 模块卸载时释放最后一份快照（此前已没有连接在读）
+static void lotspeed_config_free(void)
+{
+    kfree(rcu_dereference_protected(lotspeed_cfg, 1));
+    RCU_INIT_POINTER(lotspeed_cfg, NULL);
+}
+
+// 日志与直方图开关用 static key 实现，关闭时快路径上只剩一条被打补丁的跳转
+static DEFINE_STATIC_KEY_FALSE(lotspeed_verbose_key);
+static DEFINE_STATIC_KEY_FALSE(lotspeed_hist_key);
+static DEFINE_STATIC_KEY_FALSE(lotspeed_ecn_key);
+static DEFINE_STATIC_KEY_FALSE(lotspeed_capture_key);
+
+static struct tcp_congestion_ops lotspeed_ops;
+
+#define lotspeed_verbose()  static_branch_unlikely(&lotspeed_verbose_key)
+
+// 策略档案：规则在 init 时匹配一次，连接持有引用直到 release。
+// 数值字段为 0、开关字段为 -1 表示沿用对应的全局参数
+struct lotspeed_profile {
+    refcount_t ref;
+    char name[LOTSPEED_PROFILE_NAME_LEN];
+    u64 rate;
+    u32 gain;
+    u32 min_cwnd;
+    u32 max_cwnd;
+    u32 weight;
+    s8 turbo;
+    s8 soft_turbo;
+};
+
+// 每连接私有状态（存放于 icsk_ca_priv，受 ICSK_CA_PRIV_SIZE 限制）
+struct lotspeed {
+    u64 target_rate;
+    struct minmax bw_max;   // 最近 LOTSPEED_BW_RTTS 个往返的交付速率最大值（LOTSPEED_BW_SHIFT 单位）
+    struct lotspeed_profile *profile;   // NULL = 全局参数
+    u32 bw_ema;             // 交付速率 EMA（LOTSPEED_BW_SHIFT 单位）
+    u32 next_rtt_delivered; // tp->delivered 到达该值即进入下一个往返
+    u32 round_count;        // 往返计数，bw_max 的时间轴
+    u32 round_bw;           // 本往返内的最大交付速率样本（LOTSPEED_BW_SHIFT 单位）
+    u32 rtt_min;
+    u32 rtt_ema;
+    u32 rtt_var;
+    u32 rtt_min_stamp;  // rtt_min 最近一次刷新（jiffies）；排空阶段（probe_rtt）中为排空结束时间
+    u32 ecn_prior_ce;   // 本往返开始时的 tp->delivered_ce（交付数取 next_rtt_delivered）
+    u32 cfg_gen;        // 上次对齐时的参数快照代号
+    u32 rate_ceiling;   // 速率上限（LOTSPEED_BW_SHIFT 单位），建连与每个往返结束时更新，供启动中逐 ACK 使用
+    u32 pkt_rate;       // 速率换算的每秒包数（LOTSPEED_PKT_SHIFT 单位），速率或 mss 变化时重算，见 lotspeed_pkt_rate()
+    u16 cwnd_gain;
+    u16 loss_prior_gain;    // 丢包片段开始前的 cwnd_gain
+    u32 ecn_alpha:11,   // 被标记比例的 EWMA（LOTSPEED_ECN_SHIFT 单位）
+        group:11,       // 耦合组槽位 + 1，0 = 不耦合
+        budget_slot:6;  // 出口预算槽位（出口网卡），0 = 出口网卡未知
+    u16 ecn_rcv_nxt;    // 接收端：上一个报文到达后 tp->rcv_nxt 的低 16 位，见 lotspeed_ecn_echo()
+    u8 ss_mode:1,       // 启动阶段（含启动后的排空），见 lotspeed_startup_round()
+       cycle_phase:2,   // enum lotspeed_phase；启动中 DRAIN 表示启动后的排空
+       idle_resume:1,   // 空闲重启后回升中，见 lotspeed_idle_round()
+       probe_rtt:1;     // rtt_min 过期后的排空阶段，见 lotspeed_update_rtt()
+    u8 turbo_budget:4,  // 不超过 8
+       loss_count:3,    // 饱和计数，见 lotspeed_count_loss()
+       loss_rate_cut:1; // 丢包片段内目标速率按交付速率下调过，误判恢复时还原
+    u8 tso_segs;        // 当前 TSO 段数目标，0 = 未接管
+    u8 cycle_rtts;      // 当前阶段已经过的往返数；启动中为交付速率未明显增长的往返数
+    u8 flags;           // LOTSPEED_ECN_* / LOTSPEED_ROUND_* / LOTSPEED_LOSS_*
+};
+
+// 交付速率单位换算：字节/秒 <-> u32 存储值
+static inline u64 lotspeed_bw_bytes(u32 bw)
+{
+    return (u64)bw << LOTSPEED_BW_SHIFT;
 }
 
-static inline void lotspeed_consume_turbo_ignore(struct lotspeed *ca)
+static inline u32 lotspeed_bw_from_bytes(u64 rate)
 {
-    if (ca && ca->turbo_ignore_ref > 0)
-        ca->turbo_ignore_ref--;
+    return (u32)min_t(u64, rate >> LOTSPEED_BW_SHIFT, U32_MAX);
 }
 
-static inline bool lotspeed_turbo_ignore_active(const struct lotspeed *ca)
+// ECN 模式只作用于协商了 ECN 的连接（4.19 以下内核 lotspeed_ecn_key 不会打开）
+static inline bool lotspeed_ecn_active(const struct sock *sk)
 {
-    return ca && ca->turbo_ignore_ref > 0;
+    return static_branch_unlikely(&lotspeed_ecn_key) &&
+           (tcp_sk(sk)->ecn_flags & TCP_ECN_OK);
 }
 
-static bool lotspeed_turbo_should_ignore(struct lotspeed *ca, const char *reason)
+// 丢包计数只用于"是否丢过包"的判断，饱和而不回绕到 0（总数见 stats 的 losses）
+static inline void lotspeed_count_loss(struct lotspeed *ca)
 {
-    if (!ca)
-        return lotserver_turbo;
+    if (ca->loss_count < 7)
+        ca->loss_count++;
+}
 
-    ca->turbo_ignore_ref = 0;
+// 缓存的换算结果 n 是否等于 clamp(bytes / mss, lo, hi)：n × mss <= bytes < (n + 1) × mss（到达上下限的一侧不查）。
+// 只用一次乘法就能确认输入没变，不必把 64 位的速率另存一份作为键
+static inline bool lotspeed_div_ok(u64 bytes, u32 mss, u64 n, u64 lo, u64 hi)
+{
+    u64 base = n * mss;
 
-    if (!lotserver_turbo)
-        return false;
+    return n >= lo && n <= hi &&
+           (n == lo || base <= bytes) && (n == hi || bytes < base + mss);
+}
 
-    if (!lotserver_soft_turbo) {
-        ca->turbo_ignore_ref = LOTSPEED_TURBO_IGNORE_SPAN;
-        return true;
+// 速率换算的每秒包数：逐 ACK 的窗口与排空判断都要除以 mss，速率每个往返才变一次（启动中随交付速率上升），
+// 只在校验不通过（速率或 mss 变了）时做一次除法
+static inline u32 lotspeed_pkt_rate(struct lotspeed *ca, u64 rate, u32 mss)
+{
+    u64 bytes = rate << LOTSPEED_PKT_SHIFT;
+
+    if (unlikely(!lotspeed_div_ok(bytes, mss, ca->pkt_rate, 0, U32_MAX)))
+        ca->pkt_rate = (u32)min_t(u64, div_u64(bytes, mss), U32_MAX);
+    return ca->pkt_rate;
+}
+
+// 速率（字节/秒）× 时间（us）对应的包数，与精确除法最多差 1 个包（us 不超过 256 秒）
+static inline u32 lotspeed_rate_pkts(struct lotspeed *ca, u64 rate, u32 us, u32 mss)
+{
+    u32 pkt_rate = lotspeed_pkt_rate(ca, rate, mss);
+
+    // 每秒包数存不下（mss 1460 时约 196Gbps 以上）时直接除
+    if (unlikely(pkt_rate == U32_MAX))
+        return (u32)min_t(u64, div64_u64(rate * us, (u64)mss * USEC_PER_SEC), U32_MAX);
+    return (u32)min_t(u64, div_u64((u64)pkt_rate * us, USEC_PER_SEC << LOTSPEED_PKT_SHIFT), U32_MAX);
+}
+
+// 出口网卡速率缓存。ethtool 查询要持 RTNL，不能放在建连 / ACK 路径上，
+// 由 netdevice 通知链（调用时已持 RTNL）在注册、up、链路变化、改名时刷新；读侧走 RCU。
+// 只缓存报告了协商速率的网卡，lo / tun 等取不到速率的不占表项
+struct lotspeed_link {
+    struct hlist_node node;
+    struct rcu_head rcu;
+    const struct net_device *dev;   // 只作 key，不解引用
+    u64 rate;                       // 协商速率（字节/秒），0 = 链路断开等暂时未知
+    u8 slot;                        // 出口预算槽位，0 = 槽位用完、该网卡不设预算
+    char name[IFNAMSIZ];            // 供 debugfs 显示
+};
+
+// 出口预算：每块出口网卡一个槽，容量取链路缓存里的协商速率，
+// lotserver_egress_pct% 按权重分给经该网卡发送的活跃连接。
+// 权重按 CPU、按槽加减（init/release 可能落在不同 CPU，单个 CPU 上的值可以为负），
+// 每 LOTSPEED_BUDGET_REFRESH_MS 由该槽上恰好一个连接汇总一次，得到每单位权重的份额；
+// 逐 ACK 只做一次乘法，不加锁。槽位随链路缓存项在 RTNL 下分配和回收
+struct lotspeed_budget {
+    const struct net_device *dev;   // 占用该槽的网卡（只作 key），NULL = 空闲
+    u64 capacity;           // 网卡协商速率（字节/秒），链路缓存刷新时写入
+    u64 per_weight;         // 每单位权重的字节/秒
+    long weight;            // 最近一次汇总的活跃权重
+    unsigned long stamp;    // 最近一次汇总的 jiffies
+} ____cacheline_aligned;
+
+struct lotspeed_budget_weights {
+    long w[LOTSPEED_BUDGET_SLOTS];
+};
+
+static struct lotspeed_budget lotspeed_budgets[LOTSPEED_BUDGET_SLOTS];
+static DEFINE_PER_CPU(struct lotspeed_budget_weights, lotspeed_pcpu_weight);
+
+static struct hlist_head lotspeed_link_hash[1 << LOTSPEED_LINK_HASH_BITS];
+
+static inline struct hlist_head *lotspeed_link_bucket(const struct net_device *dev)
+{
+    return &lotspeed_link_hash[hash_ptr(dev, LOTSPEED_LINK_HASH_BITS)];
+}
+
+// 写侧（RTNL 下）查找
+static struct lotspeed_link *lotspeed_link_find(const struct net_device *dev)
+{
+    struct lotspeed_link *l;
+
+    hlist_for_each_entry(l, lotspeed_link_bucket(dev), node) {
+        if (l->dev == dev)
+            return l;
     }
+    return NULL;
+}
 
-    if (!ca->turbo_budget)
-        return false;
+static void lotspeed_link_update(struct net_device *dev)
+{
+    struct ethtool_link_ksettings ks;
+    struct lotspeed_link *l;
+    u64 rate = 0;
+
+    ASSERT_RTNL();
+
+    if (!__ethtool_get_link_ksettings(dev, &ks) &&
+        ks.base.speed && ks.base.speed != (u32)SPEED_UNKNOWN)
+        rate = (u64)ks.base.speed * 125000;     // Mbps -> 字节/秒
+
+    l = lotspeed_link_find(dev);
+    if (!l) {
+        int i;
+
+        if (!rate)
+            return;
+        l = kzalloc(sizeof(*l), GFP_KERNEL);
+        if (!l)
+            return;
+        l->dev = dev;
+        for (i = 1; i < LOTSPEED_BUDGET_SLOTS; i++) {
+            if (!lotspeed_budgets[i].dev) {
+                lotspeed_budgets[i].dev = dev;
+                l->slot = i;
+                break;
+            }
+        }
+        hlist_add_head_rcu(&l->node, lotspeed_link_bucket(dev));
+    }
+    WRITE_ONCE(l->rate, rate);
+    if (l->slot)
+        WRITE_ONCE(lotspeed_budgets[l->slot].capacity, rate);
+    strscpy(l->name, dev->name, sizeof(l->name));
+}
 
-    ca->turbo_budget--;
-    ca->turbo_ignore_ref = LOTSPEED_TURBO_IGNORE_SPAN;
-    if (lotserver_verbose) {
-        pr_info("lotspeed: soft turbo ignoring %s (budget=%u)\n",
-                reason, ca->turbo_budget);
+static void lotspeed_link_forget(struct net_device *dev)
+{
+    struct lotspeed_link *l;
+
+    ASSERT_RTNL();
+
+    l = lotspeed_link_find(dev);
+    if (l) {
+        // 仍记在该槽上的连接下一个往返重新查找出口网卡时迁走；
+        // 在此之前槽被别的网卡复用，只会让它们的权重短暂算在新网卡上
+        if (l->slot) {
+            WRITE_ONCE(lotspeed_budgets[l->slot].capacity, 0);
+            lotspeed_budgets[l->slot].dev = NULL;
+        }
+        hlist_del_rcu(&l->node);
+        kfree_rcu(l, rcu);
     }
+}
+
+// bond / team 的速率是成员之和：成员加入、离开或自身链路变化时一并刷新上层设备。
+// 注销通知链时内核会对每个设备重放 NETDEV_UNREGISTER，缓存随之清空
+static int lotspeed_netdev_event(struct notifier_block *nb, unsigned long event, void *ptr)
+{
+    struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+    struct netdev_notifier_changeupper_info *info;
+    struct net_device *upper;
+
+    switch (event) {
+    case NETDEV_REGISTER:
+    case NETDEV_UP:
+    case NETDEV_CHANGE:
+    case NETDEV_CHANGENAME:
+        lotspeed_link_update(dev);
+        upper = netdev_master_upper_dev_get(dev);
+        if (upper)
+            lotspeed_link_update(upper);
+        break;
+    case NETDEV_CHANGEUPPER:
+        info = ptr;
+        lotspeed_link_update(info->upper_dev);
+        break;
+    case NETDEV_UNREGISTER:
+        lotspeed_link_forget(dev);
+        break;
+    }
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block lotspeed_netdev_notifier = {
+    .notifier_call = lotspeed_netdev_event,
+};
+
+// 连接当前路由的出口网卡：返回协商速率（字节/秒，0 = 未知），slot 非空时一并取出口预算槽位
+static u64 lotspeed_link_lookup(struct sock *sk, u8 *slot)
+{
+    const struct lotspeed_link *l;
+    const struct dst_entry *dst;
+    u64 rate = 0;
+
+    if (slot)
+        *slot = 0;
+    rcu_read_lock();
+    dst = __sk_dst_get(sk);
+    if (dst && dst->dev) {
+        hlist_for_each_entry_rcu(l, lotspeed_link_bucket(dst->dev), node) {
+            if (l->dev == dst->dev) {
+                rate = READ_ONCE(l->rate);
+                if (slot)
+                    *slot = l->slot;
+                break;
+            }
+        }
+    }
+    rcu_read_unlock();
+    return rate;
+}
+
+static inline u64 lotspeed_link_rate(struct sock *sk)
+{
+    return lotspeed_link_lookup(sk, NULL);
+}
+
+// 自动速率：网卡协商速率的 lotserver_link_pct%
+static inline u64 lotspeed_link_target(const struct lotspeed_config *cfg, u64 link_rate)
+{
+    return div_u64(link_rate * clamp_t(u32, cfg->link_pct, 1, 100), 100);
+}
+
+// 按连接所属档案取参数。速率为 0 时取出口网卡协商速率的 lotserver_link_pct%，
+// 每次建连和每个往返结束时查一次缓存，多网卡主机上各连接按自己的出口网卡定速
+static inline u64 lotspeed_rate(struct sock *sk, const struct lotspeed_config *cfg)
+{
+    const struct lotspeed *ca = inet_csk_ca(sk);
+    u64 rate = ca->profile && ca->profile->rate ? ca->profile->rate : cfg->rate;
+
+    if (likely(rate))
+        return rate;
+
+    rate = lotspeed_link_rate(sk);
+    return rate ? lotspeed_link_target(cfg, rate) : LOTSPEED_RATE_FALLBACK;
+}
+
+static inline u32 lotspeed_gain(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    return ca->profile && ca->profile->gain ? ca->profile->gain : cfg->gain;
+}
+
+static inline u32 lotspeed_min_cwnd(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    return ca->profile && ca->profile->min_cwnd ? ca->profile->min_cwnd : cfg->min_cwnd;
+}
+
+static inline u32 lotspeed_max_cwnd(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    return ca->profile && ca->profile->max_cwnd ? ca->profile->max_cwnd : cfg->max_cwnd;
+}
+
+static inline u32 lotspeed_weight(const struct lotspeed *ca)
+{
+    return ca->profile ? ca->profile->weight : 1;
+}
+
+static inline bool lotspeed_turbo(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    return ca->profile && ca->profile->turbo >= 0 ? ca->profile->turbo : cfg->turbo;
+}
+
+static inline bool lotspeed_soft_turbo(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    return ca->profile && ca->profile->soft_turbo >= 0 ? ca->profile->soft_turbo :
+                                                         cfg->soft_turbo;
+}
+
+static inline u8 lotspeed_get_turbo_budget(const struct lotspeed *ca,
+                                           const struct lotspeed_config *cfg)
+{
+    return lotspeed_soft_turbo(ca, cfg) ?
+           (u8)clamp_t(unsigned int, cfg->soft_turbo_budget, 1U, 8U) : 0;
+}
 
+static inline void lotspeed_reset_turbo_budget(struct lotspeed *ca,
+                                               const struct lotspeed_config *cfg)
+{
+    ca->turbo_budget = lotspeed_get_turbo_budget(ca, cfg);
+}
+
+// 软涡轮：预算内的拥塞丢包片段整个忽略，出现无丢包的往返后预算恢复
+static inline bool lotspeed_turbo_ignore(struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    if (!lotspeed_turbo(ca, cfg) || !ca->turbo_budget)
+        return false;
+    ca->turbo_budget--;
     return true;
 }
 
@@ -109,13 +651,18 @@ static int param_set_rate(const char *val, const struct kernel_param *kp)
     unsigned long old_val = lotserver_rate;
     int ret = param_set_ulong(val, kp);
 
-    if (ret == 0 && old_val != lotserver_rate && lotserver_verbose) {
+    if (ret == 0 && old_val != lotserver_rate && lotspeed_verbose()) {
         unsigned long gbps_int = lotserver_rate / 125000000;
         unsigned long gbps_frac = (lotserver_rate % 125000000) * 100 / 125000000;
-        pr_info("lotspeed: [uk0@2025-11-19 17:06:58] rate changed: %lu -> %lu (%lu.%02lu Gbps)\n",
-                old_val, lotserver_rate, gbps_int, gbps_frac);
+
+        if (lotserver_rate)
+            pr_info("lotspeed: [uk0@2025-11-19 17:06:58] rate changed: %lu -> %lu (%lu.%02lu Gbps)\n",
+                    old_val, lotserver_rate, gbps_int, gbps_frac);
+        else
+            pr_info("lotspeed: [uk0@2025-11-19 17:06:58] rate changed: %lu -> auto (%u%% of link speed)\n",
+                    old_val, lotserver_link_pct);
     }
-    return ret;
+    return ret ? ret : lotspeed_config_commit();
 }
 
 // 参数变更回调 - 增益
@@ -124,13 +671,13 @@ static int param_set_gain(const char *val, const struct kernel_param *kp)
     unsigned int old_val = lotserver_gain;
     int ret = param_set_uint(val, kp);
 
-    if (ret == 0 && old_val != lotserver_gain && lotserver_verbose) {
+    if (ret == 0 && old_val != lotserver_gain && lotspeed_verbose()) {
         unsigned int gain_int = lotserver_gain / 10;
         unsigned int gain_frac = lotserver_gain % 10;
         pr_info("lotspeed: [uk0@2025-11-19 17:06:58] gain changed: %u -> %u (%u.%ux)\n",
                 old_val, lotserver_gain, gain_int, gain_frac);
     }
-    return ret;
+    return ret ? ret : lotspeed_config_commit();
 }
 
 // 参数变更回调 - 最小窗口
@@ -139,11 +686,11 @@ static int param_set_min_cwnd(const char *val, const struct kernel_param *kp)
     unsigned int old_val = lotserver_min_cwnd;
     int ret = param_set_uint(val, kp);
 
-    if (ret == 0 && old_val != lotserver_min_cwnd && lotserver_verbose) {
+    if (ret == 0 && old_val != lotserver_min_cwnd && lotspeed_verbose()) {
         pr_info("lotspeed: [uk0@2025-11-19 17:06:58] min_cwnd changed: %u -> %u\n",
                 old_val, lotserver_min_cwnd);
     }
-    return ret;
+    return ret ? ret : lotspeed_config_commit();
 }
 
 // 参数变更回调 - 最大窗口
@@ -152,11 +699,11 @@ static int param_set_max_cwnd(const char *val, const struct kernel_param *kp)
     unsigned int old_val = lotserver_max_cwnd;
     int ret = param_set_uint(val, kp);
 
-    if (ret == 0 && old_val != lotserver_max_cwnd && lotserver_verbose) {
+    if (ret == 0 && old_val != lotserver_max_cwnd && lotspeed_verbose()) {
         pr_info("lotspeed: [uk0@2025-11-19 17:06:58] max_cwnd changed: %u -> %u\n",
                 old_val, lotserver_max_cwnd);
     }
-    return ret;
+    return ret ? ret : lotspeed_config_commit();
 }
 
 // 参数变更回调 - 自适应模式
@@ -165,11 +712,11 @@ static int param_set_adaptive(const char *val, const struct kernel_param *kp)
     bool old_val = lotserver_adaptive;
     int ret = param_set_bool(val, kp);
 
-    if (ret == 0 && old_val != lotserver_adaptive && lotserver_verbose) {
+    if (ret == 0 && old_val != lotserver_adaptive && lotspeed_verbose()) {
         pr_info("lotspeed: [uk0@2025-11-19 17:06:58] adaptive mode: %s -> %s\n",
                 old_val ? "ON" : "OFF", lotserver_adaptive ? "ON" : "OFF");
     }
-    return ret;
+    return ret ? ret : lotspeed_config_commit();
 }
 
 // 参数变更回调 - 涡轮模式
@@ -178,7 +725,7 @@ static int param_set_turbo(const char *val, const struct kernel_param *kp)
     bool old_val = lotserver_turbo;
     int ret = param_set_bool(val, kp);
 
-    if (ret == 0 && old_val != lotserver_turbo && lotserver_verbose) {
+    if (ret == 0 && old_val != lotserver_turbo && lotspeed_verbose()) {
         if (lotserver_turbo) {
             pr_info("lotspeed: [uk0@2025-11-19 17:06:58] ⚡⚡⚡ TURBO MODE ACTIVATED ⚡⚡⚡\n");
             pr_info("lotspeed: WARNING: Ignoring ALL congestion signals!\n");
@@ -186,9 +733,106 @@ static int param_set_turbo(const char *val, const struct kernel_param *kp)
             pr_info("lotspeed: [uk0@2025-11-19 17:06:58] Turbo mode DEACTIVATED\n");
         }
     }
+    return ret ? ret : lotspeed_config_commit();
+}
+
+static void lotspeed_set_key(struct static_key_false *key, bool on)
+{
+    if (on)
+        static_branch_enable(key);
+    else
+        static_branch_disable(key);
+}
+
+// 参数变更回调 - 详细日志
+static int param_set_verbose(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_set_bool(val, kp);
+
+    if (ret == 0)
+        lotspeed_set_key(&lotspeed_verbose_key, lotserver_verbose);
+    return ret;
+}
+
+// 参数变更回调 - 直方图采集
+static int param_set_histograms(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_set_bool(val, kp);
+
+    if (ret == 0)
+        lotspeed_set_key(&lotspeed_hist_key, lotserver_histograms);
+    return ret;
+}
+
+static struct lotspeed_capture_hdr *lotspeed_capture_ring;
+static DEFINE_MUTEX(lotspeed_capture_mutex);
+
+// 环形缓冲区在第一次打开采集时分配，之后一直保留到模块卸载：
+// 用户态可能还映射着它，debugfs 文件的 owner 保证映射期间模块不会被卸载
+static int lotspeed_capture_alloc(void)
+{
+    struct lotspeed_capture_hdr *hdr;
+
+    if (lotspeed_capture_ring)
+        return 0;
+    hdr = vmalloc_user(LOTSPEED_CAPTURE_SIZE);
+    if (!hdr)
+        return -ENOMEM;
+    hdr->magic = LOTSPEED_CAPTURE_MAGIC;
+    hdr->version = LOTSPEED_CAPTURE_VERSION;
+    hdr->rec_size = sizeof(struct lotspeed_capture_rec);
+    hdr->nr_recs = LOTSPEED_CAPTURE_RECS;
+    hdr->hz = HZ;
+    smp_store_release(&lotspeed_capture_ring, hdr);
+    return 0;
+}
+
+// 参数变更回调 - 逐 ACK 采集
+static int param_set_capture(const char *val, const struct kernel_param *kp)
+{
+    u32 n;
+    int ret = kstrtou32(val, 0, &n);
+
+    if (ret)
+        return ret;
+    mutex_lock(&lotspeed_capture_mutex);
+    if (n)
+        ret = lotspeed_capture_alloc();
+    if (!ret) {
+        WRITE_ONCE(lotserver_capture, n);
+        lotspeed_set_key(&lotspeed_capture_key, n);
+    }
+    mutex_unlock(&lotspeed_capture_mutex);
     return ret;
 }
 
+// 其余控制律参数：写入后发布新快照
+static int param_set_cfg_uint(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_set_uint(val, kp);
+
+    return ret ? ret : lotspeed_config_commit();
+}
+
+static int param_set_cfg_bool(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_set_bool(val, kp);
+
+    return ret ? ret : lotspeed_config_commit();
+}
+
+static int param_set_cfg_array(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_array_ops.set(val, kp);
+
+    return ret ? ret : lotspeed_config_commit();
+}
+
+static int param_get_cfg_array(char *buffer, const struct kernel_param *kp)
+{
+    return param_array_ops.get(buffer, kp);
+}
+
 // 自定义参数操作
 static const struct kernel_param_ops param_ops_rate = {
         .set = param_set_rate,
@@ -220,12 +864,58 @@ static const struct kernel_param_ops param_ops_turbo = {
         .get = param_get_bool,
 };
 
+static const struct kernel_param_ops param_ops_verbose = {
+        .set = param_set_verbose,
+        .get = param_get_bool,
+};
+
+static const struct kernel_param_ops param_ops_histograms = {
+        .set = param_set_histograms,
+        .get = param_get_bool,
+};
+
+static const struct kernel_param_ops param_ops_capture = {
+        .set = param_set_capture,
+        .get = param_get_uint,
+};
+
+static const struct kernel_param_ops param_ops_cfg_uint = {
+        .set = param_set_cfg_uint,
+        .get = param_get_uint,
+};
+
+static const struct kernel_param_ops param_ops_cfg_bool = {
+        .set = param_set_cfg_bool,
+        .get = param_get_bool,
+};
+
+static const struct kernel_param_ops param_ops_cfg_array = {
+        .set = param_set_cfg_array,
+        .get = param_get_cfg_array,
+};
+
+// 增益循环参数是数组，沿用内核的数组解析，只把写入回调换成发布快照的版本
+#define LOTSPEED_CYCLE_ARRAY(name)                                      \
+    static const struct kparam_array name##_arr = {                     \
+        .max = LOTSPEED_PHASE_NR,                                       \
+        .elemsize = sizeof(unsigned int),                               \
+        .ops = &param_ops_uint,                                         \
+        .elem = name,                                                   \
+    }
+
+LOTSPEED_CYCLE_ARRAY(lotserver_cycle_pacing);
+LOTSPEED_CYCLE_ARRAY(lotserver_cycle_cwnd);
+LOTSPEED_CYCLE_ARRAY(lotserver_cycle_rtts);
+
 // 注册参数
 module_param(force_unload, bool, 0644);
-MODULE_PARM_DESC(force_unload, "Force unload module ignoring references");
+MODULE_PARM_DESC(force_unload, "Deprecated, no effect: module references already keep lotspeed loaded while connections use it");
 
 module_param_cb(lotserver_rate, &param_ops_rate, &lotserver_rate, 0644);
-MODULE_PARM_DESC(lotserver_rate, "Target rate in bytes/sec (default 1Gbps)");
+MODULE_PARM_DESC(lotserver_rate, "Target rate in bytes/sec (0 = derive from the egress link speed, default)");
+
+module_param_cb(lotserver_link_pct, &param_ops_cfg_uint, &lotserver_link_pct, 0644);
+MODULE_PARM_DESC(lotserver_link_pct, "Target rate as % of the egress link speed when lotserver_rate is 0 (1Gbps if unknown)");
 
 module_param_cb(lotserver_gain, &param_ops_gain, &lotserver_gain, 0644);
 MODULE_PARM_DESC(lotserver_gain, "Gain multiplier x10 (30 = 3.0x)");
@@ -242,345 +932,1967 @@ MODULE_PARM_DESC(lotserver_adaptive, "Enable adaptive rate control");
 module_param_cb(lotserver_turbo, &param_ops_turbo, &lotserver_turbo, 0644);
 MODULE_PARM_DESC(lotserver_turbo, "Turbo mode - ignore all congestion signals");
 
-module_param(lotserver_verbose, bool, 0644);
-MODULE_PARM_DESC(lotserver_verbose, "Enable verbose logging");
+module_param_cb(lotserver_verbose, &param_ops_verbose, &lotserver_verbose, 0644);
+MODULE_PARM_DESC(lotserver_verbose, "Enable verbose logging (per-ACK events go to tracepoints)");
+
+module_param_cb(lotserver_histograms, &param_ops_histograms, &lotserver_histograms, 0644);
+MODULE_PARM_DESC(lotserver_histograms, "Collect per-CPU RTT/cwnd/rate histograms (debugfs)");
+
+module_param_cb(lotserver_capture, &param_ops_capture, &lotserver_capture, 0644);
+MODULE_PARM_DESC(lotserver_capture, "Per-ACK capture into the debugfs ring: 0 = off, N = one flow in N");
+
+module_param(lotserver_capture_port, uint, 0644);
+MODULE_PARM_DESC(lotserver_capture_port, "Only capture flows with this local or remote port (0 = any)");
 
-module_param(lotserver_soft_turbo, bool, 0644);
+module_param_cb(lotserver_soft_turbo, &param_ops_cfg_bool, &lotserver_soft_turbo, 0644);
 MODULE_PARM_DESC(lotserver_soft_turbo, "Soft turbo - allow limited loss ignoring before backing off");
 
-module_param(lotserver_soft_turbo_budget, uint, 0644);
-MODULE_PARM_DESC(lotserver_soft_turbo_budget, "Number of consecutive losses Turbo mode may ignore");
+module_param_cb(lotserver_soft_turbo_budget, &param_ops_cfg_uint, &lotserver_soft_turbo_budget, 0644);
+MODULE_PARM_DESC(lotserver_soft_turbo_budget, "Number of consecutive loss episodes Turbo mode may ignore");
 
-// 统计信息
-static atomic_t active_connections = ATOMIC_INIT(0);
-static atomic64_t total_bytes_sent = ATOMIC64_INIT(0);
-static atomic_t total_losses = ATOMIC_INIT(0);
-static atomic_t module_ref_count = ATOMIC_INIT(0);
+module_param_cb(lotserver_loss_classify, &param_ops_cfg_bool, &lotserver_loss_classify, 0644);
+MODULE_PARM_DESC(lotserver_loss_classify, "Only back off on congestive losses; losses without queueing or delivery shortfall are ignored");
 
-struct lotspeed {
-    u64 target_rate;
-    u64 actual_rate;
-    u64 bw_window_max;
-    u64 last_update;
-    u64 bytes_sent;     // 添加字节统计
-    u64 start_time;     // 连接开始时间
-    u32 cwnd_gain;
-    u32 loss_count;
-    u32 rtt_min;
-    u32 rtt_cnt;
-    u32 bw_window_stamp;
-    u32 rtt_ema;
-    u32 rtt_var;
-    u32 probe_cnt;
-    bool ss_mode;
-    u8 turbo_budget;
-    u8 turbo_ignore_ref;
-    u8 reserved;
-};
+module_param_cb(lotserver_loss_rtt_pct, &param_ops_cfg_uint, &lotserver_loss_rtt_pct, 0644);
+MODULE_PARM_DESC(lotserver_loss_rtt_pct, "Loss is congestive if srtt exceeds rtt_min by more than this percent");
 
-static struct tcp_congestion_ops lotspeed_ops;
+module_param_cb(lotserver_loss_bw_pct, &param_ops_cfg_uint, &lotserver_loss_bw_pct, 0644);
+MODULE_PARM_DESC(lotserver_loss_bw_pct, "Loss is congestive if the delivery rate is below this percent of the target rate");
 
-// 初始化连接
-static void lotspeed_init(struct sock *sk)
-{
-    struct tcp_sock *tp = tcp_sk(sk);
-    struct lotspeed *ca = inet_csk_ca(sk);
-    memset(ca, 0, sizeof(*ca));
+module_param_cb(lotserver_loss_beta, &param_ops_cfg_uint, &lotserver_loss_beta, 0644);
+MODULE_PARM_DESC(lotserver_loss_beta, "Percent of cwnd_gain kept per round trip of congestive loss (undone if the loss was spurious)");
 
-    // 初始化状态
-    tp->snd_ssthresh = lotserver_turbo ? TCP_INFINITE_SSTHRESH : tp->snd_cwnd * 2;
-    ca->target_rate = lotserver_rate;
-    ca->actual_rate = 0;
-    ca->cwnd_gain = lotserver_gain;
-    ca->loss_count = 0;
-    ca->rtt_min = 0;
-    ca->rtt_cnt = 0;
-    ca->last_update = tcp_jiffies32;
-    ca->ss_mode = true;
-    ca->probe_cnt = 0;
-    ca->bytes_sent = 0;
-    ca->start_time = ktime_get_real_seconds();
-    ca->bw_window_stamp = tcp_jiffies32;
-    lotspeed_reset_turbo_budget(ca);
+module_param_cb(lotserver_startup_gain, &param_ops_cfg_uint, &lotserver_startup_gain, 0644);
+MODULE_PARM_DESC(lotserver_startup_gain, "Startup pacing and cwnd gain in percent (drain paces at the inverse)");
 
-    // 强制开启 pacing
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
-    cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
-#endif
+module_param_cb(lotserver_startup_rtt_pct, &param_ops_cfg_uint, &lotserver_startup_rtt_pct, 0644);
+MODULE_PARM_DESC(lotserver_startup_rtt_pct, "Leave startup once srtt exceeds rtt_min by more than this percent (0 = bandwidth plateau and loss only)");
 
-    atomic_inc(&active_connections);
-    atomic_inc(&module_ref_count);
+module_param_cb(lotserver_idle_halflife_ms, &param_ops_cfg_uint, &lotserver_idle_halflife_ms, 0644);
+MODULE_PARM_DESC(lotserver_idle_halflife_ms, "After idle, resume at the target rate halved once per this many ms of idle time and verify it round by round (0 = resume at the pre-idle rate)");
 
-    if (lotserver_verbose) {
-        unsigned long gbps_int = ca->target_rate / 125000000;
-        unsigned long gbps_frac = (ca->target_rate % 125000000) * 100 / 125000000;
-        unsigned int gain_int = ca->cwnd_gain / 10;
-        unsigned int gain_frac = ca->cwnd_gain % 10;
+module_param_cb(lotserver_egress_pct, &param_ops_cfg_uint, &lotserver_egress_pct, 0644);
+MODULE_PARM_DESC(lotserver_egress_pct, "Per egress NIC budget as % of its link speed, shared by weight among the flows on it (0 = off)");
 
-        pr_info("lotspeed: [uk0@2025-11-19 17:06:58] NEW connection #%d | rate=%lu.%02lu Gbps | gain=%u.%ux | mode=%s\n",
-                atomic_read(&active_connections),
-                gbps_int, gbps_frac,
-                gain_int, gain_frac,
-                lotserver_turbo ? "TURBO" : (lotserver_adaptive ? "adaptive" : "fixed"));
-    }
-}
+module_param_cb(lotserver_path_cache, &param_ops_cfg_bool, &lotserver_path_cache, 0644);
+MODULE_PARM_DESC(lotserver_path_cache, "Seed new flows from the per-destination-prefix path cache");
 
-// 释放连接
-static void lotspeed_release(struct sock *sk)
-{
-    struct lotspeed *ca = inet_csk_ca(sk);
-    u64 duration;
+module_param_cb(lotserver_path_ttl, &param_ops_cfg_uint, &lotserver_path_ttl, 0644);
+MODULE_PARM_DESC(lotserver_path_ttl, "Path cache entry lifetime in seconds");
 
-    // 添加空指针检查
-    if (!ca) {
-        pr_warn("lotspeed: [uk0@2025-11-19 17:06:58] release called with NULL ca\n");
-        atomic_dec(&active_connections);
-        return;
-    }
+module_param_cb(lotserver_path_prefix4, &param_ops_cfg_uint, &lotserver_path_prefix4, 0644);
+MODULE_PARM_DESC(lotserver_path_prefix4, "IPv4 prefix length used as path cache key (0-32)");
 
-    // 安全获取 duration
-    if (ca->start_time > 0) {
-        duration = ktime_get_real_seconds() - ca->start_time;
-    } else {
-        duration = 0;
-    }
+module_param_cb(lotserver_path_prefix6, &param_ops_cfg_uint, &lotserver_path_prefix6, 0644);
+MODULE_PARM_DESC(lotserver_path_prefix6, "IPv6 prefix length used as path cache key (0-128)");
 
-    atomic_dec(&active_connections);
+module_param_cb(lotserver_tso_burst_us, &param_ops_cfg_uint, &lotserver_tso_burst_us, 0644);
+MODULE_PARM_DESC(lotserver_tso_burst_us, "Max TSO burst in usec of pacing rate, also capped at rtt_min/4 (0 = kernel autosizing)");
 
-    // 只有在有数据时才更新统计
-    if (ca->bytes_sent > 0) {
-        atomic64_add(ca->bytes_sent, &total_bytes_sent);
-    }
-    if (ca->loss_count > 0) {
-        atomic_add(ca->loss_count, &total_losses);
-    }
+module_param_cb(lotserver_min_rtt_win_ms, &param_ops_cfg_uint, &lotserver_min_rtt_win_ms, 0644);
+MODULE_PARM_DESC(lotserver_min_rtt_win_ms, "Expire rtt_min after this many ms without a new minimum (0 = never)");
 
-    if (lotserver_verbose) {
-        pr_info("lotspeed: [uk0@2025-11-19 17:06:58] connection released, active=%d\n",
-                atomic_read(&active_connections));
-    }
+module_param_cb(lotserver_probe_rtt_ms, &param_ops_cfg_uint, &lotserver_probe_rtt_ms, 0644);
+MODULE_PARM_DESC(lotserver_probe_rtt_ms, "Drain phase length in ms when rtt_min expires (0 = no drain)");
 
-    // 清理 ca 结构
-    memset(ca, 0, sizeof(struct lotspeed));
+// 只能在加载时设置：TCP_CONG_NEEDS_ECN 是 lotspeed_ops 的标志，注册之后不能再改
+module_param(lotserver_ecn, bool, 0444);
+MODULE_PARM_DESC(lotserver_ecn, "DCTCP-style ECN mode: negotiate ECN and cut rate by the marked fraction (4.19+, load time only)");
+
+module_param_cb(lotserver_couple, &param_ops_cfg_uint, &lotserver_couple, 0644);
+MODULE_PARM_DESC(lotserver_couple, "Coupled groups sharing one rate: 0 = off, 1 = by destination address, 2 = by sk_mark (new connections)");
+
+module_param_cb(lotserver_cycle_pacing, &param_ops_cfg_array, (void *)&lotserver_cycle_pacing_arr, 0644);
+MODULE_PARM_DESC(lotserver_cycle_pacing, "Pacing gain in percent for the probe,drain,cruise phases");
+
+module_param_cb(lotserver_cycle_cwnd, &param_ops_cfg_array, (void *)&lotserver_cycle_cwnd_arr, 0644);
+MODULE_PARM_DESC(lotserver_cycle_cwnd, "Cwnd gain in percent for the probe,drain,cruise phases");
+
+module_param_cb(lotserver_cycle_rtts, &param_ops_cfg_array, (void *)&lotserver_cycle_rtts_arr, 0644);
+MODULE_PARM_DESC(lotserver_cycle_rtts, "Length in round trips of the probe,drain,cruise phases (0 = skip)");
+
+module_param_cb(lotserver_hold, &param_ops_cfg_bool, &lotserver_hold, 0644);
+MODULE_PARM_DESC(lotserver_hold, "1 = stage parameter writes, 0 = publish everything staged as one snapshot");
+
+// 统计信息：每 CPU 计数，读取（debugfs / 卸载）时再汇总，
+// 避免大量短连接在 init/release 时争抢同一条 cache line
+struct lotspeed_stats {
+    u64 conn_init;
+    u64 conn_release;
+    u64 bytes_sent;
+    u64 losses;             // 因拥塞丢包而退让的往返数
+    u64 ss_exits;           // 退出慢启动次数
+    u64 loss_episodes;      // 丢包片段数（从 Open / Disorder / CWR 进入 Recovery / Loss）
+    u64 turbo_ignored;      // 被涡轮模式忽略的丢包信号
+    u64 loss_random;        // 判定为随机丢包（不降速）的丢包片段
+    u64 loss_congestive;    // 判定为拥塞丢包的丢包片段
+    u64 loss_undos;         // 误判恢复时还原的丢包片段
+    u64 path_hits;          // 由路径缓存预热的新连接
+    u64 rtt_probes;         // rtt_min 过期后的排空次数
+    u64 ecn_cuts;           // ECN 模式下因标记而降速的往返数
+    u64 idle_restarts;      // 空闲后按衰减的估计恢复发送的次数
+    u64 idle_fallbacks;     // 空闲后回升中出现拥塞、退回启动的次数
+};
+
+static DEFINE_PER_CPU(struct lotspeed_stats, lotspeed_pcpu_stats);
+
+#define lotspeed_stat_inc(field)     this_cpu_inc(lotspeed_pcpu_stats.field)
+#define lotspeed_stat_add(field, v)  this_cpu_add(lotspeed_pcpu_stats.field, v)
+
+static void lotspeed_stats_fold(struct lotspeed_stats *sum)
+{
+    int cpu;
+
+    memset(sum, 0, sizeof(*sum));
+    for_each_possible_cpu(cpu) {
+        const struct lotspeed_stats *s = per_cpu_ptr(&lotspeed_pcpu_stats, cpu);
+
+        sum->conn_init += READ_ONCE(s->conn_init);
+        sum->conn_release += READ_ONCE(s->conn_release);
+        sum->bytes_sent += READ_ONCE(s->bytes_sent);
+        sum->losses += READ_ONCE(s->losses);
+        sum->ss_exits += READ_ONCE(s->ss_exits);
+        sum->loss_episodes += READ_ONCE(s->loss_episodes);
+        sum->turbo_ignored += READ_ONCE(s->turbo_ignored);
+        sum->loss_random += READ_ONCE(s->loss_random);
+        sum->loss_congestive += READ_ONCE(s->loss_congestive);
+        sum->loss_undos += READ_ONCE(s->loss_undos);
+        sum->path_hits += READ_ONCE(s->path_hits);
+        sum->rtt_probes += READ_ONCE(s->rtt_probes);
+        sum->ecn_cuts += READ_ONCE(s->ecn_cuts);
+        sum->idle_restarts += READ_ONCE(s->idle_restarts);
+        sum->idle_fallbacks += READ_ONCE(s->idle_fallbacks);
+    }
 }
 
-// 更新 RTT 统计
-static void lotspeed_update_rtt(struct sock *sk)
+// 活跃连接数 = 累计 init - 累计 release（跨 CPU 汇总，只在慢路径使用）
+static s64 lotspeed_active_connections(void)
 {
-    struct lotspeed *ca = inet_csk_ca(sk);
-    struct tcp_sock *tp = tcp_sk(sk);
-    u32 rtt_us = tp->srtt_us >> 3;
-    s32 delta;
-    u32 abs_delta;
+    struct lotspeed_stats sum;
 
-    if (!rtt_us || rtt_us == 0)
-        return;
+    lotspeed_stats_fold(&sum);
+    return (s64)(sum.conn_init - sum.conn_release);
+}
 
-    // 记录最小 RTT 作为基准
-    if (!ca->rtt_min || rtt_us < ca->rtt_min) {
-        ca->rtt_min = rtt_us;
-        if (lotserver_verbose && ca->rtt_cnt > 100) {
-            pr_debug("lotspeed: new min RTT: %u us\n", ca->rtt_min);
-        }
-    }
+// 直方图：每 CPU、按 2 的幂分桶，bucket i 覆盖 [2^(i-1), 2^i)，bucket 0 只计 0
+enum lotspeed_hist_id {
+    LOTSPEED_HIST_SRTT,         // us
+    LOTSPEED_HIST_RTT_INFL,     // (srtt - rtt_min) / rtt_min，百分比
+    LOTSPEED_HIST_CWND,         // 包
+    LOTSPEED_HIST_PACING,       // 字节/秒
+    LOTSPEED_HIST_DELIVERY,     // 字节/秒
+    LOTSPEED_HIST_NR,
+};
+
+#define LOTSPEED_HIST_BUCKETS   40
+
+struct lotspeed_hist {
+    u64 bucket[LOTSPEED_HIST_NR][LOTSPEED_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct lotspeed_hist, lotspeed_pcpu_hist);
+
+static const char * const lotspeed_hist_names[LOTSPEED_HIST_NR] = {
+    [LOTSPEED_HIST_SRTT]     = "srtt_us",
+    [LOTSPEED_HIST_RTT_INFL] = "rtt_inflation_pct",
+    [LOTSPEED_HIST_CWND]     = "cwnd_pkts",
+    [LOTSPEED_HIST_PACING]   = "pacing_rate_Bps",
+    [LOTSPEED_HIST_DELIVERY] = "delivery_rate_Bps",
+};
+
+static inline void lotspeed_hist_add(enum lotspeed_hist_id id, u64 val)
+{
+    u32 b = min_t(u32, fls64(val), LOTSPEED_HIST_BUCKETS - 1);
+
+    this_cpu_inc(lotspeed_pcpu_hist.bucket[id][b]);
+}
+
+// 只在 lotserver_histograms 打开时调用（static key 之后），除法开销不计入常态快路径
+static void lotspeed_hist_record(const struct lotspeed *ca, const struct rate_sample *rs,
+                                 u32 rtt_us, u32 cwnd, u64 pacing, u32 mss)
+{
+    u32 inflation = 0;
+
+    lotspeed_hist_add(LOTSPEED_HIST_SRTT, rtt_us);
+    if (ca->rtt_min && rtt_us > ca->rtt_min)
+        inflation = (u32)div_u64((u64)(rtt_us - ca->rtt_min) * 100, ca->rtt_min);
+    lotspeed_hist_add(LOTSPEED_HIST_RTT_INFL, inflation);
+    lotspeed_hist_add(LOTSPEED_HIST_CWND, cwnd);
+    lotspeed_hist_add(LOTSPEED_HIST_PACING, pacing);
+
+    if (rs && rs->delivered > 0 && rs->interval_us > 0)
+        lotspeed_hist_add(LOTSPEED_HIST_DELIVERY,
+                          div_u64((u64)rs->delivered * mss * USEC_PER_SEC,
+                                  (u32)rs->interval_us));
+}
+
+// 逐 ACK 采集：记录回调前的 tcp_sock / rate_sample 输入和回调后的决策，供离线回放。
+// 按 socket 地址哈希抽样，同一连接的回调要么全部采集要么全部不采集；
+// 中途修改 lotserver_capture 会让部分连接缺少 INIT 记录，回放时跳过这些连接
+struct lotspeed_capture_ctx {
+    struct lotspeed_capture_rec *rec;
+    u64 idx;
+};
+
+static bool lotspeed_capture_match(const struct sock *sk)
+{
+    u32 n = READ_ONCE(lotserver_capture);
+    u32 port = READ_ONCE(lotserver_capture_port);
+
+    if (!n)
+        return false;
+    if (port && port != sk->sk_num && port != ntohs(sk->sk_dport))
+        return false;
+    // 乘法代替取模：哈希值落在 [0, 2^32 / n) 内的连接被选中
+    return reciprocal_scale(hash_ptr(sk, 32), n) == 0;
+}
+
+static noinline void __lotspeed_capture_begin(struct sock *sk, u8 type, u8 arg,
+                                              const struct rate_sample *rs,
+                                              struct lotspeed_capture_ctx *cap)
+{
+    struct lotspeed_capture_hdr *hdr = smp_load_acquire(&lotspeed_capture_ring);
+    const struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed_capture_rec *rec;
+
+    if (!hdr || !lotspeed_capture_match(sk))
+        return;
+
+    // head 位于与用户态共享的页里，按 atomic64_t 访问
+    cap->idx = atomic64_inc_return((atomic64_t *)&hdr->head) - 1;
+    rec = (struct lotspeed_capture_rec *)((char *)hdr + LOTSPEED_CAPTURE_HDR_SIZE) +
+          (cap->idx & (LOTSPEED_CAPTURE_RECS - 1));
+    WRITE_ONCE(rec->seq, 0);
+    smp_wmb();
+
+    rec->flow = hash_ptr(sk, 32);
+    rec->stamp = tcp_jiffies32;
+    rec->type = type;
+    rec->arg = arg;
+    rec->ecn_flags = tp->ecn_flags;
+    rec->rs_flags = 0;
+    rec->snd_cwnd = tp->snd_cwnd;
+    rec->snd_ssthresh = tp->snd_ssthresh;
+    rec->snd_cwnd_clamp = tp->snd_cwnd_clamp;
+    rec->prior_cwnd = tp->prior_cwnd;
+    rec->srtt_us = tp->srtt_us;
+    rec->mss_cache = tp->mss_cache;
+    rec->delivered = tp->delivered;
+    rec->delivered_ce = tp->delivered_ce;
+    memset(&rec->rs, 0, sizeof(rec->rs));
+
+    if (rs) {
+        rec->rs.delivered = rs->delivered;
+        rec->rs.losses = rs->losses;
+        rec->rs.interval_us = (s32)rs->interval_us;
+        rec->rs.rtt_us = (s32)rs->rtt_us;
+        rec->rs.prior_delivered = rs->prior_delivered;
+        rec->rs.prior_in_flight = rs->prior_in_flight;
+        rec->rs.acked_sacked = rs->acked_sacked;
+        if (rs->is_app_limited)
+            rec->rs_flags |= LOTSPEED_CAPTURE_APP_LIMITED;
+        if (rs->is_ece)
+            rec->rs_flags |= LOTSPEED_CAPTURE_ECE;
+    } else if (type == LOTSPEED_CAPTURE_INIT) {
+        rec->id.family = sk->sk_family;
+        rec->id.sport = sk->sk_num;
+        rec->id.dport = ntohs(sk->sk_dport);
+        rec->id.mark = sk->sk_mark;
+        rec->id.link_mbps = (u32)div_u64(lotspeed_link_rate(sk), 125000);
+#if IS_ENABLED(CONFIG_IPV6)
+        if (sk->sk_family == AF_INET6)
+            memcpy(rec->id.daddr, &sk->sk_v6_daddr, sizeof(rec->id.daddr));
+        else
+#endif
+            rec->id.daddr[0] = sk->sk_daddr;
+    } else if (type == LOTSPEED_CAPTURE_EVENT) {
+        rec->ev.lsndtime = tp->lsndtime;
+    }
+    cap->rec = rec;
+}
+
+static noinline void __lotspeed_capture_end(struct sock *sk, struct lotspeed_capture_ctx *cap,
+                                            u32 ret)
+{
+    const struct tcp_sock *tp = tcp_sk(sk);
+    const struct lotspeed *ca = inet_csk_ca(sk);
+    struct lotspeed_capture_rec *rec = cap->rec;
+
+    rec->cwnd = tp->snd_cwnd;
+    rec->ssthresh = tp->snd_ssthresh;
+    rec->ret = ret;
+    rec->cwnd_gain = ca->cwnd_gain;
+    rec->loss_count = ca->loss_count;
+    rec->phase = ca->cycle_phase;
+    rec->ss_mode = ca->ss_mode;
+    rec->pacing_rate = READ_ONCE(sk->sk_pacing_rate);
+    rec->target_rate = ca->target_rate;
+    smp_store_release(&rec->seq, cap->idx + 1);
+}
+
+// 采集关闭时两者都只剩一条被打补丁跳过的指令
+static __always_inline void lotspeed_capture_begin(struct sock *sk, u8 type, u8 arg,
+                                                   const struct rate_sample *rs,
+                                                   struct lotspeed_capture_ctx *cap)
+{
+    if (static_branch_unlikely(&lotspeed_capture_key))
+        __lotspeed_capture_begin(sk, type, arg, rs, cap);
+}
+
+static __always_inline void lotspeed_capture_end(struct sock *sk,
+                                                 struct lotspeed_capture_ctx *cap, u32 ret)
+{
+    if (unlikely(cap->rec))
+        __lotspeed_capture_end(sk, cap, ret);
+}
+
+static void lotspeed_budget_fold(struct lotspeed_budget *b, const struct lotspeed_config *cfg,
+                                 unsigned int slot)
+{
+    u32 pct = min_t(u32, cfg->egress_pct, 100);
+    u64 budget = div_u64(READ_ONCE(b->capacity) * pct, 100);
+    long weight = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        weight += READ_ONCE(per_cpu_ptr(&lotspeed_pcpu_weight, cpu)->w[slot]);
+
+    WRITE_ONCE(b->weight, weight);
+    WRITE_ONCE(b->per_weight, budget ? div64_u64(budget, max(weight, 1L)) : 0);
+}
+
+static inline void lotspeed_budget_join(struct lotspeed *ca, u8 slot)
+{
+    ca->budget_slot = slot;
+    this_cpu_add(lotspeed_pcpu_weight.w[slot], lotspeed_weight(ca));
+}
+
+static inline void lotspeed_budget_leave(const struct lotspeed *ca)
+{
+    this_cpu_sub(lotspeed_pcpu_weight.w[ca->budget_slot], lotspeed_weight(ca));
+}
+
+// 路由换了出口网卡：权重从原来的槽移到新槽
+static void lotspeed_budget_refresh(struct sock *sk, struct lotspeed *ca)
+{
+    u8 slot;
+
+    lotspeed_link_lookup(sk, &slot);
+    if (slot != ca->budget_slot) {
+        lotspeed_budget_leave(ca);
+        lotspeed_budget_join(ca, slot);
+    }
+}
+
+// 本连接当前可用的速率份额，0 = 未启用预算或出口网卡速率未知
+static u64 lotspeed_budget_cap(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    struct lotspeed_budget *b;
+    unsigned long stamp;
+
+    if (!ca->budget_slot || !cfg->egress_pct)
+        return 0;
+
+    b = &lotspeed_budgets[ca->budget_slot];
+    stamp = READ_ONCE(b->stamp);
+    if (time_after(jiffies, stamp + msecs_to_jiffies(LOTSPEED_BUDGET_REFRESH_MS)) &&
+        cmpxchg(&b->stamp, stamp, jiffies) == stamp)
+        lotspeed_budget_fold(b, cfg, ca->budget_slot);
+
+    return READ_ONCE(b->per_weight) * lotspeed_weight(ca);
+}
+
+// 本连接的速率上限：lotspeed_rate() 与出口预算份额取小
+static inline u64 lotspeed_rate_ceiling(const struct lotspeed *ca,
+                                        const struct lotspeed_config *cfg, u64 max_rate)
+{
+    u64 cap = lotspeed_budget_cap(ca, cfg);
+
+    return cap ? min(max_rate, cap) : max_rate;
+}
+
+// 路径缓存：按目的网段记录上一条连接学到的 rtt_min / 带宽 / 增益，
+// 新连接据此跳过慢启动。读侧（init）走 RCU，写侧（release）持锁并以替换代替原地改 key。
+struct lotspeed_path_key {
+    u32 addr[4];        // 已按前缀掩码，IPv4 只用 addr[0]
+    u16 family;
+    u16 plen;
+};
+
+struct lotspeed_path {
+    struct hlist_node node;
+    struct rcu_head rcu;
+    struct lotspeed_path_key key;
+    u64 bw;             // 字节/秒
+    u32 rtt_min;        // us
+    u32 cwnd_gain;
+    unsigned long stamp;
+};
+
+static struct hlist_head lotspeed_path_hash[1 << LOTSPEED_PATH_HASH_BITS];
+static DEFINE_SPINLOCK(lotspeed_path_lock);
+
+// 取目的地址，v4-mapped 的 IPv6 按 IPv4 处理；返回地址族，0 表示无法识别
+static u16 lotspeed_sk_daddr(const struct sock *sk, u32 addr[4])
+{
+    memset(addr, 0, 4 * sizeof(u32));
+
+#if IS_ENABLED(CONFIG_IPV6)
+    if (sk->sk_family == AF_INET6 && !ipv6_addr_v4mapped(&sk->sk_v6_daddr)) {
+        memcpy(addr, &sk->sk_v6_daddr, 4 * sizeof(u32));
+        return AF_INET6;
+    }
+#endif
+    if (sk->sk_family == AF_INET || sk->sk_family == AF_INET6) {
+        addr[0] = sk->sk_family == AF_INET ? sk->sk_daddr :
+                  sk->sk_v6_daddr.s6_addr32[3];
+        return AF_INET;
+    }
+    return 0;
+}
+
+// 就地按前缀掩码
+static void lotspeed_addr_mask(u16 family, u32 addr[4], unsigned int plen)
+{
+    if (family == AF_INET) {
+        addr[0] = plen ? addr[0] & htonl(~0U << (32 - min(plen, 32U))) : 0;
+    } else {
+        struct in6_addr pfx;
+
+        ipv6_addr_prefix(&pfx, (const struct in6_addr *)addr, min(plen, 128U));
+        memcpy(addr, &pfx, sizeof(pfx));
+    }
+}
+
+static bool lotspeed_path_key(const struct sock *sk, const struct lotspeed_config *cfg,
+                              struct lotspeed_path_key *key)
+{
+    memset(key, 0, sizeof(*key));
+
+    key->family = lotspeed_sk_daddr(sk, key->addr);
+    if (!key->family)
+        return false;
+
+    key->plen = key->family == AF_INET ?
+                min_t(unsigned int, cfg->path_prefix4, 32) :
+                min_t(unsigned int, cfg->path_prefix6, 128);
+    lotspeed_addr_mask(key->family, key->addr, key->plen);
+    return true;
+}
+
+static inline struct hlist_head *lotspeed_path_bucket(const struct lotspeed_path_key *key)
+{
+    u32 hash = jhash2(key->addr, ARRAY_SIZE(key->addr),
+                      ((u32)key->family << 16) | key->plen);
+
+    return &lotspeed_path_hash[hash >> (32 - LOTSPEED_PATH_HASH_BITS)];
+}
+
+static inline bool lotspeed_path_fresh(const struct lotspeed_path *p,
+                                       const struct lotspeed_config *cfg)
+{
+    return time_before(jiffies, READ_ONCE(p->stamp) + cfg->path_ttl * HZ);
+}
+
+// 新连接预热：目标速率取缓存带宽（不低于自适应降速的下限），直接进入正常阶段
+static void lotspeed_path_seed(struct sock *sk, struct lotspeed *ca,
+                               const struct lotspeed_config *cfg)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed_path_key key;
+    struct lotspeed_path *p;
+    u32 mss = tp->mss_cache ? tp->mss_cache : 1460;
+    u64 bw = 0;
+    u32 rtt_min = 0, gain = 0;
+    u64 max_rate;
+
+    if (!cfg->path_cache || !lotspeed_path_key(sk, cfg, &key))
+        return;
+
+    rcu_read_lock();
+    hlist_for_each_entry_rcu(p, lotspeed_path_bucket(&key), node) {
+        if (!memcmp(&p->key, &key, sizeof(key)) && lotspeed_path_fresh(p, cfg)) {
+            bw = READ_ONCE(p->bw);
+            rtt_min = READ_ONCE(p->rtt_min);
+            gain = READ_ONCE(p->cwnd_gain);
+            break;
+        }
+    }
+    rcu_read_unlock();
+
+    if (!bw || !rtt_min)
+        return;
+
+    max_rate = lotspeed_rate(sk, cfg);
+    ca->target_rate = clamp_t(u64, bw, max_rate / 4, lotspeed_rate_ceiling(ca, cfg, max_rate));
+    ca->rtt_min = rtt_min;
+    ca->rtt_min_stamp = tcp_jiffies32;
+    ca->bw_ema = lotspeed_bw_from_bytes(bw);
+    minmax_reset(&ca->bw_max, ca->round_count, ca->bw_ema);
+    ca->cwnd_gain = clamp_t(u32, gain, LOTSPEED_MIN_GAIN, lotspeed_gain(ca, cfg));
+    ca->ss_mode = false;
+
+    // 一个 rtt_min 的 BDP 作为起始窗口，由 pacing 摊平突发
+    tp->snd_cwnd = max_t(u32, tp->snd_cwnd,
+                         min_t(u32, (u32)div64_u64(ca->target_rate * rtt_min,
+                                                   (u64)mss * USEC_PER_SEC),
+                               min_t(u32, lotspeed_max_cwnd(ca, cfg), tp->snd_cwnd_clamp)));
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+    sk->sk_pacing_rate = ca->target_rate + (ca->target_rate >> 2);
+#endif
+    lotspeed_stat_inc(path_hits);
+}
+
+// 连接结束时写回：桶满则替换最久未更新的一项
+static void lotspeed_path_record(struct sock *sk, const struct lotspeed *ca,
+                                 const struct lotspeed_config *cfg)
+{
+    struct lotspeed_path_key key;
+    struct lotspeed_path *p, *oldest = NULL, *np;
+    struct hlist_head *head;
+    u64 bw = lotspeed_bw_bytes(minmax_get(&ca->bw_max));
+    int depth = 0;
+
+    if (!cfg->path_cache || !ca->rtt_min || !bw ||
+        !lotspeed_path_key(sk, cfg, &key))
+        return;
+
+    head = lotspeed_path_bucket(&key);
+
+    spin_lock_bh(&lotspeed_path_lock);
+    hlist_for_each_entry(p, head, node) {
+        if (!memcmp(&p->key, &key, sizeof(key))) {
+            // 仍有效的记录与本次结果平均，避免一条异常连接覆盖历史
+            if (lotspeed_path_fresh(p, cfg)) {
+                bw = (p->bw + bw) >> 1;
+                WRITE_ONCE(p->rtt_min, min(p->rtt_min, ca->rtt_min));
+            } else {
+                WRITE_ONCE(p->rtt_min, ca->rtt_min);
+            }
+            WRITE_ONCE(p->bw, bw);
+            WRITE_ONCE(p->cwnd_gain, ca->cwnd_gain);
+            WRITE_ONCE(p->stamp, jiffies);
+            goto out;
+        }
+        if (!oldest || time_before(p->stamp, oldest->stamp))
+            oldest = p;
+        depth++;
+    }
+
+    np = kzalloc(sizeof(*np), GFP_ATOMIC | __GFP_NOWARN);
+    if (!np)
+        goto out;
+    np->key = key;
+    np->bw = bw;
+    np->rtt_min = ca->rtt_min;
+    np->cwnd_gain = ca->cwnd_gain;
+    np->stamp = jiffies;
+
+    if (depth >= LOTSPEED_PATH_DEPTH) {
+        hlist_replace_rcu(&oldest->node, &np->node);
+        kfree_rcu(oldest, rcu);
+    } else {
+        hlist_add_head_rcu(&np->node, head);
+    }
+out:
+    spin_unlock_bh(&lotspeed_path_lock);
+}
+
+// 模块卸载时调用，此时已没有连接在读
+static void lotspeed_path_flush(void)
+{
+    struct lotspeed_path *p;
+    struct hlist_node *n;
+    int i;
+
+    spin_lock_bh(&lotspeed_path_lock);
+    for (i = 0; i < ARRAY_SIZE(lotspeed_path_hash); i++) {
+        hlist_for_each_entry_safe(p, n, &lotspeed_path_hash[i], node) {
+            hlist_del_rcu(&p->node);
+            kfree_rcu(p, rcu);
+        }
+    }
+    spin_unlock_bh(&lotspeed_path_lock);
+}
+
+// 耦合组：同一目的地址（或同一 sk_mark）的并行连接共用一个组速率，按成员数均分。
+// 每条连接仍按自己的交付速率和丢包做调整，但调整量记到组速率上，组速率不超过单条连接的速率上限：
+// N 条并行连接合在一起像一条连接那样探测和退让，不会因为连接数把瓶颈压垮 N 倍。
+// 成员加入 / 离开时组速率不变，只是份额重新均分；份额在每个往返结束时刷新，逐 ACK 路径不加锁。
+struct lotspeed_group_key {
+    u32 addr[4];        // 按目的地址分组时使用
+    u32 mark;           // 按 sk_mark 分组时使用
+    u16 family;         // 0 = 按 sk_mark
+    u16 pad;
+};
+
+struct lotspeed_group {
+    struct lotspeed_group_key key;
+    u32 members;        // 0 = 空槽位
+    u64 rate;           // 组速率（字节/秒），所有成员份额之和
+    spinlock_t lock;    // 保护 rate
+};
+
+static struct lotspeed_group lotspeed_groups[1 << LOTSPEED_GROUP_BITS];
+static DEFINE_SPINLOCK(lotspeed_group_lock);    // 保护槽位分配与 members
+
+static bool lotspeed_group_key(const struct sock *sk, const struct lotspeed_config *cfg,
+                               struct lotspeed_group_key *key)
+{
+    memset(key, 0, sizeof(*key));
+
+    switch (cfg->couple) {
+    case LOTSPEED_COUPLE_DST:
+        key->family = lotspeed_sk_daddr(sk, key->addr);
+        return key->family != 0;
+    case LOTSPEED_COUPLE_MARK:
+        key->mark = READ_ONCE(sk->sk_mark);
+        return key->mark != 0;
+    default:
+        return false;
+    }
+}
+
+static inline struct lotspeed_group *lotspeed_group_get(const struct lotspeed *ca)
+{
+    return ca->group ? &lotspeed_groups[ca->group - 1] : NULL;
+}
+
+static inline u64 lotspeed_group_share(const struct lotspeed_group *grp)
+{
+    return div64_u64(READ_ONCE(grp->rate), max_t(u32, READ_ONCE(grp->members), 1));
+}
+
+// 新连接加入（或新建）所属的组，目标速率改为组内份额；新建组时组速率取本连接的初始目标速率
+static void lotspeed_group_join(struct sock *sk, struct lotspeed *ca,
+                                const struct lotspeed_config *cfg)
+{
+    struct lotspeed_group_key key;
+    struct lotspeed_group *grp, *free = NULL;
+    u32 hash;
+    int i;
+
+    if (!lotspeed_group_key(sk, cfg, &key))
+        return;
+
+    hash = jhash2((const u32 *)&key, sizeof(key) / sizeof(u32), 0);
+
+    spin_lock_bh(&lotspeed_group_lock);
+    for (i = 0; i < LOTSPEED_GROUP_PROBE; i++) {
+        grp = &lotspeed_groups[(hash + i) & ((1 << LOTSPEED_GROUP_BITS) - 1)];
+        if (!grp->members) {
+            if (!free)
+                free = grp;
+            continue;
+        }
+        if (!memcmp(&grp->key, &key, sizeof(key)))
+            goto join;
+    }
+    grp = free;
+    if (!grp)
+        goto out;
+    grp->key = key;
+    WRITE_ONCE(grp->rate, ca->target_rate);
+join:
+    WRITE_ONCE(grp->members, grp->members + 1);
+    ca->group = grp - lotspeed_groups + 1;
+    ca->target_rate = lotspeed_group_share(grp);
+out:
+    spin_unlock_bh(&lotspeed_group_lock);
+}
+
+// 离开时组速率保持不变，剩下的成员在各自下一个往返结束时分到更大的份额
+static void lotspeed_group_leave(struct lotspeed *ca)
+{
+    struct lotspeed_group *grp = lotspeed_group_get(ca);
+
+    if (!grp)
+        return;
+
+    spin_lock_bh(&lotspeed_group_lock);
+    WRITE_ONCE(grp->members, grp->members - 1);
+    spin_unlock_bh(&lotspeed_group_lock);
+    ca->group = 0;
+}
+
+// 成员调整了自己的份额（old_rate -> target_rate），把变化量记到组速率上。
+// 组速率不超过单条连接的速率上限，也不低于本成员当前的份额
+static void lotspeed_group_adjust(struct sock *sk, const struct lotspeed_config *cfg, u64 old_rate)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct lotspeed_group *grp = lotspeed_group_get(ca);
+    u64 rate;
+
+    if (!grp || ca->target_rate == old_rate)
+        return;
+
+    spin_lock_bh(&grp->lock);
+    rate = grp->rate;
+    if (ca->target_rate > old_rate)
+        rate = min(rate + (ca->target_rate - old_rate), lotspeed_rate(sk, cfg));
+    else
+        rate -= min(rate, old_rate - ca->target_rate);
+    WRITE_ONCE(grp->rate, max(rate, ca->target_rate));
+    spin_unlock_bh(&grp->lock);
+}
+
+// 策略表：lotserver_profiles 定义档案，lotserver_rules 按顺序匹配（首条命中生效）。
+// 两个参数任一改动都会整体重建并以 RCU 发布，旧表在宽限期后释放；
+// 档案本身带引用计数，已建立的连接继续使用旧档案直到结束。
+struct lotspeed_rule {
+    u32 addr[4];            // 已按 plen 掩码
+    u16 family;             // 0 = 不限目的地址
+    u16 plen;
+    u16 sport;              // 本地端口，0 = 不限
+    u16 dport;              // 远端端口，0 = 不限
+    u32 mark;
+    u32 mark_mask;          // 0 = 不限 sk_mark
+    u64 cgroup;             // cgroup v2 id，0 = 不限
+    struct lotspeed_profile *profile;
+};
+
+struct lotspeed_policy {
+    struct rcu_head rcu;
+    char *profiles_text;
+    char *rules_text;
+    unsigned int nr_profiles;
+    unsigned int nr_rules;
+    struct lotspeed_profile *profiles[LOTSPEED_MAX_PROFILES];
+    struct lotspeed_rule rules[LOTSPEED_MAX_RULES];
+};
+
+static struct lotspeed_policy __rcu *lotspeed_policy;
+static DEFINE_MUTEX(lotspeed_policy_mutex);
+
+static void lotspeed_profile_put(struct lotspeed_profile *prof)
+{
+    if (prof && refcount_dec_and_test(&prof->ref))
+        kfree(prof);
+}
+
+static void lotspeed_policy_free(struct lotspeed_policy *pol)
+{
+    unsigned int i;
+
+    if (!pol)
+        return;
+    for (i = 0; i < pol->nr_profiles; i++)
+        lotspeed_profile_put(pol->profiles[i]);
+    kfree(pol->profiles_text);
+    kfree(pol->rules_text);
+    kfree(pol);
+}
+
+static void lotspeed_policy_free_rcu(struct rcu_head *head)
+{
+    lotspeed_policy_free(container_of(head, struct lotspeed_policy, rcu));
+}
+
+static struct lotspeed_profile *lotspeed_policy_find(const struct lotspeed_policy *pol,
+                                                     const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < pol->nr_profiles; i++)
+        if (!strcmp(pol->profiles[i]->name, name))
+            return pol->profiles[i];
+    return NULL;
+}
+
+// 档案格式：name:key=val,key=val;name2:...
+// key 取 rate（字节/秒）、gain、min_cwnd、max_cwnd、turbo、soft_turbo、weight
+static int lotspeed_parse_profile(struct lotspeed_policy *pol, char *entry)
+{
+    struct lotspeed_profile *prof;
+    char *name = strsep(&entry, ":");
+    char *opt;
+    int ret = 0;
+
+    name = strim(name);
+    if (!*name || strlen(name) >= LOTSPEED_PROFILE_NAME_LEN ||
+        lotspeed_policy_find(pol, name))
+        return -EINVAL;
+    if (pol->nr_profiles >= LOTSPEED_MAX_PROFILES)
+        return -ENOSPC;
+
+    prof = kzalloc(sizeof(*prof), GFP_KERNEL);
+    if (!prof)
+        return -ENOMEM;
+    refcount_set(&prof->ref, 1);
+    strscpy(prof->name, name, sizeof(prof->name));
+    prof->weight = 1;
+    prof->turbo = -1;
+    prof->soft_turbo = -1;
+    pol->profiles[pol->nr_profiles++] = prof;
+
+    while (entry && (opt = strsep(&entry, ",")) != NULL) {
+        char *val;
+        bool b;
+
+        opt = strim(opt);
+        if (!*opt)
+            continue;
+        val = strchr(opt, '=');
+        if (!val)
+            return -EINVAL;
+        *val++ = '\0';
+
+        if (!strcmp(opt, "rate")) {
+            ret = kstrtou64(val, 0, &prof->rate);
+        } else if (!strcmp(opt, "gain")) {
+            ret = kstrtou32(val, 0, &prof->gain);
+        } else if (!strcmp(opt, "min_cwnd")) {
+            ret = kstrtou32(val, 0, &prof->min_cwnd);
+        } else if (!strcmp(opt, "max_cwnd")) {
+            ret = kstrtou32(val, 0, &prof->max_cwnd);
+        } else if (!strcmp(opt, "weight")) {
+            ret = kstrtou32(val, 0, &prof->weight);
+        } else if (!strcmp(opt, "turbo")) {
+            ret = kstrtobool(val, &b);
+            prof->turbo = ret ? -1 : b;
+        } else if (!strcmp(opt, "soft_turbo")) {
+            ret = kstrtobool(val, &b);
+            prof->soft_turbo = ret ? -1 : b;
+        } else {
+            ret = -EINVAL;
+        }
+        if (ret)
+            return ret;
+    }
+
+    if (!prof->weight)
+        return -EINVAL;
+    return 0;
+}
+
+static int lotspeed_parse_prefix(struct lotspeed_rule *rule, char *val)
+{
+    char *slash = strchr(val, '/');
+    unsigned int max_plen;
+
+    if (slash)
+        *slash++ = '\0';
+    if (in4_pton(val, -1, (u8 *)rule->addr, -1, NULL)) {
+        rule->family = AF_INET;
+        max_plen = 32;
+    } else if (in6_pton(val, -1, (u8 *)rule->addr, -1, NULL)) {
+        rule->family = AF_INET6;
+        max_plen = 128;
+    } else {
+        return -EINVAL;
+    }
+
+    rule->plen = max_plen;
+    if (slash) {
+        u16 plen;
+
+        if (kstrtou16(slash, 10, &plen) || plen > max_plen)
+            return -EINVAL;
+        rule->plen = plen;
+    }
+    lotspeed_addr_mask(rule->family, rule->addr, rule->plen);
+    return 0;
+}
+
+// 规则格式：dst=10.0.0.0/8 dport=443 sport=.. mark=0x10[/0xff] cgroup=ID profile=name;...
+static int lotspeed_parse_rule(struct lotspeed_policy *pol, char *entry)
+{
+    struct lotspeed_rule *rule;
+    char *opt;
+    int ret = 0;
+
+    if (pol->nr_rules >= LOTSPEED_MAX_RULES)
+        return -ENOSPC;
+    rule = &pol->rules[pol->nr_rules];
+    memset(rule, 0, sizeof(*rule));
+
+    while ((opt = strsep(&entry, " \t,")) != NULL) {
+        char *val;
+
+        if (!*opt)
+            continue;
+        val = strchr(opt, '=');
+        if (!val)
+            return -EINVAL;
+        *val++ = '\0';
+
+        if (!strcmp(opt, "dst")) {
+            ret = lotspeed_parse_prefix(rule, val);
+        } else if (!strcmp(opt, "sport")) {
+            ret = kstrtou16(val, 0, &rule->sport);
+        } else if (!strcmp(opt, "dport")) {
+            ret = kstrtou16(val, 0, &rule->dport);
+        } else if (!strcmp(opt, "mark")) {
+            char *mask = strchr(val, '/');
+
+            if (mask)
+                *mask++ = '\0';
+            rule->mark_mask = ~0U;
+            ret = kstrtou32(val, 0, &rule->mark);
+            if (!ret && mask)
+                ret = kstrtou32(mask, 0, &rule->mark_mask);
+            rule->mark &= rule->mark_mask;
+        } else if (!strcmp(opt, "cgroup")) {
+            ret = kstrtou64(val, 0, &rule->cgroup);
+        } else if (!strcmp(opt, "profile")) {
+            rule->profile = lotspeed_policy_find(pol, val);
+            if (!rule->profile)
+                ret = -ENOENT;
+        } else {
+            ret = -EINVAL;
+        }
+        if (ret)
+            return ret;
+    }
+
+    if (!rule->profile)
+        return -EINVAL;
+    pol->nr_rules++;
+    return 0;
+}
+
+// 解析一段以 ';' 或换行分隔的文本，空条目忽略
+static int lotspeed_parse_list(struct lotspeed_policy *pol, const char *text,
+                               int (*parse)(struct lotspeed_policy *, char *))
+{
+    char *buf, *cur, *entry;
+    int ret = 0;
+
+    buf = kstrdup(text, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    cur = buf;
+    while ((entry = strsep(&cur, ";\n")) != NULL) {
+        entry = strim(entry);
+        if (!*entry)
+            continue;
+        ret = parse(pol, entry);
+        if (ret)
+            break;
+    }
+    kfree(buf);
+    return ret;
+}
+
+// 复制并去掉首尾空白（sysfs 写入通常带换行）
+static char *lotspeed_strdup_trim(const char *text)
+{
+    char *buf = kstrdup(skip_spaces(text), GFP_KERNEL);
+
+    if (buf)
+        strim(buf);
+    return buf;
+}
+
+// 用新的档案或规则文本（NULL = 保持当前）重建并发布策略表
+static int lotspeed_policy_update(const char *profiles, const char *rules)
+{
+    struct lotspeed_policy *old, *pol;
+    int ret;
+
+    mutex_lock(&lotspeed_policy_mutex);
+    old = rcu_dereference_protected(lotspeed_policy,
+                                    lockdep_is_held(&lotspeed_policy_mutex));
+
+    pol = kzalloc(sizeof(*pol), GFP_KERNEL);
+    if (!pol) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    pol->profiles_text = lotspeed_strdup_trim(profiles ? profiles :
+                                              old ? old->profiles_text : "");
+    pol->rules_text = lotspeed_strdup_trim(rules ? rules :
+                                           old ? old->rules_text : "");
+    if (!pol->profiles_text || !pol->rules_text) {
+        ret = -ENOMEM;
+        goto err;
+    }
+
+    ret = lotspeed_parse_list(pol, pol->profiles_text, lotspeed_parse_profile);
+    if (!ret)
+        ret = lotspeed_parse_list(pol, pol->rules_text, lotspeed_parse_rule);
+    if (ret)
+        goto err;
+
+    rcu_assign_pointer(lotspeed_policy, pol);
+    if (old)
+        call_rcu(&old->rcu, lotspeed_policy_free_rcu);
+    goto out;
+
+err:
+    lotspeed_policy_free(pol);
+out:
+    mutex_unlock(&lotspeed_policy_mutex);
+    return ret;
+}
+
+static u64 lotspeed_sk_cgroup(const struct sock *sk)
+{
+#if defined(CONFIG_SOCK_CGROUP_DATA) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    return cgroup_id(sock_cgroup_ptr(&sk->sk_cgrp_data));
+#else
+    return 0;
+#endif
+}
+
+static bool lotspeed_rule_match(const struct lotspeed_rule *rule, const struct sock *sk,
+                                u16 family, const u32 daddr[4])
+{
+    if (rule->family) {
+        u32 addr[4];
+
+        if (rule->family != family)
+            return false;
+        memcpy(addr, daddr, sizeof(addr));
+        lotspeed_addr_mask(family, addr, rule->plen);
+        if (memcmp(addr, rule->addr, sizeof(addr)))
+            return false;
+    }
+    if (rule->sport && rule->sport != sk->sk_num)
+        return false;
+    if (rule->dport && rule->dport != ntohs(sk->sk_dport))
+        return false;
+    if (rule->mark_mask && (sk->sk_mark & rule->mark_mask) != rule->mark)
+        return false;
+    if (rule->cgroup && rule->cgroup != lotspeed_sk_cgroup(sk))
+        return false;
+    return true;
+}
+
+// init 时调用一次：返回命中的档案（已加引用），没有命中返回 NULL
+static struct lotspeed_profile *lotspeed_policy_lookup(const struct sock *sk)
+{
+    const struct lotspeed_policy *pol;
+    struct lotspeed_profile *prof = NULL;
+    u32 daddr[4];
+    u16 family;
+    unsigned int i;
+
+    if (!rcu_access_pointer(lotspeed_policy))
+        return NULL;
+
+    family = lotspeed_sk_daddr(sk, daddr);
+
+    rcu_read_lock();
+    pol = rcu_dereference(lotspeed_policy);
+    for (i = 0; pol && i < pol->nr_rules; i++) {
+        if (lotspeed_rule_match(&pol->rules[i], sk, family, daddr)) {
+            prof = pol->rules[i].profile;
+            // 策略表持有引用直到 RCU 宽限期结束，这里一定不为 0
+            refcount_inc(&prof->ref);
+            break;
+        }
+    }
+    rcu_read_unlock();
+
+    return prof;
+}
+
+static int param_set_profiles(const char *val, const struct kernel_param *kp)
+{
+    return lotspeed_policy_update(val, NULL);
+}
+
+static int param_set_rules(const char *val, const struct kernel_param *kp)
+{
+    return lotspeed_policy_update(NULL, val);
+}
+
+static int lotspeed_policy_get(char *buffer, bool rules)
+{
+    const struct lotspeed_policy *pol;
+    int len;
+
+    mutex_lock(&lotspeed_policy_mutex);
+    pol = rcu_dereference_protected(lotspeed_policy,
+                                    lockdep_is_held(&lotspeed_policy_mutex));
+    len = scnprintf(buffer, PAGE_SIZE, "%s\n",
+                    !pol ? "" : rules ? pol->rules_text : pol->profiles_text);
+    mutex_unlock(&lotspeed_policy_mutex);
+    return len;
+}
+
+static int param_get_profiles(char *buffer, const struct kernel_param *kp)
+{
+    return lotspeed_policy_get(buffer, false);
+}
+
+static int param_get_rules(char *buffer, const struct kernel_param *kp)
+{
+    return lotspeed_policy_get(buffer, true);
+}
+
+static const struct kernel_param_ops param_ops_profiles = {
+        .set = param_set_profiles,
+        .get = param_get_profiles,
+};
+
+static const struct kernel_param_ops param_ops_rules = {
+        .set = param_set_rules,
+        .get = param_get_rules,
+};
+
+module_param_cb(lotserver_profiles, &param_ops_profiles, NULL, 0644);
+MODULE_PARM_DESC(lotserver_profiles, "Policy profiles: name:rate=,gain=,min_cwnd=,max_cwnd=,turbo=,soft_turbo=,weight=;...");
+
+module_param_cb(lotserver_rules, &param_ops_rules, NULL, 0644);
+MODULE_PARM_DESC(lotserver_rules, "Policy rules, first match wins: dst=PREFIX sport= dport= mark=V[/M] cgroup=ID profile=NAME;...");
+
+// 模块卸载时调用，此时已没有连接持有档案
+static void lotspeed_policy_flush(void)
+{
+    struct lotspeed_policy *pol;
+
+    mutex_lock(&lotspeed_policy_mutex);
+    pol = rcu_dereference_protected(lotspeed_policy,
+                                    lockdep_is_held(&lotspeed_policy_mutex));
+    RCU_INIT_POINTER(lotspeed_policy, NULL);
+    mutex_unlock(&lotspeed_policy_mutex);
+
+    // 等待 call_rcu 回调（旧策略表）全部执行完
+    rcu_barrier();
+    lotspeed_policy_free(pol);
+}
+
+// 增益循环重新从巡航开始（慢启动 / 空闲重启之后）
+static void lotspeed_reset_cycle(struct lotspeed *ca)
+{
+    ca->cycle_phase = LOTSPEED_PHASE_CRUISE;
+    ca->cycle_rtts = 0;
+}
+
+// 结束启动（排空中结束的已在 lotspeed_startup_exit() 计过数）
+static inline void lotspeed_leave_slow_start(struct lotspeed *ca)
+{
+    if (ca->ss_mode) {
+        if (ca->cycle_phase != LOTSPEED_PHASE_DRAIN)
+            lotspeed_stat_inc(ss_exits);
+        ca->ss_mode = false;
+    }
+}
+
+// 启动的初始速率：第一个往返的窗口（初始窗口与 lotserver_min_cwnd 的较大者）
+// 在一个 srtt（握手测得，没有时按 1ms）内发完。空闲重启时 snd_cwnd 还是空闲前的窗口，
+// 调用方与 tcp_cwnd_restart() 一样传入不超过 TCP_INIT_CWND 的窗口
+static u64 lotspeed_initial_rate(const struct sock *sk, const struct lotspeed *ca,
+                                 const struct lotspeed_config *cfg, u32 init_cwnd)
+{
+    const struct tcp_sock *tp = tcp_sk(sk);
+    u32 rtt_us = tp->srtt_us ? max_t(u32, tp->srtt_us >> 3, 1) : USEC_PER_MSEC;
+    u32 mss = tp->mss_cache ? tp->mss_cache : 1460;
+    u32 cwnd = max_t(u32, init_cwnd, lotspeed_min_cwnd(ca, cfg));
+
+    return div_u64((u64)cwnd * mss * USEC_PER_SEC, rtt_us);
+}
+
+// 空闲重启的速率下限：以此重新启动不比新连接更激进
+static u64 lotspeed_idle_floor(const struct sock *sk, const struct lotspeed *ca,
+                               const struct lotspeed_config *cfg)
+{
+    return lotspeed_initial_rate(sk, ca, cfg, min_t(u32, tcp_sk(sk)->snd_cwnd, TCP_INIT_CWND));
+}
+
+// 初始化连接
+static void lotspeed_init_impl(struct sock *sk, const struct lotspeed_config *cfg)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    u8 budget_slot;
+
+    memset(ca, 0, sizeof(*ca));
+    ca->cfg_gen = cfg->gen;
+
+    // 匹配策略规则，之后所有参数都按所属档案读取
+    ca->profile = lotspeed_policy_lookup(sk);
+    lotspeed_link_lookup(sk, &budget_slot);
+    lotspeed_budget_join(ca, budget_slot);
+
+    // 初始化状态
+    // 启动由 ss_mode 与管道已满检测控制，不依赖 ssthresh；自适应模式从初始窗口对应的速率起步
+    tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+    ca->target_rate = lotspeed_rate_ceiling(ca, cfg, lotspeed_rate(sk, cfg));
+    ca->rate_ceiling = lotspeed_bw_from_bytes(ca->target_rate);
+    if (cfg->adaptive)
+        ca->target_rate = min(ca->target_rate, lotspeed_initial_rate(sk, ca, cfg, tp->snd_cwnd));
+    ca->bw_ema = 0;
+    ca->cwnd_gain = lotspeed_gain(ca, cfg);
+    ca->loss_count = 0;
+    ca->rtt_min = 0;
+    ca->ss_mode = true;
+    ca->cycle_phase = LOTSPEED_PHASE_CRUISE;
+    ca->next_rtt_delivered = tp->delivered;
+    lotspeed_reset_turbo_budget(ca, cfg);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
+    // 同 DCTCP，alpha 从 1 起步：第一次出现标记就减半，不必等 EWMA 收敛
+    ca->ecn_alpha = 1U << LOTSPEED_ECN_SHIFT;
+    ca->ecn_prior_ce = tp->delivered_ce;
+    ca->ecn_rcv_nxt = tp->rcv_nxt;
+#endif
+
+    // 同网段有近期学习结果时直接预热，跳过慢启动
+    lotspeed_path_seed(sk, ca, cfg);
+
+    // 耦合组：目标速率改为组速率中的份额
+    lotspeed_group_join(sk, ca, cfg);
+
+    // 强制开启 pacing
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+    cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
+#endif
+
+    lotspeed_stat_inc(conn_init);
+
+    if (lotspeed_verbose()) {
+        unsigned long gbps_int = ca->target_rate / 125000000;
+        unsigned long gbps_frac = (ca->target_rate % 125000000) * 100 / 125000000;
+        unsigned int gain_int = ca->cwnd_gain / 10;
+        unsigned int gain_frac = ca->cwnd_gain % 10;
+
+        pr_info("lotspeed: [uk0@2025-11-19 17:06:58] NEW connection #%lld | rate=%lu.%02lu Gbps | gain=%u.%ux | mode=%s\n",
+                lotspeed_active_connections(),
+                gbps_int, gbps_frac,
+                gain_int, gain_frac,
+                lotspeed_turbo(ca, cfg) ? "TURBO" : (cfg->adaptive ? "adaptive" : "fixed"));
+    }
+}
+
+static void lotspeed_init(struct sock *sk)
+{
+    struct lotspeed_capture_ctx cap = {};
+
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_INIT, 0, NULL, &cap);
+    lotspeed_init_impl(sk, lotspeed_cfg_get());
+    lotspeed_capture_end(sk, &cap, 0);
+    rcu_read_unlock();
+}
+
+// 释放连接
+static void lotspeed_release_impl(struct sock *sk, const struct lotspeed_config *cfg)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+
+    // 添加空指针检查
+    if (!ca) {
+        pr_warn("lotspeed: [uk0@2025-11-19 17:06:58] release called with NULL ca\n");
+        lotspeed_stat_inc(conn_release);
+        return;
+    }
+
+    lotspeed_stat_inc(conn_release);
+
+    lotspeed_path_record(sk, ca, cfg);
+    lotspeed_group_leave(ca);
+    lotspeed_budget_leave(ca);
+    lotspeed_profile_put(ca->profile);
+
+    // 只有在有数据时才更新统计（bytes_acked 由协议栈按字节精确累计）
+    if (tcp_sk(sk)->bytes_acked > 0) {
+        lotspeed_stat_add(bytes_sent, tcp_sk(sk)->bytes_acked);
+    }
+
+    if (lotspeed_verbose()) {
+        pr_info("lotspeed: [uk0@2025-11-19 17:06:58] connection released, active=%lld\n",
+                lotspeed_active_connections());
+    }
+
+    // 清理 ca 结构
+    memset(ca, 0, sizeof(struct lotspeed));
+}
+
+// RELEASE 记录的是释放前的最终状态
+static void lotspeed_release(struct sock *sk)
+{
+    struct lotspeed_capture_ctx cap = {};
+
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_RELEASE, 0, NULL, &cap);
+    lotspeed_capture_end(sk, &cap, 0);
+    lotspeed_release_impl(sk, lotspeed_cfg_get());
+    rcu_read_unlock();
+}
+
+// 更新 RTT 统计
+//
+// rtt_min 是窗口内的最小值：超过 lotserver_min_rtt_win_ms 没有测到更小的 RTT 就以当前 srtt 重新起算，
+// 并进入一次排空阶段（见 lotspeed_cong_control_impl），让瓶颈队列清空后测到真实的传播时延。
+// 路由切到更长的路径后不会再因旧基准一直判定为 RTT 膨胀，把 cwnd_gain 压到底。
+static void lotspeed_update_rtt(struct sock *sk, const struct lotspeed_config *cfg)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct tcp_sock *tp = tcp_sk(sk);
+    u32 rtt_us = tp->srtt_us >> 3;
+    u32 now = tcp_jiffies32;
+    u32 win_ms = cfg->min_rtt_win_ms;
+    u32 probe_ms = cfg->probe_rtt_ms;
+    bool expired;
+
+    if (!rtt_us || rtt_us == 0)
+        return;
+
+    expired = win_ms && ca->rtt_min &&
+              time_after32(now, ca->rtt_min_stamp + (u32)msecs_to_jiffies(win_ms));
+
+    // 记录窗口内最小 RTT 作为基准（排空中 rtt_min_stamp 存的是结束时间，结束时再刷新）
+    if (!ca->rtt_min || rtt_us <= ca->rtt_min || expired) {
+        ca->rtt_min = rtt_us;
+        if (!ca->probe_rtt)
+            ca->rtt_min_stamp = now;
+    }
+
+    // 每个窗口最多排空一次，至少持续一个 RTT；慢启动中队列本来就短，只重设基准
+    if (expired && probe_ms && !ca->probe_rtt && !ca->ss_mode) {
+        u32 len = max_t(u32, msecs_to_jiffies(probe_ms),
+                        msecs_to_jiffies(DIV_ROUND_UP(rtt_us, 1000)));
+
+        ca->probe_rtt = 1;
+        ca->rtt_min_stamp = now + len;
+        lotspeed_stat_inc(rtt_probes);
+    } else if (ca->probe_rtt && time_after32(now, ca->rtt_min_stamp)) {
+        ca->probe_rtt = 0;
+        ca->rtt_min_stamp = now;
+    }
+}
+
+// 逐 ACK：只累积本往返的样本，返回 true 表示本 ACK 开始了一个新往返（上一往返已结束）。
+// 往返边界按 rs->prior_delivered 判定：本 ACK 确认的数据发出时已越过上一轮的边界。
+// 交付速率样本先用乘法与本往返的最大值比较，只有出现新的最大值时才做一次除法。
+static bool lotspeed_update_round(struct sock *sk, const struct rate_sample *rs)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct tcp_sock *tp = tcp_sk(sk);
+    bool round_end = false;
+    u64 bytes;
+    u32 bw;
+
+    if (!rs)
+        return false;
+
+    if (rs->delivered > 0 && !before(rs->prior_delivered, ca->next_rtt_delivered)) {
+        ca->next_rtt_delivered = tp->delivered;
+        round_end = true;
+    }
+
+    // 随机丢包片段内的丢包不算本往返的拥塞信号（协议栈先处理丢包再调 cong_control，此时已分类）
+    if (rs->losses > 0 && !(ca->flags & LOTSPEED_LOSS_RANDOM))
+        ca->flags |= LOTSPEED_ROUND_LOSS;
+
+    if (rs->delivered <= 0 || rs->interval_us <= 0)
+        return round_end;
+
+    // 字节/秒 >> LOTSPEED_BW_SHIFT 与 round_bw × interval 比较（都不会溢出 u64）
+    bytes = (u64)rs->delivered * tp->mss_cache * USEC_PER_SEC;
+    if ((bytes >> LOTSPEED_BW_SHIFT) <= (u64)ca->round_bw * (u32)rs->interval_us)
+        return round_end;
+
+    bw = lotspeed_bw_from_bytes(div_u64(bytes, (u32)rs->interval_us));
+
+    // 应用层没有数据可发时，样本只反映应用速率而非路径容量：只在高于当前估计时采用
+    if (!rs->is_app_limited || bw >= minmax_get(&ca->bw_max))
+        ca->round_bw = bw;
+    return round_end;
+}
+
+// 丢包退让：cwnd_gain 按 lotserver_loss_beta 缩小一次。每个拥塞丢包片段（进入 Recovery / Loss 开始，回到 Open 结束）
+// 在开始时退让一次，之后每个仍有丢包的往返再退让一次；Recovery / Loss 状态切换与 CA_EVENT_LOSS
+// 不再各自退让，同一次丢包不会被重复惩罚
+static void lotspeed_loss_cut(struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    u32 beta = min_t(u32, cfg->loss_beta, 100);
+
+    lotspeed_count_loss(ca);
+    lotspeed_stat_inc(losses);
+    ca->cwnd_gain = max_t(u32, ca->cwnd_gain * beta / 100, LOTSPEED_MIN_GAIN);
+}
+
+// 启动结束，转入排空：ss_mode 保留，cycle_phase 置为 DRAIN，pacing 取启动增益的倒数，
+// 在途量降到 rtt_min 下的一个 BDP 以内（启动造成的排队已排空）后进入增益循环。
+// 固定速率模式的启动只是窗口爬坡，没有超发的速率需要排空，直接结束
+static void lotspeed_startup_exit(struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    if (!ca->ss_mode || ca->cycle_phase == LOTSPEED_PHASE_DRAIN)
+        return;
+    if (!cfg->adaptive) {
+        lotspeed_leave_slow_start(ca);
+        return;
+    }
+    ca->cycle_phase = LOTSPEED_PHASE_DRAIN;
+    ca->cycle_rtts = 0;
+    lotspeed_stat_inc(ss_exits);
+}
+
+// 启动中的时延检查（逐 ACK）：srtt 高出 rtt_min 超过 lotserver_startup_rtt_pct%（至少 1ms）
+// 说明瓶颈开始排队。浅缓冲在速率越过瓶颈的那个往返内就会溢出，等到往返结束再查就晚了
+static bool lotspeed_startup_queued(const struct lotspeed *ca, const struct lotspeed_config *cfg,
+                                    u32 rtt_us)
+{
+    u32 rtt_pct = cfg->startup_rtt_pct;
+
+    return rtt_pct && ca->rtt_min &&
+           rtt_us > ca->rtt_min + max_t(u32, ca->rtt_min / 100 * rtt_pct, LOTSPEED_STARTUP_RTT_SLACK);
+}
+
+// 启动阶段的往返结束：目标速率跟随交付速率窗口最大值，按启动增益 pacing 时每个往返约翻倍。
+// 排空中只跟随不判断：这期间确认的仍是启动最后一个往返发出的包。
+// 连续 LOTSPEED_FULL_BW_RTTS 个往返交付速率增长不到 25%（管道已满）或目标速率到达上限时结束启动；
+// 时延上升见 lotspeed_startup_queued()，拥塞丢包在片段开始时（lotspeed_loss_episode()）直接结束启动
+static void lotspeed_startup_round(struct sock *sk, const struct lotspeed_config *cfg, u32 bw,
+                                   u32 prev_max, u64 ceiling)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    u64 old_rate = ca->target_rate;
+
+    ca->target_rate = max(ca->target_rate, lotspeed_bw_bytes(minmax_get(&ca->bw_max)));
+    if (ca->target_rate != old_rate)
+        trace_lotspeed_adapt(sk, old_rate, ca->target_rate, lotspeed_bw_bytes(bw), ca->cwnd_gain);
+
+    // 在途量迟迟降不下来（应用在排空中补发、ACK 聚合）时最多排空 LOTSPEED_FULL_BW_RTTS 个往返
+    if (ca->cycle_phase == LOTSPEED_PHASE_DRAIN) {
+        if (++ca->cycle_rtts >= LOTSPEED_FULL_BW_RTTS) {
+            lotspeed_leave_slow_start(ca);
+            lotspeed_reset_cycle(ca);
+        }
+        return;
+    }
+
+    // 应用受限、没有有效样本的往返不计入
+    if (bw) {
+        if ((u64)bw * 100 >= (u64)prev_max * LOTSPEED_FULL_BW_PCT)
+            ca->cycle_rtts = 0;
+        else if (ca->cycle_rtts < U8_MAX)
+            ca->cycle_rtts++;
+    }
+
+    if (ca->cycle_rtts >= LOTSPEED_FULL_BW_RTTS || ca->target_rate >= ceiling)
+        lotspeed_startup_exit(ca, cfg);
+}
+
+// 空闲重启后的回升（每个往返，从重启后发出的包算起）：出现排队或拥塞丢包说明恢复的速率
+// 已高于路径现在的容量，丢掉旧估计，从本往返测到的交付速率（没有有效样本时从初始速率）重新启动；
+// 否则目标速率翻倍，回到交付速率窗口最大值（空闲前的估计）后交还给正常的调整
+static void lotspeed_idle_round(struct sock *sk, const struct lotspeed_config *cfg, u32 bw,
+                                bool round_loss, u32 rtt_us, u64 ceiling)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    u64 old_rate = ca->target_rate;
+    u64 max_bw;
+
+    if (round_loss || lotspeed_startup_queued(ca, cfg, rtt_us)) {
+        ca->target_rate = min(lotspeed_idle_floor(sk, ca, cfg), old_rate);
+        if (bw)
+            ca->target_rate = max(ca->target_rate, min(lotspeed_bw_bytes(bw), old_rate));
+        ca->bw_ema = lotspeed_bw_from_bytes(ca->target_rate);
+        minmax_reset(&ca->bw_max, ca->round_count, bw);
+        ca->ss_mode = true;
+        ca->idle_resume = 0;
+        lotspeed_reset_cycle(ca);
+        lotspeed_stat_inc(idle_fallbacks);
+    } else {
+        max_bw = min(lotspeed_bw_bytes(minmax_get(&ca->bw_max)), ceiling);
+        ca->target_rate = max(min(old_rate * 2, max_bw), old_rate);
+        if (ca->target_rate >= max_bw)
+            ca->idle_resume = 0;
+    }
+    if (ca->target_rate != old_rate)
+        trace_lotspeed_adapt(sk, old_rate, ca->target_rate, lotspeed_bw_bytes(bw), ca->cwnd_gain);
+}
+
+// 每个往返结束时做一次完整的调整：带宽估计、目标速率、cwnd_gain。
+// 调整幅度按往返计算，不再随 ACK 频率变化：40Gbps 和 10Mbps 的连接以同样的节奏收敛，
+// 延迟 ACK / 聚合 ACK 也不会放大或缩小步长。
+static void lotspeed_adapt_rate(struct sock *sk, const struct lotspeed_config *cfg,
+                                const struct rate_sample *rs)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct tcp_sock *tp = tcp_sk(sk);
+    u64 filtered_bw;
+    u32 rtt_us = tp->srtt_us >> 3;
+    u32 min_rtt = ca->rtt_min ? ca->rtt_min : rtt_us;
+    bool ecn = rs && rs->is_ece;
+    u32 mss = tp->mss_cache ? tp->mss_cache : 1460;
+    u64 max_rate, ceiling;
+    bool round_loss = ca->flags & LOTSPEED_ROUND_LOSS;
+    bool persistent = round_loss && (ca->flags & LOTSPEED_LOSS_PREV);
+    u32 bw = ca->round_bw;
+    u32 prev_max = minmax_get(&ca->bw_max);
+    struct lotspeed_group *grp = lotspeed_group_get(ca);
+    u64 share = 0;
+
+    // 出口网卡可能随路由变化，每个往返重新确认预算槽位
+    if (cfg->egress_pct)
+        lotspeed_budget_refresh(sk, ca);
+    max_rate = lotspeed_rate(sk, cfg);
+    ceiling = lotspeed_rate_ceiling(ca, cfg, max_rate);
+    ca->rate_ceiling = lotspeed_bw_from_bytes(ceiling);
+
+    ca->round_count++;
+    ca->round_bw = 0;
+    ca->flags &= ~(LOTSPEED_ROUND_LOSS | LOTSPEED_LOSS_PREV);
+    if (round_loss)
+        ca->flags |= LOTSPEED_LOSS_PREV;
+
+    // 丢包片段内：本往返有丢包且还没退让过（片段开始的往返已在 lotspeed_loss_episode() 中退让）则退让一次。
+    // 一个无丢包的往返之后软涡轮预算恢复
+    if (ca->flags & LOTSPEED_LOSS_EPISODE) {
+        if (round_loss && !(ca->flags & LOTSPEED_LOSS_CUT))
+            lotspeed_loss_cut(ca, cfg);
+        ca->flags &= ~LOTSPEED_LOSS_CUT;
+    } else if (!round_loss) {
+        lotspeed_reset_turbo_budget(ca, cfg);
+    }
+
+    // RTT 的 EMA 与平均偏差（逐往返，增益 1/8 与 1/4）
+    if (rtt_us) {
+        if (!ca->rtt_ema) {
+            ca->rtt_ema = rtt_us;
+            ca->rtt_var = rtt_us >> 3;
+        } else {
+            s32 delta = (s32)rtt_us - (s32)ca->rtt_ema;
+            u32 abs_delta = delta < 0 ? -delta : delta;
+
+            ca->rtt_ema += delta >> 3;
+            ca->rtt_var += ((s32)abs_delta - (s32)ca->rtt_var) >> 2;
+        }
+    }
+
+    // 耦合组：先取回组速率中的最新份额，速率上限也按成员数均分
+    if (grp) {
+        share = lotspeed_group_share(grp);
+        ca->target_rate = share;
+        ceiling = min(ceiling, div64_u64(max_rate,
+                                         max_t(u32, READ_ONCE(grp->members), 1)));
+    }
+
+    if (!cfg->adaptive) {
+        // 不自适应时目标速率固定为上限（预算份额随连接数变化）
+        ca->target_rate = ceiling;
+        goto rtt_check;
+    }
+
+    // 本往返的最大样本进入窗口最大值滤波器和 EMA
+    if (bw) {
+        minmax_running_max(&ca->bw_max, LOTSPEED_BW_RTTS, ca->round_count, bw);
+        if (!ca->bw_ema) {
+            ca->bw_ema = bw;
+        } else {
+            ca->bw_ema -= ca->bw_ema >> LOTSPEED_BW_EMA_SHIFT;
+            ca->bw_ema += bw >> LOTSPEED_BW_EMA_SHIFT;
+        }
+    }
+
+    filtered_bw = lotspeed_bw_bytes(ca->bw_ema);
+
+    if (ca->ss_mode) {
+        lotspeed_startup_round(sk, cfg, bw, prev_max, ceiling);
+    } else if (ca->idle_resume) {
+        lotspeed_idle_round(sk, cfg, bw, round_loss, rtt_us, ceiling);
+    } else if (filtered_bw) {
+        // 如果实际速率远低于目标且存在丢包，快速降速（不低于上限的 1/4，也不会因此升速）。
+        // 丢包片段内的交付样本被重传压低，只有连续两个往返有丢包才降，且增益已按往返退让过，
+        // 只降速率（记下以便误判恢复时还原）
+        if (filtered_bw < ca->target_rate / 2 && ca->loss_count > 0) {
+            u64 old_rate = ca->target_rate;
+            u64 cut = min(old_rate, max_t(u64, filtered_bw * 15 / 10, ceiling / 4));
+
+            if (!(ca->flags & LOTSPEED_LOSS_EPISODE)) {
+                ca->target_rate = cut;
+                ca->cwnd_gain = max_t(u32, ca->cwnd_gain - 5, LOTSPEED_MIN_GAIN);
+            } else if (persistent) {
+                ca->target_rate = cut;
+                ca->loss_rate_cut = 1;
+            }
+            if (ca->target_rate != old_rate)
+                trace_lotspeed_adapt(sk, old_rate, ca->target_rate, filtered_bw, ca->cwnd_gain);
+        }
+        // 表现良好，每往返最多翻倍，不超过窗口最大值；丢过包的连接只在增益循环的探测阶段
+        //（且该往返无丢包）提升，ECN 模式下上一个往返有标记时不提升
+        else if ((ca->loss_count == 0 ||
+                  (ca->cycle_phase == LOTSPEED_PHASE_PROBE && !round_loss)) &&
+                 !(lotspeed_ecn_active(sk) && (ca->flags & LOTSPEED_ECN_MARKED)) &&
+                 filtered_bw > ca->target_rate * 8 / 10) {
+            u64 max_bw = lotspeed_bw_bytes(minmax_get(&ca->bw_max));
+            u64 desired = max_bw ? min_t(u64, max_bw, ceiling) : ceiling;
+            u64 step = max_t(u64, ca->target_rate, mss * 8ULL);
+            u64 old_rate = ca->target_rate;
+
+            ca->target_rate = min_t(u64, ca->target_rate + step, desired);
+            ca->cwnd_gain = min_t(u32, ca->cwnd_gain + 1, lotspeed_gain(ca, cfg));
+            if (ca->target_rate != old_rate)
+                trace_lotspeed_adapt(sk, old_rate, ca->target_rate, filtered_bw, ca->cwnd_gain);
+        }
+    }
+
+    // 出口预算收紧时立即压到份额以内
+    ca->target_rate = min(ca->target_rate, ceiling);
+    lotspeed_group_adjust(sk, cfg, share);
+
+rtt_check:
+    // RTT 膨胀检测：阈值 = minRTT + max(minRTT/3, 1.5~2×方差)。
+    // 启动与排空中的排队由启动增益造成，交给启动自己的退出条件
+    if (min_rtt && rtt_us && !ca->ss_mode) {
+        u32 var = ca->rtt_var ? ca->rtt_var : min_rtt >> 3;
+        u32 tolerance = min_rtt / 3;
+        u32 var_term = (var * (ecn ? 3 : 4)) >> 1;
+        u32 threshold = min_rtt + max(tolerance, var_term);
+
+        if (!lotspeed_turbo(ca, cfg) && rtt_us > threshold) {
+            ca->cwnd_gain = max_t(u32, ca->cwnd_gain - 2, LOTSPEED_MIN_GAIN);
+        } else if (ca->cwnd_gain < lotspeed_gain(ca, cfg)) {
+            ca->cwnd_gain++;
+        }
+    }
+}
+
+// 推进增益循环：每个阶段持续 lotserver_cycle_rtts[phase] 个往返（与 lotspeed_adapt_rate 同一时间轴）。
+// 探测阶段遇到丢包（随机丢包除外）提前结束；排空阶段在途量降到 rtt_min 下的一个 BDP 以内
+//（探测造成的排队已排空）时提前结束。
+static void lotspeed_update_cycle(struct sock *sk, const struct lotspeed_config *cfg,
+                                  const struct rate_sample *rs, u64 rate,
+                                  bool round_end)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    bool done;
+    int i;
+
+    if (round_end && ca->cycle_rtts < U8_MAX)
+        ca->cycle_rtts++;
+
+    done = ca->cycle_rtts >= cfg->cycle_rtts[ca->cycle_phase];
+    if (ca->cycle_phase == LOTSPEED_PHASE_PROBE && rs && rs->losses > 0 &&
+        !(ca->flags & LOTSPEED_LOSS_RANDOM))
+        done = true;
+    if (ca->cycle_phase == LOTSPEED_PHASE_DRAIN && rs && ca->rtt_min &&
+        rs->prior_in_flight <= lotspeed_rate_pkts(ca, rate, ca->rtt_min, max(tcp_sk(sk)->mss_cache, 1u)))
+        done = true;
+    if (!done)
+        return;
+
+    // 跳过长度为 0 的阶段；全部为 0 时停在巡航
+    for (i = 0; i < LOTSPEED_PHASE_NR; i++) {
+        ca->cycle_phase = (ca->cycle_phase + 1) % LOTSPEED_PHASE_NR;
+        if (cfg->cycle_rtts[ca->cycle_phase])
+            break;
+    }
+    if (i == LOTSPEED_PHASE_NR)
+        ca->cycle_phase = LOTSPEED_PHASE_CRUISE;
+    ca->cycle_rtts = 0;
+}
+
+// 启动增益（%），不低于 100
+static inline u32 lotspeed_startup_pct(const struct lotspeed_config *cfg)
+{
+    return max_t(u32, cfg->startup_gain, 100);
+}
+
+// 当前 pacing 增益（%）：启动取启动增益（固定速率模式沿用探测增益），启动后的排空取其倒数，
+// rtt_min 排空期间不加速
+static u32 lotspeed_pacing_pct(const struct lotspeed *ca, const struct lotspeed_config *cfg)
+{
+    u32 pct;
+
+    if (ca->probe_rtt)
+        return 100;
+    if (ca->ss_mode && ca->cycle_phase == LOTSPEED_PHASE_DRAIN)
+        return 10000 / lotspeed_startup_pct(cfg);
+    if (ca->ss_mode && cfg->adaptive)
+        return lotspeed_startup_pct(cfg);
+    pct = cfg->cycle_pacing[ca->ss_mode ? LOTSPEED_PHASE_PROBE : ca->cycle_phase];
+    return pct ? pct : 100;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+// TSO 突发大小：每个 TSO 包最多承载 lotserver_tso_burst_us 的发送量，且不超过 rtt_min/4，
+// 高速时减少小包带来的 CPU 开销，低 RTT / 浅缓冲路径上又不会一次突发打满交换机缓冲。
+// 内核 tcp_tso_autosize() 取 sk_pacing_rate >> sk_pacing_shift 字节，
+// 这里用 sk_pacing_shift 决定上限（取 2 的幂），min_tso_segs 给出对应段数作为下限。
+static void lotspeed_size_tso(struct sock *sk, struct lotspeed *ca,
+                              const struct lotspeed_config *cfg, u64 pacing, u32 mss)
+{
+    u32 burst_us = cfg->tso_burst_us;
+    u32 floor = pacing < LOTSPEED_TSO_LOW_RATE ? 1 : 2;
+    int shift;
+
+    if (!burst_us) {
+        // 关闭后恢复内核默认值
+        if (ca->tso_segs) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
+            WRITE_ONCE(sk->sk_pacing_shift, LOTSPEED_PACING_SHIFT_DEF);
+#endif
+            ca->tso_segs = 0;
+        }
+        return;
+    }
+
+    if (ca->rtt_min)
+        burst_us = min(burst_us, max(ca->rtt_min >> 2, 1u));
+
+    // 2^-shift 秒 >= burst_us 的最小 2 的幂（1s 约等于 2^20us）
+    shift = clamp_t(int, 20 - fls(burst_us - 1),
+                    LOTSPEED_PACING_SHIFT_MIN, LOTSPEED_PACING_SHIFT_MAX);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
+    if (sk->sk_pacing_shift != shift)
+        WRITE_ONCE(sk->sk_pacing_shift, shift);
+#endif
+
+    // pacing 不变时沿用上次的段数
+    if (!lotspeed_div_ok(pacing >> shift, mss, ca->tso_segs, floor, LOTSPEED_TSO_MAX_SEGS))
+        ca->tso_segs = clamp_t(u64, div_u64(pacing >> shift, mss),
+                               floor, LOTSPEED_TSO_MAX_SEGS);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
+// 内核取 max(autosize, min_tso_segs)，再受 sk_gso_max_segs 限制
+static u32 lotspeed_min_tso_segs(struct sock *sk)
+{
+    const struct lotspeed *ca = inet_csk_ca(sk);
+
+    return ca->tso_segs ? ca->tso_segs : 2;
+}
+#else
+// 4.13 ~ 4.19：由拥塞控制直接给出 TSO 段数目标
+static u32 lotspeed_tso_segs_goal(struct sock *sk)
+{
+    const struct lotspeed *ca = inet_csk_ca(sk);
+
+    return ca->tso_segs ? ca->tso_segs : 2;
+}
+#endif
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
+// ECN 模式（DCTCP / L4S 风格）：交换机在队列超过阈值时打 CE 标记，
+// 每个往返统计一次被标记的交付比例 F，alpha = (1 - g) * alpha + g * F；
+// 该往返有标记时 target_rate 按 alpha/2 成比例下调（全部被标记时减半），
+// 下一个往返仍有标记则不再提升。队列维持在标记阈值附近，不必等到丢包或 RTT 明显膨胀。
+// 在 cong_control 的往返结束处、lotspeed_adapt_rate 之后调用，delivered 为刚结束的往返交付的包数
+static void lotspeed_ecn_round(struct sock *sk, const struct lotspeed_config *cfg, u32 delivered)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    u32 ce, alpha;
+
+    ce = min(tp->delivered_ce - ca->ecn_prior_ce, delivered);
+    ca->ecn_prior_ce = tp->delivered_ce;
+    if (!delivered)
+        return;
 
-    ca->rtt_cnt++;
+    alpha = ca->ecn_alpha;
+    alpha -= alpha >> LOTSPEED_ECN_G;
+    alpha += (ce << (LOTSPEED_ECN_SHIFT - LOTSPEED_ECN_G)) / delivered;
+    ca->ecn_alpha = min_t(u32, alpha, 1U << LOTSPEED_ECN_SHIFT);
 
-    if (!ca->rtt_ema) {
-        ca->rtt_ema = rtt_us;
-        ca->rtt_var = rtt_us >> 3;
+    // 启动中速率跟随交付速率，不按标记下调：一个往返过半被标记说明队列已到阈值，转入排空。
+    // 零星标记与第一个往返（未经 pacing 的初始窗口突发）不算
+    if (ca->ss_mode) {
+        if (ca->round_count > 1 && ce * 2 >= delivered)
+            lotspeed_startup_exit(ca, cfg);
         return;
     }
 
-    delta = (s32)rtt_us - (s32)ca->rtt_ema;
-    ca->rtt_ema += delta >> 3;
-
-    abs_delta = delta < 0 ? -delta : delta;
-    ca->rtt_var += ((s32)abs_delta - (s32)ca->rtt_var) >> 2;
+    if (ce) {
+        u64 old_rate = ca->target_rate;
+        u64 cut = ((ca->target_rate >> LOTSPEED_ECN_SHIFT) * ca->ecn_alpha) >> 1;
+        u32 mss = tp->mss_cache ? tp->mss_cache : 1460;
+
+        ca->target_rate = max_t(u64, ca->target_rate - cut, mss * 8ULL);
+        lotspeed_group_adjust(sk, cfg, old_rate);
+        ca->flags |= LOTSPEED_ECN_MARKED;
+        lotspeed_stat_inc(ecn_cuts);
+        if (ca->target_rate != old_rate)
+            trace_lotspeed_adapt(sk, old_rate, ca->target_rate,
+                                 lotspeed_bw_bytes(ca->bw_ema), ca->cwnd_gain);
+    } else {
+        ca->flags &= ~LOTSPEED_ECN_MARKED;
+    }
 }
 
-// 自适应速率调整
-static void lotspeed_adapt_rate(struct sock *sk, const struct rate_sample *rs)
+// 接收端：逐包回显 CE（同 DCTCP），发送端才能统计出被标记的比例；
+// 经典 ECN 会一直置 ECE 直到收到 CWR，比例信息就丢了。
+static inline void lotspeed_ecn_demand_cwr(struct tcp_sock *tp, bool ce)
 {
-    struct lotspeed *ca = inet_csk_ca(sk);
-    struct tcp_sock *tp = tcp_sk(sk);
-    u64 sample_bw = 0;
-    u64 filtered_bw;
-    u32 rtt_us = tp->srtt_us >> 3;
-    u32 min_rtt = ca->rtt_min ? ca->rtt_min : rtt_us;
-    bool ecn = rs && rs->is_ece;
-    u32 mss = tp->mss_cache ? tp->mss_cache : 1460;
-    u32 window_deadline;
-
-    if (!lotserver_adaptive)
-        goto rtt_check;
-
-    // 计算实际带宽（瞬时值）
-    if (rs && rs->delivered > 0 && rs->interval_us > 0) {
-        sample_bw = (u64)rs->delivered * USEC_PER_SEC;
-        do_div(sample_bw, rs->interval_us);
-
-        // 发送字节统计
-        ca->bytes_sent += (u64)rs->delivered * mss;
+    if (ce)
+        tp->ecn_flags |= TCP_ECN_DEMAND_CWR;
+    else
+        tp->ecn_flags &= ~TCP_ECN_DEMAND_CWR;
+}
 
-        // 指数滑动平均，抑制抖动
-        if (!ca->actual_rate) {
-            ca->actual_rate = sample_bw;
-        } else {
-            ca->actual_rate -= ca->actual_rate >> LOTSPEED_BW_EMA_SHIFT;
-            ca->actual_rate += sample_bw >> LOTSPEED_BW_EMA_SHIFT;
-        }
+// 立即发出确认到 rcv_nxt 的 ACK，ECE 取当前的 DEMAND_CWR
+static void lotspeed_send_ack(struct sock *sk, u32 rcv_nxt)
+{
+    KUNIT_STATIC_STUB_REDIRECT(lotspeed_send_ack, sk, rcv_nxt);
+    __tcp_send_ack(sk, rcv_nxt);
+}
 
-        // BBR 风格窗口最大值，探测更高带宽
-        if (!ca->bw_window_max || sample_bw >= ca->bw_window_max) {
-            ca->bw_window_max = sample_bw;
-            ca->bw_window_stamp = tcp_jiffies32;
-        } else {
-            window_deadline = ca->bw_window_stamp +
-                    (u32)msecs_to_jiffies(LOTSPEED_BW_WINDOW_MS);
-            if (time_after32(tcp_jiffies32, window_deadline)) {
-                ca->bw_window_max -= ca->bw_window_max >> LOTSPEED_BW_DECAY_SHIFT;
-                if (ca->bw_window_max < ca->actual_rate)
-                    ca->bw_window_max = ca->actual_rate;
-                ca->bw_window_stamp = tcp_jiffies32;
-            }
-        }
-    }
+// CE 状态变化时立即 ACK；有延迟 ACK 挂起时先按旧状态确认上一个报文为止的数据（同 dctcp_ece_ack_update()），
+// 否则标记与未标记的数据会被同一个 ACK 按新状态确认。上一个报文之后的 rcv_nxt 只存了低 16 位，
+// 未确认的数据不足 64KB 时能准确还原，超过时（极少见）只发新状态的 ACK
+static void lotspeed_ecn_echo(struct sock *sk, bool ce)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
 
-    filtered_bw = ca->actual_rate ? ca->actual_rate : sample_bw;
+    if (!!(ca->flags & LOTSPEED_ECN_CE) != ce) {
+        u32 prior = tp->rcv_nxt - (u16)((u16)tp->rcv_nxt - ca->ecn_rcv_nxt);
 
-    if (filtered_bw) {
-        // 如果实际速率远低于目标且存在丢包，快速降速
-        if (filtered_bw < ca->target_rate / 2 && ca->loss_count > 0) {
-            ca->target_rate = max_t(u64, filtered_bw * 15 / 10, lotserver_rate / 4);
-            ca->cwnd_gain = max_t(u32, ca->cwnd_gain - 5, LOTSPEED_MIN_GAIN);
-            if (lotserver_verbose) {
-                unsigned long gbps_int = ca->target_rate / 125000000;
-                unsigned long gbps_frac = (ca->target_rate % 125000000) * 100 / 125000000;
-                unsigned int gain_int = ca->cwnd_gain / 10;
-                unsigned int gain_frac = ca->cwnd_gain % 10;
-                pr_info("lotspeed: adapt DOWN: rate=%lu.%02lu Gbps, gain=%u.%ux\n",
-                        gbps_int, gbps_frac, gain_int, gain_frac);
-            }
-        }
-        // 表现良好，逐步提升到窗口最大值
-        else if (ca->loss_count == 0 &&
-                 filtered_bw > ca->target_rate * 8 / 10) {
-            u64 desired = ca->bw_window_max ?
-                          min(ca->bw_window_max, lotserver_rate) :
-                          lotserver_rate;
-            u64 step = max_t(u64, ca->target_rate >> 3, mss * 8ULL);
-            ca->target_rate = min_t(u64, ca->target_rate + step, desired);
-            ca->cwnd_gain = min_t(u32, ca->cwnd_gain + 1, lotserver_gain);
+        if ((inet_csk(sk)->icsk_ack.pending & ICSK_ACK_TIMER) &&
+            tp->rcv_nxt - tp->rcv_wup <= U16_MAX && after(prior, tp->rcv_wup)) {
+            // 收到 CWR 时内核会清掉 DEMAND_CWR，发之前按旧状态重新设置
+            lotspeed_ecn_demand_cwr(tp, !ce);
+            lotspeed_send_ack(sk, prior);
         }
+        ca->flags ^= LOTSPEED_ECN_CE;
+        inet_csk(sk)->icsk_ack.pending |= ICSK_ACK_NOW;
     }
+    ca->ecn_rcv_nxt = tp->rcv_nxt;
+    lotspeed_ecn_demand_cwr(tp, ce);
+}
+#endif
 
-rtt_check:
-    // RTT 膨胀检测：阈值 = minRTT + max(minRTT/3, 1.5~2×方差)
-    if (min_rtt && rtt_us) {
-        u32 var = ca->rtt_var ? ca->rtt_var : min_rtt >> 3;
-        u32 tolerance = min_rtt / 3;
-        u32 var_term = (var * (ecn ? 3 : 4)) >> 1;
-        u32 threshold = min_rtt + max(tolerance, var_term);
-
-        if (!lotserver_turbo && rtt_us > threshold) {
-            ca->cwnd_gain = max_t(u32, ca->cwnd_gain - 2, LOTSPEED_MIN_GAIN);
-        } else if (ca->cwnd_gain < lotserver_gain) {
-            ca->cwnd_gain++;
-        }
-    }
+// 参数快照换代后只对齐变化了的那组参数（各组的改动代号见 lotspeed_config_commit）：
+// 增益变了 cwnd_gain 取新增益，涡轮参数变了按新参数重置预算，没变的那组保留连接学到的状态；
+// 速率参数变了目标速率收进新的上限，固定速率模式直接取上限，自适应模式保留学到的速率，
+// 上限调高时由 lotspeed_adapt_rate 逐往返爬上去。丢包片段中不对齐：片段内退让过的增益与速率
+// 在片段结束（或误判恢复还原）之后再按新参数处理。档案参数仍以建连时匹配到的档案为准
+static inline bool lotspeed_cfg_changed(const struct lotspeed *ca, u32 gen)
+{
+    return (s32)(gen - ca->cfg_gen) > 0;
 }
 
-static u32 lotspeed_probe_threshold(const struct lotspeed *ca, u32 target_cwnd, u32 rtt_us)
+static void lotspeed_config_rebase(struct sock *sk, struct lotspeed *ca,
+                                   const struct lotspeed_config *cfg)
 {
-    u32 denom = max(50u, target_cwnd);
-    u32 cwnd_term = clamp_t(u32, LOTSPEED_PROBE_BASE / denom, 4u, 60u);
-    u32 min_rtt = ca->rtt_min ? ca->rtt_min : (rtt_us ? rtt_us : 1000);
-    u32 min_rtt_ms = max(1u, DIV_ROUND_UP(min_rtt, 1000));
-    u32 rtt_term = clamp_t(u32, 50u / min_rtt_ms, 4u, 20u);
+    if (ca->flags & LOTSPEED_LOSS_EPISODE)
+        return;
 
-    return clamp_t(u32, cwnd_term + rtt_term,
-                   LOTSPEED_PROBE_MIN, LOTSPEED_PROBE_MAX);
+    if (lotspeed_cfg_changed(ca, cfg->gain_gen))
+        ca->cwnd_gain = lotspeed_gain(ca, cfg);
+    if (lotspeed_cfg_changed(ca, cfg->turbo_gen))
+        lotspeed_reset_turbo_budget(ca, cfg);
+    if (lotspeed_cfg_changed(ca, cfg->rate_gen)) {
+        u64 old_rate = ca->target_rate;
+        u64 ceiling = lotspeed_rate_ceiling(ca, cfg, lotspeed_rate(sk, cfg));
+
+        ca->target_rate = cfg->adaptive ? min(old_rate, ceiling) : ceiling;
+        ca->rate_ceiling = lotspeed_bw_from_bytes(ceiling);
+        lotspeed_group_adjust(sk, cfg, old_rate);
+    }
+    ca->cfg_gen = cfg->gen;
 }
 
 // 核心拥塞控制逻辑实现（内部函数）
-static void lotspeed_cong_control_impl(struct sock *sk, const struct rate_sample *rs)
+static void lotspeed_cong_control_impl(struct sock *sk, const struct lotspeed_config *cfg,
+                                       const struct rate_sample *rs)
 {
     struct tcp_sock *tp = tcp_sk(sk);
     struct lotspeed *ca = inet_csk_ca(sk);
+    u32 round_start = ca->next_rtt_delivered;
     u64 rate;
     u32 cwnd;
     u32 rtt_us = tp->srtt_us >> 3;
     u32 mss = tp->mss_cache;
     u32 target_cwnd;
-    u32 probe_threshold;
+    u32 bdp;
+    u32 cwnd_pct;
+    bool round_end;
 
     // 默认值处理
     if (!rtt_us) rtt_us = 1000;   // 1ms 默认
     if (!mss) mss = 1460;          // 标准以太网 MSS
 
-    // 更新 RTT 统计
-    lotspeed_update_rtt(sk);
+    if (unlikely(ca->cfg_gen != cfg->gen))
+        lotspeed_config_rebase(sk, ca, cfg);
 
-    // 自适应调整
-    lotspeed_adapt_rate(sk, rs);
+    // 更新 RTT 统计
+    lotspeed_update_rtt(sk, cfg);
+
+    // 逐 ACK 只累积样本，每个往返结束时做一次自适应调整
+    round_end = lotspeed_update_round(sk, rs);
+    if (round_end) {
+        lotspeed_adapt_rate(sk, cfg, rs);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
+        if (lotspeed_ecn_active(sk))
+            lotspeed_ecn_round(sk, cfg, tp->delivered - round_start);
+#endif
+    }
 
-    // 选择速率
+    // 选择速率。启动中逐 ACK 跟上本往返已测到的交付速率：按往返更新会让新速率晚一个往返
+    // 才反映到样本里，变成两个往返才放大一次（不超过上一往返结束时算出的上限，
+    // 往返结束时再计入 target_rate）
     rate = ca->target_rate;
+    if (ca->ss_mode && ca->cycle_phase != LOTSPEED_PHASE_DRAIN && cfg->adaptive)
+        rate = max(rate, lotspeed_bw_bytes(min(ca->round_bw, ca->rate_ceiling)));
 
     // 核心公式：CWND = (rate × RTT) / MSS × gain
-    target_cwnd = div64_u64(rate * (u64)rtt_us, (u64)mss * 1000000);
-    target_cwnd = div_u64(target_cwnd * ca->cwnd_gain, 10);
-
-    probe_threshold = lotspeed_probe_threshold(ca,
-                                               max_t(u32, target_cwnd, 1),
-                                               rtt_us);
-
-    // 慢启动阶段特殊处理
-    if (ca->ss_mode && tp->snd_cwnd < tp->snd_ssthresh) {
-        // 指数增长
-        cwnd = tp->snd_cwnd * 2;
-        if (cwnd >= target_cwnd) {
-            ca->ss_mode = false;
-            cwnd = target_cwnd;
-        }
-    } else {
-        // 正常阶段
-        cwnd = target_cwnd;
+    bdp = lotspeed_rate_pkts(ca, rate, rtt_us, mss);
+    target_cwnd = div_u64((u64)bdp * ca->cwnd_gain, 10);
 
-        // 周期性探测更高速率
-        ca->probe_cnt++;
-        if (ca->probe_cnt >= probe_threshold) {
-            cwnd = cwnd * 11 / 10;   // 探测 +10%
-            ca->probe_cnt = 0;
+    if (ca->ss_mode && ca->cycle_phase == LOTSPEED_PHASE_DRAIN) {
+        // 启动后的排空：窗口回到正常值，在途量降到 rtt_min 下的一个 BDP 以内即进入增益循环
+        cwnd = target_cwnd;
+        if (rs && rs->prior_in_flight <= lotspeed_rate_pkts(ca, rate, ca->rtt_min ? : rtt_us, mss)) {
+            lotspeed_leave_slow_start(ca);
+            lotspeed_reset_cycle(ca);
+        }
+    } else if (ca->ss_mode) {
+        // 启动：窗口取启动增益下 rtt_min 的 BDP，发送量由 pacing 决定，
+        // 交付速率与目标速率每个往返一起放大约启动增益倍。
+        // 固定速率模式没有交付速率估计：逐 ACK 加上新确认的包数（每个往返翻倍），到达目标窗口即结束
+        if (cfg->adaptive) {
+            cwnd = (u32)div_u64((u64)lotspeed_rate_pkts(ca, rate, ca->rtt_min ? : rtt_us, mss) *
+                                lotspeed_startup_pct(cfg), 100);
+            // 开始排队：本往返已测到的交付速率计入目标速率，转入排空
+            if (lotspeed_startup_queued(ca, cfg, rtt_us)) {
+                u64 old_rate = ca->target_rate;
+
+                ca->target_rate = rate;
+                lotspeed_group_adjust(sk, cfg, old_rate);
+                lotspeed_startup_exit(ca, cfg);
+            }
+        } else {
+            cwnd = tp->snd_cwnd + (rs && rs->acked_sacked > 0 ? rs->acked_sacked : 0);
+            if (cwnd >= target_cwnd) {
+                cwnd = target_cwnd;
+                lotspeed_leave_slow_start(ca);
+            }
         }
+    } else {
+        // 正常阶段：按增益循环的当前阶段放大 / 收缩
+        lotspeed_update_cycle(sk, cfg, rs, rate, round_end);
+        cwnd_pct = cfg->cycle_cwnd[ca->cycle_phase];
+        cwnd = cwnd_pct ? (u32)div_u64((u64)target_cwnd * cwnd_pct, 100) : target_cwnd;
     }
 
+    // 排空阶段：在途量压到半个 BDP（不乘增益），清空瓶颈队列以测量真实 rtt_min
+    if (ca->probe_rtt)
+        cwnd = min(cwnd, bdp >> 1);
+
     // 应用安全限制
-    cwnd = max_t(u32, cwnd, lotserver_min_cwnd);
-    cwnd = min_t(u32, cwnd, lotserver_max_cwnd);
+    cwnd = max_t(u32, cwnd, lotspeed_min_cwnd(ca, cfg));
+    cwnd = min_t(u32, cwnd, lotspeed_max_cwnd(ca, cfg));
     cwnd = min_t(u32, cwnd, tp->snd_cwnd_clamp);
 
     // 设置拥塞窗口和 pacing 速率
     tp->snd_cwnd = cwnd;
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
-    // 改进: 给予 20% 的 Overhead 空间，防止 Pacing 限制了 TCP 本身的突发能力
-    // 许多网卡需要小规模的突发来维持高吞吐
-    u64 pacing = rate + (rate >> 2); // Rate * 1.25
+    // pacing 倍数随增益循环变化：探测阶段高于估计带宽，排空阶段低于估计带宽
+    u64 pacing = div_u64(rate * lotspeed_pacing_pct(ca, cfg), 100);
+    u64 budget_cap = lotspeed_budget_cap(ca, cfg);
+
+    // 启用出口预算时 pacing 不超过份额，所有连接合计不超过线速
+    if (budget_cap)
+        pacing = min(pacing, budget_cap);
     sk->sk_pacing_rate = pacing;
+    lotspeed_size_tso(sk, ca, cfg, pacing, mss);
 #endif
 
-    // 定期状态输出
-    if (lotserver_verbose && ca->rtt_cnt > 0 && ca->rtt_cnt % 1000 == 0) {
-        unsigned long gbps_int = rate / 125000000;
-        unsigned long gbps_frac = (rate % 125000000) * 100 / 125000000;
-        unsigned int gain_int = ca->cwnd_gain / 10;
-        unsigned int gain_frac = ca->cwnd_gain % 10;
+    trace_lotspeed_cong_control(sk, cwnd, target_cwnd, rate, rtt_us,
+                                ca->rtt_min, ca->cwnd_gain, ca->ss_mode,
+                                ca->cycle_phase);
 
-        pr_info("lotspeed: [uk0] STATUS: cwnd=%u | rate=%lu.%02lu Gbps | RTT=%u us | gain=%u.%ux | losses=%u\n",
-                cwnd, gbps_int, gbps_frac, rtt_us, gain_int, gain_frac, ca->loss_count);
-    }
+    if (static_branch_unlikely(&lotspeed_hist_key))
+        lotspeed_hist_record(ca, rs, rtt_us, cwnd, sk->sk_pacing_rate, mss);
 }
 
 // 主拥塞控制函数 - 兼容不同内核版本
@@ -589,140 +2901,340 @@ static void lotspeed_cong_control_impl(struct sock *sk, const struct rate_sample
 static void lotspeed_cong_control(struct sock *sk, u32 ack, int flag,
                                   const struct rate_sample *rs)
 {
+    struct lotspeed_capture_ctx cap = {};
+
     // 新版本可以使用 ack 和 flag 参数进行更精细的控制
     #ifdef KERNEL_6_17_PLUS
     // 6.17+ 内核的特殊处理
-    if (flag & CA_ACK_ECE && lotserver_verbose) {
+    if (flag & CA_ACK_ECE && lotspeed_verbose()) {
         pr_debug("lotspeed: [6.17+] ECN echo received, ack=%u\n", ack);
     }
     #endif
 
     // 调用实际的拥塞控制逻辑
-    lotspeed_cong_control_impl(sk, rs);
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_ACK, 0, rs, &cap);
+    lotspeed_cong_control_impl(sk, lotspeed_cfg_get(), rs);
+    lotspeed_capture_end(sk, &cap, 0);
+    rcu_read_unlock();
 }
 #else
 // 旧版本内核 (5.18 及以下, 6.8.0-6.8.x)
 static void lotspeed_cong_control(struct sock *sk, const struct rate_sample *rs)
 {
+    struct lotspeed_capture_ctx cap = {};
+
     // 直接调用实际的拥塞控制逻辑
-    lotspeed_cong_control_impl(sk, rs);
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_ACK, 0, rs, &cap);
+    lotspeed_cong_control_impl(sk, lotspeed_cfg_get(), rs);
+    lotspeed_capture_end(sk, &cap, 0);
+    rcu_read_unlock();
 }
 #endif
 
-// 处理状态变化
-static void lotspeed_set_state(struct sock *sk, u8 new_state)
+// 丢包分类：每个丢包片段开始时（lotspeed_loss_episode()）判断一次，结果记在 LOTSPEED_LOSS_RANDOM 中，
+// 同一片段随后的 ssthresh / cong_control 据此决定是否退让。
+// 拥塞丢包总伴随排队或交付不足：RTT 明显高于 rtt_min，或交付速率跟不上目标速率（瓶颈已满，
+// 多发的部分被丢弃）。两者都正常时丢包与发送速率无关（误码、无线、长途链路上的随机丢包），降速只会白白损失吞吐。
+// 启动中目标速率本身跟随交付速率，改看交付速率是否还在增长：连续两个往返没有增长 25% 才算管道已满
+// （单个往返的样本会被恢复中的重传、ACK 聚合拉低）。
+// 启动后的排空中与非自适应模式下没有可靠的判据，一律按拥塞处理
+static bool lotspeed_loss_is_random(struct sock *sk, const struct lotspeed *ca,
+                                    const struct lotspeed_config *cfg)
+{
+    const struct tcp_sock *tp = tcp_sk(sk);
+    u32 rtt_us = tp->srtt_us >> 3;
+    u64 bw = lotspeed_bw_bytes(ca->bw_ema);
+
+    if (!cfg->loss_classify || !cfg->adaptive ||
+        !ca->rtt_min || !rtt_us)
+        return false;
+    if ((u64)rtt_us * 100 > (u64)ca->rtt_min * (100 + cfg->loss_rtt_pct))
+        return false;
+    if (ca->ss_mode)
+        return ca->cycle_phase != LOTSPEED_PHASE_DRAIN && ca->cycle_rtts < LOTSPEED_FULL_BW_RTTS - 1;
+    return bw && bw * 100 >= ca->target_rate * cfg->loss_bw_pct;
+}
+
+// 丢包时的 ssthresh：拥塞片段取 cwnd 的 70%，随机丢包 / 涡轮忽略的片段不降
+static inline u32 lotspeed_loss_thresh(const struct lotspeed *ca, const struct lotspeed_config *cfg,
+                                       u32 cwnd)
+{
+    if (!(ca->flags & LOTSPEED_LOSS_EPISODE))
+        return TCP_INFINITE_SSTHRESH;
+    return max_t(u32, cwnd * 7 / 10, lotspeed_min_cwnd(ca, cfg));
+}
+
+// 丢包片段开始：分类、软涡轮预算，再记下片段前的增益供误判恢复还原，
+// 并按结果改写 ssthresh 给出的暂定值。片段前的 cwnd 取 prior_cwnd（超时时协议栈已把 snd_cwnd 降到在途量）
+static void lotspeed_loss_episode(struct sock *sk, const struct lotspeed_config *cfg)
 {
-    struct lotspeed *ca = inet_csk_ca(sk);
     struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
 
-    switch (new_state) {
-        case TCP_CA_Loss:
-            // 涡轮模式根据软/硬策略选择是否忽略
-            if (lotspeed_turbo_should_ignore(ca, "loss")) {
-                lotspeed_consume_turbo_ignore(ca);
-                tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
-                return;
-            }
-            // 记录丢包
-            ca->loss_count++;
-            ca->cwnd_gain = max_t(u32, ca->cwnd_gain * 8 / 10, LOTSPEED_MIN_GAIN);
-
-            if (lotserver_verbose && (ca->loss_count == 1 || ca->loss_count % 10 == 0)) {
-                unsigned int gain_int = ca->cwnd_gain / 10;
-                unsigned int gain_frac = ca->cwnd_gain % 10;
-                pr_info("lotspeed: LOSS #%u detected, gain reduced to %u.%ux\n",
-                        ca->loss_count, gain_int, gain_frac);
+    ca->flags &= ~(LOTSPEED_LOSS_RANDOM | LOTSPEED_LOSS_EPISODE | LOTSPEED_LOSS_STARTUP);
+    if (lotspeed_turbo(ca, cfg) && !lotspeed_soft_turbo(ca, cfg)) {
+        lotspeed_stat_inc(turbo_ignored);
+    } else if (lotspeed_loss_is_random(sk, ca, cfg)) {
+        ca->flags |= LOTSPEED_LOSS_RANDOM;
+        lotspeed_stat_inc(loss_random);
+    } else {
+        lotspeed_stat_inc(loss_congestive);
+        if (lotspeed_turbo_ignore(ca, cfg)) {
+            lotspeed_stat_inc(turbo_ignored);
+        } else {
+            ca->loss_prior_gain = ca->cwnd_gain;
+            ca->flags |= LOTSPEED_LOSS_EPISODE;
+            // 启动中的拥塞丢包说明管道已满，直接转入排空
+            if (ca->ss_mode && ca->cycle_phase != LOTSPEED_PHASE_DRAIN)
+                ca->flags |= LOTSPEED_LOSS_STARTUP;
+            lotspeed_startup_exit(ca, cfg);
+            // 温和降速，每个往返最多一次
+            if (!(ca->flags & LOTSPEED_LOSS_CUT)) {
+                lotspeed_loss_cut(ca, cfg);
+                ca->flags |= LOTSPEED_LOSS_CUT;
             }
-            break;
+        }
+    }
+    tp->snd_ssthresh = lotspeed_loss_thresh(ca, cfg, tp->prior_cwnd);
+}
+
+// 处理状态变化。回调时 icsk_ca_state 还是旧状态
+static void lotspeed_set_state_impl(struct sock *sk, const struct lotspeed_config *cfg, u8 new_state)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    u8 old_state = inet_csk(sk)->icsk_ca_state;
 
+    switch (new_state) {
+        case TCP_CA_Loss:
         case TCP_CA_Recovery:
-            // 进入恢复阶段
-            if (!lotserver_turbo) {
-                ca->cwnd_gain = max_t(u32, ca->cwnd_gain * 9 / 10, 15);
+            // Recovery 升级为 Loss、Loss 中再次超时都属于同一个片段，只在从 Open / Disorder / CWR 进入时
+            // 开始并计一次（非 ECN 模式的 CWR 已经开始了片段）；随机丢包、涡轮忽略的片段记为 ignored
+            if (old_state < TCP_CA_Recovery) {
+                lotspeed_stat_inc(loss_episodes);
+                if (old_state != TCP_CA_CWR || lotspeed_ecn_active(sk))
+                    lotspeed_loss_episode(sk, cfg);
             }
+            trace_lotspeed_set_state(sk, new_state, ca->loss_count, ca->cwnd_gain,
+                                     ca->turbo_budget, !(ca->flags & LOTSPEED_LOSS_EPISODE));
+            return;
+
+        case TCP_CA_CWR:
+            // ECN 模式下 ECE 触发的 CWR 不是丢包，ssthresh 已按标记比例给出；
+            // 其余的 CWR（经典 ECN 回显、本地拥塞）按丢包片段处理
+            if (!lotspeed_ecn_active(sk) && old_state < TCP_CA_CWR)
+                lotspeed_loss_episode(sk, cfg);
             break;
 
         case TCP_CA_Open:
-            // 恢复正常
-            ca->ss_mode = false;
-            lotspeed_reset_turbo_budget(ca);
+            // 恢复正常，丢包片段结束。启动已在拥塞片段开始时转入排空，
+            // 随机丢包 / 涡轮忽略的片段不结束启动
+            ca->flags &= ~(LOTSPEED_LOSS_RANDOM | LOTSPEED_LOSS_EPISODE | LOTSPEED_LOSS_CUT |
+                           LOTSPEED_LOSS_STARTUP);
+            ca->loss_rate_cut = 0;
             break;
 
         default:
             break;
     }
+
+    trace_lotspeed_set_state(sk, new_state, ca->loss_count,
+                             ca->cwnd_gain, ca->turbo_budget, false);
 }
 
-// 丢包时的 ssthresh
-static u32 lotspeed_ssthresh(struct sock *sk)
+static void lotspeed_set_state(struct sock *sk, u8 new_state)
+{
+    struct lotspeed_capture_ctx cap = {};
+
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_STATE, new_state, NULL, &cap);
+    lotspeed_set_state_impl(sk, lotspeed_cfg_get(), new_state);
+    lotspeed_capture_end(sk, &cap, 0);
+    rcu_read_unlock();
+}
+
+// ssthresh 在 set_state 之前调用，ECE 与丢包又可能出现在同一个 ACK 上，此时分不清是 CWR 还是丢包，
+// 只给出暂定值：ECN 模式按标记比例（CWR 就此定下），否则按丢包。
+// 丢包片段在随后的 set_state(Recovery / Loss) 中按旧状态判断开始，并改写 snd_ssthresh。
+// 片段内再次调用（恢复中又超时）沿用同一片段
+static u32 lotspeed_ssthresh_impl(struct sock *sk, const struct lotspeed_config *cfg)
 {
     struct lotspeed *ca = inet_csk_ca(sk);
     struct tcp_sock *tp = tcp_sk(sk);
-    u32 thresh;
 
     // 硬涡轮：永不降速
-    if (lotserver_turbo && !lotserver_soft_turbo) {
+    if (lotspeed_turbo(ca, cfg) && !lotspeed_soft_turbo(ca, cfg))
         return TCP_INFINITE_SSTHRESH;
-    }
 
-    if (lotserver_turbo && lotspeed_turbo_ignore_active(ca)) {
-        lotspeed_consume_turbo_ignore(ca);
-        return TCP_INFINITE_SSTHRESH;
+    if (inet_csk(sk)->icsk_ca_state >= TCP_CA_Recovery) {
+        // 温和降速，每个往返最多一次
+        if ((ca->flags & LOTSPEED_LOSS_EPISODE) && !(ca->flags & LOTSPEED_LOSS_CUT)) {
+            lotspeed_loss_cut(ca, cfg);
+            ca->flags |= LOTSPEED_LOSS_CUT;
+        }
+        return lotspeed_loss_thresh(ca, cfg, tp->snd_cwnd);
     }
 
-    // 温和降速
-    ca->loss_count++;
-    ca->cwnd_gain = max_t(u32, ca->cwnd_gain * 8 / 10, LOTSPEED_MIN_GAIN);
+    // 速率在往返结束时已按同一比例下调（lotspeed_ecn_round()）
+    if (lotspeed_ecn_active(sk)) {
+        u32 cut = (tp->snd_cwnd * ca->ecn_alpha) >> (LOTSPEED_ECN_SHIFT + 1);
 
-    thresh = max_t(u32, tp->snd_cwnd * 7 / 10, lotserver_min_cwnd);
-    return thresh;
+        return max_t(u32, tp->snd_cwnd - cut, lotspeed_min_cwnd(ca, cfg));
+    }
+    return max_t(u32, tp->snd_cwnd * 7 / 10, lotspeed_min_cwnd(ca, cfg));
+}
+
+static u32 lotspeed_ssthresh(struct sock *sk)
+{
+    struct lotspeed_capture_ctx cap = {};
+    u32 ret;
+
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_SSTHRESH, 0, NULL, &cap);
+    ret = lotspeed_ssthresh_impl(sk, lotspeed_cfg_get());
+    lotspeed_capture_end(sk, &cap, ret);
+    rcu_read_unlock();
+    return ret;
 }
 
 // 恢复拥塞窗口
-static u32 lotspeed_undo_cwnd(struct sock *sk)
+static u32 lotspeed_undo_cwnd_impl(struct sock *sk, const struct lotspeed_config *cfg)
 {
     struct tcp_sock *tp = tcp_sk(sk);
     struct lotspeed *ca = inet_csk_ca(sk);
 
-    // 误判恢复，重置丢包计数
+    // 误判恢复：还原片段开始前的增益；片段内降过的目标速率按交付速率窗口最大值还原
+    //（窗口覆盖片段之前的 LOTSPEED_BW_RTTS 个往返，私有区放不下第二个 64 位速率快照）。
+    // 片段结束了启动的回到启动，管道已满检测重新计数：启动只由管道已满检测结束。重置丢包计数
+    if (ca->flags & LOTSPEED_LOSS_EPISODE) {
+        ca->cwnd_gain = min_t(u32, max_t(u32, ca->cwnd_gain, ca->loss_prior_gain),
+                              lotspeed_gain(ca, cfg));
+        if (ca->loss_rate_cut) {
+            u64 old_rate = ca->target_rate;
+            u64 bw = lotspeed_bw_bytes(minmax_get(&ca->bw_max));
+
+            ca->target_rate = max(ca->target_rate,
+                                  min(bw, lotspeed_rate_ceiling(ca, cfg, lotspeed_rate(sk, cfg))));
+            lotspeed_group_adjust(sk, cfg, old_rate);
+        }
+        if (ca->flags & LOTSPEED_LOSS_STARTUP) {
+            ca->ss_mode = true;
+            lotspeed_reset_cycle(ca);
+        }
+        ca->flags &= ~(LOTSPEED_LOSS_EPISODE | LOTSPEED_LOSS_CUT | LOTSPEED_LOSS_STARTUP);
+        ca->loss_rate_cut = 0;
+        lotspeed_stat_inc(loss_undos);
+    }
     ca->loss_count = 0;
-    ca->ss_mode = false;
 
     return max(tp->snd_cwnd, tp->prior_cwnd);
 }
 
+static u32 lotspeed_undo_cwnd(struct sock *sk)
+{
+    struct lotspeed_capture_ctx cap = {};
+    u32 ret;
+
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_UNDO, 0, NULL, &cap);
+    ret = lotspeed_undo_cwnd_impl(sk, lotspeed_cfg_get());
+    lotspeed_capture_end(sk, &cap, ret);
+    rcu_read_unlock();
+    return ret;
+}
+
+// 空闲 idle_ms 后的速率：每 halflife_ms 减半，两次减半之间线性插值
+static u64 lotspeed_idle_decay(u64 rate, u32 idle_ms, u32 halflife_ms)
+{
+    u32 halvings, frac;
+
+    if (!halflife_ms)
+        return rate;
+    halvings = idle_ms / halflife_ms;
+    if (halvings >= 32)
+        return 0;
+    rate >>= halvings;
+    // 两次减半之间线性插值，比例取 16 位定点，避免大半衰期时乘法溢出
+    frac = (u32)div_u64((u64)(idle_ms % halflife_ms) << 16, halflife_ms);
+    return rate - mul_u64_u32_shr(rate >> 1, frac, 16);
+}
+
+// 空闲后重新开始发送：目标速率从空闲前的值按空闲时长衰减（每 lotserver_idle_halflife_ms 减半，
+// 不低于初始速率），增益循环从巡航开始，之后由 lotspeed_idle_round() 逐往返核对并回升。
+// 没有交付速率估计时重新启动。启动中（含新连接的第一次发送）不打断启动；
+// 丢包恢复中（超时重传时在途量也为 0）、不到一个 rtt_min 的间隙和固定速率模式只把增益循环拉回巡航
+static void lotspeed_idle_restart(struct sock *sk, const struct lotspeed_config *cfg)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    u32 idle_ms = jiffies_to_msecs(tcp_jiffies32 - tp->lsndtime);
+    u64 old_rate = ca->target_rate;
+    u64 rate;
+
+    if (ca->ss_mode)
+        return;
+    lotspeed_reset_cycle(ca);
+    if (!cfg->adaptive || inet_csk(sk)->icsk_ca_state != TCP_CA_Open ||
+        (u64)idle_ms * USEC_PER_MSEC < ca->rtt_min)
+        return;
+    // 半衰期为 0：沿用空闲前的目标速率直接恢复、不逐往返核对，还没有目标速率时才重新启动
+    if (!cfg->idle_halflife_ms) {
+        if (!old_rate) {
+            ca->loss_count = 0;
+            ca->ss_mode = true;
+        }
+        return;
+    }
+
+    rate = min(lotspeed_idle_floor(sk, ca, cfg), old_rate);
+    if (minmax_get(&ca->bw_max)) {
+        // 窗口最大值保留，作为回升的上限
+        rate = max(rate, lotspeed_idle_decay(old_rate, idle_ms,
+                                             cfg->idle_halflife_ms));
+        ca->idle_resume = 1;
+    } else {
+        ca->bw_ema = lotspeed_bw_from_bytes(rate);
+        ca->loss_count = 0;
+        ca->ss_mode = true;
+    }
+    ca->target_rate = rate;
+
+    // 空闲前的往返在重启后的第一个 ACK 上就会结束：往返边界改为重启后发出的包，
+    // 空闲前残留的样本与丢包标记不计入
+    ca->next_rtt_delivered = tp->delivered + 1;
+    ca->round_bw = 0;
+    ca->flags &= ~(LOTSPEED_ROUND_LOSS | LOTSPEED_LOSS_PREV);
+
+    lotspeed_group_adjust(sk, cfg, old_rate);
+    lotspeed_stat_inc(idle_restarts);
+    if (rate != old_rate)
+        trace_lotspeed_adapt(sk, old_rate, rate, lotspeed_bw_bytes(minmax_get(&ca->bw_max)),
+                             ca->cwnd_gain);
+}
+
 // 处理拥塞事件
-static void lotspeed_cwnd_event(struct sock *sk, enum tcp_ca_event event)
+static void lotspeed_cwnd_event_impl(struct sock *sk, const struct lotspeed_config *cfg,
+                                     enum tcp_ca_event event)
 {
     struct lotspeed *ca = inet_csk_ca(sk);
 
     switch (event) {
-        case CA_EVENT_LOSS:
-            // 发生丢包
-            if (lotserver_turbo && (!lotserver_soft_turbo || lotspeed_turbo_ignore_active(ca))) {
-                lotspeed_consume_turbo_ignore(ca);
-                break;
-            }
-            ca->loss_count++;
-            if (!lotserver_turbo || lotserver_soft_turbo) {
-                ca->cwnd_gain = max_t(u32, ca->cwnd_gain - 5, LOTSPEED_MIN_GAIN);
-            }
-            break;
-
         case CA_EVENT_TX_START:
-            // 开始传输
-            ca->ss_mode = true;
-            ca->probe_cnt = 0;
-            lotspeed_reset_turbo_budget(ca);
+        case CA_EVENT_CWND_RESTART:
+            // 在途量为 0 时开始发送。设置了 cong_control 的内核不发 CWND_RESTART，
+            // 两者按同一套空闲重启处理
+            lotspeed_idle_restart(sk, cfg);
+            lotspeed_reset_turbo_budget(ca, cfg);
             break;
 
-        case CA_EVENT_CWND_RESTART:
-            // 重新开始
-            ca->ss_mode = true;
-            ca->loss_count = 0;
-            ca->probe_cnt = 0;
-            lotspeed_reset_turbo_budget(ca);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
+        case CA_EVENT_ECN_IS_CE:
+        case CA_EVENT_ECN_NO_CE:
+            // 只有设置了 TCP_CONG_NEEDS_ECN 才会收到
+            lotspeed_ecn_echo(sk, event == CA_EVENT_ECN_IS_CE);
             break;
+#endif
 
         default:
             // 其他事件忽略
@@ -730,6 +3242,65 @@ static void lotspeed_cwnd_event(struct sock *sk, enum tcp_ca_event event)
     }
 }
 
+static void lotspeed_cwnd_event(struct sock *sk, enum tcp_ca_event event)
+{
+    struct lotspeed_capture_ctx cap = {};
+
+    rcu_read_lock();
+    lotspeed_capture_begin(sk, LOTSPEED_CAPTURE_EVENT, event, NULL, &cap);
+    lotspeed_cwnd_event_impl(sk, lotspeed_cfg_get(), event);
+    lotspeed_capture_end(sk, &cap, 0);
+    rcu_read_unlock();
+}
+
+// 通过 INET_DIAG 导出连接状态：ss -ti 的请求回 tcp_bbr_info（ss 能解析），请求位带 LOTSPEED_DIAG_EXT 时
+// 回完整的 struct lotspeed_diag_info（tools/lotspeed_diag 解析），见 lotspeed_diag.h。
+// TCP_CC_INFO 套接字选项的请求位全置，得到的是后者
+static size_t lotspeed_get_info(struct sock *sk, u32 ext, int *attr,
+                                union tcp_cc_info *info)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct lotspeed_diag_info *di = (struct lotspeed_diag_info *)info;
+    u32 pacing_gain;
+
+    if (!(ext & (1 << (INET_DIAG_BBRINFO - 1))) &&
+        !(ext & (1 << (INET_DIAG_VEGASINFO - 1))))
+        return 0;
+
+    rcu_read_lock();
+    pacing_gain = lotspeed_pacing_pct(ca, lotspeed_cfg_get()) * LOTSPEED_DIAG_UNIT / 100;
+    rcu_read_unlock();
+
+    if (!(ext & LOTSPEED_DIAG_EXT)) {
+        memset(&info->bbr, 0, sizeof(info->bbr));
+        info->bbr.bbr_bw_lo = (u32)ca->target_rate;
+        info->bbr.bbr_bw_hi = (u32)(ca->target_rate >> 32);
+        info->bbr.bbr_min_rtt = ca->rtt_min;
+        info->bbr.bbr_pacing_gain = pacing_gain;
+        info->bbr.bbr_cwnd_gain = ca->cwnd_gain * LOTSPEED_DIAG_UNIT / 10;
+        *attr = INET_DIAG_BBRINFO;
+        return sizeof(info->bbr);
+    }
+
+    memset(di, 0, sizeof(*di));
+    di->rate_lo = (u32)ca->target_rate;
+    di->rate_hi = (u32)(ca->target_rate >> 32);
+    di->rtt_min = ca->rtt_min;
+    di->pacing_gain = pacing_gain;
+    di->cwnd_gain = ca->cwnd_gain * LOTSPEED_DIAG_UNIT / 10;
+    di->loss_count = ca->loss_count;
+    di->turbo_budget = ca->turbo_budget;
+    di->phase = ca->cycle_phase;
+    if (ca->ss_mode)
+        di->flags |= LOTSPEED_DIAG_STARTUP;
+    if (ca->flags & LOTSPEED_LOSS_EPISODE)
+        di->flags |= LOTSPEED_DIAG_LOSS_EPISODE;
+    if (ca->idle_resume)
+        di->flags |= LOTSPEED_DIAG_IDLE_RESUME;
+    *attr = LOTSPEED_DIAG_INFO;
+    return sizeof(*di);
+}
+
 static struct tcp_congestion_ops lotspeed_ops __read_mostly = {
         .name           = "lotspeed",
         .owner          = THIS_MODULE,
@@ -740,9 +3311,306 @@ static struct tcp_congestion_ops lotspeed_ops __read_mostly = {
         .ssthresh       = lotspeed_ssthresh,
         .undo_cwnd      = lotspeed_undo_cwnd,
         .cwnd_event     = lotspeed_cwnd_event,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
+#endif
+        .get_info       = lotspeed_get_info,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
+        .min_tso_segs   = lotspeed_min_tso_segs,
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+        .tso_segs_goal  = lotspeed_tso_segs_goal,
+#endif
         .flags          = TCP_CONG_NON_RESTRICTED,
 };
 
+// debugfs：/sys/kernel/debug/lotspeed/stats
+static struct dentry *lotspeed_debugfs_dir;
+
+static int lotspeed_stats_show(struct seq_file *m, void *v)
+{
+    struct lotspeed_stats sum;
+
+    lotspeed_stats_fold(&sum);
+    seq_printf(m, "active_connections %lld\n", (s64)(sum.conn_init - sum.conn_release));
+    seq_printf(m, "connections_total %llu\n", sum.conn_init);
+    seq_printf(m, "bytes_sent %llu\n", sum.bytes_sent);
+    seq_printf(m, "losses %llu\n", sum.losses);
+    seq_printf(m, "slow_start_exits %llu\n", sum.ss_exits);
+    seq_printf(m, "loss_episodes %llu\n", sum.loss_episodes);
+    seq_printf(m, "turbo_ignored_losses %llu\n", sum.turbo_ignored);
+    seq_printf(m, "loss_random %llu\n", sum.loss_random);
+    seq_printf(m, "loss_congestive %llu\n", sum.loss_congestive);
+    seq_printf(m, "loss_undos %llu\n", sum.loss_undos);
+    // 被忽略的丢包片段占比（千分比），运维据此核对分类是否合理
+    seq_printf(m, "loss_random_permille %llu\n",
+               div64_u64(sum.loss_random * 1000,
+                         max_t(u64, sum.loss_random + sum.loss_congestive, 1)));
+    seq_printf(m, "path_cache_hits %llu\n", sum.path_hits);
+    seq_printf(m, "rtt_probes %llu\n", sum.rtt_probes);
+    seq_printf(m, "ecn_cuts %llu\n", sum.ecn_cuts);
+    seq_printf(m, "idle_restarts %llu\n", sum.idle_restarts);
+    seq_printf(m, "idle_fallbacks %llu\n", sum.idle_fallbacks);
+    seq_printf(m, "egress_pct %u\n", lotspeed_cfg_read(egress_pct));
+    return 0;
+}
+
+static int lotspeed_stats_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, lotspeed_stats_show, inode->i_private);
+}
+
+static const struct file_operations lotspeed_stats_fops = {
+    .owner   = THIS_MODULE,
+    .open    = lotspeed_stats_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+// /sys/kernel/debug/lotspeed/histograms：每行 "[下界, 上界) 计数"，写入任意内容清零
+static int lotspeed_hist_show(struct seq_file *m, void *v)
+{
+    u64 sum[LOTSPEED_HIST_BUCKETS];
+    int id, b, cpu;
+
+    seq_printf(m, "enabled %d\n", static_key_enabled(&lotspeed_hist_key));
+    for (id = 0; id < LOTSPEED_HIST_NR; id++) {
+        memset(sum, 0, sizeof(sum));
+        for_each_possible_cpu(cpu) {
+            const struct lotspeed_hist *h = per_cpu_ptr(&lotspeed_pcpu_hist, cpu);
+
+            for (b = 0; b < LOTSPEED_HIST_BUCKETS; b++)
+                sum[b] += READ_ONCE(h->bucket[id][b]);
+        }
+
+        seq_printf(m, "%s:\n", lotspeed_hist_names[id]);
+        for (b = 0; b < LOTSPEED_HIST_BUCKETS; b++) {
+            u64 lo = b ? 1ULL << (b - 1) : 0;
+
+            if (!sum[b])
+                continue;
+            if (b == LOTSPEED_HIST_BUCKETS - 1)
+                seq_printf(m, "  [%llu, inf) %llu\n", lo, sum[b]);
+            else
+                seq_printf(m, "  [%llu, %llu) %llu\n", lo, 1ULL << b, sum[b]);
+        }
+    }
+    return 0;
+}
+
+static int lotspeed_hist_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, lotspeed_hist_show, inode->i_private);
+}
+
+static ssize_t lotspeed_hist_write(struct file *file, const char __user *buf,
+                                   size_t count, loff_t *ppos)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&lotspeed_pcpu_hist, cpu), 0, sizeof(struct lotspeed_hist));
+    return count;
+}
+
+static const struct file_operations lotspeed_hist_fops = {
+    .owner   = THIS_MODULE,
+    .open    = lotspeed_hist_open,
+    .read    = seq_read,
+    .write   = lotspeed_hist_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+// /sys/kernel/debug/lotspeed/paths：路径缓存内容
+static int lotspeed_paths_show(struct seq_file *m, void *v)
+{
+    const struct lotspeed_config *cfg;
+    struct lotspeed_path *p;
+    int i;
+
+    seq_printf(m, "# prefix bw_Bps rtt_min_us cwnd_gain age_s\n");
+    rcu_read_lock();
+    cfg = lotspeed_cfg_get();
+    for (i = 0; i < ARRAY_SIZE(lotspeed_path_hash); i++) {
+        hlist_for_each_entry_rcu(p, &lotspeed_path_hash[i], node) {
+            unsigned long age = (jiffies - READ_ONCE(p->stamp)) / HZ;
+
+            if (p->key.family == AF_INET)
+                seq_printf(m, "%pI4/%u", &p->key.addr[0], p->key.plen);
+            else
+                seq_printf(m, "%pI6c/%u", p->key.addr, p->key.plen);
+            seq_printf(m, " %llu %u %u %lu%s\n", READ_ONCE(p->bw),
+                       READ_ONCE(p->rtt_min), READ_ONCE(p->cwnd_gain), age,
+                       lotspeed_path_fresh(p, cfg) ? "" : " (expired)");
+        }
+    }
+    rcu_read_unlock();
+    return 0;
+}
+
+static int lotspeed_paths_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, lotspeed_paths_show, inode->i_private);
+}
+
+static const struct file_operations lotspeed_paths_fops = {
+    .owner   = THIS_MODULE,
+    .open    = lotspeed_paths_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+// /sys/kernel/debug/lotspeed/profiles：当前策略表中的档案及使用中的连接数
+static int lotspeed_profiles_show(struct seq_file *m, void *v)
+{
+    const struct lotspeed_policy *pol;
+    unsigned int i;
+
+    seq_printf(m, "# name rate gain min_cwnd max_cwnd turbo soft_turbo weight flows\n");
+    mutex_lock(&lotspeed_policy_mutex);
+    pol = rcu_dereference_protected(lotspeed_policy,
+                                    lockdep_is_held(&lotspeed_policy_mutex));
+    for (i = 0; pol && i < pol->nr_profiles; i++) {
+        const struct lotspeed_profile *prof = pol->profiles[i];
+
+        // 策略表自身持有一个引用
+        seq_printf(m, "%s %llu %u %u %u %d %d %u %u\n", prof->name, prof->rate,
+                   prof->gain, prof->min_cwnd, prof->max_cwnd, prof->turbo,
+                   prof->soft_turbo, prof->weight, refcount_read(&prof->ref) - 1);
+    }
+    mutex_unlock(&lotspeed_policy_mutex);
+    return 0;
+}
+
+static int lotspeed_profiles_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, lotspeed_profiles_show, inode->i_private);
+}
+
+static const struct file_operations lotspeed_profiles_fops = {
+    .owner   = THIS_MODULE,
+    .open    = lotspeed_profiles_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+// /sys/kernel/debug/lotspeed/groups：活跃的耦合组
+static int lotspeed_groups_show(struct seq_file *m, void *v)
+{
+    const struct lotspeed_group *grp;
+    int i;
+
+    seq_printf(m, "# key members rate_Bps share_Bps\n");
+    spin_lock_bh(&lotspeed_group_lock);
+    for (i = 0; i < ARRAY_SIZE(lotspeed_groups); i++) {
+        grp = &lotspeed_groups[i];
+        if (!grp->members)
+            continue;
+        if (grp->key.family == AF_INET)
+            seq_printf(m, "%pI4", &grp->key.addr[0]);
+        else if (grp->key.family == AF_INET6)
+            seq_printf(m, "%pI6c", grp->key.addr);
+        else
+            seq_printf(m, "mark=%u", grp->key.mark);
+        seq_printf(m, " %u %llu %llu\n", grp->members, READ_ONCE(grp->rate),
+                   lotspeed_group_share(grp));
+    }
+    spin_unlock_bh(&lotspeed_group_lock);
+    return 0;
+}
+
+static int lotspeed_groups_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, lotspeed_groups_show, inode->i_private);
+}
+
+static const struct file_operations lotspeed_groups_fops = {
+    .owner   = THIS_MODULE,
+    .open    = lotspeed_groups_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+// /sys/kernel/debug/lotspeed/links：网卡速率缓存与自动速率
+static int lotspeed_links_show(struct seq_file *m, void *v)
+{
+    const struct lotspeed_config *cfg;
+    const struct lotspeed_link *l;
+    int i;
+
+    seq_printf(m, "# dev speed_Mbps target_Bps budget_slot budget_weight budget_per_weight_Bps\n");
+    rtnl_lock();
+    rcu_read_lock();
+    cfg = lotspeed_cfg_get();
+    for (i = 0; i < ARRAY_SIZE(lotspeed_link_hash); i++) {
+        hlist_for_each_entry(l, &lotspeed_link_hash[i], node) {
+            const struct lotspeed_budget *b = &lotspeed_budgets[l->slot];
+
+            seq_printf(m, "%s %llu %llu %u %ld %llu\n", l->name, div_u64(l->rate, 125000),
+                       lotspeed_link_target(cfg, l->rate), l->slot,
+                       l->slot ? READ_ONCE(b->weight) : 0L,
+                       l->slot ? READ_ONCE(b->per_weight) : 0ULL);
+        }
+    }
+    rcu_read_unlock();
+    rtnl_unlock();
+    return 0;
+}
+
+static int lotspeed_links_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, lotspeed_links_show, inode->i_private);
+}
+
+static const struct file_operations lotspeed_links_fops = {
+    .owner   = THIS_MODULE,
+    .open    = lotspeed_links_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+// /sys/kernel/debug/lotspeed/capture：只支持 mmap，布局见 lotspeed_capture.h
+static int lotspeed_capture_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct lotspeed_capture_hdr *hdr = smp_load_acquire(&lotspeed_capture_ring);
+
+    // 环形缓冲区在第一次写 lotserver_capture 时才分配
+    if (!hdr)
+        return -ENODEV;
+    if (vma->vm_pgoff)
+        return -EINVAL;
+    return remap_vmalloc_range(vma, hdr, 0);
+}
+
+static const struct file_operations lotspeed_capture_fops = {
+    .owner   = THIS_MODULE,
+    .mmap    = lotspeed_capture_mmap,
+};
+
+// debugfs 只是观测手段，创建失败不影响算法注册
+static void lotspeed_debugfs_init(void)
+{
+    lotspeed_debugfs_dir = debugfs_create_dir("lotspeed", NULL);
+    debugfs_create_file("stats", 0444, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_stats_fops);
+    debugfs_create_file("histograms", 0644, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_hist_fops);
+    debugfs_create_file("paths", 0444, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_paths_fops);
+    debugfs_create_file("profiles", 0444, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_profiles_fops);
+    debugfs_create_file("groups", 0444, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_groups_fops);
+    debugfs_create_file("links", 0444, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_links_fops);
+    debugfs_create_file("capture", 0600, lotspeed_debugfs_dir, NULL,
+                        &lotspeed_capture_fops);
+}
+
 // 辅助函数来格式化带边框的行
 static void print_boxed_line(const char *prefix, const char *content)
 {
@@ -761,8 +3629,25 @@ static int __init lotspeed_module_init(void)
     unsigned long gbps_int, gbps_frac;
     unsigned int gain_int, gain_frac;
     char buffer[128];
+    int ret, i;
 
     BUILD_BUG_ON(sizeof(struct lotspeed) > ICSK_CA_PRIV_SIZE);
+    BUILD_BUG_ON(ARRAY_SIZE(lotspeed_groups) >= 1 << 11);  // 以下三项对应 struct lotspeed 的位域宽度
+    BUILD_BUG_ON(LOTSPEED_BUDGET_SLOTS > 1 << 6);
+    BUILD_BUG_ON(LOTSPEED_ECN_SHIFT > 10);
+    BUILD_BUG_ON(sizeof(struct lotspeed_capture_rec) != 128);   // 用户态按固定布局读取
+    BUILD_BUG_ON(sizeof(struct lotspeed_diag_info) > sizeof(union tcp_cc_info));
+    BUILD_BUG_ON(LOTSPEED_DIAG_EXT != 1 << (INET_DIAG_SHUTDOWN - 1));
+
+    // 加载时传入的参数已经各自发布过快照，这里保证至少有一份
+    if (!rcu_access_pointer(lotspeed_cfg)) {
+        ret = lotspeed_config_commit();
+        if (ret)
+            goto err_free;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(lotspeed_groups); i++)
+        spin_lock_init(&lotspeed_groups[i].lock);
 
     pr_info("╔════════════════════════════════════════════════════════╗\n");
     pr_info("║          LotSpeed v2.0 - 锐速复活版                    ║\n");
@@ -797,55 +3682,92 @@ static int __init lotspeed_module_init(void)
     gain_frac = lotserver_gain % 10;
 
     pr_info("Initial Parameters:\n");
-    pr_info("  Rate: %lu.%02lu Gbps\n", gbps_int, gbps_frac);
+    if (lotserver_rate)
+        pr_info("  Rate: %lu.%02lu Gbps\n", gbps_int, gbps_frac);
+    else
+        pr_info("  Rate: auto (%u%% of link speed)\n", lotserver_link_pct);
     pr_info("  Gain: %u.%ux\n", gain_int, gain_frac);
     pr_info("  Min/Max CWND: %u/%u\n", lotserver_min_cwnd, lotserver_max_cwnd);
-    pr_info("  Adaptive: %s | Turbo: %s | Verbose: %s\n",
+    pr_info("  Adaptive: %s | Turbo: %s | Verbose: %s | Histograms: %s\n",
             lotserver_adaptive ? "ON" : "OFF",
             lotserver_turbo ? "ON" : "OFF",
-            lotserver_verbose ? "ON" : "OFF");
+            lotserver_verbose ? "ON" : "OFF",
+            lotserver_histograms ? "ON" : "OFF");
+
+    lotspeed_debugfs_init();
+
+    // 让第一个 ACK 就汇总出口预算
+    for (i = 0; i < LOTSPEED_BUDGET_SLOTS; i++)
+        lotspeed_budgets[i].stamp = jiffies - msecs_to_jiffies(LOTSPEED_BUDGET_REFRESH_MS) - 1;
+
+    // 注册时内核会对已有的网卡重放 NETDEV_REGISTER / NETDEV_UP，速率缓存随之建好
+    ret = register_netdevice_notifier(&lotspeed_netdev_notifier);
+    if (ret)
+        goto err_debugfs;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
+    // ECN 模式：协议栈在建连时检查 TCP_CONG_NEEDS_ECN，标志必须在注册前定下
+    if (lotserver_ecn) {
+        lotspeed_ops.flags |= TCP_CONG_NEEDS_ECN;
+        static_branch_enable(&lotspeed_ecn_key);
+    }
+#endif
 
-    return tcp_register_congestion_control(&lotspeed_ops);
+    ret = tcp_register_congestion_control(&lotspeed_ops);
+    if (ret)
+        goto err_notifier;
+    return 0;
+
+err_notifier:
+    unregister_netdevice_notifier(&lotspeed_netdev_notifier);
+err_debugfs:
+    debugfs_remove_recursive(lotspeed_debugfs_dir);
+err_free:
+    // 加载时的参数回调可能已发布快照、分配采集缓冲区、写入策略表，同卸载一样释放
+    lotspeed_policy_flush();
+    lotspeed_config_free();
+    vfree(lotspeed_capture_ring);
+    return ret;
 }
 
 static void __exit lotspeed_module_exit(void)
 {
+    struct lotspeed_stats sum;
     u64 total_bytes;
     u64 gb_sent, mb_sent;
-    int active_conns;
+    s64 active_conns;
     int retry_count = 0;
 
     pr_info("lotspeed: [uk0@2025-11-19 17:06:58] Beginning module unload\n");
 
-    // 先注销算法，防止新连接使用
+    // 先注销算法，防止新连接使用；debugfs 与网卡通知也在等待之前摘掉，
+    // 之后不会再有回调进入本模块
     tcp_unregister_congestion_control(&lotspeed_ops);
+    debugfs_remove_recursive(lotspeed_debugfs_dir);
+    unregister_netdevice_notifier(&lotspeed_netdev_notifier);
     pr_info("lotspeed: Unregistered from TCP stack\n");
 
-    // 等待现有连接释放（最多等待5秒）
-    while (atomic_read(&active_connections) > 0 && retry_count < 50) {
-        pr_info("lotspeed: Waiting for %d connections to close (attempt %d/50)\n",
-                atomic_read(&active_connections), retry_count + 1);
+    // 每条连接都通过 lotspeed_ops.owner 持有模块引用，能走到这里时不应还有连接；
+    // 计数只可能因统计误差偏高，最多等待 5 秒后继续卸载。module_exit 无法失败，
+    // 不能以重新注册的方式“拒绝卸载”
+    while ((active_conns = lotspeed_active_connections()) > 0 && retry_count < 50) {
+        pr_info("lotspeed: Waiting for %lld connections to close (attempt %d/50)\n",
+                active_conns, retry_count + 1);
         msleep(100);  // 等待100ms
         retry_count++;
     }
 
-    active_conns = atomic_read(&active_connections);
-
-    if (active_conns > 0) {
-        pr_err("lotspeed: WARNING - Force unloading with %d active connections!\n", active_conns);
-        pr_err("lotspeed: This may cause system instability!\n");
-
-        if (!force_unload) {
-            pr_err("lotspeed: Refusing to unload. Set force_unload=1 to override\n");
-            pr_err("lotspeed: echo 1 > /sys/module/lotspeed/parameters/force_unload\n");
+    active_conns = lotspeed_active_connections();
+    if (active_conns > 0)
+        pr_warn("lotspeed: %lld connections still counted as active at unload\n", active_conns);
 
-            // 重新注册以保持稳定
-            tcp_register_congestion_control(&lotspeed_ops);
-            return;  // 拒绝卸载
-        }
-    }
+    lotspeed_path_flush();
+    lotspeed_policy_flush();
+    lotspeed_config_free();
+    vfree(lotspeed_capture_ring);
 
-    total_bytes = atomic64_read(&total_bytes_sent);
+    lotspeed_stats_fold(&sum);
+    total_bytes = sum.bytes_sent;
     gb_sent = total_bytes >> 30;
     mb_sent = (total_bytes >> 20) & 0x3FF;
 
@@ -853,7 +3775,7 @@ static void __exit lotspeed_module_exit(void)
     pr_info("║          LotSpeed v2.0 Unloaded                        ║\n");
     pr_info("║          Time: 2025-11-19 17:06:58                     ║\n");
     pr_info("║          User: uk0                                     ║\n");
-    pr_info("║          Active Connections: %-26d║\n", active_conns);
+    pr_info("║          Active Connections: %-26lld║\n", active_conns);
     pr_info("║          Data Sent: %llu.%llu GB%*s║\n",
             gb_sent, mb_sent * 1000 / 1024,
             (int)(30 - snprintf(NULL, 0, "%llu.%llu GB", gb_sent, mb_sent * 1000 / 1024)), "");
@@ -867,4 +3789,9 @@ MODULE_LICENSE("GPL");
 MODULE_AUTHOR("uk0 <github.com/uk0>");
 MODULE_VERSION("2.0");
 MODULE_DESCRIPTION("LotSpeed v2.0 - Modern LotServer/ServerSpeeder replacement for 1G~40G networks");
-MODULE_ALIAS("tcp_lotspeed");
\ No newline at end of file
+MODULE_ALIAS("tcp_lotspeed");
+
+// KUnit 用例需要访问本文件的 static 函数，直接编进同一个编译单元
+#if IS_ENABLED(CONFIG_LOTSPEED_KUNIT_TEST)
+#include "lotspeed_kunit.c"
+#endif
@@ -0,0 +1,162 @@
+// lotspeed_capture.h  ——  逐 ACK 采集的环形缓冲区与文件格式
+//
+// 内核模块、用户态采集工具（tools/lotspeed_capture）与模拟器中的回放器共用。
+//
+// 环形缓冲区通过 mmap /sys/kernel/debug/lotspeed/capture 映射到用户态：
+//   [0, LOTSPEED_CAPTURE_HDR_SIZE)  struct lotspeed_capture_hdr
+//   之后 nr_recs 个 struct lotspeed_capture_rec
+// 生产者（各 CPU 上的回调）用原子加预留槽位，写完记录后以 release 语义写入 seq = 槽位序号 + 1；
+// 消费者读 seq、拷贝、再读一次 seq，两次都等于期望值才算有效，否则说明已被覆盖（计入丢失）。
+// 生产者从不等待消费者：消费者跟不上时旧记录被覆盖，不影响 ACK 路径。
+//
+// 采集文件：struct lotspeed_capture_file，随后 params_len 字节的参数文本（每行 name=value），
+// 然后按槽位顺序排列的记录。
+
+#ifndef _LOTSPEED_CAPTURE_H
+#define _LOTSPEED_CAPTURE_H
+
+#include <linux/types.h>
+
+#define LOTSPEED_CAPTURE_MAGIC      0x4c534341U   // "LSCA"
+#define LOTSPEED_CAPTURE_VERSION    2
+#define LOTSPEED_CAPTURE_HDR_SIZE   4096
+#define LOTSPEED_CAPTURE_RECS       8192          // 2 的幂，共 1MB
+#define LOTSPEED_CAPTURE_SIZE       (LOTSPEED_CAPTURE_HDR_SIZE + \
+                                     LOTSPEED_CAPTURE_RECS * sizeof(struct lotspeed_capture_rec))
+
+// 被采集的回调
+enum lotspeed_capture_type {
+    LOTSPEED_CAPTURE_INIT = 1,
+    LOTSPEED_CAPTURE_RELEASE,
+    LOTSPEED_CAPTURE_ACK,          // cong_control
+    LOTSPEED_CAPTURE_IN_ACK,       // in_ack_event，arg = CA_ACK_* 标志（旧版本模块才有）
+    LOTSPEED_CAPTURE_STATE,        // set_state，arg = 新状态
+    LOTSPEED_CAPTURE_SSTHRESH,     // ret = 返回值
+    LOTSPEED_CAPTURE_UNDO,         // undo_cwnd，ret = 返回值
+    LOTSPEED_CAPTURE_EVENT,        // cwnd_event，arg = 事件
+};
+
+#define LOTSPEED_CAPTURE_APP_LIMITED  0x01   // rs_flags
+#define LOTSPEED_CAPTURE_ECE          0x02
+
+struct lotspeed_capture_hdr {
+    __u32 magic;
+    __u32 version;
+    __u32 rec_size;
+    __u32 nr_recs;
+    __u32 hz;               // 记录中 stamp（jiffies）的单位
+    __u32 pad;
+    __u64 head;             // 已预留的槽位数，生产者原子递增
+    __u64 tail;             // 消费者已读到的位置，仅供参考，生产者不读
+};
+
+struct lotspeed_capture_rec {
+    __u64 seq;              // 槽位序号 + 1，0 = 正在写
+    __u64 flow;             // 连接标识（socket 地址的哈希），INIT 到 RELEASE 之间唯一
+    __u32 stamp;            // tcp_jiffies32
+    __u8  type;             // enum lotspeed_capture_type
+    __u8  arg;
+    __u8  ecn_flags;        // tp->ecn_flags
+    __u8  rs_flags;         // LOTSPEED_CAPTURE_APP_LIMITED / ECE
+
+    // 回调前的 tcp_sock 输入
+    __u32 snd_cwnd;
+    __u32 snd_ssthresh;
+    __u32 snd_cwnd_clamp;
+    __u32 prior_cwnd;
+    __u32 srtt_us;
+    __u32 mss_cache;
+    __u32 delivered;
+    __u32 delivered_ce;
+
+    union {
+        struct {            // ACK：rate_sample
+            __s32 delivered;
+            __s32 losses;
+            __s32 interval_us;
+            __s32 rtt_us;
+            __u32 prior_delivered;
+            __u32 prior_in_flight;
+            __u32 acked_sacked;
+            __u32 pad;
+        } rs;
+        struct {            // INIT：策略匹配与自动速率用到的连接属性
+            __u32 daddr[4];
+            __u16 family;
+            __u16 dport;    // 主机字节序
+            __u16 sport;
+            __u16 pad;
+            __u32 mark;
+            __u32 link_mbps;    // 出口网卡速率，0 = 未知
+        } id;
+        struct {            // EVENT：空闲重启按 stamp - lsndtime 计算空闲时长
+            __u32 lsndtime;
+        } ev;
+    };
+
+    // 回调后的决策
+    __u32 cwnd;
+    __u32 ssthresh;
+    __u32 ret;
+    __u16 cwnd_gain;
+    __u16 loss_count;
+    __u8  phase;
+    __u8  ss_mode;
+    __u16 pad;
+    __u32 pad2;
+    __u64 pacing_rate;
+    __u64 target_rate;
+};
+
+struct lotspeed_capture_file {
+    __u32 magic;
+    __u32 version;
+    __u32 rec_size;
+    __u32 hz;
+    __u32 params_len;
+    __u32 pad;
+};
+
+#ifndef __KERNEL__
+// 用户态消费者：把 [*tail, head) 中完整提交的记录依次交给 emit，返回被覆盖而丢失的记录数。
+// 遇到还没写完的槽位就停下，下次从这里继续
+static inline __u64 lotspeed_capture_drain(struct lotspeed_capture_hdr *hdr, __u64 *tail,
+                                           void (*emit)(const struct lotspeed_capture_rec *rec,
+                                                        void *arg),
+                                           void *arg)
+{
+    struct lotspeed_capture_rec *recs =
+        (struct lotspeed_capture_rec *)((char *)hdr + LOTSPEED_CAPTURE_HDR_SIZE);
+    __u64 head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    __u64 lost = 0;
+
+    if (head - *tail > hdr->nr_recs) {
+        lost += head - hdr->nr_recs - *tail;
+        *tail = head - hdr->nr_recs;
+    }
+
+    while (*tail < head) {
+        struct lotspeed_capture_rec *slot = &recs[*tail & (hdr->nr_recs - 1)];
+        struct lotspeed_capture_rec rec;
+        __u64 seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq < *tail + 1)
+            break;                  // 生产者还在写
+        if (seq == *tail + 1) {
+            __builtin_memcpy(&rec, slot, sizeof(rec));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+        }
+        if (seq == *tail + 1)
+            emit(&rec, arg);
+        else
+            lost++;                 // 拷贝期间被下一圈覆盖
+        (*tail)++;
+    }
+
+    __atomic_store_n(&hdr->tail, *tail, __ATOMIC_RELEASE);
+    return lost;
+}
+#endif
+
+#endif // _LOTSPEED_CAPTURE_H
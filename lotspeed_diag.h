@@ -0,0 +1,42 @@
+// lotspeed_diag.h  ——  lotspeed 的 INET_DIAG 每连接状态
+//
+// 内核模块的 get_info 与用户态工具（tools/lotspeed_diag）共用。
+//
+// ss -ti 只设 INET_DIAG_VEGASINFO 请求位，get_info 按 BBR 的约定回 INET_DIAG_BBRINFO
+//（tcp_bbr_info：目标速率、rtt_min、pacing / cwnd 增益），ss 显示为 "bbr:(bw:... mrtt:...)"。
+// 请求位另带 LOTSPEED_DIAG_EXT 时改回私有属性号 LOTSPEED_DIAG_INFO 的 struct lotspeed_diag_info，
+// 多出丢包计数、软涡轮预算、增益循环阶段与状态标志，由 tools/lotspeed_diag 解析。
+// idiag_ext 只有 8 位且都已有名字：LOTSPEED_DIAG_EXT 借用 INET_DIAG_SHUTDOWN 的位，
+// 内核总是回 SHUTDOWN 属性、不看这一位，ss 也从不设置它。
+// 内核对 get_info 返回的属性号不做检查，原样放进 netlink 应答；
+// 属性号远高于内核 INET_DIAG_* 的取值，且低于 NLA_TYPE_MASK。
+//
+// 结构体大小不能超过内核 union tcp_cc_info（20 字节，tcp_bbr_info 的大小），
+// 因此 64 位的目标速率拆成高低两半，避免对齐把结构体撑到 24 字节。
+
+#ifndef _LOTSPEED_DIAG_H
+#define _LOTSPEED_DIAG_H
+
+#include <linux/types.h>
+
+#define LOTSPEED_DIAG_INFO          0x3f4c        // INET_DIAG 属性号
+#define LOTSPEED_DIAG_EXT           0x80          // idiag_ext 位：1 << (INET_DIAG_SHUTDOWN - 1)
+#define LOTSPEED_DIAG_UNIT          256           // 增益单位（同 BBR_UNIT）
+
+#define LOTSPEED_DIAG_STARTUP       0x01          // 启动中（phase 为 DRAIN 时是启动后的排空）
+#define LOTSPEED_DIAG_LOSS_EPISODE  0x02          // 处于拥塞丢包片段中
+#define LOTSPEED_DIAG_IDLE_RESUME   0x04          // 空闲后按衰减的估计回升中
+
+struct lotspeed_diag_info {
+    __u32 rate_lo;          // 目标速率（字节/秒）低 32 位
+    __u32 rate_hi;
+    __u32 rtt_min;          // us
+    __u16 pacing_gain;      // 当前 pacing 倍数 × LOTSPEED_DIAG_UNIT
+    __u16 cwnd_gain;        // 当前 cwnd_gain × LOTSPEED_DIAG_UNIT
+    __u8  loss_count;       // 拥塞丢包退让的往返数（饱和于 7）
+    __u8  turbo_budget;     // 软涡轮剩余预算
+    __u8  phase;            // 增益循环阶段：0 探测，1 排空，2 巡航
+    __u8  flags;            // LOTSPEED_DIAG_*
+};
+
+#endif
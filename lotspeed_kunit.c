@@ -0,0 +1,1337 @@
+// lotspeed_kunit.c  ——  lotspeed 控制律的 KUnit 用例
+//
+// CONFIG_LOTSPEED_KUNIT_TEST 打开时由 lotspeed.c 在末尾 #include，可以直接调用其中的 static 函数。
+// 用合成的 rate_sample 序列驱动 lotspeed_cong_control_impl 和各个状态回调，逐往返比对
+// cwnd / pacing / cwnd_gain / 增益循环阶段与黄金轨迹，并报告各模式下每个 ACK 的耗时。
+//
+// 运行方式：
+//   UML（无需硬件）：./kunit/run_uml.sh /path/to/linux
+//   模块：          make LOTSPEED_KUNIT=1 && sudo insmod lotspeed.ko（内核需开启 CONFIG_KUNIT，结果见 dmesg）
+//   用户态：        make -C sim kunit（同一份用例跑在模拟器的内核垫片上）
+//
+// 控制律有意改变时，不一致的用例会把实际轨迹按 C 初始化列表打印出来，核对后替换黄金轨迹即可。
+
+#include <kunit/test.h>
+#include <linux/etherdevice.h>
+
+#define LOTSPEED_KT_MSS          1448
+#define LOTSPEED_KT_ROUNDS       16
+#define LOTSPEED_KT_MAX_ACKS     200000    // 单个用例的 ACK 上限，防止往返不前进时死循环
+#define LOTSPEED_KT_BENCH_ACKS   200000
+#define LOTSPEED_KT_ACK_NS_MAX   5000      // 每 ACK 耗时上限（ns），只拦截数量级的退化
+
+enum lotspeed_kt_mode {
+    LOTSPEED_KT_FIXED,          // lotserver_adaptive=0
+    LOTSPEED_KT_ADAPTIVE,       // 默认
+    LOTSPEED_KT_TURBO,          // 硬涡轮：忽略全部拥塞信号
+    LOTSPEED_KT_SOFT_TURBO,     // 软涡轮：忽略 lotserver_soft_turbo_budget 次丢包后退让
+    LOTSPEED_KT_NR,
+};
+
+static const char * const lotspeed_kt_mode_names[LOTSPEED_KT_NR] = {
+    "fixed", "adaptive", "turbo", "soft_turbo",
+};
+
+// 合成路径：100Mbps 瓶颈、20ms 基础 RTT、1/4 BDP 缓冲，每个 ACK 确认 2 个包
+struct lotspeed_kt_path {
+    u64 link_bw;        // 字节/秒
+    u32 base_rtt_us;
+    u32 buf_pkts;
+    u32 ack_pkts;
+};
+
+static const struct lotspeed_kt_path lotspeed_kt_default_path = {
+    .link_bw        = 12500000,
+    .base_rtt_us    = 20000,
+    .buf_pkts       = 43,
+    .ack_pkts       = 2,
+};
+
+// 每个往返结束时的快照
+struct lotspeed_kt_point {
+    u32 cwnd;
+    u64 pacing;
+    u32 gain;
+    u8 phase;
+};
+
+// 用例会改动的模块参数，suite 开始前保存、结束后恢复
+static struct {
+    unsigned long rate;
+    unsigned int gain;
+    unsigned int min_cwnd;
+    unsigned int max_cwnd;
+    bool adaptive;
+    bool turbo;
+    bool soft_turbo;
+    unsigned int soft_turbo_budget;
+    bool loss_classify;
+    unsigned int loss_rtt_pct;
+    unsigned int loss_bw_pct;
+    unsigned int loss_beta;
+    unsigned int startup_gain;
+    unsigned int startup_rtt_pct;
+    unsigned int idle_halflife_ms;
+    bool path_cache;
+    unsigned int egress_pct;
+    unsigned int tso_burst_us;
+    unsigned int min_rtt_win_ms;
+    unsigned int couple;
+    unsigned int link_pct;
+    unsigned int cycle_pacing[LOTSPEED_PHASE_NR];
+    unsigned int cycle_cwnd[LOTSPEED_PHASE_NR];
+    unsigned int cycle_rtts[LOTSPEED_PHASE_NR];
+} lotspeed_kt_saved;
+
+static int lotspeed_kt_suite_init(struct kunit_suite *suite)
+{
+    lotspeed_kt_saved.rate = lotserver_rate;
+    lotspeed_kt_saved.gain = lotserver_gain;
+    lotspeed_kt_saved.min_cwnd = lotserver_min_cwnd;
+    lotspeed_kt_saved.max_cwnd = lotserver_max_cwnd;
+    lotspeed_kt_saved.adaptive = lotserver_adaptive;
+    lotspeed_kt_saved.turbo = lotserver_turbo;
+    lotspeed_kt_saved.soft_turbo = lotserver_soft_turbo;
+    lotspeed_kt_saved.soft_turbo_budget = lotserver_soft_turbo_budget;
+    lotspeed_kt_saved.loss_classify = lotserver_loss_classify;
+    lotspeed_kt_saved.loss_rtt_pct = lotserver_loss_rtt_pct;
+    lotspeed_kt_saved.loss_bw_pct = lotserver_loss_bw_pct;
+    lotspeed_kt_saved.loss_beta = lotserver_loss_beta;
+    lotspeed_kt_saved.startup_gain = lotserver_startup_gain;
+    lotspeed_kt_saved.startup_rtt_pct = lotserver_startup_rtt_pct;
+    lotspeed_kt_saved.idle_halflife_ms = lotserver_idle_halflife_ms;
+    lotspeed_kt_saved.path_cache = lotserver_path_cache;
+    lotspeed_kt_saved.egress_pct = lotserver_egress_pct;
+    lotspeed_kt_saved.tso_burst_us = lotserver_tso_burst_us;
+    lotspeed_kt_saved.min_rtt_win_ms = lotserver_min_rtt_win_ms;
+    lotspeed_kt_saved.couple = lotserver_couple;
+    lotspeed_kt_saved.link_pct = lotserver_link_pct;
+    memcpy(lotspeed_kt_saved.cycle_pacing, lotserver_cycle_pacing, sizeof(lotserver_cycle_pacing));
+    memcpy(lotspeed_kt_saved.cycle_cwnd, lotserver_cycle_cwnd, sizeof(lotserver_cycle_cwnd));
+    memcpy(lotspeed_kt_saved.cycle_rtts, lotserver_cycle_rtts, sizeof(lotserver_cycle_rtts));
+    return 0;
+}
+
+static void lotspeed_kt_suite_exit(struct kunit_suite *suite)
+{
+    lotserver_rate = lotspeed_kt_saved.rate;
+    lotserver_gain = lotspeed_kt_saved.gain;
+    lotserver_min_cwnd = lotspeed_kt_saved.min_cwnd;
+    lotserver_max_cwnd = lotspeed_kt_saved.max_cwnd;
+    lotserver_adaptive = lotspeed_kt_saved.adaptive;
+    lotserver_turbo = lotspeed_kt_saved.turbo;
+    lotserver_soft_turbo = lotspeed_kt_saved.soft_turbo;
+    lotserver_soft_turbo_budget = lotspeed_kt_saved.soft_turbo_budget;
+    lotserver_loss_classify = lotspeed_kt_saved.loss_classify;
+    lotserver_loss_rtt_pct = lotspeed_kt_saved.loss_rtt_pct;
+    lotserver_loss_bw_pct = lotspeed_kt_saved.loss_bw_pct;
+    lotserver_loss_beta = lotspeed_kt_saved.loss_beta;
+    lotserver_startup_gain = lotspeed_kt_saved.startup_gain;
+    lotserver_startup_rtt_pct = lotspeed_kt_saved.startup_rtt_pct;
+    lotserver_idle_halflife_ms = lotspeed_kt_saved.idle_halflife_ms;
+    lotserver_path_cache = lotspeed_kt_saved.path_cache;
+    lotserver_egress_pct = lotspeed_kt_saved.egress_pct;
+    lotserver_tso_burst_us = lotspeed_kt_saved.tso_burst_us;
+    lotserver_min_rtt_win_ms = lotspeed_kt_saved.min_rtt_win_ms;
+    lotserver_couple = lotspeed_kt_saved.couple;
+    lotserver_link_pct = lotspeed_kt_saved.link_pct;
+    memcpy(lotserver_cycle_pacing, lotspeed_kt_saved.cycle_pacing, sizeof(lotserver_cycle_pacing));
+    memcpy(lotserver_cycle_cwnd, lotspeed_kt_saved.cycle_cwnd, sizeof(lotserver_cycle_cwnd));
+    memcpy(lotserver_cycle_rtts, lotspeed_kt_saved.cycle_rtts, sizeof(lotserver_cycle_rtts));
+    lotspeed_config_commit();
+}
+
+// 每个用例从同一组参数出发，不受加载模块时传入的参数影响。
+// rtt_min 不过期、不查路径缓存：轨迹只取决于输入的样本，与 jiffies 无关
+static int lotspeed_kt_init(struct kunit *test)
+{
+    static const unsigned int pacing[LOTSPEED_PHASE_NR] = { 125, 75, 100 };
+    static const unsigned int cwnd[LOTSPEED_PHASE_NR] = { 110, 100, 100 };
+    static const unsigned int rtts[LOTSPEED_PHASE_NR] = { 1, 1, 6 };
+
+    lotserver_rate = 30000000;      // 240Mbps，超过瓶颈一倍多
+    lotserver_gain = 15;
+    lotserver_min_cwnd = 50;
+    lotserver_max_cwnd = 10000;
+    lotserver_adaptive = true;
+    lotserver_turbo = false;
+    lotserver_soft_turbo = true;
+    lotserver_soft_turbo_budget = 2;
+    lotserver_loss_classify = true;
+    lotserver_loss_rtt_pct = 5;
+    lotserver_loss_bw_pct = 90;
+    lotserver_loss_beta = 80;
+    lotserver_startup_gain = 277;
+    lotserver_startup_rtt_pct = 25;
+    lotserver_idle_halflife_ms = 1000;
+    lotserver_path_cache = false;
+    lotserver_egress_pct = 0;
+    lotserver_tso_burst_us = 1000;
+    lotserver_min_rtt_win_ms = 0;
+    lotserver_couple = LOTSPEED_COUPLE_OFF;
+    lotserver_link_pct = 90;
+    memcpy(lotserver_cycle_pacing, pacing, sizeof(pacing));
+    memcpy(lotserver_cycle_cwnd, cwnd, sizeof(cwnd));
+    memcpy(lotserver_cycle_rtts, rtts, sizeof(rtts));
+    return lotspeed_config_commit();
+}
+
+static void lotspeed_kt_set_mode(enum lotspeed_kt_mode mode)
+{
+    lotserver_adaptive = mode != LOTSPEED_KT_FIXED;
+    lotserver_turbo = mode == LOTSPEED_KT_TURBO || mode == LOTSPEED_KT_SOFT_TURBO;
+    lotserver_soft_turbo = mode == LOTSPEED_KT_SOFT_TURBO;
+    lotspeed_config_commit();
+}
+
+// 直接调用内部函数时传入的参数快照。快照只由测试线程自己提交，下一次提交之前一直有效
+static const struct lotspeed_config *lotspeed_kt_cfg(void)
+{
+    return rcu_dereference_protected(lotspeed_cfg, 1);
+}
+
+// 只填 lotspeed 用到的字段，其余保持为 0。srtt_us 是握手给出的第一个 RTT 样本，
+// 0 表示没有样本（自适应模式的初始速率取上限）
+static struct sock *lotspeed_kt_sock_rtt(struct kunit *test, u32 mark, u32 srtt_us)
+{
+    struct tcp_sock *tp = kunit_kzalloc(test, sizeof(*tp), GFP_KERNEL);
+    struct sock *sk;
+
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tp);
+    sk = (struct sock *)tp;
+    tp->mss_cache = LOTSPEED_KT_MSS;
+    tp->snd_cwnd = 10;
+    tp->snd_cwnd_clamp = U32_MAX;
+    tp->srtt_us = srtt_us << 3;
+    sk->sk_mark = mark;
+    inet_csk(sk)->icsk_ca_state = TCP_CA_Open;
+    lotspeed_ops.init(sk);
+    return sk;
+}
+
+static struct sock *lotspeed_kt_sock_mark(struct kunit *test, u32 mark)
+{
+    return lotspeed_kt_sock_rtt(test, mark, 0);
+}
+
+static struct sock *lotspeed_kt_sock(struct kunit *test)
+{
+    return lotspeed_kt_sock_mark(test, 0);
+}
+
+// 切换拥塞状态：和 tcp_set_ca_state() 一样先回调、后更新 icsk_ca_state
+static void lotspeed_kt_set_state(struct sock *sk, u8 state)
+{
+    lotspeed_ops.set_state(sk, state);
+    inet_csk(sk)->icsk_ca_state = state;
+}
+
+// 丢包 / CWR：和 tcp_enter_recovery() 等一样先 ssthresh 再 set_state，返回最终的 snd_ssthresh。
+// icsk_ca_state 保持不变，每次调用都是从 Open 进入
+static u32 lotspeed_kt_loss(struct sock *sk, u8 state)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+
+    tp->prior_cwnd = tp->snd_cwnd;
+    tp->snd_ssthresh = lotspeed_ops.ssthresh(sk);
+    lotspeed_ops.set_state(sk, state);
+    return tp->snd_ssthresh;
+}
+
+// 合成一个 ACK：在途量为 cwnd，发送速率取 pacing 与 cwnd/RTT 的较小者。
+// 超过瓶颈带宽的部分按在途量超出 BDP 的包数排队，队列超过缓冲即丢包。
+// 丢包时按协议栈的顺序先 ssthresh 再 set_state(Recovery)，往返结束时回到 Open。
+// 返回 true 表示本 ACK 结束了一个往返。
+static bool lotspeed_kt_ack(struct sock *sk, const struct lotspeed_kt_path *path)
+{
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct inet_connection_sock *icsk = inet_csk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct rate_sample rs = {};
+    u32 mss = tp->mss_cache;
+    u32 inflight = tp->snd_cwnd;
+    u32 bdp = (u32)div64_u64(path->link_bw * path->base_rtt_us, (u64)mss * USEC_PER_SEC);
+    u64 send_rate = div64_u64((u64)inflight * mss * USEC_PER_SEC, path->base_rtt_us);
+    u32 round = ca->round_count;
+    u32 queue = 0;
+    u64 bw;
+
+    if (sk->sk_pacing_rate)
+        send_rate = min_t(u64, send_rate, sk->sk_pacing_rate);
+    bw = min(send_rate, path->link_bw);
+    if (send_rate > path->link_bw && inflight > bdp)
+        queue = inflight - bdp;
+    if (queue > path->buf_pkts) {
+        rs.losses = 1;
+        queue = path->buf_pkts;
+    }
+
+    rs.prior_delivered = tp->delivered - inflight;
+    rs.prior_in_flight = inflight;
+    rs.delivered = path->ack_pkts;
+    rs.acked_sacked = path->ack_pkts;
+    rs.interval_us = (long)div64_u64((u64)path->ack_pkts * mss * USEC_PER_SEC, max_t(u64, bw, 1));
+    rs.rtt_us = path->base_rtt_us + (long)div64_u64((u64)queue * mss * USEC_PER_SEC, path->link_bw);
+    tp->delivered += path->ack_pkts;
+    tp->srtt_us = (u32)rs.rtt_us << 3;
+
+    if (rs.losses && icsk->icsk_ca_state == TCP_CA_Open) {
+        tp->prior_cwnd = tp->snd_cwnd;
+        tp->snd_ssthresh = lotspeed_ops.ssthresh(sk);
+        lotspeed_kt_set_state(sk, TCP_CA_Recovery);
+    }
+
+    lotspeed_cong_control_impl(sk, lotspeed_kt_cfg(), &rs);
+
+    if (ca->round_count == round)
+        return false;
+    if (icsk->icsk_ca_state == TCP_CA_Recovery) {
+        lotspeed_kt_set_state(sk, TCP_CA_Open);
+    }
+    return true;
+}
+
+// 跑满 n 个往返，记录每个往返结束时的状态
+static void lotspeed_kt_run(struct kunit *test, struct sock *sk,
+                            const struct lotspeed_kt_path *path,
+                            struct lotspeed_kt_point *pts, int n)
+{
+    struct lotspeed *ca = inet_csk_ca(sk);
+    int acks = 0, i = 0;
+
+    while (i < n && acks++ < LOTSPEED_KT_MAX_ACKS) {
+        if (!lotspeed_kt_ack(sk, path))
+            continue;
+        pts[i].cwnd = tcp_sk(sk)->snd_cwnd;
+        pts[i].pacing = sk->sk_pacing_rate;
+        pts[i].gain = ca->cwnd_gain;
+        pts[i].phase = ca->cycle_phase;
+        i++;
+    }
+    KUNIT_ASSERT_EQ_MSG(test, i, n, "round trips stopped advancing after %d ACKs", acks);
+}
+
+static void lotspeed_kt_expect_trace(struct kunit *test, enum lotspeed_kt_mode mode,
+                                     const struct lotspeed_kt_point *golden)
+{
+    struct lotspeed_kt_point pts[LOTSPEED_KT_ROUNDS] = {};
+    struct sock *sk;
+    bool match = true;
+    int i;
+
+    lotspeed_kt_set_mode(mode);
+    sk = lotspeed_kt_sock_rtt(test, 0, lotspeed_kt_default_path.base_rtt_us);
+    lotspeed_kt_run(test, sk, &lotspeed_kt_default_path, pts, LOTSPEED_KT_ROUNDS);
+    lotspeed_ops.release(sk);
+
+    for (i = 0; i < LOTSPEED_KT_ROUNDS; i++) {
+        KUNIT_EXPECT_EQ_MSG(test, pts[i].cwnd, golden[i].cwnd, "round %d cwnd", i);
+        KUNIT_EXPECT_EQ_MSG(test, pts[i].pacing, golden[i].pacing, "round %d pacing", i);
+        KUNIT_EXPECT_EQ_MSG(test, pts[i].gain, golden[i].gain, "round %d gain", i);
+        KUNIT_EXPECT_EQ_MSG(test, pts[i].phase, golden[i].phase, "round %d phase", i);
+        if (pts[i].cwnd != golden[i].cwnd || pts[i].pacing != golden[i].pacing ||
+            pts[i].gain != golden[i].gain || pts[i].phase != golden[i].phase)
+            match = false;
+    }
+    if (match)
+        return;
+
+    kunit_info(test, "%s trajectory { cwnd, pacing, gain, phase }:\n",
+               lotspeed_kt_mode_names[mode]);
+    for (i = 0; i < LOTSPEED_KT_ROUNDS; i++)
+        kunit_info(test, "    { %u, %llu, %u, %u },\n", pts[i].cwnd,
+                   (unsigned long long)pts[i].pacing, pts[i].gain, pts[i].phase);
+}
+
+// 黄金轨迹：lotspeed_kt_default_path 上前 LOTSPEED_KT_ROUNDS 个往返
+static const struct lotspeed_kt_point lotspeed_kt_golden[LOTSPEED_KT_NR][LOTSPEED_KT_ROUNDS] = {
+    [LOTSPEED_KT_FIXED] = {
+        { 672, 30000000, 13, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 624, 37500000, 11, 0 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 624, 37500000, 11, 0 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+        { 568, 30000000, 11, 2 },
+    },
+    [LOTSPEED_KT_ADAPTIVE] = {
+        { 207, 12535808, 12, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 260, 15669760, 11, 0 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 260, 15669760, 11, 0 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+    },
+    [LOTSPEED_KT_TURBO] = {
+        { 479, 34724188, 15, 2 },
+        { 479, 34724188, 15, 2 },
+        { 479, 34724188, 15, 2 },
+        { 324, 4512890, 15, 1 },
+        { 259, 4512890, 15, 1 },
+        { 259, 4512890, 15, 1 },
+        { 259, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+        { 356, 15669760, 15, 0 },
+        { 259, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+        { 324, 12535808, 15, 2 },
+    },
+    [LOTSPEED_KT_SOFT_TURBO] = {
+        { 479, 34724188, 15, 2 },
+        { 479, 34724188, 15, 2 },
+        { 207, 4512890, 12, 1 },
+        { 207, 4512890, 12, 1 },
+        { 224, 12535808, 13, 2 },
+        { 302, 12535808, 14, 2 },
+        { 324, 12535808, 15, 2 },
+        { 280, 12535808, 13, 2 },
+        { 237, 12535808, 11, 2 },
+        { 260, 15669760, 11, 0 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 237, 12535808, 11, 2 },
+        { 260, 15669760, 11, 0 },
+    },
+};
+
+static void lotspeed_kt_trace_fixed(struct kunit *test)
+{
+    lotspeed_kt_expect_trace(test, LOTSPEED_KT_FIXED, lotspeed_kt_golden[LOTSPEED_KT_FIXED]);
+}
+
+static void lotspeed_kt_trace_adaptive(struct kunit *test)
+{
+    lotspeed_kt_expect_trace(test, LOTSPEED_KT_ADAPTIVE, lotspeed_kt_golden[LOTSPEED_KT_ADAPTIVE]);
+}
+
+static void lotspeed_kt_trace_turbo(struct kunit *test)
+{
+    lotspeed_kt_expect_trace(test, LOTSPEED_KT_TURBO, lotspeed_kt_golden[LOTSPEED_KT_TURBO]);
+}
+
+static void lotspeed_kt_trace_soft_turbo(struct kunit *test)
+{
+    lotspeed_kt_expect_trace(test, LOTSPEED_KT_SOFT_TURBO,
+                             lotspeed_kt_golden[LOTSPEED_KT_SOFT_TURBO]);
+}
+
+// 丢包 / 误判恢复 / 重启对 cwnd_gain、丢包计数和慢启动状态的影响
+static void lotspeed_kt_state_callbacks(struct kunit *test)
+{
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    struct lotspeed_stats before, after;
+
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 15U);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, (u64)lotserver_rate);
+
+    // 快速重传：丢包片段开始时退让一次，ssthresh 取 cwnd 的 70%，增益 ×0.8
+    lotspeed_stats_fold(&before);
+    tp->snd_cwnd = 1000;
+    tp->prior_cwnd = 1000;
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.ssthresh(sk), 700U);
+    lotspeed_kt_set_state(sk, TCP_CA_Recovery);
+    KUNIT_EXPECT_EQ(test, tp->snd_ssthresh, 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 1U);
+
+    // 同一片段内又超时：ssthresh、CA_EVENT_LOSS、set_state(Loss) 都不再退让，片段只计一次
+    tp->snd_cwnd = 60;
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.ssthresh(sk), lotserver_min_cwnd);
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_LOSS);
+    lotspeed_kt_set_state(sk, TCP_CA_Loss);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 1U);
+    lotspeed_stats_fold(&after);
+    KUNIT_EXPECT_EQ(test, after.loss_episodes - before.loss_episodes, 1ULL);
+
+    // 误判恢复：增益回到片段开始前，清零丢包计数，cwnd 取撤销前的较大值；
+    // 片段把启动转入了排空，撤销后回到启动
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_DRAIN);
+    tp->prior_cwnd = 900;
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.undo_cwnd(sk), 900U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 15U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_CRUISE);
+    KUNIT_EXPECT_FALSE(test, ca->flags & (LOTSPEED_LOSS_EPISODE | LOTSPEED_LOSS_STARTUP));
+    lotspeed_kt_set_state(sk, TCP_CA_Open);
+
+    // 启动之后的片段不影响撤销后的状态
+    ca->ss_mode = false;
+    tp->snd_cwnd = 1000;
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    lotspeed_ops.undo_cwnd(sk);
+    KUNIT_EXPECT_FALSE(test, ca->ss_mode);
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+
+    // 没有交付速率估计的连接空闲重启：回到启动，增益循环从巡航开始
+    ca->cycle_phase = LOTSPEED_PHASE_PROBE;
+    ca->loss_count = 3;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_CWND_RESTART);
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_CRUISE);
+
+    lotspeed_ops.release(sk);
+}
+
+// 软涡轮：预算内的丢包片段被忽略，用完后正常退让，出现无丢包的往返后预算恢复
+static void lotspeed_kt_soft_turbo_budget(struct kunit *test)
+{
+    struct sock *sk;
+    struct tcp_sock *tp;
+    struct lotspeed *ca;
+    int i;
+
+    lotspeed_kt_set_mode(LOTSPEED_KT_SOFT_TURBO);
+    sk = lotspeed_kt_sock(test);
+    tp = tcp_sk(sk);
+    ca = inet_csk_ca(sk);
+    tp->snd_cwnd = 1000;
+
+    for (i = 0; i < 2; i++) {
+        KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Loss), (u32)TCP_INFINITE_SSTHRESH);
+        KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+        lotspeed_ops.set_state(sk, TCP_CA_Open);
+    }
+    KUNIT_EXPECT_EQ(test, (u32)ca->turbo_budget, 0U);
+
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 1U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+    KUNIT_EXPECT_EQ(test, (u32)ca->turbo_budget, 0U);
+
+    lotspeed_adapt_rate(sk, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->turbo_budget, 2U);
+
+    lotspeed_ops.release(sk);
+
+    // 硬涡轮：ssthresh 永远不降
+    lotspeed_kt_set_mode(LOTSPEED_KT_TURBO);
+    sk = lotspeed_kt_sock(test);
+    tcp_sk(sk)->snd_cwnd = 1000;
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.ssthresh(sk), (u32)TCP_INFINITE_SSTHRESH);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), (u32)TCP_INFINITE_SSTHRESH);
+    KUNIT_EXPECT_EQ(test, (u32)((struct lotspeed *)inet_csk_ca(sk))->loss_count, 0U);
+    lotspeed_ops.release(sk);
+}
+
+// 丢包分类：RTT 贴着 rtt_min 且交付速率跟得上目标速率时判为随机丢包，整个片段不退让、
+// 不计丢包、不消耗软涡轮预算；RTT 膨胀或交付不足时按拥塞丢包正常退让
+static void lotspeed_kt_loss_classify(struct kunit *test)
+{
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+
+    ca->ss_mode = false;
+    ca->rtt_min = 20000;
+    ca->bw_ema = lotspeed_bw_from_bytes(ca->target_rate);
+    tp->srtt_us = 20500 << 3;
+    tp->snd_cwnd = 1000;
+
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Loss), (u32)TCP_INFINITE_SSTHRESH);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 15U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->turbo_budget, 2U);
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+    KUNIT_EXPECT_FALSE(test, ca->flags & LOTSPEED_LOSS_RANDOM);
+
+    // 排队：RTT 高出 rtt_min 超过 5%
+    tp->srtt_us = 22000 << 3;
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 1U);
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+
+    // 交付不足：交付速率只有目标速率的一半
+    tp->srtt_us = 20500 << 3;
+    ca->cwnd_gain = 15;
+    ca->bw_ema = lotspeed_bw_from_bytes(ca->target_rate / 2);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+
+    // 关闭分类后回到原来的行为
+    ca->bw_ema = lotspeed_bw_from_bytes(ca->target_rate);
+    lotserver_loss_classify = false;
+    lotspeed_config_commit();
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 3U);
+
+    lotspeed_ops.release(sk);
+}
+
+// ECN 模式：ECE 触发的 CWR 按标记比例降窗，不算丢包片段；CWR 中又发生的丢包、
+// 与 ECE 同一个 ACK 报告的丢包按进入 Recovery 时的旧状态判断，照常开始片段
+static void lotspeed_kt_ecn_cwr(struct kunit *test)
+{
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct tcp_sock *tp = tcp_sk(sk);
+    struct lotspeed *ca = inet_csk_ca(sk);
+
+    static_branch_enable(&lotspeed_ecn_key);
+    tp->ecn_flags |= TCP_ECN_OK;
+    ca->ss_mode = false;
+    tp->snd_cwnd = 1000;
+
+    // alpha 初值为 1：窗口减半，增益与丢包计数不变
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_CWR), 500U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 15U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+    KUNIT_EXPECT_FALSE(test, ca->flags & LOTSPEED_LOSS_EPISODE);
+
+    // CWR 中丢包：协议栈不再调用 ssthresh，片段在进入 Recovery 时开始
+    inet_csk(sk)->icsk_ca_state = TCP_CA_CWR;
+    lotspeed_kt_set_state(sk, TCP_CA_Recovery);
+    KUNIT_EXPECT_EQ(test, tp->snd_ssthresh, 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 1U);
+    KUNIT_EXPECT_TRUE(test, ca->flags & LOTSPEED_LOSS_EPISODE);
+    lotspeed_kt_set_state(sk, TCP_CA_Open);
+
+    // ECE 与丢包在同一个 ACK 上：ssthresh 暂按标记比例给出，进入 Recovery 时按丢包改写
+    ca->cwnd_gain = 15;
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.ssthresh(sk), 500U);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 2U);
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+
+    static_branch_disable(&lotspeed_ecn_key);
+    lotspeed_ops.release(sk);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+// lotspeed_send_ack() 的静态桩：只记录发出的 ACK
+static struct {
+    unsigned int count;
+    u32 seq;
+    bool ece;
+} lotspeed_kt_acks;
+
+static void lotspeed_kt_send_ack(struct sock *sk, u32 rcv_nxt)
+{
+    lotspeed_kt_acks.count++;
+    lotspeed_kt_acks.seq = rcv_nxt;
+    lotspeed_kt_acks.ece = tcp_sk(sk)->ecn_flags & TCP_ECN_DEMAND_CWR;
+}
+
+// 接收端 CE 回显：状态变化且有延迟 ACK 挂起时，先按旧状态确认到上一个报文为止，再立即发新状态的 ACK；
+// 未确认的数据超过 64KB（上一个报文的 rcv_nxt 无法还原）时只发新状态的 ACK
+static void lotspeed_kt_ecn_echo(struct kunit *test)
+{
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct tcp_sock *tp = tcp_sk(sk);
+    u8 *pending = &inet_csk(sk)->icsk_ack.pending;
+
+    memset(&lotspeed_kt_acks, 0, sizeof(lotspeed_kt_acks));
+    kunit_activate_static_stub(test, lotspeed_send_ack, lotspeed_kt_send_ack);
+
+    tp->rcv_nxt = 1000;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_ECN_NO_CE);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.count, 0U);
+    KUNIT_EXPECT_FALSE(test, *pending & ICSK_ACK_NOW);
+
+    *pending = ICSK_ACK_TIMER;
+    tp->rcv_nxt = 2000;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_ECN_IS_CE);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.count, 1U);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.seq, 1000U);
+    KUNIT_EXPECT_FALSE(test, lotspeed_kt_acks.ece);
+    KUNIT_EXPECT_TRUE(test, *pending & ICSK_ACK_NOW);
+    KUNIT_EXPECT_TRUE(test, tp->ecn_flags & TCP_ECN_DEMAND_CWR);
+
+    // 新状态的 ACK 已发出；之后收到 CWR 清掉了 DEMAND_CWR，旧状态的 ACK 仍要带 ECE
+    tp->rcv_wup = 2000;
+    tp->rcv_nxt = 3000;
+    *pending = 0;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_ECN_IS_CE);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.count, 1U);
+    KUNIT_EXPECT_FALSE(test, *pending & ICSK_ACK_NOW);
+    tp->ecn_flags &= ~TCP_ECN_DEMAND_CWR;
+    *pending = ICSK_ACK_TIMER;
+    tp->rcv_nxt = 4000;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_ECN_NO_CE);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.count, 2U);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.seq, 3000U);
+    KUNIT_EXPECT_TRUE(test, lotspeed_kt_acks.ece);
+    KUNIT_EXPECT_FALSE(test, tp->ecn_flags & TCP_ECN_DEMAND_CWR);
+
+    // 未确认的数据超过 64KB
+    tp->rcv_wup = 4000;
+    tp->rcv_nxt = 4000 + 70000;
+    *pending = ICSK_ACK_TIMER;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_ECN_IS_CE);
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_acks.count, 2U);
+    KUNIT_EXPECT_TRUE(test, *pending & ICSK_ACK_NOW);
+    KUNIT_EXPECT_TRUE(test, tp->ecn_flags & TCP_ECN_DEMAND_CWR);
+
+    lotspeed_ops.release(sk);
+}
+#endif
+
+// 速率换算的包数缓存：与精确除法最多差 1 个包，速率或 mss 不变时不重算，任一变化后校验失败并重算
+static void lotspeed_kt_rate_pkts(struct kunit *test)
+{
+    static const u64 rates[] = { 125000, 12500000, 1250000000, 5000000000ULL, 50000000000ULL };
+    static const u32 msses[] = { 536, 1448, 8948 };
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(rates); i++) {
+        for (j = 0; j < ARRAY_SIZE(msses); j++) {
+            u64 exact = div64_u64(rates[i] * 20000, (u64)msses[j] * USEC_PER_SEC);
+            u32 pkts = lotspeed_rate_pkts(ca, rates[i], 20000, msses[j]);
+
+            KUNIT_EXPECT_LE(test, (u64)pkts, exact);
+            KUNIT_EXPECT_LE(test, exact, (u64)pkts + 1);
+        }
+    }
+
+    lotspeed_rate_pkts(ca, 1250000000, 20000, 1448);
+    KUNIT_EXPECT_EQ(test, ca->pkt_rate, (u32)div_u64(1250000000ULL << LOTSPEED_PKT_SHIFT, 1448));
+    ca->pkt_rate++;
+    KUNIT_EXPECT_EQ(test, lotspeed_rate_pkts(ca, 1250000000, 20000, 1448), 17265U);
+    KUNIT_EXPECT_EQ(test, ca->pkt_rate, (u32)div_u64(1250000000ULL << LOTSPEED_PKT_SHIFT, 1448));
+    lotspeed_rate_pkts(ca, 1250000000, 20000, 1460);
+    KUNIT_EXPECT_EQ(test, ca->pkt_rate, (u32)div_u64(1250000000ULL << LOTSPEED_PKT_SHIFT, 1460));
+    lotspeed_rate_pkts(ca, 1250000001, 20000, 1460);
+    KUNIT_EXPECT_EQ(test, ca->pkt_rate, (u32)div_u64(1250000001ULL << LOTSPEED_PKT_SHIFT, 1460));
+
+    lotspeed_ops.release(sk);
+}
+
+// 丢包片段：每个有丢包的往返退让一次（lotserver_loss_beta），误判恢复还原增益与片段内降过的速率
+static void lotspeed_kt_loss_episode(struct kunit *test)
+{
+    struct sock *sk;
+    struct tcp_sock *tp;
+    struct lotspeed *ca;
+    u64 rate;
+
+    lotserver_gain = 40;
+    lotserver_loss_beta = 50;
+    lotspeed_config_commit();
+    sk = lotspeed_kt_sock(test);
+    tp = tcp_sk(sk);
+    ca = inet_csk_ca(sk);
+    rate = ca->target_rate;
+    ca->ss_mode = false;
+    tp->snd_cwnd = 1000;
+    minmax_reset(&ca->bw_max, ca->round_count, lotspeed_bw_from_bytes(rate));
+
+    // 片段开始的往返只退让一次
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), 700U);
+    ca->flags |= LOTSPEED_ROUND_LOSS;
+    lotspeed_adapt_rate(sk, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 20U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 1U);
+
+    // 丢包持续到下一个往返：再退让一次；之后无丢包的往返不退让
+    ca->flags |= LOTSPEED_ROUND_LOSS;
+    lotspeed_adapt_rate(sk, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, (u32)LOTSPEED_MIN_GAIN);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 2U);
+    lotspeed_adapt_rate(sk, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, (u32)LOTSPEED_MIN_GAIN);
+
+    // 片段内按交付速率降过速：误判恢复时增益回到 4.0x，速率回到交付速率窗口最大值
+    ca->target_rate = rate / 4;
+    ca->loss_rate_cut = 1;
+    lotspeed_ops.undo_cwnd(sk);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 40U);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, lotspeed_bw_bytes(lotspeed_bw_from_bytes(rate)));
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+    KUNIT_EXPECT_FALSE(test, ca->loss_rate_cut);
+
+    lotspeed_ops.release(sk);
+}
+
+// 启动：从握手 RTT 下的初始窗口起步，按启动增益 pacing，交付速率停止增长或开始排队时转入排空，
+// 在途量回落后进入增益循环；交付速率仍在增长时的随机丢包不结束启动
+static void lotspeed_kt_startup(struct kunit *test)
+{
+    // 深缓冲：不丢包，只有交付速率停止增长或时延上升能结束启动
+    static const struct lotspeed_kt_path path = {
+        .link_bw        = 12500000,
+        .base_rtt_us    = 20000,
+        .buf_pkts       = 2000,
+        .ack_pkts       = 2,
+    };
+    struct lotspeed_kt_point pt;
+    struct tcp_sock *tp;
+    struct lotspeed *ca;
+    struct sock *sk;
+    int i, drain = -1, cruise = -1;
+
+    lotserver_startup_rtt_pct = 0;
+    lotspeed_config_commit();
+    sk = lotspeed_kt_sock_rtt(test, 0, path.base_rtt_us);
+    tp = tcp_sk(sk);
+    ca = inet_csk_ca(sk);
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 50ULL * LOTSPEED_KT_MSS * USEC_PER_SEC / 20000);
+
+    // 第一个 ACK 之后：没有排队，交付速率还在增长，丢包判为随机，恢复后仍在启动中
+    lotspeed_kt_ack(sk, &path);
+    tp->snd_cwnd = 1000;
+    KUNIT_EXPECT_EQ(test, lotspeed_kt_loss(sk, TCP_CA_Recovery), (u32)TCP_INFINITE_SSTHRESH);
+    lotspeed_ops.set_state(sk, TCP_CA_Open);
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_NE(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_DRAIN);
+
+    for (i = 0; i < LOTSPEED_KT_ROUNDS && cruise < 0; i++) {
+        lotspeed_kt_run(test, sk, &path, &pt, 1);
+        if (drain < 0 && ca->ss_mode && ca->cycle_phase == LOTSPEED_PHASE_DRAIN)
+            drain = i;
+        if (!ca->ss_mode)
+            cruise = i;
+    }
+    // 交付速率到达瓶颈后再过 LOTSPEED_FULL_BW_RTTS 个往返转入排空，排空不超过同样的往返数
+    KUNIT_EXPECT_GT(test, drain, 0);
+    KUNIT_EXPECT_GT(test, cruise, drain);
+    KUNIT_EXPECT_LE(test, cruise - drain, LOTSPEED_FULL_BW_RTTS);
+    KUNIT_EXPECT_GT(test, ca->target_rate, path.link_bw * 99 / 100);
+    KUNIT_EXPECT_LT(test, ca->target_rate, path.link_bw * 101 / 100);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_CRUISE);
+    KUNIT_EXPECT_EQ(test, (u32)ca->loss_count, 0U);
+    lotspeed_ops.release(sk);
+
+    // 时延检查：排队超过 rtt_min 的 25% 立即转入排空，比等交付速率停止增长早
+    lotserver_startup_rtt_pct = 25;
+    lotspeed_config_commit();
+    sk = lotspeed_kt_sock_rtt(test, 0, path.base_rtt_us);
+    ca = inet_csk_ca(sk);
+    for (i = 0; i < drain && ca->cycle_phase != LOTSPEED_PHASE_DRAIN; i++)
+        lotspeed_kt_run(test, sk, &path, &pt, 1);
+    KUNIT_EXPECT_LT(test, i, drain);
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_DRAIN);
+    lotspeed_ops.release(sk);
+}
+
+// 空闲重启：目标速率按空闲时长衰减后逐往返翻倍回到空闲前的估计；恢复的第一个往返就出现排队时退回启动。
+// 丢包恢复中和短于 rtt_min 的间隙不算空闲；半衰期为 0 时沿用空闲前的速率
+static void lotspeed_kt_idle_restart(struct kunit *test)
+{
+    // 空闲之后瓶颈只剩 1/4（其他流量占满了剩余部分）
+    static const struct lotspeed_kt_path slow = {
+        .link_bw        = 12500000 / 4,
+        .base_rtt_us    = 20000,
+        .buf_pkts       = 43,
+        .ack_pkts       = 2,
+    };
+    const struct lotspeed_kt_path *path = &lotspeed_kt_default_path;
+    struct lotspeed_kt_point pt;
+    struct tcp_sock *tp;
+    struct lotspeed *ca;
+    struct sock *sk;
+    u64 rate;
+    int i;
+
+    sk = lotspeed_kt_sock_rtt(test, 0, path->base_rtt_us);
+    tp = tcp_sk(sk);
+    ca = inet_csk_ca(sk);
+    for (i = 0; i < LOTSPEED_KT_ROUNDS && ca->ss_mode; i++)
+        lotspeed_kt_run(test, sk, path, &pt, 1);
+    KUNIT_ASSERT_FALSE(test, ca->ss_mode);
+    rate = ca->target_rate;
+
+    // 丢包恢复中（超时重传）与不到一个 rtt_min 的间隙：速率不变
+    tp->lsndtime = tcp_jiffies32 - msecs_to_jiffies(1000);
+    inet_csk(sk)->icsk_ca_state = TCP_CA_Loss;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_TX_START);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, rate);
+    inet_csk(sk)->icsk_ca_state = TCP_CA_Open;
+    tp->lsndtime = tcp_jiffies32;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_TX_START);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, rate);
+    KUNIT_EXPECT_FALSE(test, ca->idle_resume);
+
+    // 空闲一个半衰期：从一半的速率恢复，不回到启动，路径没变时几个往返内回到原来的速率
+    tp->lsndtime = tcp_jiffies32 - msecs_to_jiffies(1000);
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_TX_START);
+    KUNIT_EXPECT_FALSE(test, ca->ss_mode);
+    KUNIT_EXPECT_TRUE(test, ca->idle_resume);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, rate / 2);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_CRUISE);
+    for (i = 0; i < 3 && ca->idle_resume; i++)
+        lotspeed_kt_run(test, sk, path, &pt, 1);
+    KUNIT_EXPECT_FALSE(test, ca->idle_resume);
+    KUNIT_EXPECT_FALSE(test, ca->ss_mode);
+    KUNIT_EXPECT_GE(test, ca->target_rate, rate * 99 / 100);
+
+    // 空闲期间路径变窄：恢复的第一个往返开始排队，丢掉旧估计退回启动
+    tp->lsndtime = tcp_jiffies32 - msecs_to_jiffies(1000);
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_TX_START);
+    KUNIT_EXPECT_TRUE(test, ca->idle_resume);
+    lotspeed_kt_run(test, sk, &slow, &pt, 1);
+    KUNIT_EXPECT_TRUE(test, ca->ss_mode);
+    KUNIT_EXPECT_FALSE(test, ca->idle_resume);
+    KUNIT_EXPECT_LT(test, ca->target_rate, rate / 2);
+    KUNIT_EXPECT_LE(test, lotspeed_bw_bytes(minmax_get(&ca->bw_max)), slow.link_bw * 101 / 100);
+
+    // 半衰期为 0：空闲前的速率原样恢复，不进入回升核对
+    for (i = 0; i < LOTSPEED_KT_ROUNDS && ca->ss_mode; i++)
+        lotspeed_kt_run(test, sk, &slow, &pt, 1);
+    KUNIT_ASSERT_FALSE(test, ca->ss_mode);
+    rate = ca->target_rate;
+    lotserver_idle_halflife_ms = 0;
+    lotspeed_config_commit();
+    tp->lsndtime = tcp_jiffies32 - msecs_to_jiffies(1000);
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_TX_START);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, rate);
+    KUNIT_EXPECT_FALSE(test, ca->idle_resume);
+    KUNIT_EXPECT_FALSE(test, ca->ss_mode);
+
+    // 交付速率窗口为空但已有目标速率：不重新启动；丢包恢复中同样只把增益循环拉回巡航
+    minmax_reset(&ca->bw_max, ca->round_count, 0);
+    tp->lsndtime = tcp_jiffies32 - msecs_to_jiffies(1000);
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_TX_START);
+    KUNIT_EXPECT_FALSE(test, ca->ss_mode);
+    inet_csk(sk)->icsk_ca_state = TCP_CA_Loss;
+    ca->cycle_phase = LOTSPEED_PHASE_PROBE;
+    lotspeed_ops.cwnd_event(sk, CA_EVENT_CWND_RESTART);
+    KUNIT_EXPECT_FALSE(test, ca->ss_mode);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cycle_phase, (u32)LOTSPEED_PHASE_CRUISE);
+    inet_csk(sk)->icsk_ca_state = TCP_CA_Open;
+    lotspeed_ops.release(sk);
+}
+
+// 耦合组：同一 sk_mark 的连接均分组速率，成员的调整记到组速率上，离开后份额由其余成员收回
+static void lotspeed_kt_couple(struct kunit *test)
+{
+    struct sock *a, *b, *solo;
+    struct lotspeed *ca_a, *ca_b;
+    u64 rate = lotserver_rate;
+
+    lotserver_couple = LOTSPEED_COUPLE_MARK;
+    lotspeed_config_commit();
+    a = lotspeed_kt_sock_mark(test, 7);
+    b = lotspeed_kt_sock_mark(test, 7);
+    solo = lotspeed_kt_sock_mark(test, 0);
+    ca_a = inet_csk_ca(a);
+    ca_b = inet_csk_ca(b);
+
+    KUNIT_ASSERT_NE(test, (u32)ca_a->group, 0U);
+    KUNIT_EXPECT_EQ(test, (u32)ca_a->group, (u32)ca_b->group);
+    KUNIT_EXPECT_EQ(test, (u32)((struct lotspeed *)inet_csk_ca(solo))->group, 0U);
+    KUNIT_EXPECT_EQ(test, ca_b->target_rate, rate / 2);
+
+    // 先加入的成员在下一个往返结束时让出一半
+    lotspeed_adapt_rate(a, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, ca_a->target_rate, rate / 2);
+
+    // 一个成员降速，组速率同步减少，另一个成员的份额随之变化
+    ca_b->target_rate = rate / 4;
+    lotspeed_group_adjust(b, lotspeed_kt_cfg(), rate / 2);
+    KUNIT_EXPECT_EQ(test, lotspeed_group_get(ca_a)->rate, rate * 3 / 4);
+    lotspeed_adapt_rate(a, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, ca_a->target_rate, rate * 3 / 8);
+
+    // 成员离开后组速率不变，剩下的成员拿回全部
+    lotspeed_ops.release(b);
+    lotspeed_adapt_rate(a, lotspeed_kt_cfg(), NULL);
+    KUNIT_EXPECT_EQ(test, ca_a->target_rate, rate * 3 / 4);
+
+    lotspeed_ops.release(a);
+    lotspeed_ops.release(solo);
+}
+
+static u32 lotspeed_kt_link_mbps;
+
+static int lotspeed_kt_get_link_ksettings(struct net_device *dev,
+                                          struct ethtool_link_ksettings *ks)
+{
+    ks->base.speed = lotspeed_kt_link_mbps;
+    return 0;
+}
+
+static const struct ethtool_ops lotspeed_kt_ethtool_ops = {
+    .get_link_ksettings = lotspeed_kt_get_link_ksettings,
+};
+
+static void lotspeed_kt_netdev_event(unsigned long event, struct net_device *dev)
+{
+    struct netdev_notifier_info info = { .dev = dev };
+
+    rtnl_lock();
+    lotspeed_netdev_event(NULL, event, &info);
+    rtnl_unlock();
+}
+
+// 自动速率：lotserver_rate = 0 时按出口网卡协商速率定速，链路变化后下一次查询即生效，
+// 网卡未知时退回 1Gbps，显式设置的速率优先
+static void lotspeed_kt_link_rate(struct kunit *test)
+{
+    struct dst_entry dst = {};
+    struct net_device *dev;
+    struct sock *sk;
+
+    lotserver_rate = 0;
+    lotspeed_config_commit();
+    sk = lotspeed_kt_sock(test);
+    KUNIT_EXPECT_EQ(test, lotspeed_rate(sk, lotspeed_kt_cfg()), LOTSPEED_RATE_FALLBACK);
+
+    dev = alloc_netdev(0, "lstest%d", NET_NAME_UNKNOWN, ether_setup);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+    dev->ethtool_ops = &lotspeed_kt_ethtool_ops;
+    dst.dev = dev;
+    RCU_INIT_POINTER(sk->sk_dst_cache, &dst);
+    KUNIT_EXPECT_EQ(test, lotspeed_rate(sk, lotspeed_kt_cfg()), LOTSPEED_RATE_FALLBACK);
+
+    lotspeed_kt_link_mbps = 25000;
+    lotspeed_kt_netdev_event(NETDEV_REGISTER, dev);
+    KUNIT_EXPECT_EQ(test, lotspeed_rate(sk, lotspeed_kt_cfg()), 25000ULL * 125000 * 90 / 100);
+
+    lotspeed_kt_link_mbps = 10000;
+    lotspeed_kt_netdev_event(NETDEV_CHANGE, dev);
+    KUNIT_EXPECT_EQ(test, lotspeed_rate(sk, lotspeed_kt_cfg()), 10000ULL * 125000 * 90 / 100);
+
+    lotserver_rate = 30000000;
+    lotspeed_config_commit();
+    KUNIT_EXPECT_EQ(test, lotspeed_rate(sk, lotspeed_kt_cfg()), 30000000ULL);
+    lotserver_rate = 0;
+    lotspeed_config_commit();
+
+    lotspeed_kt_netdev_event(NETDEV_UNREGISTER, dev);
+    KUNIT_EXPECT_EQ(test, lotspeed_rate(sk, lotspeed_kt_cfg()), LOTSPEED_RATE_FALLBACK);
+
+    RCU_INIT_POINTER(sk->sk_dst_cache, NULL);
+    free_netdev(dev);
+    lotspeed_ops.release(sk);
+}
+
+// 参数快照：lotserver_hold 期间的写入不生效，发布后已建立的连接在下一个 ACK 按变化了的参数对齐
+static void lotspeed_kt_config_rebase(struct kunit *test)
+{
+    // 缓冲足够深，启动中不丢包，增益只随参数变化
+    static const struct lotspeed_kt_path path = {
+        .link_bw        = 12500000,
+        .base_rtt_us    = 20000,
+        .buf_pkts       = 10000,
+        .ack_pkts       = 2,
+    };
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct lotspeed *ca = inet_csk_ca(sk);
+
+    lotspeed_kt_ack(sk, &path);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 30000000ULL);
+
+    lotserver_hold = true;
+    lotspeed_config_commit();
+    lotserver_rate = 10000000;
+    lotspeed_config_commit();
+    lotserver_gain = 25;
+    lotspeed_config_commit();
+    lotspeed_kt_ack(sk, &path);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 30000000ULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 15U);
+
+    // 自适应模式：速率收进新上限，增益取新值
+    lotserver_hold = false;
+    lotspeed_config_commit();
+    lotspeed_kt_ack(sk, &path);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 10000000ULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 25U);
+
+    // 上限调高时自适应连接保留当前速率，固定速率连接直接取上限
+    lotserver_rate = 40000000;
+    lotspeed_config_commit();
+    lotspeed_kt_ack(sk, &path);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 10000000ULL);
+
+    lotserver_adaptive = false;
+    lotspeed_config_commit();
+    lotspeed_kt_ack(sk, &path);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 40000000ULL);
+
+    // 只对齐变化了的那组参数：只改速率时学到的增益和涡轮预算不动
+    ca->cwnd_gain = 12;
+    ca->turbo_budget = 1;
+    lotserver_rate = 20000000;
+    lotspeed_config_commit();
+    lotspeed_config_rebase(sk, ca, lotspeed_kt_cfg());
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 20000000ULL);
+    KUNIT_EXPECT_EQ(test, ca->rate_ceiling, lotspeed_bw_from_bytes(20000000));
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    KUNIT_EXPECT_EQ(test, (u32)ca->turbo_budget, 1U);
+
+    // 丢包片段中不对齐，片段结束后再对齐
+    ca->flags |= LOTSPEED_LOSS_EPISODE;
+    lotserver_gain = 30;
+    lotspeed_config_commit();
+    lotspeed_config_rebase(sk, ca, lotspeed_kt_cfg());
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 12U);
+    ca->flags &= ~LOTSPEED_LOSS_EPISODE;
+    lotspeed_config_rebase(sk, ca, lotspeed_kt_cfg());
+    KUNIT_EXPECT_EQ(test, (u32)ca->cwnd_gain, 30U);
+    KUNIT_EXPECT_EQ(test, ca->target_rate, 20000000ULL);
+    KUNIT_EXPECT_EQ(test, (u32)ca->turbo_budget, 1U);
+    KUNIT_EXPECT_EQ(test, ca->cfg_gen, lotspeed_kt_cfg()->gen);
+
+    lotspeed_ops.release(sk);
+}
+
+// INET_DIAG：私有属性号，丢包计数、软涡轮预算和阶段随状态导出；没有请求位时不返回
+static void lotspeed_kt_get_info(struct kunit *test)
+{
+    struct sock *sk = lotspeed_kt_sock(test);
+    struct lotspeed *ca = inet_csk_ca(sk);
+    union tcp_cc_info info;
+    struct lotspeed_diag_info *di = (struct lotspeed_diag_info *)&info;
+    int attr = 0;
+
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.get_info(sk, 0, &attr, &info), (size_t)0);
+
+    // ss -ti 的请求：tcp_bbr_info
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.get_info(sk, 1 << (INET_DIAG_VEGASINFO - 1), &attr, &info),
+                    sizeof(info.bbr));
+    KUNIT_EXPECT_EQ(test, attr, INET_DIAG_BBRINFO);
+    KUNIT_EXPECT_EQ(test, (u64)info.bbr.bbr_bw_hi << 32 | info.bbr.bbr_bw_lo, ca->target_rate);
+    KUNIT_EXPECT_EQ(test, info.bbr.bbr_min_rtt, ca->rtt_min);
+    KUNIT_EXPECT_EQ(test, info.bbr.bbr_cwnd_gain, 15U * LOTSPEED_DIAG_UNIT / 10);
+
+    // lotspeed_diag 的请求：完整的私有结构
+    KUNIT_EXPECT_EQ(test, lotspeed_ops.get_info(sk, 1 << (INET_DIAG_VEGASINFO - 1) | LOTSPEED_DIAG_EXT,
+                                                &attr, &info),
+                    sizeof(*di));
+    KUNIT_EXPECT_EQ(test, attr, LOTSPEED_DIAG_INFO);
+    KUNIT_EXPECT_EQ(test, (u64)di->rate_hi << 32 | di->rate_lo, ca->target_rate);
+    KUNIT_EXPECT_EQ(test, (u32)di->cwnd_gain, 15U * LOTSPEED_DIAG_UNIT / 10);
+    KUNIT_EXPECT_EQ(test, (u32)di->loss_count, 0U);
+    KUNIT_EXPECT_EQ(test, (u32)di->turbo_budget, (u32)ca->turbo_budget);
+    KUNIT_EXPECT_EQ(test, (u32)di->flags, (u32)LOTSPEED_DIAG_STARTUP);
+
+    tcp_sk(sk)->snd_cwnd = 1000;
+    lotspeed_kt_loss(sk, TCP_CA_Recovery);
+    lotspeed_ops.get_info(sk, ~0U, &attr, &info);
+    KUNIT_EXPECT_EQ(test, (u32)di->loss_count, 1U);
+    KUNIT_EXPECT_EQ(test, (u32)di->cwnd_gain, 12U * LOTSPEED_DIAG_UNIT / 10);
+    // 拥塞丢包结束启动：仍带启动标志，阶段为排空
+    KUNIT_EXPECT_EQ(test, (u32)di->flags, (u32)(LOTSPEED_DIAG_STARTUP | LOTSPEED_DIAG_LOSS_EPISODE));
+    KUNIT_EXPECT_EQ(test, (u32)di->phase, (u32)LOTSPEED_PHASE_DRAIN);
+
+    lotspeed_ops.release(sk);
+}
+
+// 出口预算：每块网卡的协商速率按 lotserver_egress_pct 与权重分给经它发送的连接，
+// 出口网卡未知的连接不受限；路由换到另一块网卡后，下一次确认槽位时权重随之迁移
+static void lotspeed_kt_budget_fold_now(u8 slot)
+{
+    lotspeed_budgets[slot].stamp = jiffies - msecs_to_jiffies(LOTSPEED_BUDGET_REFRESH_MS) - 1;
+}
+
+static void lotspeed_kt_egress_budget(struct kunit *test)
+{
+    struct dst_entry dst_a = {}, dst_b = {};
+    struct net_device *a, *b;
+    struct lotspeed *ca1, *ca2;
+    struct sock *sk1, *sk2;
+
+    a = alloc_netdev(0, "lsa%d", NET_NAME_UNKNOWN, ether_setup);
+    b = alloc_netdev(0, "lsb%d", NET_NAME_UNKNOWN, ether_setup);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, a);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, b);
+    a->ethtool_ops = &lotspeed_kt_ethtool_ops;
+    b->ethtool_ops = &lotspeed_kt_ethtool_ops;
+    dst_a.dev = a;
+    dst_b.dev = b;
+    lotspeed_kt_link_mbps = 10000;
+    lotspeed_kt_netdev_event(NETDEV_REGISTER, a);
+    lotspeed_kt_link_mbps = 1000;
+    lotspeed_kt_netdev_event(NETDEV_REGISTER, b);
+
+    lotserver_egress_pct = 80;
+    lotspeed_config_commit();
+    sk1 = lotspeed_kt_sock(test);
+    sk2 = lotspeed_kt_sock(test);
+    ca1 = inet_csk_ca(sk1);
+    ca2 = inet_csk_ca(sk2);
+    KUNIT_EXPECT_EQ(test, (u32)ca1->budget_slot, 0U);
+    KUNIT_EXPECT_EQ(test, lotspeed_budget_cap(ca1, lotspeed_kt_cfg()), 0ULL);
+
+    // 两条连接都经 10G 网卡：80% 对半分
+    RCU_INIT_POINTER(sk1->sk_dst_cache, &dst_a);
+    RCU_INIT_POINTER(sk2->sk_dst_cache, &dst_a);
+    lotspeed_budget_refresh(sk1, ca1);
+    lotspeed_budget_refresh(sk2, ca2);
+    KUNIT_ASSERT_NE(test, (u32)ca1->budget_slot, 0U);
+    KUNIT_EXPECT_EQ(test, (u32)ca1->budget_slot, (u32)ca2->budget_slot);
+    lotspeed_kt_budget_fold_now(ca1->budget_slot);
+    KUNIT_EXPECT_EQ(test, lotspeed_budget_cap(ca1, lotspeed_kt_cfg()), 10000ULL * 125000 * 80 / 100 / 2);
+
+    // 第二条连接改走 1G 网卡：各自独占所在网卡的 80%
+    RCU_INIT_POINTER(sk2->sk_dst_cache, &dst_b);
+    lotspeed_budget_refresh(sk2, ca2);
+    KUNIT_EXPECT_NE(test, (u32)ca1->budget_slot, (u32)ca2->budget_slot);
+    lotspeed_kt_budget_fold_now(ca1->budget_slot);
+    lotspeed_kt_budget_fold_now(ca2->budget_slot);
+    KUNIT_EXPECT_EQ(test, lotspeed_budget_cap(ca1, lotspeed_kt_cfg()), 10000ULL * 125000 * 80 / 100);
+    KUNIT_EXPECT_EQ(test, lotspeed_budget_cap(ca2, lotspeed_kt_cfg()), 1000ULL * 125000 * 80 / 100);
+
+    lotserver_egress_pct = 0;
+    lotspeed_config_commit();
+    KUNIT_EXPECT_EQ(test, lotspeed_budget_cap(ca1, lotspeed_kt_cfg()), 0ULL);
+
+    lotspeed_ops.release(sk1);
+    lotspeed_ops.release(sk2);
+    lotspeed_kt_netdev_event(NETDEV_UNREGISTER, a);
+    lotspeed_kt_netdev_event(NETDEV_UNREGISTER, b);
+    RCU_INIT_POINTER(sk1->sk_dst_cache, NULL);
+    RCU_INIT_POINTER(sk2->sk_dst_cache, NULL);
+    free_netdev(a);
+    free_netdev(b);
+}
+
+// 逐 ACK 采集：打开后每个回调写一条已提交的记录（输入取回调前、决策取回调后），
+// 端口不符或关闭后不再写
+static void lotspeed_kt_capture(struct kunit *test)
+{
+    struct lotspeed_capture_rec *recs, *rec;
+    struct lotspeed_capture_hdr *hdr;
+    struct sock *sk, *other;
+    struct lotspeed *ca;
+    u64 head;
+    u32 ret;
+
+    KUNIT_ASSERT_EQ(test, param_set_capture("1", NULL), 0);
+    hdr = lotspeed_capture_ring;
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, hdr);
+    KUNIT_EXPECT_EQ(test, hdr->rec_size, (u32)sizeof(struct lotspeed_capture_rec));
+    recs = (struct lotspeed_capture_rec *)((char *)hdr + LOTSPEED_CAPTURE_HDR_SIZE);
+    head = hdr->head;
+
+    sk = lotspeed_kt_sock(test);
+    ca = inet_csk_ca(sk);
+    KUNIT_ASSERT_EQ(test, hdr->head, head + 1);
+    rec = &recs[head & (LOTSPEED_CAPTURE_RECS - 1)];
+    KUNIT_EXPECT_EQ(test, rec->seq, head + 1);
+    KUNIT_EXPECT_EQ(test, rec->flow, (u64)hash_ptr(sk, 32));
+    KUNIT_EXPECT_EQ(test, (u32)rec->type, (u32)LOTSPEED_CAPTURE_INIT);
+    KUNIT_EXPECT_EQ(test, rec->snd_cwnd, 10U);
+    KUNIT_EXPECT_EQ(test, rec->cwnd, tcp_sk(sk)->snd_cwnd);
+    KUNIT_EXPECT_EQ(test, rec->target_rate, ca->target_rate);
+
+    tcp_sk(sk)->snd_cwnd = 100;
+    ret = lotspeed_ops.ssthresh(sk);
+    rec = &recs[(head + 1) & (LOTSPEED_CAPTURE_RECS - 1)];
+    KUNIT_EXPECT_EQ(test, (u32)rec->type, (u32)LOTSPEED_CAPTURE_SSTHRESH);
+    KUNIT_EXPECT_EQ(test, rec->snd_cwnd, 100U);
+    KUNIT_EXPECT_EQ(test, rec->ret, ret);
+    KUNIT_EXPECT_EQ(test, (u32)rec->loss_count, (u32)ca->loss_count);
+
+    lotserver_capture_port = 443;
+    other = lotspeed_kt_sock(test);
+    KUNIT_EXPECT_EQ(test, hdr->head, head + 2);
+    lotserver_capture_port = 0;
+
+    KUNIT_ASSERT_EQ(test, param_set_capture("0", NULL), 0);
+    lotspeed_ops.release(other);
+    lotspeed_ops.release(sk);
+    KUNIT_EXPECT_EQ(test, hdr->head, head + 2);
+}
+
+// 各模式下稳态逐 ACK 路径的耗时：先跑到增益循环稳定，再只计时 cong_control
+static void lotspeed_kt_ack_cost(struct kunit *test)
+{
+    struct lotspeed_kt_point pts[LOTSPEED_KT_ROUNDS];
+    struct rate_sample rs = {};
+    enum lotspeed_kt_mode mode;
+    struct tcp_sock *tp;
+    struct sock *sk;
+    u64 t0, ns;
+    int i;
+
+    for (mode = 0; mode < LOTSPEED_KT_NR; mode++) {
+        lotspeed_kt_set_mode(mode);
+        sk = lotspeed_kt_sock(test);
+        tp = tcp_sk(sk);
+        lotspeed_kt_run(test, sk, &lotspeed_kt_default_path, pts, LOTSPEED_KT_ROUNDS);
+
+        rs.delivered = lotspeed_kt_default_path.ack_pkts;
+        rs.interval_us = tp->srtt_us >> 3;
+        rs.prior_in_flight = tp->snd_cwnd;
+
+        t0 = ktime_get_mono_fast_ns();
+        for (i = 0; i < LOTSPEED_KT_BENCH_ACKS; i++) {
+            rs.prior_delivered = tp->delivered - tp->snd_cwnd;
+            tp->delivered += rs.delivered;
+            lotspeed_cong_control_impl(sk, lotspeed_kt_cfg(), &rs);
+        }
+        ns = div_u64(ktime_get_mono_fast_ns() - t0, LOTSPEED_KT_BENCH_ACKS);
+        lotspeed_ops.release(sk);
+
+        kunit_info(test, "%s: %llu ns/ACK (%d ACKs)\n", lotspeed_kt_mode_names[mode],
+                   (unsigned long long)ns, LOTSPEED_KT_BENCH_ACKS);
+        KUNIT_EXPECT_LT_MSG(test, ns, (u64)LOTSPEED_KT_ACK_NS_MAX,
+                            "%s per-ACK cost", lotspeed_kt_mode_names[mode]);
+    }
+}
+
+static struct kunit_case lotspeed_kt_cases[] = {
+    KUNIT_CASE(lotspeed_kt_trace_fixed),
+    KUNIT_CASE(lotspeed_kt_trace_adaptive),
+    KUNIT_CASE(lotspeed_kt_trace_turbo),
+    KUNIT_CASE(lotspeed_kt_trace_soft_turbo),
+    KUNIT_CASE(lotspeed_kt_state_callbacks),
+    KUNIT_CASE(lotspeed_kt_soft_turbo_budget),
+    KUNIT_CASE(lotspeed_kt_loss_episode),
+    KUNIT_CASE(lotspeed_kt_loss_classify),
+    KUNIT_CASE(lotspeed_kt_ecn_cwr),
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    KUNIT_CASE(lotspeed_kt_ecn_echo),
+#endif
+    KUNIT_CASE(lotspeed_kt_rate_pkts),
+    KUNIT_CASE(lotspeed_kt_startup),
+    KUNIT_CASE(lotspeed_kt_idle_restart),
+    KUNIT_CASE(lotspeed_kt_couple),
+    KUNIT_CASE(lotspeed_kt_link_rate),
+    KUNIT_CASE(lotspeed_kt_egress_budget),
+    KUNIT_CASE(lotspeed_kt_config_rebase),
+    KUNIT_CASE(lotspeed_kt_get_info),
+    KUNIT_CASE(lotspeed_kt_capture),
+    KUNIT_CASE(lotspeed_kt_ack_cost),
+    {}
+};
+
+static struct kunit_suite lotspeed_kt_suite = {
+    .name       = "lotspeed",
+    .suite_init = lotspeed_kt_suite_init,
+    .suite_exit = lotspeed_kt_suite_exit,
+    .init       = lotspeed_kt_init,
+    .test_cases = lotspeed_kt_cases,
+};
+
+kunit_test_suite(lotspeed_kt_suite);
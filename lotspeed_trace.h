@@ -0,0 +1,123 @@
+// lotspeed_trace.h  ——  lotspeed 跟踪点
+//
+// 跟踪点关闭时只是一条被 static key 打补丁跳过的指令，不影响 ACK 快路径。
+// 开启方式：
+//   echo 1 > /sys/kernel/tracing/events/lotspeed/enable
+//   cat /sys/kernel/tracing/trace_pipe
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lotspeed
+
+#if !defined(_LOTSPEED_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _LOTSPEED_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// 每个 ACK 的控制结果（取代原来每 1000 个 ACK 一次的 STATUS 日志）
+TRACE_EVENT(lotspeed_cong_control,
+
+    TP_PROTO(const struct sock *sk, u32 cwnd, u32 target_cwnd, u64 rate,
+             u32 rtt_us, u32 rtt_min, u32 gain, bool ss_mode, u8 phase),
+
+    TP_ARGS(sk, cwnd, target_cwnd, rate, rtt_us, rtt_min, gain, ss_mode, phase),
+
+    TP_STRUCT__entry(
+        __field(const void *, skaddr)
+        __field(u32, cwnd)
+        __field(u32, target_cwnd)
+        __field(u64, rate)
+        __field(u32, rtt_us)
+        __field(u32, rtt_min)
+        __field(u32, gain)
+        __field(bool, ss_mode)
+        __field(u8, phase)
+    ),
+
+    TP_fast_assign(
+        __entry->skaddr = sk;
+        __entry->cwnd = cwnd;
+        __entry->target_cwnd = target_cwnd;
+        __entry->rate = rate;
+        __entry->rtt_us = rtt_us;
+        __entry->rtt_min = rtt_min;
+        __entry->gain = gain;
+        __entry->ss_mode = ss_mode;
+        __entry->phase = phase;
+    ),
+
+    TP_printk("sk=%p cwnd=%u target_cwnd=%u rate=%llu rtt=%u rtt_min=%u gain=%u ss=%d phase=%s",
+              __entry->skaddr, __entry->cwnd, __entry->target_cwnd,
+              (unsigned long long)__entry->rate, __entry->rtt_us,
+              __entry->rtt_min, __entry->gain, __entry->ss_mode,
+              __print_symbolic(__entry->phase, { 0, "probe" }, { 1, "drain" }, { 2, "cruise" }))
+);
+
+// 自适应调速（升 / 降）
+TRACE_EVENT(lotspeed_adapt,
+
+    TP_PROTO(const struct sock *sk, u64 old_rate, u64 new_rate,
+             u64 delivery_rate, u32 gain),
+
+    TP_ARGS(sk, old_rate, new_rate, delivery_rate, gain),
+
+    TP_STRUCT__entry(
+        __field(const void *, skaddr)
+        __field(u64, old_rate)
+        __field(u64, new_rate)
+        __field(u64, delivery_rate)
+        __field(u32, gain)
+    ),
+
+    TP_fast_assign(
+        __entry->skaddr = sk;
+        __entry->old_rate = old_rate;
+        __entry->new_rate = new_rate;
+        __entry->delivery_rate = delivery_rate;
+        __entry->gain = gain;
+    ),
+
+    TP_printk("sk=%p rate=%llu->%llu delivery=%llu gain=%u",
+              __entry->skaddr, (unsigned long long)__entry->old_rate,
+              (unsigned long long)__entry->new_rate,
+              (unsigned long long)__entry->delivery_rate, __entry->gain)
+);
+
+// 拥塞状态切换，ignored 表示该信号被涡轮模式吞掉
+TRACE_EVENT(lotspeed_set_state,
+
+    TP_PROTO(const struct sock *sk, u8 new_state, u32 loss_count, u32 gain,
+             u32 turbo_budget, bool ignored),
+
+    TP_ARGS(sk, new_state, loss_count, gain, turbo_budget, ignored),
+
+    TP_STRUCT__entry(
+        __field(const void *, skaddr)
+        __field(u8, new_state)
+        __field(u32, loss_count)
+        __field(u32, gain)
+        __field(u32, turbo_budget)
+        __field(bool, ignored)
+    ),
+
+    TP_fast_assign(
+        __entry->skaddr = sk;
+        __entry->new_state = new_state;
+        __entry->loss_count = loss_count;
+        __entry->gain = gain;
+        __entry->turbo_budget = turbo_budget;
+        __entry->ignored = ignored;
+    ),
+
+    TP_printk("sk=%p state=%u losses=%u gain=%u turbo_budget=%u ignored=%d",
+              __entry->skaddr, __entry->new_state, __entry->loss_count,
+              __entry->gain, __entry->turbo_budget, __entry->ignored)
+);
+
+#endif // _LOTSPEED_TRACE_H
+
+// 模块在源码树外编译，define_trace.h 需要从 -I$(src) 找到本文件
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE lotspeed_trace
+#include <trace/define_trace.h>
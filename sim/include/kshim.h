@@ -0,0 +1,1037 @@
+// kshim.h  ——  lotspeed 用户态模拟器的内核接口垫片
+//
+// 只提供 lotspeed.c 实际用到的那一小部分内核 API，让 lotspeed.c 可以
+// 原样编译进用户态模拟器。结构体字段名与内核保持一致，语义按
+// net/ipv4/tcp_input.c / tcp_rate.c 简化；时间由模拟器的虚拟时钟驱动。
+
+#ifndef LOTSPEED_SIM_KSHIM_H
+#define LOTSPEED_SIM_KSHIM_H
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 以 6.6 内核的接口编译（对应 lotspeed.c 中的 NEW_CONG_CONTROL_API 分支）
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + ((c) > 255 ? 255 : (c)))
+#define LINUX_VERSION_CODE      KERNEL_VERSION(6, 6, 0)
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef long long s64;
+typedef s64      time64_t;
+
+// uapi 类型（lotspeed_capture.h）
+typedef u8       __u8;
+typedef u16      __u16;
+typedef u32      __u32;
+typedef u64      __u64;
+typedef s32      __s32;
+
+#define U8_MAX   ((u8)~0U)
+#define U16_MAX  ((u16)~0U)
+#define U32_MAX  ((u32)~0U)
+
+// ---------------------------------------------------------------------------
+// 编译器 / 通用宏
+// ---------------------------------------------------------------------------
+#define __init
+#define __exit
+#define __read_mostly
+#define noinline           __attribute__((noinline))
+#ifndef __always_inline     // glibc 的 sys/cdefs.h 已定义
+#define __always_inline    inline __attribute__((always_inline))
+#endif
+#define likely(x)          __builtin_expect(!!(x), 1)
+#define unlikely(x)        __builtin_expect(!!(x), 0)
+#define READ_ONCE(x)       (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *)&(x) = (val))
+#define BUILD_BUG_ON(cond) ((void)sizeof(char[1 - 2 * !!(cond)]))
+#define ARRAY_SIZE(a)      (sizeof(a) / sizeof((a)[0]))
+
+#define min(x, y) ({ __typeof__(x) _x = (x); __typeof__(y) _y = (y); \
+                     (void)(&_x == &_y); _x < _y ? _x : _y; })
+#define max(x, y) ({ __typeof__(x) _x = (x); __typeof__(y) _y = (y); \
+                     (void)(&_x == &_y); _x > _y ? _x : _y; })
+#define min_t(type, x, y) ({ type _x = (x); type _y = (y); _x < _y ? _x : _y; })
+#define max_t(type, x, y) ({ type _x = (x); type _y = (y); _x > _y ? _x : _y; })
+#define clamp_t(type, val, lo, hi) min_t(type, max_t(type, val, lo), hi)
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define BIT(nr) (1UL << (nr))
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define PAGE_SIZE     4096
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+#define USEC_PER_MSEC 1000L
+#define USEC_PER_SEC  1000000L
+#define NSEC_PER_USEC 1000L
+#define NSEC_PER_MSEC 1000000L
+#define NSEC_PER_SEC  1000000000L
+
+// ---------------------------------------------------------------------------
+// 64 位除法
+// ---------------------------------------------------------------------------
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+    return dividend / divisor;
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+    return dividend / divisor;
+}
+
+static inline u64 mul_u64_u32_shr(u64 a, u32 mul, unsigned int shift)
+{
+    return (u64)(((unsigned __int128)a * mul) >> shift);
+}
+
+#define do_div(n, base) ({ u32 __base = (base); u32 __rem = (u32)((n) % __base); \
+                           (n) /= __base; __rem; })
+
+// ---------------------------------------------------------------------------
+// 原子量（模拟器单线程运行，直接读写即可）
+// ---------------------------------------------------------------------------
+typedef struct { int counter; } atomic_t;
+typedef struct { s64 counter; } atomic64_t;
+
+#define ATOMIC_INIT(i)   { (i) }
+#define ATOMIC64_INIT(i) { (i) }
+
+static inline int  atomic_read(const atomic_t *v)        { return v->counter; }
+static inline void atomic_set(atomic_t *v, int i)        { v->counter = i; }
+static inline void atomic_inc(atomic_t *v)               { v->counter++; }
+static inline void atomic_dec(atomic_t *v)               { v->counter--; }
+static inline void atomic_add(int i, atomic_t *v)        { v->counter += i; }
+static inline s64  atomic64_read(const atomic64_t *v)    { return v->counter; }
+static inline void atomic64_add(s64 i, atomic64_t *v)    { v->counter += i; }
+static inline s64  atomic64_inc_return(atomic64_t *v)    { return ++v->counter; }
+
+#define smp_wmb()                  __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_rmb()                  __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define smp_load_acquire(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+
+#define cmpxchg(ptr, old, new) __sync_val_compare_and_swap(ptr, old, new)
+#define ____cacheline_aligned __attribute__((aligned(64)))
+
+// ---------------------------------------------------------------------------
+// 每 CPU 变量（模拟器只有一个 CPU）
+// ---------------------------------------------------------------------------
+#define DEFINE_PER_CPU(type, name)   type name
+#define per_cpu_ptr(ptr, cpu)        ((void)(cpu), (ptr))
+#define this_cpu_ptr(ptr)            (ptr)
+#define this_cpu_inc(var)            ((var)++)
+#define this_cpu_add(var, v)         ((var) += (v))
+#define this_cpu_sub(var, v)         ((var) -= (v))
+#define this_cpu_read(var)           (var)
+#define for_each_possible_cpu(cpu)   for ((cpu) = 0; (cpu) < 1; (cpu)++)
+
+static inline int fls(unsigned int x) { return x ? 32 - __builtin_clz(x) : 0; }
+static inline int fls64(u64 x) { return x ? 64 - __builtin_clzll(x) : 0; }
+
+// ---------------------------------------------------------------------------
+// 内存、锁与 RCU（模拟器单线程：锁为空操作，RCU 宽限期立即结束）
+// ---------------------------------------------------------------------------
+typedef unsigned int gfp_t;
+#define GFP_KERNEL 0u
+#define GFP_ATOMIC 1u
+#define __GFP_NOWARN 0u
+
+static inline void *kmalloc(size_t size, gfp_t flags) { (void)flags; return malloc(size); }
+static inline void *kzalloc(size_t size, gfp_t flags) { (void)flags; return calloc(1, size); }
+static inline void kfree(const void *p) { free((void *)p); }
+
+typedef struct { int unused; } spinlock_t;
+#define DEFINE_SPINLOCK(name)   spinlock_t name = { 0 }
+#define spin_lock_init(l)       ((void)(l))
+#define spin_lock(l)            ((void)(l))
+#define spin_unlock(l)          ((void)(l))
+#define spin_lock_bh(l)         ((void)(l))
+#define spin_unlock_bh(l)       ((void)(l))
+
+struct mutex { int unused; };
+#define DEFINE_MUTEX(name)      struct mutex name = { 0 }
+#define mutex_lock(m)           ((void)(m))
+#define mutex_unlock(m)         ((void)(m))
+#define lockdep_is_held(l)      ((void)(l), 1)
+
+typedef struct { int refs; } refcount_t;
+static inline void refcount_set(refcount_t *r, int n)        { r->refs = n; }
+static inline unsigned int refcount_read(const refcount_t *r) { return r->refs; }
+static inline void refcount_inc(refcount_t *r)               { r->refs++; }
+static inline bool refcount_dec_and_test(refcount_t *r)      { return --r->refs == 0; }
+
+struct rcu_head { void *unused; };
+
+#define rcu_read_lock()                 do { } while (0)
+#define rcu_read_unlock()               do { } while (0)
+#define synchronize_rcu()               do { } while (0)
+#define rcu_barrier()                   do { } while (0)
+#define kfree_rcu(ptr, field)           kfree(ptr)
+#define call_rcu(head, func)            (func)(head)
+#define rcu_dereference(p)              READ_ONCE(p)
+#define rcu_access_pointer(p)           READ_ONCE(p)
+#define rcu_dereference_protected(p, c) (p)
+#define rcu_assign_pointer(p, v)        WRITE_ONCE(p, v)
+#define RCU_INIT_POINTER(p, v)          ((p) = (v))
+#define __rcu
+
+// hlist（与 include/linux/list.h 同名同义）
+struct hlist_node { struct hlist_node *next, **pprev; };
+struct hlist_head { struct hlist_node *first; };
+
+#define hlist_entry(ptr, type, member) container_of(ptr, type, member)
+#define hlist_entry_safe(ptr, type, member) \
+    ({ __typeof__(ptr) ____ptr = (ptr); ____ptr ? hlist_entry(____ptr, type, member) : NULL; })
+
+static inline void hlist_add_head_rcu(struct hlist_node *n, struct hlist_head *h)
+{
+    n->next = h->first;
+    n->pprev = &h->first;
+    if (h->first)
+        h->first->pprev = &n->next;
+    h->first = n;
+}
+
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+    *n->pprev = n->next;
+    if (n->next)
+        n->next->pprev = n->pprev;
+}
+
+static inline void hlist_replace_rcu(struct hlist_node *old, struct hlist_node *n)
+{
+    n->next = old->next;
+    n->pprev = old->pprev;
+    *n->pprev = n;
+    if (n->next)
+        n->next->pprev = &n->next;
+}
+
+#define hlist_for_each_entry_rcu(pos, head, member, ...)                         \
+    for (pos = hlist_entry_safe((head)->first, __typeof__(*(pos)), member); pos; \
+         pos = hlist_entry_safe((pos)->member.next, __typeof__(*(pos)), member))
+#define hlist_for_each_entry(pos, head, member) \
+    hlist_for_each_entry_rcu(pos, head, member)
+#define hlist_for_each_entry_safe(pos, n, head, member)                          \
+    for (pos = hlist_entry_safe((head)->first, __typeof__(*(pos)), member);      \
+         pos && ({ n = pos->member.next; 1; });                                  \
+         pos = hlist_entry_safe(n, __typeof__(*(pos)), member))
+
+// Bob Jenkins lookup3，与 include/linux/jhash.h 相同
+#define __jhash_rot(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+#define __jhash_mix(a, b, c) {                          \
+    a -= c; a ^= __jhash_rot(c, 4);  c += b;            \
+    b -= a; b ^= __jhash_rot(a, 6);  a += c;            \
+    c -= b; c ^= __jhash_rot(b, 8);  b += a;            \
+    a -= c; a ^= __jhash_rot(c, 16); c += b;            \
+    b -= a; b ^= __jhash_rot(a, 19); a += c;            \
+    c -= b; c ^= __jhash_rot(b, 4);  b += a; }
+#define __jhash_final(a, b, c) {                        \
+    c ^= b; c -= __jhash_rot(b, 14);                    \
+    a ^= c; a -= __jhash_rot(c, 11);                    \
+    b ^= a; b -= __jhash_rot(a, 25);                    \
+    c ^= b; c -= __jhash_rot(b, 16);                    \
+    a ^= c; a -= __jhash_rot(c, 4);                     \
+    b ^= a; b -= __jhash_rot(a, 14);                    \
+    c ^= b; c -= __jhash_rot(b, 24); }
+
+static inline u32 jhash2(const u32 *k, u32 length, u32 initval)
+{
+    u32 a, b, c;
+
+    a = b = c = 0xdeadbeef + (length << 2) + initval;
+    while (length > 3) {
+        a += k[0]; b += k[1]; c += k[2];
+        __jhash_mix(a, b, c);
+        length -= 3;
+        k += 3;
+    }
+    switch (length) {
+    case 3: c += k[2]; /* fallthrough */
+    case 2: b += k[1]; /* fallthrough */
+    case 1: a += k[0];
+        __jhash_final(a, b, c);
+        break;
+    case 0:
+        break;
+    }
+    return c;
+}
+
+// ---------------------------------------------------------------------------
+// 字符串与数字解析（lib/string.c、lib/kstrtox.c、net/core/utils.c 的子集）
+// ---------------------------------------------------------------------------
+static inline char *kstrdup(const char *s, gfp_t gfp)
+{
+    (void)gfp;
+    return s ? strdup(s) : NULL;
+}
+
+static inline char *skip_spaces(const char *str)
+{
+    while (isspace((unsigned char)*str))
+        str++;
+    return (char *)str;
+}
+
+static inline char *strim(char *s)
+{
+    size_t len = strlen(s);
+
+    while (len && isspace((unsigned char)s[len - 1]))
+        s[--len] = '\0';
+    return skip_spaces(s);
+}
+
+static inline ssize_t strscpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strnlen(src, size);
+
+    if (!size)
+        return -E2BIG;
+    if (len >= size) {
+        memcpy(dst, src, size - 1);
+        dst[size - 1] = '\0';
+        return -E2BIG;
+    }
+    memcpy(dst, src, len + 1);
+    return (ssize_t)len;
+}
+
+#define scnprintf(buf, size, fmt, ...) \
+    ({ int __n = snprintf(buf, size, fmt, ##__VA_ARGS__); \
+       __n < 0 ? 0 : (size_t)__n >= (size_t)(size) ? (int)(size) - 1 : __n; })
+
+int kstrtoull(const char *s, unsigned int base, unsigned long long *res);
+int kstrtobool(const char *s, bool *res);
+
+static inline int kstrtou64(const char *s, unsigned int base, u64 *res)
+{
+    return kstrtoull(s, base, res);
+}
+
+static inline int kstrtou32(const char *s, unsigned int base, u32 *res)
+{
+    unsigned long long v;
+    int ret = kstrtoull(s, base, &v);
+
+    if (ret)
+        return ret;
+    if (v > UINT32_MAX)
+        return -ERANGE;
+    *res = (u32)v;
+    return 0;
+}
+
+static inline int kstrtou16(const char *s, unsigned int base, u16 *res)
+{
+    unsigned long long v;
+    int ret = kstrtoull(s, base, &v);
+
+    if (ret)
+        return ret;
+    if (v > UINT16_MAX)
+        return -ERANGE;
+    *res = (u16)v;
+    return 0;
+}
+
+int in4_pton(const char *src, int srclen, u8 *dst, int delim, const char **end);
+int in6_pton(const char *src, int srclen, u8 *dst, int delim, const char **end);
+
+static inline u32 hash_32(u32 val, unsigned int bits)
+{
+    return (val * 0x61C88647u) >> (32 - bits);
+}
+
+static inline u32 hash_64(u64 val, unsigned int bits)
+{
+    return (u32)((val * 0x61C8864680B583EBull) >> (64 - bits));
+}
+
+#define hash_ptr(ptr, bits) hash_64((unsigned long)(ptr), bits)
+
+static inline u32 reciprocal_scale(u32 val, u32 ep_ro)
+{
+    return (u32)(((u64)val * ep_ro) >> 32);
+}
+
+// ---------------------------------------------------------------------------
+// static key：模拟器里就是普通的布尔判断
+// ---------------------------------------------------------------------------
+struct static_key_false { int enabled; };
+
+#define DEFINE_STATIC_KEY_FALSE(name)  struct static_key_false name = { 0 }
+#define static_branch_unlikely(key)    __builtin_expect((key)->enabled, 0)
+#define static_branch_likely(key)      __builtin_expect((key)->enabled, 1)
+#define static_branch_enable(key)      ((key)->enabled = 1)
+#define static_branch_disable(key)     ((key)->enabled = 0)
+#define static_key_enabled(key)        ((key)->enabled)
+
+// ---------------------------------------------------------------------------
+// 日志
+// ---------------------------------------------------------------------------
+extern int sim_printk_level;    // 0 = 静默, 1 = info/warn/err, 2 = 含 debug
+
+__attribute__((format(printf, 2, 3)))
+void sim_printk(int level, const char *fmt, ...);
+
+#define pr_err(fmt, ...)   sim_printk(1, fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)  sim_printk(1, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)  sim_printk(1, fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...) sim_printk(2, fmt, ##__VA_ARGS__)
+
+// ---------------------------------------------------------------------------
+// 虚拟时钟
+// ---------------------------------------------------------------------------
+#define HZ 1000
+
+extern u64 sim_now_ns;
+
+#define jiffies        ((unsigned long)(sim_now_ns / (NSEC_PER_SEC / HZ)))
+#define tcp_jiffies32  ((u32)jiffies)
+
+#define time_after32(a, b)  ((s32)((u32)(b) - (u32)(a)) < 0)
+#define time_before32(b, a) time_after32(a, b)
+#define time_after(a, b)    ((long)((b) - (a)) < 0)
+#define time_before(a, b)   time_after(b, a)
+
+static inline unsigned long msecs_to_jiffies(unsigned int m)
+{
+    return (unsigned long)m * HZ / 1000;
+}
+
+static inline unsigned int jiffies_to_msecs(unsigned long j)
+{
+    return (unsigned int)(j * 1000 / HZ);
+}
+
+static inline u64 ktime_get_ns(void)
+{
+    return sim_now_ns;
+}
+
+// 真实的单调时钟，只用于测量 lotspeed 自身的耗时（KUnit 的逐 ACK 基准）
+static inline u64 ktime_get_mono_fast_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline time64_t ktime_get_real_seconds(void)
+{
+    // 固定纪元，保证 start_time 非零
+    return 1700000000LL + (time64_t)(sim_now_ns / NSEC_PER_SEC);
+}
+
+static inline void msleep(unsigned int msecs)
+{
+    (void)msecs;
+}
+
+// ---------------------------------------------------------------------------
+// 模块与参数
+// ---------------------------------------------------------------------------
+struct module;
+#define THIS_MODULE ((struct module *)0)
+
+struct kernel_param;
+
+struct kernel_param_ops {
+    int (*set)(const char *val, const struct kernel_param *kp);
+    int (*get)(char *buffer, const struct kernel_param *kp);
+};
+
+struct kernel_param {
+    const char *name;
+    const struct kernel_param_ops *ops;
+    void *arg;
+};
+
+extern const struct kernel_param_ops param_ops_bool;
+extern const struct kernel_param_ops param_ops_int;
+extern const struct kernel_param_ops param_ops_uint;
+extern const struct kernel_param_ops param_ops_ulong;
+
+int param_set_bool(const char *val, const struct kernel_param *kp);
+int param_get_bool(char *buffer, const struct kernel_param *kp);
+int param_set_int(const char *val, const struct kernel_param *kp);
+int param_get_int(char *buffer, const struct kernel_param *kp);
+int param_set_uint(const char *val, const struct kernel_param *kp);
+int param_get_uint(char *buffer, const struct kernel_param *kp);
+int param_set_ulong(const char *val, const struct kernel_param *kp);
+int param_get_ulong(char *buffer, const struct kernel_param *kp);
+
+// 参数登记到独立段中，模拟器通过 __start/__stop 符号遍历并调用真实的 set 回调
+#define module_param_cb(name, ops, arg, perm)                                  \
+    static const struct kernel_param __sim_param_##name                        \
+    __attribute__((used, section("sim_kparams"), aligned(sizeof(void *)))) =  \
+        { #name, ops, arg }
+#define module_param(name, type, perm) \
+    module_param_cb(name, &param_ops_##type, &name, perm)
+#define MODULE_PARM_DESC(name, desc) extern int __sim_unused_decl
+
+// 数组参数：逗号分隔，逐个交给元素类型的 set/get
+struct kparam_array {
+    unsigned int max;
+    unsigned int elemsize;
+    unsigned int *num;
+    const struct kernel_param_ops *ops;
+    void *elem;
+};
+
+extern const struct kernel_param_ops param_array_ops;
+
+#define module_param_array(name, type, nump, perm)                             \
+    static const struct kparam_array __sim_param_arr_##name = {                \
+        ARRAY_SIZE(name), sizeof(name[0]), nump, &param_ops_##type, name };    \
+    module_param_cb(name, &param_array_ops, (void *)&__sim_param_arr_##name, perm)
+
+#define module_init(fn) int sim_module_init(void) { return fn(); }
+#define module_exit(fn) void sim_module_exit(void) { fn(); }
+
+#define MODULE_LICENSE(x)     extern int __sim_unused_decl
+#define MODULE_AUTHOR(x)      extern int __sim_unused_decl
+#define MODULE_VERSION(x)     extern int __sim_unused_decl
+#define MODULE_DESCRIPTION(x) extern int __sim_unused_decl
+#define MODULE_ALIAS(x)       extern int __sim_unused_decl
+
+int sim_module_init(void);
+void sim_module_exit(void);
+
+// 模拟器侧：按名字读写模块参数（走 lotspeed.c 自己的 set/get 回调）
+int sim_param_set(const char *name, const char *val);
+int sim_param_get(const char *name, char *buffer);
+void sim_param_dump(FILE *out);
+// 每行 name=value，与 /sys/module/lotspeed/parameters 下逐个读出的内容相同（采集文件用）
+void sim_param_save(FILE *out);
+
+// ---------------------------------------------------------------------------
+// 套接字与 TCP 状态
+// ---------------------------------------------------------------------------
+enum sk_pacing {
+    SK_PACING_NONE = 0,
+    SK_PACING_NEEDED = 1,
+    SK_PACING_FQ = 2,
+};
+
+typedef u32 __be32;
+typedef u16 __be16;
+
+#define CONFIG_IPV6         1
+#define IS_ENABLED(option)  (option)
+
+static inline bool ipv6_addr_v4mapped(const struct in6_addr *a)
+{
+    return a->s6_addr32[0] == 0 && a->s6_addr32[1] == 0 &&
+           a->s6_addr32[2] == htonl(0x0000ffff);
+}
+
+static inline void ipv6_addr_prefix(struct in6_addr *pfx, const struct in6_addr *addr,
+                                    int plen)
+{
+    int o = plen >> 3, b = plen & 0x7;
+
+    memset(pfx->s6_addr, 0, sizeof(pfx->s6_addr));
+    memcpy(pfx->s6_addr, addr, o);
+    if (b != 0)
+        pfx->s6_addr[o] = addr->s6_addr[o] & (0xff00 >> b);
+}
+
+// cgroup v2：模拟器里每个套接字直接带一个 cgroup id
+#define CONFIG_SOCK_CGROUP_DATA 1
+
+struct cgroup { u64 id; };
+struct sock_cgroup_data { struct cgroup *cgroup; };
+
+static inline struct cgroup *sock_cgroup_ptr(const struct sock_cgroup_data *skcd)
+{
+    return skcd->cgroup;
+}
+
+static inline u64 cgroup_id(const struct cgroup *cgrp)
+{
+    return cgrp ? cgrp->id : 0;
+}
+
+// ---------------------------------------------------------------------------
+// 网卡、路由与 netdevice 通知链（模拟器单线程：RTNL 为空操作）
+// ---------------------------------------------------------------------------
+#define IFNAMSIZ        16
+#define SPEED_UNKNOWN   -1
+#define NET_NAME_UNKNOWN 0
+#define NOTIFY_DONE     0
+
+struct net_device;
+
+struct ethtool_link_ksettings {
+    struct {
+        u32 speed;      // Mbps
+    } base;
+};
+
+struct ethtool_ops {
+    int (*get_link_ksettings)(struct net_device *dev, struct ethtool_link_ksettings *ks);
+};
+
+struct net_device {
+    char name[IFNAMSIZ];
+    const struct ethtool_ops *ethtool_ops;
+    struct net_device *master;      // bond / team 等上层设备
+};
+
+struct dst_entry {
+    struct net_device *dev;
+};
+
+static inline int __ethtool_get_link_ksettings(struct net_device *dev,
+                                               struct ethtool_link_ksettings *ks)
+{
+    if (!dev->ethtool_ops || !dev->ethtool_ops->get_link_ksettings)
+        return -EOPNOTSUPP;
+    memset(ks, 0, sizeof(*ks));
+    return dev->ethtool_ops->get_link_ksettings(dev, ks);
+}
+
+static inline struct net_device *netdev_master_upper_dev_get(struct net_device *dev)
+{
+    return dev->master;
+}
+
+struct net_device *alloc_netdev(int sizeof_priv, const char *name,
+                                unsigned char name_assign_type,
+                                void (*setup)(struct net_device *));
+void free_netdev(struct net_device *dev);
+
+static inline void ether_setup(struct net_device *dev)
+{
+    (void)dev;
+}
+
+#define rtnl_lock()     do { } while (0)
+#define rtnl_unlock()   do { } while (0)
+#define ASSERT_RTNL()   do { } while (0)
+
+enum netdev_cmd {
+    NETDEV_UP = 1,
+    NETDEV_DOWN,
+    NETDEV_REBOOT,
+    NETDEV_CHANGE,
+    NETDEV_REGISTER,
+    NETDEV_UNREGISTER,
+    NETDEV_CHANGEMTU,
+    NETDEV_CHANGEADDR,
+    NETDEV_PRE_CHANGEADDR,
+    NETDEV_GOING_DOWN,
+    NETDEV_CHANGENAME,
+    NETDEV_CHANGEUPPER,
+};
+
+struct notifier_block {
+    int (*notifier_call)(struct notifier_block *nb, unsigned long action, void *data);
+};
+
+struct netdev_notifier_info {
+    struct net_device *dev;
+};
+
+struct netdev_notifier_changeupper_info {
+    struct netdev_notifier_info info;
+    struct net_device *upper_dev;
+    bool linking;
+};
+
+static inline struct net_device *netdev_notifier_info_to_dev(const struct netdev_notifier_info *info)
+{
+    return info->dev;
+}
+
+// 与内核相同：注册时对已有设备重放 REGISTER / UP，注销时重放 UNREGISTER
+int register_netdevice_notifier(struct notifier_block *nb);
+int unregister_netdevice_notifier(struct notifier_block *nb);
+
+// 模拟器侧：登记 / 注销一个网卡，或通知链路变化（NETDEV_CHANGE 等）
+void sim_netdev_register(struct net_device *dev);
+void sim_netdev_unregister(struct net_device *dev);
+void sim_netdev_event(unsigned long event, struct net_device *dev);
+
+// 字段名取自 struct sock_common 的访问宏（sk_daddr / sk_dport / ...）
+struct sock {
+    unsigned long sk_pacing_rate;       // 字节/秒
+    unsigned long sk_max_pacing_rate;
+    u32 sk_pacing_status;
+    u8 sk_pacing_shift;
+    u32 sk_mark;
+    unsigned short sk_family;
+    __be32 sk_daddr;
+    __be32 sk_rcv_saddr;
+    __be16 sk_dport;
+    u16 sk_num;                         // 本地端口，主机字节序
+    struct in6_addr sk_v6_daddr;
+    struct sock_cgroup_data sk_cgrp_data;
+    struct dst_entry __rcu *sk_dst_cache;
+};
+
+static inline struct dst_entry *__sk_dst_get(const struct sock *sk)
+{
+    return rcu_dereference(sk->sk_dst_cache);
+}
+
+#define ICSK_CA_PRIV_SIZE (13 * sizeof(u64))
+
+struct tcp_congestion_ops;
+
+// net/inet_connection_sock.h：icsk_ack.pending 标志
+enum inet_csk_ack_state_t {
+    ICSK_ACK_SCHED = 1,
+    ICSK_ACK_TIMER = 2,
+    ICSK_ACK_PUSHED = 4,
+    ICSK_ACK_PUSHED2 = 8,
+    ICSK_ACK_NOW = 16,
+};
+
+struct inet_connection_sock {
+    struct sock icsk_inet;              // 必须是第一个成员
+    const struct tcp_congestion_ops *icsk_ca_ops;
+    u8 icsk_ca_state;
+    struct {
+        u8 pending;
+    } icsk_ack;
+    u64 icsk_ca_priv[ICSK_CA_PRIV_SIZE / sizeof(u64)];
+};
+
+struct tcp_sock {
+    struct inet_connection_sock inet_conn;  // 必须是第一个成员
+    u32 snd_cwnd;
+    u32 snd_ssthresh;
+    u32 snd_cwnd_clamp;
+    u32 prior_cwnd;
+    u32 srtt_us;            // 平滑 RTT << 3
+    u32 mdev_us;
+    u32 mss_cache;
+    u32 packets_out;
+    u32 delivered;
+    u32 delivered_ce;
+    u32 app_limited;
+    u32 lsndtime;           // 最近一次发出数据的时间（jiffies）
+    u32 rcv_nxt;            // 接收端：期望收到的下一个序号
+    u32 rcv_wup;            // 接收端：最近一次发出的 ACK 确认到的序号
+    u8 ecn_flags;           // TCP_ECN_*
+    u64 bytes_acked;        // RFC4898 tcpEStatsAppHCThruOctetsAcked
+    u64 tcp_mstamp;         // 微秒
+};
+
+// net/tcp.h ecn_flags
+#define TCP_ECN_OK          1
+#define TCP_ECN_QUEUE_CWR   2
+#define TCP_ECN_DEMAND_CWR  4
+#define TCP_ECN_SEEN        8
+
+// net/tcp.h 序号比较
+static inline bool before(u32 seq1, u32 seq2)
+{
+    return (s32)(seq1 - seq2) < 0;
+}
+#define after(seq2, seq1) before(seq1, seq2)
+
+// linux/win_minmax.h：Kathleen Nichols 窗口极值滤波，保留窗口内最好的三个样本
+struct minmax_sample {
+    u32 t;
+    u32 v;
+};
+
+struct minmax {
+    struct minmax_sample s[3];
+};
+
+static inline u32 minmax_get(const struct minmax *m)
+{
+    return m->s[0].v;
+}
+
+static inline u32 minmax_reset(struct minmax *m, u32 t, u32 meas)
+{
+    struct minmax_sample val = { .t = t, .v = meas };
+
+    m->s[2] = m->s[1] = m->s[0] = val;
+    return m->s[0].v;
+}
+
+u32 minmax_running_max(struct minmax *m, u32 win, u32 t, u32 meas);
+
+static inline struct inet_connection_sock *inet_csk(const struct sock *sk)
+{
+    return (struct inet_connection_sock *)sk;
+}
+
+static inline struct tcp_sock *tcp_sk(const struct sock *sk)
+{
+    return (struct tcp_sock *)sk;
+}
+
+static inline void *inet_csk_ca(const struct sock *sk)
+{
+    return (void *)inet_csk(sk)->icsk_ca_priv;
+}
+
+struct rate_sample {
+    u64 prior_mstamp;
+    u32 prior_delivered;
+    u32 prior_delivered_ce;
+    s32 delivered;
+    s32 delivered_ce;
+    long interval_us;
+    u32 snd_interval_us;
+    u32 rcv_interval_us;
+    long rtt_us;
+    int losses;
+    u32 acked_sacked;
+    u32 prior_in_flight;
+    u32 last_end_seq;
+    bool is_app_limited;
+    bool is_retrans;
+    bool is_ack_delayed;
+    bool is_ece;
+};
+
+enum tcp_ca_state {
+    TCP_CA_Open = 0,
+    TCP_CA_Disorder = 1,
+    TCP_CA_CWR = 2,
+    TCP_CA_Recovery = 3,
+    TCP_CA_Loss = 4,
+};
+
+enum tcp_ca_event {
+    CA_EVENT_TX_START,
+    CA_EVENT_CWND_RESTART,
+    CA_EVENT_COMPLETE_CWR,
+    CA_EVENT_LOSS,
+    CA_EVENT_ECN_NO_CE,
+    CA_EVENT_ECN_IS_CE,
+};
+
+enum tcp_ca_ack_event_flags {
+    CA_ACK_SLOWPATH = (1 << 0),
+    CA_ACK_WIN_UPDATE = (1 << 1),
+    CA_ACK_ECE = (1 << 2),
+};
+
+// ---------------------------------------------------------------------------
+// INET_DIAG（uapi/linux/inet_diag.h 的子集）
+// ---------------------------------------------------------------------------
+enum {
+    INET_DIAG_NONE,
+    INET_DIAG_MEMINFO,
+    INET_DIAG_INFO,
+    INET_DIAG_VEGASINFO,
+    INET_DIAG_CONG,
+    INET_DIAG_TOS,
+    INET_DIAG_TCLASS,
+    INET_DIAG_SKMEMINFO,
+    INET_DIAG_SHUTDOWN,
+    INET_DIAG_DCTCPINFO,
+    INET_DIAG_PROTOCOL,
+    INET_DIAG_SKV6ONLY,
+    INET_DIAG_LOCALS,
+    INET_DIAG_PEERS,
+    INET_DIAG_PAD,
+    INET_DIAG_MARK,
+    INET_DIAG_BBRINFO,
+};
+
+struct tcpvegas_info {
+    u32 tcpv_enabled;
+    u32 tcpv_rttcnt;
+    u32 tcpv_rtt;
+    u32 tcpv_minrtt;
+};
+
+struct tcp_dctcp_info {
+    u16 dctcp_enabled;
+    u16 dctcp_ce_state;
+    u32 dctcp_alpha;
+    u32 dctcp_ab_ecn;
+    u32 dctcp_ab_tot;
+};
+
+struct tcp_bbr_info {
+    u32 bbr_bw_lo;
+    u32 bbr_bw_hi;
+    u32 bbr_min_rtt;
+    u32 bbr_pacing_gain;
+    u32 bbr_cwnd_gain;
+};
+
+union tcp_cc_info {
+    struct tcpvegas_info vegas;
+    struct tcp_dctcp_info dctcp;
+    struct tcp_bbr_info bbr;
+};
+
+#define TCP_INFINITE_SSTHRESH   0x7fffffff
+#define TCP_INIT_CWND           10
+#define TCP_CONG_NON_RESTRICTED 0x1
+#define TCP_CONG_NEEDS_ECN      0x2
+#define TCP_CA_NAME_MAX         16
+
+struct tcp_congestion_ops {
+    u32 (*ssthresh)(struct sock *sk);
+    void (*cong_avoid)(struct sock *sk, u32 ack, u32 acked);
+    void (*set_state)(struct sock *sk, u8 new_state);
+    void (*cwnd_event)(struct sock *sk, enum tcp_ca_event ev);
+    void (*in_ack_event)(struct sock *sk, u32 flags);
+    u32 (*min_tso_segs)(struct sock *sk);
+    void (*cong_control)(struct sock *sk, u32 ack, int flag,
+                         const struct rate_sample *rs);
+    u32 (*undo_cwnd)(struct sock *sk);
+    u32 (*sndbuf_expand)(struct sock *sk);
+    size_t (*get_info)(struct sock *sk, u32 ext, int *attr,
+                       union tcp_cc_info *info);
+    char name[TCP_CA_NAME_MAX];
+    struct module *owner;
+    u32 flags;
+    void (*init)(struct sock *sk);
+    void (*release)(struct sock *sk);
+};
+
+// ---------------------------------------------------------------------------
+// debugfs / seq_file：文件登记在模拟器内，--debugfs 时把内容打印到 stdout
+// ---------------------------------------------------------------------------
+#define __user
+typedef unsigned short umode_t;
+
+struct inode {
+    void *i_private;
+};
+
+struct file {
+    void *private_data;
+};
+
+struct seq_file {
+    FILE *out;
+    int (*show)(struct seq_file *m, void *v);
+    void *private;
+};
+
+// mmap：模拟器里没有地址空间，remap_vmalloc_range 把缓冲区地址写进 vm_start
+struct vm_area_struct {
+    unsigned long vm_start;
+    unsigned long vm_end;
+    unsigned long vm_pgoff;
+};
+
+static inline void *vmalloc_user(unsigned long size) { return calloc(1, size); }
+static inline void vfree(const void *p) { free((void *)p); }
+
+static inline int remap_vmalloc_range(struct vm_area_struct *vma, void *addr,
+                                      unsigned long pgoff)
+{
+    vma->vm_start = (unsigned long)addr + pgoff * PAGE_SIZE;
+    return 0;
+}
+
+struct file_operations {
+    struct module *owner;
+    int (*open)(struct inode *inode, struct file *file);
+    ssize_t (*read)(struct file *file, char __user *buf, size_t size, loff_t *ppos);
+    ssize_t (*write)(struct file *file, const char __user *buf, size_t size, loff_t *ppos);
+    loff_t (*llseek)(struct file *file, loff_t offset, int whence);
+    int (*release)(struct inode *inode, struct file *file);
+    int (*mmap)(struct file *file, struct vm_area_struct *vma);
+};
+
+struct dentry;
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, umode_t mode, struct dentry *parent,
+                                   void *data, const struct file_operations *fops);
+void debugfs_remove_recursive(struct dentry *dentry);
+
+__attribute__((format(printf, 2, 3)))
+void seq_printf(struct seq_file *m, const char *fmt, ...);
+int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data);
+ssize_t seq_read(struct file *file, char __user *buf, size_t size, loff_t *ppos);
+loff_t seq_lseek(struct file *file, loff_t offset, int whence);
+int single_release(struct inode *inode, struct file *file);
+
+// 模拟器侧：依次 open/read/release 所有已登记的 debugfs 文件
+void sim_debugfs_dump(FILE *out);
+// 模拟器侧：按文件名找 lotspeed 登记的 debugfs 文件，NULL = 不存在
+const struct file_operations *sim_debugfs_fops(const char *name);
+
+// ---------------------------------------------------------------------------
+// 跟踪点：TRACE_EVENT 展开为直接格式化输出的 trace_<name>()，--trace 时打印到 stderr
+// ---------------------------------------------------------------------------
+extern bool sim_trace_enabled;
+
+__attribute__((format(printf, 2, 3)))
+void sim_trace_printf(const char *event, const char *fmt, ...);
+
+#define TP_PROTO(...)            __VA_ARGS__
+#define TP_ARGS(...)             __VA_ARGS__
+#define TP_STRUCT__entry(...)    __VA_ARGS__
+#define TP_fast_assign(...)      __VA_ARGS__
+#define TP_printk(fmt, ...)      fmt, ##__VA_ARGS__
+#define __field(type, item)      type item;
+
+struct trace_print_flags {
+    unsigned long mask;
+    const char *name;
+};
+
+static inline const char *sim_print_symbolic(unsigned long val, const struct trace_print_flags *syms)
+{
+    for (; syms->name; syms++) {
+        if (syms->mask == val)
+            return syms->name;
+    }
+    return "?";
+}
+
+#define __print_symbolic(value, ...) \
+    sim_print_symbolic(value, (const struct trace_print_flags[]){ __VA_ARGS__, { 0, NULL } })
+
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print)          \
+    struct sim_trace_entry_##name { tstruct };                          \
+    static inline void trace_##name(proto)                              \
+    {                                                                   \
+        struct sim_trace_entry_##name __sim_entry, *__entry = &__sim_entry; \
+        if (!sim_trace_enabled)                                         \
+            return;                                                     \
+        assign;                                                         \
+        sim_trace_printf(#name, print);                                 \
+    }
+
+// 模拟器中唯一注册的拥塞控制算法
+extern struct tcp_congestion_ops *sim_registered_ca;
+
+int tcp_register_congestion_control(struct tcp_congestion_ops *type);
+void tcp_unregister_congestion_control(struct tcp_congestion_ops *type);
+
+// net/tcp.h：立即发出确认到 rcv_nxt 的 ACK（模拟器不收数据，空实现）
+void __tcp_send_ack(struct sock *sk, u32 rcv_nxt);
+
+#endif // LOTSPEED_SIM_KSHIM_H
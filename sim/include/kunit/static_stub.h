@@ -0,0 +1,33 @@
+// kunit/static_stub.h  ——  模拟器里的 KUnit 静态桩
+//
+// 同一时间只能替换一个函数；用例结束时由 kunit_main.c 的 runner 撤销，与内核一致。
+
+#ifndef LOTSPEED_SIM_KUNIT_STATIC_STUB_H
+#define LOTSPEED_SIM_KUNIT_STATIC_STUB_H
+
+#include <kunit/test.h>
+
+extern void *sim_kunit_stub_real;
+extern void *sim_kunit_stub_repl;
+
+#define KUNIT_STATIC_STUB_REDIRECT(real_fn_name, args...) do {                \
+    typeof(&real_fn_name) __repl;                                            \
+    if (unlikely(sim_kunit_stub_real == (void *)real_fn_name)) {             \
+        __repl = sim_kunit_stub_repl;                                        \
+        return __repl(args);                                                 \
+    }                                                                        \
+} while (0)
+
+#define kunit_activate_static_stub(test, real_fn_addr, replacement_addr) do { \
+    typeof(&(real_fn_addr)) __check = (replacement_addr);                    \
+    (void)(test);                                                            \
+    sim_kunit_stub_real = (void *)(real_fn_addr);                            \
+    sim_kunit_stub_repl = (void *)__check;                                   \
+} while (0)
+
+#define kunit_deactivate_static_stub(test, real_fn_addr) do {                 \
+    (void)(test);                                                            \
+    sim_kunit_stub_real = NULL;                                              \
+} while (0)
+
+#endif // LOTSPEED_SIM_KUNIT_STATIC_STUB_H
@@ -0,0 +1,90 @@
+// kunit/test.h  ——  模拟器里运行 KUnit 用例的最小垫片
+//
+// 只实现 lotspeed_kunit.c 用到的宏；suite 登记到独立段中，由 kunit_main.c 遍历执行，
+// 输出与内核 KUnit 相同的 KTAP 格式。ASSERT 失败时 longjmp 回 runner 结束当前用例。
+
+#ifndef LOTSPEED_SIM_KUNIT_TEST_H
+#define LOTSPEED_SIM_KUNIT_TEST_H
+
+#include <kshim.h>
+#include <setjmp.h>
+
+#define SIM_KUNIT_MAX_ALLOCS 32
+
+struct kunit {
+    const char *name;
+    bool failed;
+    jmp_buf abort;
+    void *allocs[SIM_KUNIT_MAX_ALLOCS];
+    int nr_allocs;
+};
+
+struct kunit_case {
+    void (*run_case)(struct kunit *test);
+    const char *name;
+};
+
+struct kunit_suite {
+    const char *name;
+    int (*suite_init)(struct kunit_suite *suite);
+    void (*suite_exit)(struct kunit_suite *suite);
+    int (*init)(struct kunit *test);
+    void (*exit)(struct kunit *test);
+    struct kunit_case *test_cases;
+};
+
+#define KUNIT_CASE(fn) { .run_case = fn, .name = #fn }
+
+#define kunit_test_suite(suite)                                                \
+    static struct kunit_suite *__sim_kunit_##suite                             \
+    __attribute__((used, section("sim_kunit"), aligned(sizeof(void *)))) = &suite
+
+// 用例结束时由 runner 统一释放
+static inline void *kunit_kzalloc(struct kunit *test, size_t size, gfp_t gfp)
+{
+    void *p;
+
+    if (test->nr_allocs == SIM_KUNIT_MAX_ALLOCS)
+        return NULL;
+    p = kzalloc(size, gfp);
+    if (p)
+        test->allocs[test->nr_allocs++] = p;
+    return p;
+}
+
+#define IS_ERR_OR_NULL(p) (!(p) || (unsigned long)(p) >= (unsigned long)-4095)
+
+#define kunit_info(test, fmt, ...) \
+    printf("    # %s: " fmt, (test)->name, ##__VA_ARGS__)
+
+void sim_kunit_fail(struct kunit *test, const char *file, int line, const char *expr,
+                    long long left, long long right, const char *fmt, ...);
+
+#define SIM_KUNIT_CMP(test, left, op, right, fatal, fmt, ...) do {                 \
+    __typeof__(left) __l = (left);                                                 \
+    __typeof__(right) __r = (right);                                               \
+    if (!(__l op __r)) {                                                           \
+        sim_kunit_fail(test, __FILE__, __LINE__, #left " " #op " " #right,          \
+                       (long long)__l, (long long)__r, fmt, ##__VA_ARGS__);        \
+        if (fatal)                                                                 \
+            longjmp((test)->abort, 1);                                             \
+    }                                                                              \
+} while (0)
+
+#define KUNIT_EXPECT_EQ(test, l, r)             SIM_KUNIT_CMP(test, l, ==, r, false, NULL)
+#define KUNIT_EXPECT_NE(test, l, r)             SIM_KUNIT_CMP(test, l, !=, r, false, NULL)
+#define KUNIT_EXPECT_LT(test, l, r)             SIM_KUNIT_CMP(test, l, <, r, false, NULL)
+#define KUNIT_EXPECT_LE(test, l, r)             SIM_KUNIT_CMP(test, l, <=, r, false, NULL)
+#define KUNIT_EXPECT_GT(test, l, r)             SIM_KUNIT_CMP(test, l, >, r, false, NULL)
+#define KUNIT_EXPECT_GE(test, l, r)             SIM_KUNIT_CMP(test, l, >=, r, false, NULL)
+#define KUNIT_EXPECT_EQ_MSG(test, l, r, ...)    SIM_KUNIT_CMP(test, l, ==, r, false, __VA_ARGS__)
+#define KUNIT_EXPECT_LT_MSG(test, l, r, ...)    SIM_KUNIT_CMP(test, l, <, r, false, __VA_ARGS__)
+#define KUNIT_EXPECT_TRUE(test, c)              SIM_KUNIT_CMP(test, !!(c), ==, 1, false, NULL)
+#define KUNIT_EXPECT_FALSE(test, c)             SIM_KUNIT_CMP(test, !!(c), ==, 0, false, NULL)
+#define KUNIT_ASSERT_EQ(test, l, r)             SIM_KUNIT_CMP(test, l, ==, r, true, NULL)
+#define KUNIT_ASSERT_NE(test, l, r)             SIM_KUNIT_CMP(test, l, !=, r, true, NULL)
+#define KUNIT_ASSERT_FALSE(test, c)             SIM_KUNIT_CMP(test, !!(c), ==, 0, true, NULL)
+#define KUNIT_ASSERT_EQ_MSG(test, l, r, ...)    SIM_KUNIT_CMP(test, l, ==, r, true, __VA_ARGS__)
+#define KUNIT_ASSERT_NOT_ERR_OR_NULL(test, p)   SIM_KUNIT_CMP(test, IS_ERR_OR_NULL(p), ==, 0, true, NULL)
+
+#endif // LOTSPEED_SIM_KUNIT_TEST_H
@@ -0,0 +1 @@
+// 模拟器中跟踪点在 kshim.h 里直接展开，无需二次包含
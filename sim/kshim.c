@@ -0,0 +1,742 @@
+// kshim.c  ——  内核接口垫片的用户态实现（参数解析、注册、日志、时钟）
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <arpa/inet.h>
+
+#include <kshim.h>
+
+u64 sim_now_ns;
+
+// 按内核 printk 语义输出：额外支持 %pI4 / %pI6c，其余转换逐个交给 fprintf
+static void sim_vfprintk(FILE *out, const char *fmt, va_list ap)
+{
+    while (*fmt) {
+        char spec[32], addr[INET6_ADDRSTRLEN];
+        const char *start = fmt;
+        size_t len;
+        int star = -1;
+        bool is_long = false, is_llong = false, is_size = false;
+
+        if (*fmt != '%') {
+            fputc(*fmt++, out);
+            continue;
+        }
+        fmt++;
+        if (*fmt == '%') {
+            fputc('%', out);
+            fmt++;
+            continue;
+        }
+        fmt += strspn(fmt, "-+ #0");
+        if (*fmt == '*') {
+            star = va_arg(ap, int);
+            fmt++;
+        }
+        fmt += strspn(fmt, "0123456789.");
+        if (*fmt == 'z') {
+            is_size = true;
+            fmt++;
+        }
+        while (*fmt == 'l') {
+            is_llong = is_long;
+            is_long = true;
+            fmt++;
+        }
+        len = (size_t)(fmt - start + 1);
+        if (len >= sizeof(spec))
+            len = sizeof(spec) - 1;
+        memcpy(spec, start, len);
+        spec[len] = '\0';
+
+        switch (*fmt) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (is_llong)
+                star < 0 ? fprintf(out, spec, va_arg(ap, long long)) :
+                           fprintf(out, spec, star, va_arg(ap, long long));
+            else if (is_long || is_size)
+                star < 0 ? fprintf(out, spec, va_arg(ap, long)) :
+                           fprintf(out, spec, star, va_arg(ap, long));
+            else
+                star < 0 ? fprintf(out, spec, va_arg(ap, int)) :
+                           fprintf(out, spec, star, va_arg(ap, int));
+            fmt++;
+            break;
+        case 'f': case 'g': case 'e':
+            star < 0 ? fprintf(out, spec, va_arg(ap, double)) :
+                       fprintf(out, spec, star, va_arg(ap, double));
+            fmt++;
+            break;
+        case 's':
+            star < 0 ? fprintf(out, spec, va_arg(ap, const char *)) :
+                       fprintf(out, spec, star, va_arg(ap, const char *));
+            fmt++;
+            break;
+        case 'p': {
+            const void *ptr = va_arg(ap, const void *);
+
+            fmt++;
+            if (!strncmp(fmt, "I4", 2)) {
+                fputs(inet_ntop(AF_INET, ptr, addr, sizeof(addr)), out);
+                fmt += 2;
+            } else if (!strncmp(fmt, "I6c", 3)) {
+                fputs(inet_ntop(AF_INET6, ptr, addr, sizeof(addr)), out);
+                fmt += 3;
+            } else {
+                fprintf(out, "%p", ptr);
+            }
+            break;
+        }
+        default:
+            fputs(spec, out);
+            if (*fmt)
+                fmt++;
+            break;
+        }
+    }
+}
+int sim_printk_level;
+struct tcp_congestion_ops *sim_registered_ca;
+
+void sim_printk(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (level > sim_printk_level)
+        return;
+
+    fprintf(stderr, "[%10.6f] ", (double)sim_now_ns / NSEC_PER_SEC);
+    va_start(ap, fmt);
+    sim_vfprintk(stderr, fmt, ap);
+    va_end(ap);
+}
+
+bool sim_trace_enabled;
+
+void sim_trace_printf(const char *event, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "[%10.6f] %s: ", (double)sim_now_ns / NSEC_PER_SEC, event);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+int tcp_register_congestion_control(struct tcp_congestion_ops *type)
+{
+    if (sim_registered_ca && sim_registered_ca != type)
+        return -EEXIST;
+    sim_registered_ca = type;
+    return 0;
+}
+
+void tcp_unregister_congestion_control(struct tcp_congestion_ops *type)
+{
+    if (sim_registered_ca == type)
+        sim_registered_ca = NULL;
+}
+
+void __tcp_send_ack(struct sock *sk, u32 rcv_nxt)
+{
+    (void)sk;
+    (void)rcv_nxt;
+}
+
+// ---------------------------------------------------------------------------
+// 网卡与 netdevice 通知链（只支持一个通知者，足够 lotspeed 使用）
+// ---------------------------------------------------------------------------
+#define SIM_MAX_NETDEVS 8
+
+static struct notifier_block *sim_netdev_nb;
+static struct net_device *sim_netdevs[SIM_MAX_NETDEVS];
+
+struct net_device *alloc_netdev(int sizeof_priv, const char *name,
+                                unsigned char name_assign_type,
+                                void (*setup)(struct net_device *))
+{
+    struct net_device *dev = calloc(1, sizeof(*dev) + sizeof_priv);
+
+    (void)name_assign_type;
+    if (!dev)
+        return NULL;
+    strscpy(dev->name, name, sizeof(dev->name));
+    setup(dev);
+    return dev;
+}
+
+void free_netdev(struct net_device *dev)
+{
+    free(dev);
+}
+
+void sim_netdev_event(unsigned long event, struct net_device *dev)
+{
+    struct netdev_notifier_info info = { .dev = dev };
+
+    if (sim_netdev_nb)
+        sim_netdev_nb->notifier_call(sim_netdev_nb, event, &info);
+}
+
+void sim_netdev_register(struct net_device *dev)
+{
+    int i;
+
+    for (i = 0; i < SIM_MAX_NETDEVS; i++) {
+        if (!sim_netdevs[i]) {
+            sim_netdevs[i] = dev;
+            sim_netdev_event(NETDEV_REGISTER, dev);
+            sim_netdev_event(NETDEV_UP, dev);
+            return;
+        }
+    }
+}
+
+void sim_netdev_unregister(struct net_device *dev)
+{
+    int i;
+
+    for (i = 0; i < SIM_MAX_NETDEVS; i++) {
+        if (sim_netdevs[i] == dev) {
+            sim_netdev_event(NETDEV_UNREGISTER, dev);
+            sim_netdevs[i] = NULL;
+        }
+    }
+}
+
+int register_netdevice_notifier(struct notifier_block *nb)
+{
+    int i;
+
+    if (sim_netdev_nb)
+        return -EBUSY;
+    sim_netdev_nb = nb;
+    for (i = 0; i < SIM_MAX_NETDEVS; i++) {
+        if (sim_netdevs[i]) {
+            sim_netdev_event(NETDEV_REGISTER, sim_netdevs[i]);
+            sim_netdev_event(NETDEV_UP, sim_netdevs[i]);
+        }
+    }
+    return 0;
+}
+
+int unregister_netdevice_notifier(struct notifier_block *nb)
+{
+    int i;
+
+    if (sim_netdev_nb != nb)
+        return -ENOENT;
+    for (i = 0; i < SIM_MAX_NETDEVS; i++) {
+        if (sim_netdevs[i])
+            sim_netdev_event(NETDEV_UNREGISTER, sim_netdevs[i]);
+    }
+    sim_netdev_nb = NULL;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 参数读写（与 kernel/params.c 的行为一致：失败时不修改原值）
+// ---------------------------------------------------------------------------
+static int sim_parse_ull(const char *val, unsigned long long *out)
+{
+    char *end;
+
+    if (!val || !*val)
+        return -EINVAL;
+    errno = 0;
+    *out = strtoull(val, &end, 0);
+    if (errno || (*end && *end != '\n'))
+        return -EINVAL;
+    return 0;
+}
+
+int param_set_bool(const char *val, const struct kernel_param *kp)
+{
+    bool *p = kp->arg;
+
+    if (!val || !*val || !strcmp(val, "1") || !strcasecmp(val, "y") ||
+        !strcasecmp(val, "on") || !strcasecmp(val, "true")) {
+        *p = true;
+        return 0;
+    }
+    if (!strcmp(val, "0") || !strcasecmp(val, "n") ||
+        !strcasecmp(val, "off") || !strcasecmp(val, "false")) {
+        *p = false;
+        return 0;
+    }
+    return -EINVAL;
+}
+
+int param_get_bool(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%c\n", *(bool *)kp->arg ? 'Y' : 'N');
+}
+
+int param_set_int(const char *val, const struct kernel_param *kp)
+{
+    char *end;
+    long v;
+
+    if (!val || !*val)
+        return -EINVAL;
+    errno = 0;
+    v = strtol(val, &end, 0);
+    if (errno || (*end && *end != '\n'))
+        return -EINVAL;
+    *(int *)kp->arg = (int)v;
+    return 0;
+}
+
+int param_get_int(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%d\n", *(int *)kp->arg);
+}
+
+int param_set_uint(const char *val, const struct kernel_param *kp)
+{
+    unsigned long long v;
+    int ret = sim_parse_ull(val, &v);
+
+    if (ret)
+        return ret;
+    *(unsigned int *)kp->arg = (unsigned int)v;
+    return 0;
+}
+
+int param_get_uint(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%u\n", *(unsigned int *)kp->arg);
+}
+
+int param_set_ulong(const char *val, const struct kernel_param *kp)
+{
+    unsigned long long v;
+    int ret = sim_parse_ull(val, &v);
+
+    if (ret)
+        return ret;
+    *(unsigned long *)kp->arg = (unsigned long)v;
+    return 0;
+}
+
+int param_get_ulong(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%lu\n", *(unsigned long *)kp->arg);
+}
+
+const struct kernel_param_ops param_ops_bool = {
+    .set = param_set_bool,
+    .get = param_get_bool,
+};
+
+const struct kernel_param_ops param_ops_int = {
+    .set = param_set_int,
+    .get = param_get_int,
+};
+
+const struct kernel_param_ops param_ops_uint = {
+    .set = param_set_uint,
+    .get = param_get_uint,
+};
+
+const struct kernel_param_ops param_ops_ulong = {
+    .set = param_set_ulong,
+    .get = param_get_ulong,
+};
+
+static int param_array_set(const char *val, const struct kernel_param *kp)
+{
+    const struct kparam_array *arr = kp->arg;
+    char buf[256], *cur, *tok;
+    unsigned int n = 0;
+    int ret;
+
+    if (!val || strlen(val) >= sizeof(buf))
+        return -EINVAL;
+    strcpy(buf, val);
+    buf[strcspn(buf, "\n")] = '\0';
+
+    cur = buf;
+    while ((tok = strsep(&cur, ",")) != NULL) {
+        struct kernel_param elem = { kp->name, arr->ops,
+                                     (char *)arr->elem + n * arr->elemsize };
+
+        if (n >= arr->max)
+            return -EINVAL;
+        ret = arr->ops->set(tok, &elem);
+        if (ret)
+            return ret;
+        n++;
+    }
+    if (arr->num)
+        *arr->num = n;
+    return 0;
+}
+
+static int param_array_get(char *buffer, const struct kernel_param *kp)
+{
+    const struct kparam_array *arr = kp->arg;
+    unsigned int i, n = arr->num ? *arr->num : arr->max;
+    int off = 0;
+
+    for (i = 0; i < n; i++) {
+        struct kernel_param elem = { kp->name, arr->ops,
+                                     (char *)arr->elem + i * arr->elemsize };
+
+        if (i)
+            buffer[off++] = ',';
+        off += arr->ops->get(buffer + off, &elem);
+        // 元素的 get 以换行结尾，只保留最后一个
+        if (off && buffer[off - 1] == '\n')
+            off--;
+    }
+    buffer[off++] = '\n';
+    buffer[off] = '\0';
+    return off;
+}
+
+const struct kernel_param_ops param_array_ops = {
+    .set = param_array_set,
+    .get = param_array_get,
+};
+
+// ---------------------------------------------------------------------------
+// 按名字访问 lotspeed.c 中登记的模块参数
+// ---------------------------------------------------------------------------
+extern const struct kernel_param __start_sim_kparams[];
+extern const struct kernel_param __stop_sim_kparams[];
+
+static const struct kernel_param *sim_param_find(const char *name)
+{
+    const struct kernel_param *kp;
+
+    for (kp = __start_sim_kparams; kp < __stop_sim_kparams; kp++) {
+        if (!strcmp(kp->name, name))
+            return kp;
+    }
+    return NULL;
+}
+
+int sim_param_set(const char *name, const char *val)
+{
+    const struct kernel_param *kp = sim_param_find(name);
+
+    if (!kp)
+        return -ENOENT;
+    return kp->ops->set(val, kp);
+}
+
+int sim_param_get(const char *name, char *buffer)
+{
+    const struct kernel_param *kp = sim_param_find(name);
+
+    if (!kp)
+        return -ENOENT;
+    return kp->ops->get(buffer, kp);
+}
+
+void sim_param_dump(FILE *out)
+{
+    const struct kernel_param *kp;
+    char buf[PAGE_SIZE];
+
+    for (kp = __start_sim_kparams; kp < __stop_sim_kparams; kp++) {
+        buf[0] = '\0';
+        kp->ops->get(buf, kp);
+        fprintf(out, "#   %-28s %s", kp->name, buf);
+    }
+}
+
+void sim_param_save(FILE *out)
+{
+    const struct kernel_param *kp;
+    char buf[PAGE_SIZE];
+
+    for (kp = __start_sim_kparams; kp < __stop_sim_kparams; kp++) {
+        buf[0] = '\0';
+        kp->ops->get(buf, kp);
+        fprintf(out, "%s=%s", kp->name, buf);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// debugfs / seq_file
+// ---------------------------------------------------------------------------
+#define SIM_DEBUGFS_MAX 32
+
+struct dentry {
+    char name[64];
+    struct dentry *parent;
+    const struct file_operations *fops;     // NULL 表示目录
+    void *data;
+    bool live;
+};
+
+static struct dentry sim_dentries[SIM_DEBUGFS_MAX];
+
+static struct dentry *sim_debugfs_alloc(const char *name, struct dentry *parent)
+{
+    int i;
+
+    for (i = 0; i < SIM_DEBUGFS_MAX; i++) {
+        struct dentry *d = &sim_dentries[i];
+
+        if (d->live)
+            continue;
+        memset(d, 0, sizeof(*d));
+        snprintf(d->name, sizeof(d->name), "%s", name);
+        d->parent = parent;
+        d->live = true;
+        return d;
+    }
+    return NULL;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+    return sim_debugfs_alloc(name, parent);
+}
+
+struct dentry *debugfs_create_file(const char *name, umode_t mode, struct dentry *parent,
+                                   void *data, const struct file_operations *fops)
+{
+    struct dentry *d = sim_debugfs_alloc(name, parent);
+
+    (void)mode;
+    if (d) {
+        d->fops = fops;
+        d->data = data;
+    }
+    return d;
+}
+
+static bool sim_debugfs_under(const struct dentry *d, const struct dentry *root)
+{
+    for (; d; d = d->parent)
+        if (d == root)
+            return true;
+    return false;
+}
+
+void debugfs_remove_recursive(struct dentry *dentry)
+{
+    int i;
+
+    if (!dentry)
+        return;
+    for (i = 0; i < SIM_DEBUGFS_MAX; i++)
+        if (sim_dentries[i].live && sim_debugfs_under(&sim_dentries[i], dentry))
+            sim_dentries[i].live = false;
+}
+
+void seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    sim_vfprintk(m->out, fmt, ap);
+    va_end(ap);
+}
+
+int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data)
+{
+    struct seq_file *m = calloc(1, sizeof(*m));
+
+    if (!m)
+        return -ENOMEM;
+    m->out = stdout;
+    m->show = show;
+    m->private = data;
+    file->private_data = m;
+    return 0;
+}
+
+// 一次性调用 show，输出直接写到 m->out
+ssize_t seq_read(struct file *file, char __user *buf, size_t size, loff_t *ppos)
+{
+    struct seq_file *m = file->private_data;
+
+    (void)buf;
+    (void)size;
+    if (*ppos)
+        return 0;
+    *ppos = 1;
+    return m->show(m, m->private);
+}
+
+loff_t seq_lseek(struct file *file, loff_t offset, int whence)
+{
+    (void)file;
+    (void)whence;
+    return offset;
+}
+
+int single_release(struct inode *inode, struct file *file)
+{
+    (void)inode;
+    free(file->private_data);
+    file->private_data = NULL;
+    return 0;
+}
+
+static void sim_debugfs_print_path(FILE *out, const struct dentry *d)
+{
+    if (!d)
+        return;
+    sim_debugfs_print_path(out, d->parent);
+    fprintf(out, "/%s", d->name);
+}
+
+const struct file_operations *sim_debugfs_fops(const char *name)
+{
+    int i;
+
+    for (i = 0; i < SIM_DEBUGFS_MAX; i++)
+        if (sim_dentries[i].live && sim_dentries[i].fops && !strcmp(sim_dentries[i].name, name))
+            return sim_dentries[i].fops;
+    return NULL;
+}
+
+void sim_debugfs_dump(FILE *out)
+{
+    int i;
+
+    for (i = 0; i < SIM_DEBUGFS_MAX; i++) {
+        struct dentry *d = &sim_dentries[i];
+        struct inode inode = { .i_private = d->data };
+        struct file file = { 0 };
+        loff_t pos = 0;
+
+        if (!d->live || !d->fops || !d->fops->read)
+            continue;
+        fprintf(out, "# debugfs");
+        sim_debugfs_print_path(out, d);
+        fprintf(out, "\n");
+        fflush(out);
+        if (d->fops->open && d->fops->open(&inode, &file))
+            continue;
+        if (file.private_data)
+            ((struct seq_file *)file.private_data)->out = out;
+        if (d->fops->read)
+            d->fops->read(&file, NULL, 0, &pos);
+        if (d->fops->release)
+            d->fops->release(&inode, &file);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 数字与地址解析
+// ---------------------------------------------------------------------------
+int kstrtoull(const char *s, unsigned int base, unsigned long long *res)
+{
+    char *end;
+    unsigned long long v;
+
+    if (*s == '+')
+        s++;
+    if (!isxdigit((unsigned char)*s))
+        return -EINVAL;
+    errno = 0;
+    v = strtoull(s, &end, base);
+    if (errno)
+        return -ERANGE;
+    if (*end == '\n')
+        end++;
+    if (*end || end == s)
+        return -EINVAL;
+    *res = v;
+    return 0;
+}
+
+int kstrtobool(const char *s, bool *res)
+{
+    if (!s)
+        return -EINVAL;
+    switch (s[0]) {
+    case 'y': case 'Y': case 't': case 'T': case '1':
+        *res = true;
+        return 0;
+    case 'n': case 'N': case 'f': case 'F': case '0':
+        *res = false;
+        return 0;
+    case 'o': case 'O':
+        if (s[1] == 'n' || s[1] == 'N') {
+            *res = true;
+            return 0;
+        }
+        if (s[1] == 'f' || s[1] == 'F') {
+            *res = false;
+            return 0;
+        }
+        break;
+    }
+    return -EINVAL;
+}
+
+static int sim_pton(int af, const char *src, int srclen, u8 *dst)
+{
+    char buf[INET6_ADDRSTRLEN];
+    size_t len = srclen < 0 ? strlen(src) : (size_t)srclen;
+
+    if (len >= sizeof(buf))
+        return 0;
+    memcpy(buf, src, len);
+    buf[len] = '\0';
+    return inet_pton(af, buf, dst) == 1;
+}
+
+int in4_pton(const char *src, int srclen, u8 *dst, int delim, const char **end)
+{
+    (void)delim;
+    (void)end;
+    return sim_pton(AF_INET, src, srclen, dst);
+}
+
+int in6_pton(const char *src, int srclen, u8 *dst, int delim, const char **end)
+{
+    (void)delim;
+    (void)end;
+    return sim_pton(AF_INET6, src, srclen, dst);
+}
+
+// lib/win_minmax.c
+static u32 minmax_subwin_update(struct minmax *m, u32 win, const struct minmax_sample *val)
+{
+    u32 dt = val->t - m->s[0].t;
+
+    if (unlikely(dt > win)) {
+        // 最好的样本已过期，依次递补
+        m->s[0] = m->s[1];
+        m->s[1] = m->s[2];
+        m->s[2] = *val;
+        if (unlikely(val->t - m->s[0].t > win)) {
+            m->s[0] = m->s[1];
+            m->s[1] = m->s[2];
+            m->s[2] = *val;
+        }
+    } else if (unlikely(m->s[1].t == m->s[0].t) && dt > win / 4) {
+        // 过了 1/4 窗口仍没有次优样本，取当前值
+        m->s[2] = m->s[1] = *val;
+    } else if (unlikely(m->s[2].t == m->s[1].t) && dt > win / 2) {
+        m->s[2] = *val;
+    }
+    return m->s[0].v;
+}
+
+u32 minmax_running_max(struct minmax *m, u32 win, u32 t, u32 meas)
+{
+    struct minmax_sample val = { .t = t, .v = meas };
+
+    if (unlikely(val.v >= m->s[0].v) || unlikely(val.t - m->s[2].t > win))
+        return minmax_reset(m, t, meas);
+
+    if (unlikely(val.v >= m->s[1].v))
+        m->s[2] = m->s[1] = val;
+    else if (unlikely(val.v >= m->s[2].v))
+        m->s[2] = val;
+
+    return minmax_subwin_update(m, win, &val);
+}
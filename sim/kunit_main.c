@@ -0,0 +1,99 @@
+// kunit_main.c  ——  在用户态执行 lotspeed.c 内置的 KUnit 用例
+//
+// lotspeed.c 以 -DCONFIG_LOTSPEED_KUNIT_TEST=1 编译（见 Makefile 的 kunit 目标），
+// 其中的 kunit_test_suite() 登记到 sim_kunit 段；这里逐个执行并按 KTAP 输出，有失败时返回 1。
+
+#include <stdarg.h>
+#include <kunit/test.h>
+#include <kunit/static_stub.h>
+
+extern struct kunit_suite *__start_sim_kunit[];
+extern struct kunit_suite *__stop_sim_kunit[];
+
+void *sim_kunit_stub_real;
+void *sim_kunit_stub_repl;
+
+void sim_kunit_fail(struct kunit *test, const char *file, int line, const char *expr,
+                    long long left, long long right, const char *fmt, ...)
+{
+    va_list ap;
+
+    test->failed = true;
+    printf("    # %s: EXPECTATION FAILED at %s:%d\n", test->name, file, line);
+    printf("    Expected %s, but\n        left == %lld\n        right == %lld\n",
+           expr, left, right);
+    if (!fmt)
+        return;
+    printf("    ");
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
+
+static bool sim_kunit_run_case(struct kunit_suite *suite, struct kunit_case *c)
+{
+    struct kunit test = { .name = c->name };
+    int i;
+
+    if (suite->init && suite->init(&test)) {
+        test.failed = true;
+    } else {
+        if (!setjmp(test.abort))
+            c->run_case(&test);
+        if (suite->exit)
+            suite->exit(&test);
+    }
+
+    kunit_deactivate_static_stub(&test, NULL);
+    for (i = 0; i < test.nr_allocs; i++)
+        kfree(test.allocs[i]);
+    return !test.failed;
+}
+
+static bool sim_kunit_run_suite(struct kunit_suite *suite, int idx)
+{
+    struct kunit_case *c;
+    bool ok = true;
+    int n = 0, i = 0;
+
+    for (c = suite->test_cases; c->run_case; c++)
+        n++;
+
+    printf("    KTAP version 1\n    # Subtest: %s\n    1..%d\n", suite->name, n);
+    if (suite->suite_init && suite->suite_init(suite)) {
+        printf("not ok %d %s\n", idx, suite->name);
+        return false;
+    }
+    for (c = suite->test_cases; c->run_case; c++) {
+        bool pass = sim_kunit_run_case(suite, c);
+
+        printf("    %s %d %s\n", pass ? "ok" : "not ok", ++i, c->name);
+        ok &= pass;
+    }
+    if (suite->suite_exit)
+        suite->suite_exit(suite);
+
+    printf("%s %d %s\n", ok ? "ok" : "not ok", idx, suite->name);
+    return ok;
+}
+
+int main(void)
+{
+    struct kunit_suite **s;
+    bool ok = true;
+    int idx = 0;
+
+    // 与内核一致：用例在模块初始化之后运行
+    if (sim_module_init()) {
+        fprintf(stderr, "lotspeed module init failed\n");
+        return 1;
+    }
+
+    printf("KTAP version 1\n1..%d\n", (int)(__stop_sim_kunit - __start_sim_kunit));
+    for (s = __start_sim_kunit; s < __stop_sim_kunit; s++)
+        ok &= sim_kunit_run_suite(*s, ++idx);
+
+    sim_module_exit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,2025 @@
+// lotspeed_sim.c  ——  lotspeed 用户态离散事件链路模拟器
+//
+// 把原样编译的 lotspeed.c 挂到一个包级瓶颈链路模型上：
+//
+//   发送端 (cwnd + pacing) ──> 瓶颈队列 (带宽 / 缓冲 / 随机丢包 / 背景流量)
+//                          ──> 传播时延 (RTT) ──> ACK 回到发送端
+//
+// 发送端按 tcp_rate.c 的方式生成 rate_sample，按 RACK 思路判定丢包，
+// 并像 tcp_input.c 一样在恰当时机调用 ssthresh / set_state / cwnd_event /
+// undo_cwnd / cong_control。所有时间都是虚拟时间，不需要 root 和内核。
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <kshim.h>
+
+#include "../lotspeed_capture.h"
+
+#define SIM_MSS             1448U
+#define SIM_WIRE_BYTES      (SIM_MSS + 52U)    // 含 IP/TCP 头
+#define SIM_INIT_CWND       10U
+#define SIM_RTO_MIN_US      200000U
+#define SIM_RTO_MAX_US      120000000U
+#define SIM_RTO_INIT_US     1000000U
+#define SIM_NIL             (~0ULL)
+#define SIM_MIN_BUFFER      (16ULL * SIM_WIRE_BYTES)
+
+// ---------------------------------------------------------------------------
+// 场景配置
+// ---------------------------------------------------------------------------
+struct sim_config {
+    u64 link_bps;           // 瓶颈带宽 bit/s
+    double rtt_ms;          // 基础往返传播时延
+    double rtt_change_at;   // 在该时刻（秒）把传播时延改为 rtt_change_ms，0 = 不改（模拟路由切换）
+    double rtt_change_ms;
+    double buffer_bdp;      // 缓冲深度（BDP 倍数）
+    u64 buffer_bytes;       // 非零时覆盖 buffer_bdp
+    double loss;            // 随机丢包率
+    double cross;           // 背景流量占瓶颈带宽的比例
+    double ecn_us;          // 入队时排队超过该时长（us）就给 ECN 报文打 CE，0 = 不标记
+    u32 flows;              // 并发 lotspeed 流数量
+    u64 flow_bytes;         // 每条流的传输量，0 = 持续发送
+    double idle_ms;         // 每段 flow_bytes 确认完后空闲该时长，在同一连接上再发一段（长连接上的
+                            // 请求 / 响应），直到模拟结束；0 = 传完即结束
+    double duration;        // 模拟时长（秒）
+    u64 seed;
+    u32 repeat;             // 同一目的网段上连续重复的次数
+    u32 path_id;            // 目的地址 10.<hi>.<lo>.x/24，区分场景以免共用路径缓存
+    bool same_peer;         // 所有连接同一目的地址、同一 sk_mark（并行下载 / 复制工具）
+};
+
+struct sim_result {
+    double elapsed;         // 实际统计时长（秒）
+    double goodput_bps;
+    double util;
+    double jain;
+    u64 sent;
+    u64 retrans;
+    u64 drops;
+    u64 rtos;
+    u64 recoveries;
+    double qdelay_avg_ms;
+    double qdelay_p99_ms;
+    double fct_max_ms;      // 有限流全部完成的时间，0 = 未完成；idle_ms 非零时为每段的平均完成时间
+    u32 cwnd;               // 流 0 结束时的 cwnd
+    double pacing_bps;      // 流 0 结束时的 pacing 速率
+};
+
+// ---------------------------------------------------------------------------
+// 发送端状态
+// ---------------------------------------------------------------------------
+enum sim_pkt_state {
+    PKT_OUT = 1,            // 在途
+    PKT_LOST,               // 已判丢，等待重传
+    PKT_ACKED,
+};
+
+struct sim_pkt {
+    u64 tx_ns;              // 最近一次发送时间
+    u64 first_tx_ns;        // 发送时的 first_tx_mstamp
+    u64 delivered_ns;       // 发送时的 delivered_mstamp
+    u64 prev;               // 发送顺序链表
+    u64 next;
+    u32 delivered;          // 发送时的 tp->delivered
+    u8 state;
+    u8 retrans;
+    u8 app_limited;
+    u8 ce;                  // 经过瓶颈时被打了 CE（接收端逐包回显 ECE）
+};
+
+struct sim_flow {
+    struct tcp_sock tp;     // 必须是第一个成员，(struct sock *) 指向这里
+    u32 id;
+
+    struct sim_pkt *pkts;   // 以 seq & (cap - 1) 索引
+    u64 cap;
+    u64 snd_una;
+    u64 snd_nxt;
+    u64 total_pkts;
+
+    u64 head;               // 发送顺序链表（在途报文）
+    u64 tail;
+    u64 inflight;
+    u64 lost_out;
+
+    u64 *rtxq;              // 重传队列
+    u64 rtx_cap;
+    u64 rtx_head;
+    u64 rtx_tail;
+
+    u64 next_tx_ns;
+    u64 last_send_ns;
+    u64 first_tx_ns;
+    u64 delivered_ns;
+    bool send_armed;
+
+    u64 rto_deadline;
+    bool rto_armed;
+    u32 rto_us;
+    u32 backoff;
+    u32 min_rtt_us;
+    u64 high_seq;
+    u64 loss_enter_ns;
+    u32 prior_ssthresh;
+
+    u64 acked_pkts;
+    u64 sent_pkts;
+    u64 retrans_pkts;
+    u64 rtos;
+    u64 recoveries;
+    u64 done_ns;            // idle_ms 非零时为最近一段的完成时间，下一段开始时清零
+    u64 resp_start_ns;      // 当前一段的开始时间
+    u64 resp_ns;            // 已完成各段的耗时之和
+    u64 responses;
+};
+
+// ---------------------------------------------------------------------------
+// 事件队列（最小堆）
+// ---------------------------------------------------------------------------
+enum sim_event_type {
+    EV_SEND,
+    EV_LINK_DONE,
+    EV_ACK,
+    EV_RTO,
+    EV_CROSS,
+    EV_RESUME,              // 空闲结束，再发一段
+};
+
+struct sim_event {
+    u64 t;
+    u64 order;              // 同一时刻按入队顺序处理，保证确定性
+    u64 arg;
+    u64 aux;
+    u32 type;
+    u32 flow;
+};
+
+// ---------------------------------------------------------------------------
+// 瓶颈队列
+// ---------------------------------------------------------------------------
+struct sim_qpkt {
+    u64 enq_ns;
+    u64 seq;
+    u64 tx_ns;
+    u32 bytes;
+    s32 flow;               // -1 = 背景流量
+    bool ce;
+};
+
+#define SIM_HIST_BUCKETS 1024
+
+struct sim_state {
+    const struct sim_config *cfg;
+    struct sim_flow *flows;
+    u64 rtt_ns;
+    u64 buffer_bytes;
+    u64 end_ns;
+    u64 rng;
+
+    struct sim_event *heap;
+    u64 heap_len;
+    u64 heap_cap;
+    u64 order;
+
+    struct sim_qpkt *q;
+    u64 q_cap;
+    u64 q_head;
+    u64 q_tail;
+    u64 q_bytes;
+    u64 ecn_bytes;          // CE 标记阈值（字节），0 = 不标记
+    bool link_busy;
+
+    u64 drops;
+    u64 qdelay_cnt;
+    double qdelay_sum_us;
+    u64 qdelay_hist[SIM_HIST_BUCKETS];
+    u32 flows_done;
+};
+
+static struct sim_state S;
+
+// 出口网卡：--nic 时所有连接的路由都指向它，ethtool 报告 sim_nic_bps（lotserver_rate=0 时据此定速）
+static u64 sim_nic_bps;
+
+static int sim_nic_get_link_ksettings(struct net_device *dev, struct ethtool_link_ksettings *ks)
+{
+    (void)dev;
+    ks->base.speed = (u32)(sim_nic_bps / 1000000);
+    return 0;
+}
+
+static const struct ethtool_ops sim_nic_ethtool_ops = {
+    .get_link_ksettings = sim_nic_get_link_ksettings,
+};
+
+static struct net_device sim_nic = {
+    .name = "sim0",
+    .ethtool_ops = &sim_nic_ethtool_ops,
+};
+
+static struct dst_entry sim_dst = {
+    .dev = &sim_nic,
+};
+
+static void *sim_xrealloc(void *p, size_t n)
+{
+    p = realloc(p, n);
+    if (!p) {
+        fprintf(stderr, "lotspeed_sim: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+// xorshift64*，保证不同平台上结果一致
+static double sim_rand(void)
+{
+    S.rng ^= S.rng >> 12;
+    S.rng ^= S.rng << 25;
+    S.rng ^= S.rng >> 27;
+    return (double)((S.rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void sim_push(u64 t, u32 type, u32 flow, u64 arg, u64 aux)
+{
+    struct sim_event ev = { t, S.order++, arg, aux, type, flow };
+    u64 i;
+
+    if (S.heap_len == S.heap_cap) {
+        S.heap_cap = S.heap_cap ? S.heap_cap * 2 : 1024;
+        S.heap = sim_xrealloc(S.heap, S.heap_cap * sizeof(*S.heap));
+    }
+
+    i = S.heap_len++;
+    while (i > 0) {
+        u64 parent = (i - 1) / 2;
+        struct sim_event *p = &S.heap[parent];
+
+        if (p->t < ev.t || (p->t == ev.t && p->order < ev.order))
+            break;
+        S.heap[i] = *p;
+        i = parent;
+    }
+    S.heap[i] = ev;
+}
+
+static struct sim_event sim_pop(void)
+{
+    struct sim_event top = S.heap[0];
+    struct sim_event last = S.heap[--S.heap_len];
+    u64 i = 0;
+
+    for (;;) {
+        u64 c = 2 * i + 1;
+
+        if (c >= S.heap_len)
+            break;
+        if (c + 1 < S.heap_len &&
+            (S.heap[c + 1].t < S.heap[c].t ||
+             (S.heap[c + 1].t == S.heap[c].t && S.heap[c + 1].order < S.heap[c].order)))
+            c++;
+        if (last.t < S.heap[c].t || (last.t == S.heap[c].t && last.order < S.heap[c].order))
+            break;
+        S.heap[i] = S.heap[c];
+        i = c;
+    }
+    if (S.heap_len)
+        S.heap[i] = last;
+    return top;
+}
+
+// ---------------------------------------------------------------------------
+// 统计
+// ---------------------------------------------------------------------------
+
+// 对数线性直方图：每个 2 的幂区间 16 个子桶，误差 < 7%
+static u32 sim_hist_idx(u64 v)
+{
+    u32 e;
+
+    if (v < 16)
+        return (u32)v;
+    e = 63 - __builtin_clzll(v);
+    return min_t(u32, 16 + (e - 4) * 16 + (u32)((v >> (e - 4)) & 15), SIM_HIST_BUCKETS - 1);
+}
+
+static u64 sim_hist_value(u32 idx)
+{
+    u32 e;
+
+    if (idx < 16)
+        return idx;
+    e = (idx - 16) / 16 + 4;
+    return (16ULL + (idx - 16) % 16) << (e - 4);
+}
+
+static double sim_hist_pct(const u64 *hist, u64 cnt, double pct)
+{
+    u64 want = (u64)(cnt * pct);
+    u64 seen = 0;
+    u32 i;
+
+    for (i = 0; i < SIM_HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > want)
+            return (double)sim_hist_value(i);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 瓶颈链路
+// ---------------------------------------------------------------------------
+static inline struct sock *sim_flow_sk(struct sim_flow *f)
+{
+    return (struct sock *)&f->tp;
+}
+
+static inline struct sim_pkt *sim_pkt(struct sim_flow *f, u64 seq)
+{
+    return &f->pkts[seq & (f->cap - 1)];
+}
+
+static u64 sim_tx_time_ns(u32 bytes)
+{
+    return (u64)bytes * 8ULL * NSEC_PER_SEC / S.cfg->link_bps;
+}
+
+static void sim_link_kick(void)
+{
+    struct sim_qpkt *qp;
+
+    if (S.link_busy || S.q_head == S.q_tail)
+        return;
+
+    qp = &S.q[S.q_head & (S.q_cap - 1)];
+    if (qp->flow >= 0) {
+        u64 wait_us = (sim_now_ns - qp->enq_ns) / NSEC_PER_USEC;
+
+        S.qdelay_hist[sim_hist_idx(wait_us)]++;
+        S.qdelay_sum_us += (double)wait_us;
+        S.qdelay_cnt++;
+    }
+    S.link_busy = true;
+    sim_push(sim_now_ns + sim_tx_time_ns(qp->bytes), EV_LINK_DONE, 0, 0, 0);
+}
+
+static void sim_link_enqueue(s32 flow, u64 seq, u64 tx_ns, u32 bytes)
+{
+    struct sim_qpkt *qp;
+
+    if (S.q_bytes + bytes > S.buffer_bytes) {
+        S.drops++;
+        return;
+    }
+
+    if (S.q_tail - S.q_head == S.q_cap) {
+        u64 new_cap = S.q_cap ? S.q_cap * 2 : 1024;
+        struct sim_qpkt *nq = sim_xrealloc(NULL, new_cap * sizeof(*nq));
+        u64 i;
+
+        for (i = S.q_head; i < S.q_tail; i++)
+            nq[i & (new_cap - 1)] = S.q[i & (S.q_cap - 1)];
+        free(S.q);
+        S.q = nq;
+        S.q_cap = new_cap;
+    }
+
+    qp = &S.q[S.q_tail++ & (S.q_cap - 1)];
+    qp->enq_ns = sim_now_ns;
+    qp->seq = seq;
+    qp->tx_ns = tx_ns;
+    qp->bytes = bytes;
+    qp->flow = flow;
+    // DCTCP 式瞬时队列阈值标记，只标记协商了 ECN 的流
+    qp->ce = S.ecn_bytes && S.q_bytes > S.ecn_bytes && flow >= 0 &&
+             (S.flows[flow].tp.ecn_flags & TCP_ECN_OK);
+    S.q_bytes += bytes;
+
+    sim_link_kick();
+}
+
+static void sim_link_done(void)
+{
+    struct sim_qpkt qp = S.q[S.q_head++ & (S.q_cap - 1)];
+
+    S.q_bytes -= qp.bytes;
+    S.link_busy = false;
+    if (qp.ce)
+        sim_pkt(&S.flows[qp.flow], qp.seq)->ce = 1;
+    if (qp.flow >= 0)
+        sim_push(sim_now_ns + S.rtt_ns, EV_ACK, (u32)qp.flow, qp.seq, qp.tx_ns);
+    sim_link_kick();
+}
+
+static void sim_cross_arrival(void)
+{
+    double rate_pps = S.cfg->cross * (double)S.cfg->link_bps / (SIM_WIRE_BYTES * 8.0);
+    double gap = -log(1.0 - sim_rand()) / rate_pps;
+
+    sim_link_enqueue(-1, 0, sim_now_ns, SIM_WIRE_BYTES);
+    sim_push(sim_now_ns + (u64)(gap * NSEC_PER_SEC) + 1, EV_CROSS, 0, 0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// 发送端
+// ---------------------------------------------------------------------------
+static void sim_set_ca_state(struct sim_flow *f, u8 state)
+{
+    struct sock *sk = sim_flow_sk(f);
+    struct inet_connection_sock *icsk = inet_csk(sk);
+
+    if (icsk->icsk_ca_ops->set_state)
+        icsk->icsk_ca_ops->set_state(sk, state);
+    icsk->icsk_ca_state = state;
+}
+
+static void sim_ca_event(struct sim_flow *f, enum tcp_ca_event ev)
+{
+    struct sock *sk = sim_flow_sk(f);
+
+    if (inet_csk(sk)->icsk_ca_ops->cwnd_event)
+        inet_csk(sk)->icsk_ca_ops->cwnd_event(sk, ev);
+}
+
+static void sim_flow_grow(struct sim_flow *f)
+{
+    u64 new_cap = f->cap * 2;
+    struct sim_pkt *np = sim_xrealloc(NULL, new_cap * sizeof(*np));
+    u64 seq;
+
+    for (seq = f->snd_una; seq < f->snd_nxt; seq++)
+        np[seq & (new_cap - 1)] = f->pkts[seq & (f->cap - 1)];
+    free(f->pkts);
+    f->pkts = np;
+    f->cap = new_cap;
+}
+
+static void sim_list_append(struct sim_flow *f, u64 seq)
+{
+    struct sim_pkt *p = sim_pkt(f, seq);
+
+    p->prev = f->tail;
+    p->next = SIM_NIL;
+    if (f->tail != SIM_NIL)
+        sim_pkt(f, f->tail)->next = seq;
+    else
+        f->head = seq;
+    f->tail = seq;
+    f->inflight++;
+}
+
+static void sim_list_remove(struct sim_flow *f, u64 seq)
+{
+    struct sim_pkt *p = sim_pkt(f, seq);
+
+    if (p->prev != SIM_NIL)
+        sim_pkt(f, p->prev)->next = p->next;
+    else
+        f->head = p->next;
+    if (p->next != SIM_NIL)
+        sim_pkt(f, p->next)->prev = p->prev;
+    else
+        f->tail = p->prev;
+    f->inflight--;
+}
+
+static void sim_rtx_push(struct sim_flow *f, u64 seq)
+{
+    if (f->rtx_tail - f->rtx_head == f->rtx_cap) {
+        u64 new_cap = f->rtx_cap ? f->rtx_cap * 2 : 256;
+        u64 *nq = sim_xrealloc(NULL, new_cap * sizeof(*nq));
+        u64 i;
+
+        for (i = f->rtx_head; i < f->rtx_tail; i++)
+            nq[i & (new_cap - 1)] = f->rtxq[i & (f->rtx_cap - 1)];
+        free(f->rtxq);
+        f->rtxq = nq;
+        f->rtx_cap = new_cap;
+    }
+    f->rtxq[f->rtx_tail++ & (f->rtx_cap - 1)] = seq;
+}
+
+// 跳过已被（虚假重传前的原始报文）确认的条目
+static bool sim_rtx_peek(struct sim_flow *f, u64 *seq)
+{
+    while (f->rtx_head != f->rtx_tail) {
+        u64 s = f->rtxq[f->rtx_head & (f->rtx_cap - 1)];
+
+        if (s >= f->snd_una && sim_pkt(f, s)->state == PKT_LOST) {
+            *seq = s;
+            return true;
+        }
+        f->rtx_head++;
+    }
+    return false;
+}
+
+static void sim_mark_lost(struct sim_flow *f, u64 seq)
+{
+    sim_list_remove(f, seq);
+    sim_pkt(f, seq)->state = PKT_LOST;
+    f->lost_out++;
+    sim_rtx_push(f, seq);
+}
+
+static void sim_arm_rto(struct sim_flow *f)
+{
+    if (!f->inflight) {
+        f->rto_deadline = 0;
+        return;
+    }
+    f->rto_deadline = sim_now_ns +
+        (u64)min_t(u64, (u64)f->rto_us << f->backoff, SIM_RTO_MAX_US) * NSEC_PER_USEC;
+    if (!f->rto_armed) {
+        f->rto_armed = true;
+        sim_push(f->rto_deadline, EV_RTO, f->id, 0, 0);
+    }
+}
+
+static void sim_transmit(struct sim_flow *f, u64 seq, bool rtx)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sim_pkt *p = sim_pkt(f, seq);
+
+    // tcp_rate_skb_sent()：发送窗口空时重置采样起点
+    if (!tp->packets_out) {
+        f->first_tx_ns = sim_now_ns;
+        f->delivered_ns = sim_now_ns;
+    }
+
+    if (rtx) {
+        p->retrans = 1;
+        f->lost_out--;
+        f->retrans_pkts++;
+    } else {
+        memset(p, 0, sizeof(*p));
+        f->snd_nxt++;
+    }
+
+    p->tx_ns = sim_now_ns;
+    p->first_tx_ns = f->first_tx_ns;
+    p->delivered_ns = f->delivered_ns;
+    p->delivered = tp->delivered;
+    p->app_limited = tp->app_limited != 0;
+    p->ce = 0;
+    p->state = PKT_OUT;
+    sim_list_append(f, seq);
+    tp->packets_out = f->inflight + f->lost_out;
+
+    f->sent_pkts++;
+    f->last_send_ns = sim_now_ns;
+
+    if (S.cfg->loss > 0 && sim_rand() < S.cfg->loss)
+        S.drops++;
+    else
+        sim_link_enqueue((s32)f->id, seq, sim_now_ns, SIM_WIRE_BYTES);
+
+    if (!f->rto_deadline)
+        sim_arm_rto(f);
+}
+
+static void sim_try_send(struct sim_flow *f)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+
+    for (;;) {
+        unsigned long rate;
+        u64 seq;
+        bool rtx = sim_rtx_peek(f, &seq);
+
+        if (f->inflight >= tp->snd_cwnd)
+            break;
+
+        if (!rtx) {
+            if (f->snd_nxt >= f->total_pkts) {
+                // tcp_rate_check_app_limited()：没有数据可发且窗口未满
+                tp->app_limited = (tp->delivered + (u32)f->inflight) ? : 1;
+                break;
+            }
+            if (f->snd_nxt - f->snd_una >= f->cap)
+                sim_flow_grow(f);
+            seq = f->snd_nxt;
+        }
+
+        if (f->next_tx_ns > sim_now_ns) {
+            if (!f->send_armed) {
+                f->send_armed = true;
+                sim_push(f->next_tx_ns, EV_SEND, f->id, 0, 0);
+            }
+            break;
+        }
+
+        if (!f->inflight) {
+            // tcp_cwnd_restart()：空闲超过 RTO 后重启窗口。与 tcp_slow_start_after_idle_check()
+            // 一致，设置了 cong_control 的算法由自己处理空闲
+            if (f->last_send_ns && !f->lost_out && !inet_csk(sk)->icsk_ca_ops->cong_control &&
+                sim_now_ns - f->last_send_ns > (u64)f->rto_us * NSEC_PER_USEC) {
+                sim_ca_event(f, CA_EVENT_CWND_RESTART);
+                tp->snd_cwnd = max_t(u32, min_t(u32, tp->snd_cwnd, SIM_INIT_CWND), 1);
+            }
+            // tcp_event_data_sent()
+            sim_ca_event(f, CA_EVENT_TX_START);
+        }
+        tp->lsndtime = tcp_jiffies32;
+
+        if (rtx)
+            f->rtx_head++;
+        sim_transmit(f, seq, rtx);
+
+        rate = min_t(unsigned long, sk->sk_pacing_rate, sk->sk_max_pacing_rate);
+        if (rate && rate != ~0UL)
+            f->next_tx_ns = max_t(u64, f->next_tx_ns, sim_now_ns) +
+                            (u64)SIM_MSS * NSEC_PER_SEC / rate;
+    }
+}
+
+// tcp_rtt_estimator() 的简化版本
+static void sim_rtt_estimator(struct sim_flow *f, u32 m)
+{
+    struct tcp_sock *tp = &f->tp;
+    s32 delta;
+
+    if (!m)
+        m = 1;
+    if (!f->min_rtt_us || m < f->min_rtt_us)
+        f->min_rtt_us = m;
+
+    if (!tp->srtt_us) {
+        tp->srtt_us = m << 3;
+        tp->mdev_us = m << 1;
+    } else {
+        delta = (s32)m - (s32)(tp->srtt_us >> 3);
+        tp->srtt_us += delta;
+        if (delta < 0)
+            delta = -delta;
+        delta -= (s32)(tp->mdev_us >> 2);
+        tp->mdev_us += delta;
+    }
+
+    f->rto_us = (tp->srtt_us >> 3) + max_t(u32, tp->mdev_us, SIM_RTO_MIN_US);
+    f->rto_us = min_t(u32, f->rto_us, SIM_RTO_MAX_US);
+}
+
+static void sim_enter_recovery(struct sim_flow *f)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+
+    // tcp_init_cwnd_reduction()：CWR 期间已经降过窗口，不再重复
+    if (inet_csk(sk)->icsk_ca_state < TCP_CA_CWR) {
+        f->prior_ssthresh = tp->snd_ssthresh;
+        tp->prior_cwnd = tp->snd_cwnd;
+        tp->snd_ssthresh = inet_csk(sk)->icsk_ca_ops->ssthresh(sk);
+    }
+    sim_set_ca_state(f, TCP_CA_Recovery);
+    f->high_seq = f->snd_nxt;
+    f->recoveries++;
+}
+
+// 虚假 RTO：原始报文在重传之前就已送达（Eifel/F-RTO 检测到的情形）
+static void sim_undo_loss(struct sim_flow *f)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+
+    if (inet_csk(sk)->icsk_ca_ops->undo_cwnd)
+        tp->snd_cwnd = inet_csk(sk)->icsk_ca_ops->undo_cwnd(sk);
+    if (f->prior_ssthresh > tp->snd_ssthresh)
+        tp->snd_ssthresh = f->prior_ssthresh;
+    sim_set_ca_state(f, TCP_CA_Open);
+    f->backoff = 0;
+}
+
+static void sim_on_ack(struct sim_flow *f, u64 seq, u64 tx_ns)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+    struct inet_connection_sock *icsk = inet_csk(sk);
+    struct rate_sample rs = { .prior_delivered = 0 };
+    struct sim_pkt *p;
+    u64 send_elapsed, ack_elapsed;
+    u32 prior_in_flight = (u32)f->inflight;
+    int newly_lost = 0;
+    long rtt_us = -1;
+
+    if (seq < f->snd_una)
+        return;
+    p = sim_pkt(f, seq);
+    if (p->state == PKT_ACKED)
+        return;
+
+    tp->tcp_mstamp = sim_now_ns / NSEC_PER_USEC;
+
+    if (p->state == PKT_OUT) {
+        sim_list_remove(f, seq);
+    } else {
+        f->lost_out--;
+        // 处于 Loss 状态时原始报文先于重传到达：RTO 是虚假的
+        if (icsk->icsk_ca_state == TCP_CA_Loss && tx_ns < f->loss_enter_ns)
+            sim_undo_loss(f);
+    }
+    p->state = PKT_ACKED;
+    f->acked_pkts++;
+    tp->delivered++;
+    if (p->ce) {
+        tp->delivered_ce++;
+        rs.is_ece = true;
+    }
+
+    // Karn 算法：只用未重传报文的 RTT
+    if (!p->retrans) {
+        rtt_us = (long)((sim_now_ns - tx_ns) / NSEC_PER_USEC);
+        sim_rtt_estimator(f, (u32)rtt_us);
+    }
+
+    // tcp_rate_skb_delivered()
+    rs.prior_delivered = p->delivered;
+    rs.prior_mstamp = p->delivered_ns / NSEC_PER_USEC;
+    rs.is_app_limited = p->app_limited;
+    rs.is_retrans = p->retrans;
+    send_elapsed = p->tx_ns - p->first_tx_ns;
+    ack_elapsed = sim_now_ns - p->delivered_ns;
+    f->first_tx_ns = p->tx_ns;
+    f->delivered_ns = sim_now_ns;
+
+    // RACK：FIFO 链路上不存在乱序，早于本报文发出而仍未确认的都已丢失
+    while (f->head != SIM_NIL && sim_pkt(f, f->head)->tx_ns < tx_ns) {
+        sim_mark_lost(f, f->head);
+        newly_lost++;
+    }
+
+    while (f->snd_una < f->snd_nxt && sim_pkt(f, f->snd_una)->state == PKT_ACKED) {
+        f->snd_una++;
+        tp->bytes_acked += SIM_MSS;
+    }
+    tp->packets_out = f->inflight + f->lost_out;
+
+    // tcp_in_ack_event()
+    if (icsk->icsk_ca_ops->in_ack_event)
+        icsk->icsk_ca_ops->in_ack_event(sk, CA_ACK_SLOWPATH | (rs.is_ece ? CA_ACK_ECE : 0));
+
+    // tcp_fastretrans_alert()
+    if (newly_lost && icsk->icsk_ca_state < TCP_CA_Recovery) {
+        sim_enter_recovery(f);
+    } else if (icsk->icsk_ca_state >= TCP_CA_CWR && f->snd_una >= f->high_seq) {
+        if (icsk->icsk_ca_state == TCP_CA_CWR)
+            sim_ca_event(f, CA_EVENT_COMPLETE_CWR);
+        sim_set_ca_state(f, TCP_CA_Open);
+        f->backoff = 0;
+    } else if (rs.is_ece && icsk->icsk_ca_state == TCP_CA_Open) {
+        // tcp_enter_cwr()：每个窗口响应一次 ECE
+        f->prior_ssthresh = tp->snd_ssthresh;
+        tp->prior_cwnd = tp->snd_cwnd;
+        tp->snd_ssthresh = icsk->icsk_ca_ops->ssthresh(sk);
+        sim_set_ca_state(f, TCP_CA_CWR);
+        f->high_seq = f->snd_nxt;
+    }
+
+    // tcp_rate_gen()
+    if (tp->app_limited && tp->delivered > tp->app_limited)
+        tp->app_limited = 0;
+    rs.acked_sacked = 1;
+    rs.losses = newly_lost;
+    rs.prior_in_flight = prior_in_flight;
+    rs.rtt_us = rtt_us;
+    rs.delivered = (s32)(tp->delivered - rs.prior_delivered);
+    rs.snd_interval_us = (u32)(send_elapsed / NSEC_PER_USEC);
+    rs.rcv_interval_us = (u32)(ack_elapsed / NSEC_PER_USEC);
+    rs.interval_us = (long)(max_t(u64, send_elapsed, ack_elapsed) / NSEC_PER_USEC);
+    if (!rs.prior_mstamp) {
+        rs.delivered = -1;
+        rs.interval_us = -1;
+    } else if (rs.interval_us < (long)f->min_rtt_us) {
+        rs.interval_us = -1;
+    }
+
+    icsk->icsk_ca_ops->cong_control(sk, (u32)f->snd_una, 0, &rs);
+
+    if (!f->inflight)
+        f->rto_deadline = 0;
+    else
+        sim_arm_rto(f);
+
+    if (f->snd_una >= f->total_pkts && !f->done_ns) {
+        f->done_ns = sim_now_ns;
+        if (S.cfg->idle_ms > 0) {
+            f->resp_ns += sim_now_ns - f->resp_start_ns;
+            f->responses++;
+            sim_push(sim_now_ns + (u64)(S.cfg->idle_ms * NSEC_PER_MSEC), EV_RESUME, f->id, 0, 0);
+        } else {
+            S.flows_done++;
+        }
+    }
+
+    sim_try_send(f);
+}
+
+// 空闲结束：在同一连接上再发 flow_bytes
+static void sim_on_resume(struct sim_flow *f)
+{
+    f->done_ns = 0;
+    f->resp_start_ns = sim_now_ns;
+    f->total_pkts += DIV_ROUND_UP(S.cfg->flow_bytes, SIM_MSS);
+    sim_try_send(f);
+}
+
+static void sim_on_rto(struct sim_flow *f)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+    struct inet_connection_sock *icsk = inet_csk(sk);
+
+    f->rto_armed = false;
+    if (!f->rto_deadline || !f->inflight)
+        return;
+    if (sim_now_ns < f->rto_deadline) {
+        f->rto_armed = true;
+        sim_push(f->rto_deadline, EV_RTO, f->id, 0, 0);
+        return;
+    }
+
+    // tcp_enter_loss()
+    f->rtos++;
+    if (icsk->icsk_ca_state < TCP_CA_Recovery) {
+        f->prior_ssthresh = tp->snd_ssthresh;
+        tp->prior_cwnd = tp->snd_cwnd;
+        tp->snd_ssthresh = icsk->icsk_ca_ops->ssthresh(sk);
+        sim_ca_event(f, CA_EVENT_LOSS);
+    }
+    while (f->head != SIM_NIL)
+        sim_mark_lost(f, f->head);
+    tp->packets_out = f->lost_out;
+    tp->snd_cwnd = 1;
+    sim_set_ca_state(f, TCP_CA_Loss);
+    f->high_seq = f->snd_nxt;
+    f->loss_enter_ns = sim_now_ns;
+
+    f->backoff = min_t(u32, f->backoff + 1, 10);
+    f->rto_deadline = 0;
+    f->next_tx_ns = sim_now_ns;
+    sim_try_send(f);
+}
+
+// ---------------------------------------------------------------------------
+// 逐 ACK 采集（--capture）与离线回放（--replay）
+// ---------------------------------------------------------------------------
+// 回放时重新打开采集：被回放的回调由 lotspeed.c 自己写一条记录，其中的决策
+// 与文件里的逐项比较，模拟器不需要知道 struct lotspeed 的布局
+struct sim_capture {
+    struct lotspeed_capture_hdr *hdr;
+    u64 tail;
+    u64 lost;
+};
+
+static struct sim_capture sim_cap;      // hdr 非 NULL = 正在采集或回放
+static FILE *sim_capture_out;           // --capture 的输出文件
+static u64 sim_capture_recs;
+
+static int sim_capture_map(void)
+{
+    const struct file_operations *fops = sim_debugfs_fops("capture");
+    struct vm_area_struct vma = { .vm_end = LOTSPEED_CAPTURE_SIZE };
+    struct file file = { 0 };
+    int ret;
+
+    if (!fops || !fops->mmap)
+        return -ENODEV;
+    ret = fops->mmap(&file, &vma);
+    if (ret)
+        return ret;
+    sim_cap.hdr = (struct lotspeed_capture_hdr *)vma.vm_start;
+    sim_cap.tail = sim_cap.hdr->head;
+    sim_cap.lost = 0;
+    return 0;
+}
+
+static void sim_capture_write(const struct lotspeed_capture_rec *rec, void *arg)
+{
+    (void)arg;
+    fwrite(rec, sizeof(*rec), 1, sim_capture_out);
+    sim_capture_recs++;
+}
+
+// 每个事件之后调用一次：一个事件最多产生几条记录，远小于环的容量
+static inline void sim_capture_poll(void)
+{
+    if (sim_capture_out)
+        sim_cap.lost += lotspeed_capture_drain(sim_cap.hdr, &sim_cap.tail,
+                                               sim_capture_write, NULL);
+}
+
+static int sim_capture_start(const char *path)
+{
+    struct lotspeed_capture_file fh = {
+        .magic = LOTSPEED_CAPTURE_MAGIC,
+        .version = LOTSPEED_CAPTURE_VERSION,
+        .rec_size = sizeof(struct lotspeed_capture_rec),
+        .hz = HZ,
+    };
+    char buf[PAGE_SIZE];
+    char *params = NULL;
+    size_t len = 0;
+    FILE *m;
+    int ret;
+
+    // 没有用 -p lotserver_capture=N 指定抽样时采集全部连接
+    if (sim_param_get("lotserver_capture", buf) > 0 && !strtoul(buf, NULL, 0))
+        sim_param_set("lotserver_capture", "1");
+    ret = sim_capture_map();
+    if (ret)
+        return ret;
+
+    sim_capture_out = fopen(path, "wb");
+    if (!sim_capture_out)
+        return -errno;
+    m = open_memstream(&params, &len);
+    if (!m)
+        return -ENOMEM;
+    sim_param_save(m);
+    fclose(m);
+
+    fh.params_len = (u32)len;
+    fwrite(&fh, sizeof(fh), 1, sim_capture_out);
+    fwrite(params, 1, len, sim_capture_out);
+    free(params);
+    return 0;
+}
+
+static void sim_capture_stop(const char *path)
+{
+    if (!sim_capture_out)
+        return;
+    sim_capture_poll();
+    fclose(sim_capture_out);
+    sim_capture_out = NULL;
+    printf("# capture: %llu records, %llu lost -> %s\n", sim_capture_recs, sim_cap.lost, path);
+}
+
+// 回放用的出口网卡：每种采集到的网卡速率一块，lotserver_rate=0 时据此定速
+struct sim_replay_nic {
+    struct net_device dev;
+    struct dst_entry dst;
+    u32 mbps;
+    struct sim_replay_nic *next;
+};
+
+static struct sim_replay_nic *sim_replay_nics;
+
+static int sim_replay_get_link_ksettings(struct net_device *dev, struct ethtool_link_ksettings *ks)
+{
+    ks->base.speed = container_of(dev, struct sim_replay_nic, dev)->mbps;
+    return 0;
+}
+
+static const struct ethtool_ops sim_replay_ethtool_ops = {
+    .get_link_ksettings = sim_replay_get_link_ksettings,
+};
+
+static struct dst_entry *sim_replay_dst(u32 mbps)
+{
+    struct sim_replay_nic *n;
+
+    for (n = sim_replay_nics; n; n = n->next) {
+        if (n->mbps == mbps)
+            return &n->dst;
+    }
+    n = sim_xrealloc(NULL, sizeof(*n));
+    memset(n, 0, sizeof(*n));
+    snprintf(n->dev.name, sizeof(n->dev.name), "rp%u", mbps);
+    n->dev.ethtool_ops = &sim_replay_ethtool_ops;
+    n->dst.dev = &n->dev;
+    n->mbps = mbps;
+    n->next = sim_replay_nics;
+    sim_replay_nics = n;
+    sim_netdev_register(&n->dev);
+    return &n->dst;
+}
+
+struct sim_replay_flow {
+    u64 id;                 // 采集时的 flow
+    struct tcp_sock *tp;
+};
+
+struct sim_replay {
+    bool all;               // --replay-all：逐条打印回放出的决策
+    u32 hz;
+    bool started;
+    u32 last_stamp;
+    s64 ticks;              // 展开回绕后的 stamp
+    u64 next_seq;
+
+    struct sim_replay_flow *flows;
+    u32 nr_flows;
+    u32 cap_flows;
+
+    u64 recs;
+    u64 replayed;
+    u64 flows_seen;
+    u64 skipped;            // 缺少 INIT 的连接上的记录
+    u64 gaps;
+    u64 mismatches;
+};
+
+static const char *const sim_capture_type_names[] = {
+    [LOTSPEED_CAPTURE_INIT]     = "init",
+    [LOTSPEED_CAPTURE_RELEASE]  = "release",
+    [LOTSPEED_CAPTURE_ACK]      = "ack",
+    [LOTSPEED_CAPTURE_IN_ACK]   = "in_ack",
+    [LOTSPEED_CAPTURE_STATE]    = "state",
+    [LOTSPEED_CAPTURE_SSTHRESH] = "ssthresh",
+    [LOTSPEED_CAPTURE_UNDO]     = "undo",
+    [LOTSPEED_CAPTURE_EVENT]    = "event",
+};
+
+static const char *sim_capture_type_name(u8 type)
+{
+    if (type >= ARRAY_SIZE(sim_capture_type_names) || !sim_capture_type_names[type])
+        return "?";
+    return sim_capture_type_names[type];
+}
+
+static struct sim_replay_flow *sim_replay_find(struct sim_replay *R, u64 id)
+{
+    u32 i;
+
+    for (i = 0; i < R->nr_flows; i++) {
+        if (R->flows[i].id == id)
+            return &R->flows[i];
+    }
+    return NULL;
+}
+
+static void sim_replay_drop(struct sim_replay *R, struct sim_replay_flow *f)
+{
+    struct sock *sk = (struct sock *)f->tp;
+
+    // 丢弃时也走 release，出口预算 / 耦合组 / 活跃连接数才能回到采集时的样子
+    sim_registered_ca->release(sk);
+    sim_cap.tail = sim_cap.hdr->head;
+    free(f->tp);
+    *f = R->flows[--R->nr_flows];
+}
+
+static void sim_replay_sample(const struct lotspeed_capture_rec *rec, void *arg)
+{
+    memcpy(arg, rec, sizeof(*rec));
+}
+
+static void sim_replay_print(const struct lotspeed_capture_rec *rec,
+                             const struct lotspeed_capture_rec *got)
+{
+    printf("%llu,%08llx,%.3f,%s,%u,%u,%u,%u,%u,%u,%u,%u,%llu,%llu\n",
+           rec->seq, rec->flow, (double)sim_now_ns / NSEC_PER_SEC,
+           sim_capture_type_name(rec->type), rec->arg, got->cwnd, got->ssthresh, got->ret,
+           got->cwnd_gain, got->loss_count, got->phase, got->ss_mode,
+           got->pacing_rate, got->target_rate);
+}
+
+static void sim_replay_compare(struct sim_replay *R, const struct lotspeed_capture_rec *rec,
+                               const struct lotspeed_capture_rec *got)
+{
+    char buf[512];
+    int n = 0;
+
+#define SIM_REPLAY_CMP(field)                                                           \
+    do {                                                                                \
+        if (rec->field != got->field)                                                   \
+            n += snprintf(buf + n, sizeof(buf) - n, " " #field "=%llu/%llu",            \
+                          (unsigned long long)rec->field, (unsigned long long)got->field); \
+    } while (0)
+
+    SIM_REPLAY_CMP(cwnd);
+    SIM_REPLAY_CMP(ssthresh);
+    SIM_REPLAY_CMP(ret);
+    SIM_REPLAY_CMP(cwnd_gain);
+    SIM_REPLAY_CMP(loss_count);
+    SIM_REPLAY_CMP(phase);
+    SIM_REPLAY_CMP(ss_mode);
+    SIM_REPLAY_CMP(pacing_rate);
+    SIM_REPLAY_CMP(target_rate);
+#undef SIM_REPLAY_CMP
+
+    if (!n)
+        return;
+    R->mismatches++;
+    if (!R->all)
+        printf("# mismatch seq=%llu flow=%08llx t=%.3f %s(%u): captured/replayed%s\n",
+               rec->seq, rec->flow, (double)sim_now_ns / NSEC_PER_SEC,
+               sim_capture_type_name(rec->type), rec->arg, buf);
+}
+
+static void sim_replay_rec(struct sim_replay *R, const struct lotspeed_capture_rec *rec)
+{
+    const struct tcp_congestion_ops *ops = sim_registered_ca;
+    struct lotspeed_capture_rec got = { 0 };
+    struct sim_replay_flow *f;
+    struct tcp_sock *tp;
+    struct sock *sk;
+    u32 ret = 0;
+
+    R->recs++;
+
+    // stamp 是 32 位 jiffies：按有符号差值展开，多 CPU 之间的前后颠倒也能正确处理
+    if (!R->started) {
+        R->ticks = rec->stamp;
+        R->started = true;
+    } else {
+        R->ticks += (s32)(rec->stamp - R->last_stamp);
+    }
+    R->last_stamp = rec->stamp;
+    sim_now_ns = R->ticks > 0 ? (u64)R->ticks * NSEC_PER_SEC / R->hz : 0;
+
+    // 中间丢了记录：哪些连接受影响无从得知，全部丢弃，之后它们的记录都缺 INIT
+    if (R->next_seq && rec->seq != R->next_seq) {
+        R->gaps++;
+        while (R->nr_flows)
+            sim_replay_drop(R, &R->flows[0]);
+    }
+    R->next_seq = rec->seq + 1;
+
+    f = sim_replay_find(R, rec->flow);
+    if (rec->type == LOTSPEED_CAPTURE_INIT) {
+        if (f)
+            sim_replay_drop(R, f);      // 丢了 RELEASE，地址被新连接复用
+        if (R->nr_flows == R->cap_flows) {
+            R->cap_flows = R->cap_flows ? R->cap_flows * 2 : 64;
+            R->flows = sim_xrealloc(R->flows, R->cap_flows * sizeof(*R->flows));
+        }
+        f = &R->flows[R->nr_flows++];
+        f->id = rec->flow;
+        f->tp = sim_xrealloc(NULL, sizeof(*f->tp));
+        memset(f->tp, 0, sizeof(*f->tp));
+        R->flows_seen++;
+
+        sk = (struct sock *)f->tp;
+        sk->sk_family = rec->id.family;
+        sk->sk_num = rec->id.sport;
+        sk->sk_dport = htons(rec->id.dport);
+        sk->sk_mark = rec->id.mark;
+        sk->sk_pacing_rate = ~0UL;         // 与 sock_init_data() 一致
+        sk->sk_pacing_shift = 10;
+        if (rec->id.family == AF_INET6)
+            memcpy(&sk->sk_v6_daddr, rec->id.daddr, sizeof(sk->sk_v6_daddr));
+        else
+            sk->sk_daddr = rec->id.daddr[0];
+        if (rec->id.link_mbps)
+            sk->sk_dst_cache = sim_replay_dst(rec->id.link_mbps);
+        inet_csk(sk)->icsk_ca_ops = ops;
+    } else if (!f) {
+        R->skipped++;
+        return;
+    }
+
+    tp = f->tp;
+    sk = (struct sock *)tp;
+    tp->snd_cwnd = rec->snd_cwnd;
+    tp->snd_ssthresh = rec->snd_ssthresh;
+    tp->snd_cwnd_clamp = rec->snd_cwnd_clamp;
+    tp->prior_cwnd = rec->prior_cwnd;
+    tp->srtt_us = rec->srtt_us;
+    tp->mss_cache = rec->mss_cache;
+    tp->delivered = rec->delivered;
+    tp->delivered_ce = rec->delivered_ce;
+    tp->ecn_flags = rec->ecn_flags;
+
+    switch (rec->type) {
+    case LOTSPEED_CAPTURE_INIT:
+        ops->init(sk);
+        break;
+    case LOTSPEED_CAPTURE_RELEASE:
+        ops->release(sk);
+        break;
+    case LOTSPEED_CAPTURE_ACK: {
+        struct rate_sample rs = {
+            .delivered = rec->rs.delivered,
+            .losses = rec->rs.losses,
+            .interval_us = rec->rs.interval_us,
+            .rtt_us = rec->rs.rtt_us,
+            .prior_delivered = rec->rs.prior_delivered,
+            .prior_in_flight = rec->rs.prior_in_flight,
+            .acked_sacked = rec->rs.acked_sacked,
+            .is_app_limited = !!(rec->rs_flags & LOTSPEED_CAPTURE_APP_LIMITED),
+            .is_ece = !!(rec->rs_flags & LOTSPEED_CAPTURE_ECE),
+        };
+
+        ops->cong_control(sk, 0, 0, &rs);
+        break;
+    }
+    case LOTSPEED_CAPTURE_IN_ACK:
+        // 旧版本模块的记录，现在的模块不实现 in_ack_event
+        if (ops->in_ack_event)
+            ops->in_ack_event(sk, rec->arg);
+        break;
+    case LOTSPEED_CAPTURE_STATE:
+        ops->set_state(sk, rec->arg);
+        inet_csk(sk)->icsk_ca_state = rec->arg;     // tcp_set_ca_state() 在回调之后更新
+        break;
+    case LOTSPEED_CAPTURE_SSTHRESH:
+        ret = ops->ssthresh(sk);
+        break;
+    case LOTSPEED_CAPTURE_UNDO:
+        ret = ops->undo_cwnd(sk);
+        break;
+    case LOTSPEED_CAPTURE_EVENT: {
+        // 空闲时长按采集时的 HZ 换算到模拟器的 jiffies
+        s32 idle = (s32)(rec->stamp - rec->ev.lsndtime);
+
+        tp->lsndtime = tcp_jiffies32 - (u32)div_u64((u64)max(idle, 0) * HZ, R->hz);
+        ops->cwnd_event(sk, rec->arg);
+        break;
+    }
+    default:
+        R->skipped++;
+        return;
+    }
+    (void)ret;
+
+    // 回调刚写下的那条就是回放出的决策
+    lotspeed_capture_drain(sim_cap.hdr, &sim_cap.tail, sim_replay_sample, &got);
+    R->replayed++;
+    if (R->all)
+        sim_replay_print(rec, &got);
+    sim_replay_compare(R, rec, &got);
+
+    if (rec->type == LOTSPEED_CAPTURE_RELEASE) {
+        free(tp);
+        *f = R->flows[--R->nr_flows];
+    }
+}
+
+// 读采集文件头和参数文本，参数在 sim_module_init 之前按加载参数应用
+static FILE *sim_replay_open(const char *path, struct sim_replay *R)
+{
+    static const char *const skip[] = {
+        "lotserver_capture", "lotserver_capture_port", "lotserver_hold", "force_unload",
+    };
+    struct lotspeed_capture_file fh;
+    char *params, *line, *save;
+    FILE *in;
+    u32 i;
+
+    in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "lotspeed_sim: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (fread(&fh, sizeof(fh), 1, in) != 1 || fh.magic != LOTSPEED_CAPTURE_MAGIC ||
+        fh.version != LOTSPEED_CAPTURE_VERSION ||
+        fh.rec_size != sizeof(struct lotspeed_capture_rec) || !fh.hz) {
+        fprintf(stderr, "lotspeed_sim: %s: not a lotspeed capture (version %u)\n",
+                path, LOTSPEED_CAPTURE_VERSION);
+        fclose(in);
+        return NULL;
+    }
+    R->hz = fh.hz;
+
+    params = sim_xrealloc(NULL, fh.params_len + 1);
+    if (fread(params, 1, fh.params_len, in) != fh.params_len) {
+        fprintf(stderr, "lotspeed_sim: %s: truncated\n", path);
+        free(params);
+        fclose(in);
+        return NULL;
+    }
+    params[fh.params_len] = '\0';
+
+    // 采集文件可能来自另一个版本的模块：本版本没有的参数只提示，不中止
+    for (line = strtok_r(params, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *eq = strchr(line, '=');
+
+        if (!eq)
+            continue;
+        *eq = '\0';
+        for (i = 0; i < ARRAY_SIZE(skip); i++) {
+            if (!strcmp(line, skip[i]))
+                break;
+        }
+        if (i < ARRAY_SIZE(skip))
+            continue;
+        if (sim_param_set(line, eq + 1))
+            fprintf(stderr, "lotspeed_sim: replay: cannot set %s=%s\n", line, eq + 1);
+    }
+    free(params);
+    return in;
+}
+
+static int sim_replay_run(FILE *in, struct sim_replay *R)
+{
+    struct lotspeed_capture_rec rec;
+    int ret;
+
+    ret = sim_param_set("lotserver_capture_port", "0");
+    if (!ret)
+        ret = sim_param_set("lotserver_capture", "1");
+    if (!ret)
+        ret = sim_capture_map();
+    if (ret) {
+        fprintf(stderr, "lotspeed_sim: replay: cannot enable capture (%d)\n", ret);
+        return 1;
+    }
+
+    if (R->all)
+        printf("seq,flow,time_s,type,arg,cwnd,ssthresh,ret,cwnd_gain,loss_count,phase,ss_mode,"
+               "pacing_rate,target_rate\n");
+    while (fread(&rec, sizeof(rec), 1, in) == 1)
+        sim_replay_rec(R, &rec);
+    fclose(in);
+
+    // 采集结束时仍未释放的连接
+    while (R->nr_flows)
+        sim_replay_drop(R, &R->flows[0]);
+    free(R->flows);
+
+    printf("# replay: %llu records (hz %u), %llu flows, %llu replayed, %llu skipped without INIT, "
+           "%llu gaps, %llu mismatches\n",
+           R->recs, R->hz, R->flows_seen, R->replayed, R->skipped, R->gaps, R->mismatches);
+    return R->mismatches ? 1 : 0;
+}
+
+static void sim_replay_cleanup(void)
+{
+    while (sim_replay_nics) {
+        struct sim_replay_nic *n = sim_replay_nics;
+
+        sim_replay_nics = n->next;
+        sim_netdev_unregister(&n->dev);
+        free(n);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 场景运行
+// ---------------------------------------------------------------------------
+static void sim_flow_init(struct sim_flow *f, u32 id)
+{
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+
+    memset(f, 0, sizeof(*f));
+    f->id = id;
+    f->cap = 1024;
+    f->pkts = sim_xrealloc(NULL, f->cap * sizeof(*f->pkts));
+    f->head = SIM_NIL;
+    f->tail = SIM_NIL;
+    f->rto_us = SIM_RTO_INIT_US;
+    f->total_pkts = S.cfg->flow_bytes ?
+                    DIV_ROUND_UP(S.cfg->flow_bytes, SIM_MSS) : ~0ULL;
+
+    tp->snd_cwnd = SIM_INIT_CWND;
+    tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+    tp->snd_cwnd_clamp = ~0U;
+    tp->mss_cache = SIM_MSS;
+    sk->sk_pacing_rate = ~0UL;
+    sk->sk_max_pacing_rate = ~0UL;
+    sk->sk_pacing_shift = 10;
+    sk->sk_mark = S.cfg->same_peer ? 1 : id;
+    sk->sk_family = AF_INET;
+    sk->sk_daddr = htonl(0x0a000000 | ((S.cfg->path_id & 0xffff) << 8) |
+                         (S.cfg->same_peer ? 1 : (id & 0x7f) + 1));
+    sk->sk_rcv_saddr = htonl(0xc0a80001);
+    sk->sk_dport = htons(5201);
+    sk->sk_num = 40000 + id;
+    if (sim_nic_bps)
+        sk->sk_dst_cache = &sim_dst;
+
+    // 瓶颈会打 CE 且拥塞控制要求 ECN（TCP_CONG_NEEDS_ECN）时协商成功
+    if (S.cfg->ecn_us > 0 && (sim_registered_ca->flags & TCP_CONG_NEEDS_ECN))
+        tp->ecn_flags = TCP_ECN_OK;
+
+    // tcp_init_transfer() 之前握手已给出第一个 RTT 样本（SYN 不排队，取基础时延）
+    sim_rtt_estimator(f, (u32)(S.rtt_ns / NSEC_PER_USEC));
+
+    inet_csk(sk)->icsk_ca_ops = sim_registered_ca;
+    sim_registered_ca->init(sk);
+}
+
+static void sim_flow_release(struct sim_flow *f)
+{
+    struct sock *sk = sim_flow_sk(f);
+
+    if (inet_csk(sk)->icsk_ca_ops->release)
+        inet_csk(sk)->icsk_ca_ops->release(sk);
+    free(f->pkts);
+    free(f->rtxq);
+}
+
+static void sim_run(const struct sim_config *cfg, struct sim_result *res)
+{
+    double bdp = (double)cfg->link_bps / 8.0 * cfg->rtt_ms / 1000.0;
+    double sum = 0, sum_sq = 0, elapsed;
+    u64 retrans = 0, sent = 0, rtos = 0, recoveries = 0, fct = 0, resp_ns = 0, responses = 0;
+    u32 i;
+
+    memset(&S, 0, sizeof(S));
+    memset(res, 0, sizeof(*res));
+    S.cfg = cfg;
+    S.rtt_ns = (u64)(cfg->rtt_ms * NSEC_PER_MSEC);
+    S.buffer_bytes = cfg->buffer_bytes ? cfg->buffer_bytes :
+                     max_t(u64, (u64)(bdp * cfg->buffer_bdp), SIM_MIN_BUFFER);
+    S.end_ns = (u64)(cfg->duration * NSEC_PER_SEC);
+    S.ecn_bytes = (u64)((double)cfg->link_bps / 8.0 * cfg->ecn_us / USEC_PER_SEC);
+    S.rng = cfg->seed ? cfg->seed : 0x9e3779b97f4a7c15ULL;
+    sim_now_ns = 0;
+
+    S.flows = sim_xrealloc(NULL, cfg->flows * sizeof(*S.flows));
+    for (i = 0; i < cfg->flows; i++)
+        sim_flow_init(&S.flows[i], i);
+    for (i = 0; i < cfg->flows; i++)
+        sim_try_send(&S.flows[i]);
+    if (cfg->cross > 0)
+        sim_push(0, EV_CROSS, 0, 0, 0);
+
+    while (S.heap_len && S.flows_done < cfg->flows) {
+        struct sim_event ev = sim_pop();
+        struct sim_flow *f = &S.flows[ev.flow];
+
+        if (ev.t > S.end_ns)
+            break;
+        sim_now_ns = ev.t;
+
+        if (cfg->rtt_change_at > 0 && sim_now_ns >= (u64)(cfg->rtt_change_at * NSEC_PER_SEC))
+            S.rtt_ns = (u64)(cfg->rtt_change_ms * NSEC_PER_MSEC);
+
+        switch (ev.type) {
+        case EV_SEND:
+            f->send_armed = false;
+            sim_try_send(f);
+            break;
+        case EV_LINK_DONE:
+            sim_link_done();
+            break;
+        case EV_ACK:
+            sim_on_ack(f, ev.arg, ev.aux);
+            break;
+        case EV_RTO:
+            sim_on_rto(f);
+            break;
+        case EV_CROSS:
+            sim_cross_arrival();
+            break;
+        case EV_RESUME:
+            sim_on_resume(f);
+            break;
+        }
+        sim_capture_poll();
+    }
+
+    elapsed = S.flows_done == cfg->flows ? (double)sim_now_ns / NSEC_PER_SEC : cfg->duration;
+    if (elapsed <= 0)
+        elapsed = cfg->duration;
+
+    for (i = 0; i < cfg->flows; i++) {
+        struct sim_flow *f = &S.flows[i];
+        double x = (double)f->acked_pkts;
+
+        sum += x;
+        sum_sq += x * x;
+        sent += f->sent_pkts;
+        retrans += f->retrans_pkts;
+        rtos += f->rtos;
+        recoveries += f->recoveries;
+        fct = max_t(u64, fct, f->done_ns);
+        resp_ns += f->resp_ns;
+        responses += f->responses;
+    }
+
+    res->elapsed = elapsed;
+    res->goodput_bps = sum * SIM_MSS * 8.0 / elapsed;
+    res->util = res->goodput_bps * SIM_WIRE_BYTES / SIM_MSS / (double)cfg->link_bps;
+    res->jain = sum_sq > 0 ? sum * sum / (cfg->flows * sum_sq) : 0;
+    res->sent = sent;
+    res->retrans = retrans;
+    res->drops = S.drops;
+    res->rtos = rtos;
+    res->recoveries = recoveries;
+    res->qdelay_avg_ms = S.qdelay_cnt ? S.qdelay_sum_us / S.qdelay_cnt / 1000.0 : 0;
+    res->qdelay_p99_ms = sim_hist_pct(S.qdelay_hist, S.qdelay_cnt, 0.99) / 1000.0;
+    res->fct_max_ms = S.flows_done == cfg->flows ? (double)fct / NSEC_PER_MSEC : 0;
+    if (cfg->idle_ms > 0)
+        res->fct_max_ms = responses ? (double)resp_ns / responses / NSEC_PER_MSEC : 0;
+    res->cwnd = S.flows[0].tp.snd_cwnd;
+    res->pacing_bps = S.flows[0].tp.inet_conn.icsk_inet.sk_pacing_rate == ~0UL ? 0 :
+                      (double)S.flows[0].tp.inet_conn.icsk_inet.sk_pacing_rate * 8.0;
+
+    for (i = 0; i < cfg->flows; i++)
+        sim_flow_release(&S.flows[i]);
+    free(S.flows);
+    free(S.heap);
+    free(S.q);
+}
+
+// ---------------------------------------------------------------------------
+// 输出
+// ---------------------------------------------------------------------------
+static bool sim_csv;
+
+static void sim_print_header(void)
+{
+    if (sim_csv) {
+        printf("link_gbps,rtt_ms,buffer_bytes,loss,cross,flows,goodput_mbps,util,"
+               "sent,retrans,retrans_pct,drops,rtos,recoveries,qdelay_avg_ms,"
+               "qdelay_p99_ms,jain,fct_ms,cwnd,pacing_mbps\n");
+        return;
+    }
+    printf("%-7s %7s %10s %7s %5s %5s | %10s %6s %9s %7s %9s %5s %9s %9s %6s %9s\n",
+           "link", "rtt_ms", "buffer", "loss", "cross", "flows",
+           "goodput", "util", "retrans", "retx%", "drops", "rtos",
+           "qd_avg", "qd_p99", "jain", "fct_ms");
+}
+
+static void sim_print_result(const struct sim_config *cfg, const struct sim_result *res)
+{
+    double retx_pct = res->sent ? 100.0 * res->retrans / res->sent : 0;
+    u64 buffer = S.buffer_bytes;
+
+    if (sim_csv) {
+        printf("%.3f,%.3f,%llu,%g,%g,%u,%.2f,%.4f,%llu,%llu,%.4f,%llu,%llu,%llu,"
+               "%.3f,%.3f,%.4f,%.3f,%u,%.2f\n",
+               cfg->link_bps / 1e9, cfg->rtt_ms, buffer, cfg->loss, cfg->cross,
+               cfg->flows, res->goodput_bps / 1e6, res->util, res->sent,
+               res->retrans, retx_pct, res->drops, res->rtos, res->recoveries,
+               res->qdelay_avg_ms, res->qdelay_p99_ms, res->jain, res->fct_max_ms,
+               res->cwnd, res->pacing_bps / 1e6);
+        return;
+    }
+    printf("%5.1fG %8.1f %9.2fM %7.4f %5.2f %5u | %7.1fMbps %5.1f%% %9llu %6.2f%% %9llu %5llu "
+           "%7.2fms %7.2fms %6.3f %9.1f\n",
+           cfg->link_bps / 1e9, cfg->rtt_ms, buffer / 1e6, cfg->loss, cfg->cross,
+           cfg->flows, res->goodput_bps / 1e6, res->util * 100.0, res->retrans,
+           retx_pct, res->drops, res->rtos, res->qdelay_avg_ms, res->qdelay_p99_ms,
+           res->jain, res->fct_max_ms);
+}
+
+static void sim_run_one(const struct sim_config *cfg)
+{
+    struct sim_result res;
+    u32 i;
+
+    for (i = 0; i < max_t(u32, cfg->repeat, 1); i++) {
+        sim_run(cfg, &res);
+        sim_print_result(cfg, &res);
+        fflush(stdout);
+    }
+}
+
+// 场景矩阵：1G~40G × 1~300ms × 浅/深缓冲
+static void sim_run_matrix(const struct sim_config *base)
+{
+    static const u64 rates[] = { 1000000000ULL, 10000000000ULL, 40000000000ULL };
+    static const double rtts[] = { 1, 10, 50, 150, 300 };
+    static const double buffers[] = { 0.1, 2.0 };
+    bool own_nic = !sim_nic_bps;
+    size_t r, t, b;
+
+    for (r = 0; r < ARRAY_SIZE(rates); r++) {
+        // 没给 --nic 时每一行的出口网卡与瓶颈同速，lotserver_rate=0 按网卡速率定速，
+        // 而不是所有行都退回 LOTSPEED_RATE_FALLBACK
+        if (own_nic) {
+            bool registered = sim_nic_bps != 0;
+
+            sim_nic_bps = rates[r];
+            if (registered)
+                sim_netdev_event(NETDEV_CHANGE, &sim_nic);
+            else
+                sim_netdev_register(&sim_nic);
+        }
+        for (t = 0; t < ARRAY_SIZE(rtts); t++) {
+            for (b = 0; b < ARRAY_SIZE(buffers); b++) {
+                struct sim_config cfg = *base;
+
+                cfg.link_bps = rates[r];
+                cfg.rtt_ms = rtts[t];
+                cfg.buffer_bdp = buffers[b];
+                cfg.buffer_bytes = 0;
+                cfg.path_id = (u32)((r * ARRAY_SIZE(rtts) + t) * ARRAY_SIZE(buffers) + b);
+                sim_run_one(&cfg);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 逐 ACK 开销基准
+// ---------------------------------------------------------------------------
+
+// x86 上读 TSC（周期），其他架构退化为纳秒
+static inline u64 sim_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+// 按场景的速率 / RTT 合成稳态 ACK 流（每个 ACK 确认 1 个包，RTT 带少量抖动），
+// 反复调用 cong_control（模块实现 in_ack_event 时一并调用）。同样的合成过程不调用回调再跑一遍，
+// 两者之差即回调本身的开销，不受事件队列和链路模型的缓存噪声影响。
+static double sim_ack_bench_pass(const struct sim_config *cfg, u64 acks, bool call)
+{
+    struct sim_flow *f = &S.flows[0];
+    struct tcp_sock *tp = &f->tp;
+    struct sock *sk = sim_flow_sk(f);
+    const struct tcp_congestion_ops *ops = inet_csk(sk)->icsk_ca_ops;
+    u32 rtt_us = max_t(u32, (u32)(cfg->rtt_ms * USEC_PER_MSEC), 1);
+    u64 gap_ns = max_t(u64, sim_tx_time_ns(SIM_WIRE_BYTES), 1);
+    u32 inflight = max_t(u32, (u32)(rtt_us * 1000ULL / gap_ns), 1);
+    struct rate_sample rs = { .acked_sacked = 1 };
+    u64 t_ns = 0, c0, i;
+
+    c0 = sim_cycles();
+    for (i = 0; i < acks; i++) {
+        u32 rtt = rtt_us + (u32)(i & 7);
+
+        t_ns += gap_ns;
+        tp->tcp_mstamp = t_ns / NSEC_PER_USEC;
+        tp->delivered++;
+        sim_rtt_estimator(f, rtt);
+
+        rs.prior_delivered = tp->delivered - inflight;
+        rs.prior_in_flight = inflight;
+        rs.delivered = (s32)inflight;
+        rs.interval_us = (long)max_t(u64, (u64)inflight * gap_ns / NSEC_PER_USEC, rtt_us);
+        rs.rtt_us = rtt;
+
+        if (call) {
+            if (ops->in_ack_event)
+                ops->in_ack_event(sk, CA_ACK_SLOWPATH);
+            ops->cong_control(sk, tp->delivered, 0, &rs);
+        }
+        // 防止编译器把不调用回调的那一遍整个优化掉
+        __asm__ __volatile__("" : : "r"(&rs) : "memory");
+    }
+    return (double)(sim_cycles() - c0) / acks;
+}
+
+static void sim_ack_bench(const struct sim_config *cfg, u64 acks)
+{
+    double base = 0, total = 0;
+    int i;
+
+    memset(&S, 0, sizeof(S));
+    S.cfg = cfg;
+    S.flows = sim_xrealloc(NULL, sizeof(*S.flows));
+    sim_flow_init(&S.flows[0], 0);
+
+    // 先跑一遍进入稳态（退出慢启动、速率收敛），再交替测量 3 轮取最小值
+    sim_ack_bench_pass(cfg, acks, true);
+    for (i = 0; i < 3; i++) {
+        double b = sim_ack_bench_pass(cfg, acks, false);
+        double t = sim_ack_bench_pass(cfg, acks, true);
+
+        base = i ? min(base, b) : b;
+        total = i ? min(total, t) : t;
+    }
+
+    printf("ack_bench %.1fG %.3fms: %.1f %s/ACK in callbacks (%.1f with ACK synthesis, %llu ACKs)\n",
+           cfg->link_bps / 1e9, cfg->rtt_ms, total - base,
+#if defined(__x86_64__) || defined(__i386__)
+           "cycles",
+#else
+           "ns",
+#endif
+           total, acks);
+
+    sim_flow_release(&S.flows[0]);
+    free(S.flows);
+}
+
+// ---------------------------------------------------------------------------
+// 命令行
+// ---------------------------------------------------------------------------
+static int sim_parse_scaled(const char *s, double *out)
+{
+    char *end;
+    double v;
+
+    errno = 0;
+    v = strtod(s, &end);
+    if (errno || end == s)
+        return -EINVAL;
+    switch (*end) {
+    case 'k': case 'K': v *= 1e3; end++; break;
+    case 'm': case 'M': v *= 1e6; end++; break;
+    case 'g': case 'G': v *= 1e9; end++; break;
+    default: break;
+    }
+    if (*end || v < 0)
+        return -EINVAL;
+    *out = v;
+    return 0;
+}
+
+static void sim_usage(FILE *out)
+{
+    fprintf(out,
+            "Usage: lotspeed_sim [options]\n"
+            "\n"
+            "Scenario:\n"
+            "  -r, --rate BPS         bottleneck bandwidth in bit/s (K/M/G suffix, default 1G)\n"
+            "  -t, --rtt MS           base round-trip time in ms (default 50)\n"
+            "      --rtt-change SEC:MS\n"
+            "                         switch the base RTT to MS at time SEC (route change)\n"
+            "  -b, --buffer BDP       buffer depth as a multiple of BDP (default 1.0)\n"
+            "  -B, --buffer-bytes N   buffer depth in bytes (K/M/G suffix), overrides --buffer\n"
+            "  -l, --loss P           random loss probability (default 0)\n"
+            "  -x, --cross F          cross traffic as a fraction of bandwidth (default 0)\n"
+            "      --ecn US           mark CE on ECN-capable packets when the queue exceeds\n"
+            "                         US microseconds of link time (needs lotserver_ecn=1)\n"
+            "  -n, --flows N          concurrent lotspeed flows (default 1)\n"
+            "      --same-peer        all flows go to one destination with one sk_mark\n"
+            "                         (parallel downloads; see lotserver_couple)\n"
+            "      --nic BPS          route all flows through a NIC that reports BPS bit/s\n"
+            "                         through ethtool (used when lotserver_rate=0)\n"
+            "  -f, --flow-bytes N     bytes per flow (K/M/G suffix), 0 = bulk (default 0)\n"
+            "      --idle MS          with -f, keep each connection open: after every N bytes\n"
+            "                         are acked, wait MS and send N more (keep-alive\n"
+            "                         request/response); fct_ms becomes the mean response time\n"
+            "  -d, --duration SEC     simulated time in seconds (default 5)\n"
+            "  -s, --seed N           random seed\n"
+            "  -R, --repeat N         run the scenario N times back to back on the same\n"
+            "                         destination (exercises the path cache)\n"
+            "\n"
+            "Module:\n"
+            "  -p, --param NAME=VAL   set a lotspeed module parameter (repeatable)\n"
+            "  -v, --verbose          print module log (twice for pr_debug)\n"
+            "      --trace            print the module's tracepoints to stderr\n"
+            "      --ack-bench N      instead of simulating, time N synthetic steady-state ACKs\n"
+            "                         through cong_control (TSC cycles on x86)\n"
+            "\n"
+            "Output:\n"
+            "  -m, --matrix           run the 1G-40G x 1-300ms x shallow/deep matrix (without\n"
+            "                         --nic, each row's NIC reports that row's link rate)\n"
+            "      --csv              print CSV instead of a table\n"
+            "      --debugfs          dump the module's debugfs files after the run\n"
+            "\n"
+            "Capture / replay:\n"
+            "      --capture FILE     record every callback's inputs and decisions to FILE\n"
+            "                         (all flows unless -p lotserver_capture=N samples them)\n"
+            "      --replay FILE      feed a capture (from here or tools/lotspeed_capture) back\n"
+            "                         through this build with the captured parameters, -p on\n"
+            "                         top; prints decisions that differ, exits 1 if any do\n"
+            "      --replay-all       with --replay, print every replayed decision as CSV\n"
+            "  -h, --help\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        { "rate",         required_argument, NULL, 'r' },
+        { "rtt",          required_argument, NULL, 't' },
+        { "rtt-change",   required_argument, NULL, 'c' },
+        { "buffer",       required_argument, NULL, 'b' },
+        { "buffer-bytes", required_argument, NULL, 'B' },
+        { "loss",         required_argument, NULL, 'l' },
+        { "cross",        required_argument, NULL, 'x' },
+        { "ecn",          required_argument, NULL, 'e' },
+        { "flows",        required_argument, NULL, 'n' },
+        { "same-peer",    no_argument,       NULL, 'P' },
+        { "nic",          required_argument, NULL, 'N' },
+        { "flow-bytes",   required_argument, NULL, 'f' },
+        { "idle",         required_argument, NULL, 'i' },
+        { "duration",     required_argument, NULL, 'd' },
+        { "seed",         required_argument, NULL, 's' },
+        { "repeat",       required_argument, NULL, 'R' },
+        { "param",        required_argument, NULL, 'p' },
+        { "verbose",      no_argument,       NULL, 'v' },
+        { "matrix",       no_argument,       NULL, 'm' },
+        { "csv",          no_argument,       NULL, 'C' },
+        { "debugfs",      no_argument,       NULL, 'D' },
+        { "trace",        no_argument,       NULL, 'T' },
+        { "ack-bench",    required_argument, NULL, 'A' },
+        { "capture",      required_argument, NULL, 'w' },
+        { "replay",       required_argument, NULL, 'y' },
+        { "replay-all",   no_argument,       NULL, 'Y' },
+        { "help",         no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    struct sim_config cfg = {
+        .link_bps = 1000000000ULL,
+        .rtt_ms = 50,
+        .buffer_bdp = 1.0,
+        .flows = 1,
+        .duration = 5,
+    };
+    bool matrix = false;
+    bool dump_debugfs = false;
+    u64 ack_bench = 0;
+    const char *capture = NULL;
+    const char *replay = NULL;
+    struct sim_replay R = { 0 };
+    FILE *replay_in = NULL;
+    const char **params = NULL;
+    int nr_params = 0;
+    double v;
+    int c, i, ret;
+
+    while ((c = getopt_long(argc, argv, "r:t:b:B:l:x:n:f:d:s:R:p:vmh", opts, NULL)) != -1) {
+        switch (c) {
+        case 'r':
+            if (sim_parse_scaled(optarg, &v) || v < 1)
+                goto bad;
+            cfg.link_bps = (u64)v;
+            break;
+        case 't':
+            cfg.rtt_ms = strtod(optarg, NULL);
+            if (cfg.rtt_ms <= 0)
+                goto bad;
+            break;
+        case 'c':
+            if (sscanf(optarg, "%lf:%lf", &cfg.rtt_change_at, &cfg.rtt_change_ms) != 2 ||
+                cfg.rtt_change_at <= 0 || cfg.rtt_change_ms <= 0)
+                goto bad;
+            break;
+        case 'b':
+            cfg.buffer_bdp = strtod(optarg, NULL);
+            if (cfg.buffer_bdp <= 0)
+                goto bad;
+            break;
+        case 'B':
+            if (sim_parse_scaled(optarg, &v))
+                goto bad;
+            cfg.buffer_bytes = (u64)v;
+            break;
+        case 'l':
+            cfg.loss = strtod(optarg, NULL);
+            if (cfg.loss < 0 || cfg.loss >= 1)
+                goto bad;
+            break;
+        case 'x':
+            cfg.cross = strtod(optarg, NULL);
+            if (cfg.cross < 0 || cfg.cross >= 1)
+                goto bad;
+            break;
+        case 'e':
+            cfg.ecn_us = strtod(optarg, NULL);
+            if (cfg.ecn_us <= 0)
+                goto bad;
+            break;
+        case 'P':
+            cfg.same_peer = true;
+            break;
+        case 'N':
+            if (sim_parse_scaled(optarg, &v) || v < 1e6)
+                goto bad;
+            sim_nic_bps = (u64)v;
+            break;
+        case 'n':
+            cfg.flows = (u32)strtoul(optarg, NULL, 0);
+            if (!cfg.flows)
+                goto bad;
+            break;
+        case 'f':
+            if (sim_parse_scaled(optarg, &v))
+                goto bad;
+            cfg.flow_bytes = (u64)v;
+            break;
+        case 'i':
+            cfg.idle_ms = strtod(optarg, NULL);
+            if (cfg.idle_ms <= 0)
+                goto bad;
+            break;
+        case 'd':
+            cfg.duration = strtod(optarg, NULL);
+            if (cfg.duration <= 0)
+                goto bad;
+            break;
+        case 's':
+            cfg.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'R':
+            cfg.repeat = (u32)strtoul(optarg, NULL, 0);
+            if (!cfg.repeat)
+                goto bad;
+            break;
+        case 'p':
+            // 等选项解析完再设置：--replay 时先用采集文件里的参数，-p 在其上覆盖
+            if (!strchr(optarg, '='))
+                goto bad;
+            params = sim_xrealloc(params, (nr_params + 1) * sizeof(*params));
+            params[nr_params++] = optarg;
+            break;
+        case 'v':
+            sim_printk_level++;
+            break;
+        case 'm':
+            matrix = true;
+            break;
+        case 'C':
+            sim_csv = true;
+            break;
+        case 'D':
+            dump_debugfs = true;
+            break;
+        case 'T':
+            sim_trace_enabled = true;
+            break;
+        case 'A':
+            if (sim_parse_scaled(optarg, &v) || v < 1)
+                goto bad;
+            ack_bench = (u64)v;
+            break;
+        case 'w':
+            capture = optarg;
+            break;
+        case 'y':
+            replay = optarg;
+            break;
+        case 'Y':
+            R.all = true;
+            break;
+        case 'h':
+            sim_usage(stdout);
+            return 0;
+        default:
+            goto bad;
+        }
+    }
+    if (optind != argc || (capture && replay) || (cfg.idle_ms > 0 && !cfg.flow_bytes))
+        goto bad;
+
+    if (replay) {
+        replay_in = sim_replay_open(replay, &R);
+        if (!replay_in)
+            return 1;
+    }
+    for (i = 0; i < nr_params; i++) {
+        char name[64];
+        const char *eq = strchr(params[i], '=');
+
+        if ((size_t)(eq - params[i]) >= sizeof(name))
+            goto bad;
+        memcpy(name, params[i], eq - params[i]);
+        name[eq - params[i]] = '\0';
+        ret = sim_param_set(name, eq + 1);
+        if (ret) {
+            fprintf(stderr, "lotspeed_sim: cannot set %s: %s\n", params[i], strerror(-ret));
+            return 2;
+        }
+    }
+    free(params);
+
+    ret = sim_module_init();
+    if (ret || !sim_registered_ca) {
+        fprintf(stderr, "lotspeed_sim: module init failed (%d)\n", ret);
+        return 1;
+    }
+    if (sim_nic_bps)
+        sim_netdev_register(&sim_nic);
+
+    printf("# lotspeed_sim: module parameters\n");
+    sim_param_dump(stdout);
+
+    if (replay_in) {
+        ret = sim_replay_run(replay_in, &R);
+        if (dump_debugfs)
+            sim_debugfs_dump(stdout);
+        sim_module_exit();
+        sim_replay_cleanup();
+        return ret;
+    }
+    if (capture) {
+        ret = sim_capture_start(capture);
+        if (ret) {
+            fprintf(stderr, "lotspeed_sim: cannot capture to %s: %s\n", capture, strerror(-ret));
+            return 1;
+        }
+    }
+
+    if (ack_bench) {
+        sim_ack_bench(&cfg, ack_bench);
+        sim_module_exit();
+        return 0;
+    }
+
+    sim_print_header();
+
+    if (matrix)
+        sim_run_matrix(&cfg);
+    else
+        sim_run_one(&cfg);
+
+    sim_capture_stop(capture);
+
+    if (dump_debugfs)
+        sim_debugfs_dump(stdout);
+
+    sim_module_exit();
+    return 0;
+
+bad:
+    sim_usage(stderr);
+    return 2;
+}
@@ -0,0 +1,273 @@
+// lotspeed_capture.c  ——  把 lotspeed 的逐 ACK 采集环写成采集文件
+//
+// mmap /sys/kernel/debug/lotspeed/capture（布局见 lotspeed_capture.h），
+// 按 -i 的间隔把新记录追加到文件；文件头之后是采集开始时的全部模块参数，
+// 之后可以用模拟器离线回放：
+//
+//   lotspeed_capture -o web.cap -d 30 -n 100 -p 443
+//   sim/lotspeed_sim --replay web.cap                     # 本版本是否做出相同决策
+//   sim/lotspeed_sim --replay web.cap --replay-all -p lotserver_gain=15 > b.csv
+//
+// 采集期间设置 lotserver_capture / lotserver_capture_port，退出时恢复原值。
+// 生产者从不等待：间隔过长或连接过多时旧记录被覆盖，退出时报告丢失数。
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lotspeed_capture.h"     // 仓库根目录，tools/Makefile 用 -I.. 找到
+
+#define PARAM_DIR    "/sys/module/lotspeed/parameters"
+#define CAPTURE_PATH "/sys/kernel/debug/lotspeed/capture"
+
+struct capture_opts {
+    const char *out;
+    double duration;        // 秒，0 = 直到 Ctrl-C
+    unsigned int sample;    // lotserver_capture
+    unsigned int port;      // lotserver_capture_port
+    unsigned int interval_ms;
+};
+
+static struct capture_opts opts = {
+    .sample = 1,
+    .interval_ms = 10,
+};
+
+static volatile sig_atomic_t stop;
+static FILE *out;
+static uint64_t written;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static int param_read(const char *name, char *buf, size_t len)
+{
+    char path[256];
+    FILE *f;
+
+    snprintf(path, sizeof(path), PARAM_DIR "/%s", name);
+    f = fopen(path, "r");
+    if (!f)
+        return -errno;
+    if (!fgets(buf, (int)len, f))
+        buf[0] = '\0';
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+static int param_write(const char *name, const char *val)
+{
+    char path[256];
+    FILE *f;
+    int ret = 0;
+
+    snprintf(path, sizeof(path), PARAM_DIR "/%s", name);
+    f = fopen(path, "w");
+    if (!f)
+        return -errno;
+    if (fputs(val, f) < 0)
+        ret = -EIO;
+    if (fclose(f))
+        ret = -errno;
+    return ret;
+}
+
+// 与模拟器的 sim_param_save() 相同：每行 name=value
+static char *params_dump(size_t *len)
+{
+    struct dirent *de;
+    char *text = NULL;
+    FILE *m;
+    DIR *d;
+
+    d = opendir(PARAM_DIR);
+    if (!d)
+        return NULL;
+    m = open_memstream(&text, len);
+    if (!m) {
+        closedir(d);
+        return NULL;
+    }
+    while ((de = readdir(d))) {
+        char val[4096];
+
+        if (de->d_name[0] == '.')
+            continue;
+        if (!param_read(de->d_name, val, sizeof(val)))
+            fprintf(m, "%s=%s\n", de->d_name, val);
+    }
+    fclose(m);
+    closedir(d);
+    return text;
+}
+
+static void emit(const struct lotspeed_capture_rec *rec, void *arg)
+{
+    (void)arg;
+    fwrite(rec, sizeof(*rec), 1, out);
+    written++;
+}
+
+static void usage(FILE *f)
+{
+    fprintf(f,
+            "Usage: lotspeed_capture -o FILE [options]\n"
+            "  -o, --output FILE      capture file (replay with sim/lotspeed_sim --replay FILE)\n"
+            "  -d, --duration SEC     stop after SEC seconds (default: until Ctrl-C)\n"
+            "  -n, --sample N         capture one flow in N (default 1 = all)\n"
+            "  -p, --port PORT        only flows with this local or remote port\n"
+            "  -i, --interval MS      ring polling interval (default 10)\n"
+            "  -h, --help\n"
+            "\n"
+            "Only flows that start after the capture starts are replayable.\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option long_opts[] = {
+        { "output",   required_argument, NULL, 'o' },
+        { "duration", required_argument, NULL, 'd' },
+        { "sample",   required_argument, NULL, 'n' },
+        { "port",     required_argument, NULL, 'p' },
+        { "interval", required_argument, NULL, 'i' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    struct lotspeed_capture_file fh = {
+        .magic = LOTSPEED_CAPTURE_MAGIC,
+        .version = LOTSPEED_CAPTURE_VERSION,
+        .rec_size = sizeof(struct lotspeed_capture_rec),
+    };
+    struct lotspeed_capture_hdr *hdr;
+    char old_sample[32], old_port[32], val[32];
+    struct timespec start, now, tick;
+    __u64 tail, lost = 0;
+    size_t params_len;
+    char *params;
+    int c, fd, err, ret = 1;
+
+    while ((c = getopt_long(argc, argv, "o:d:n:p:i:h", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'o':
+            opts.out = optarg;
+            break;
+        case 'd':
+            opts.duration = strtod(optarg, NULL);
+            break;
+        case 'n':
+            opts.sample = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            opts.port = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            opts.interval_ms = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+    if (!opts.out || !opts.sample || !opts.interval_ms || optind != argc) {
+        usage(stderr);
+        return 2;
+    }
+
+    if (param_read("lotserver_capture", old_sample, sizeof(old_sample)) ||
+        param_read("lotserver_capture_port", old_port, sizeof(old_port))) {
+        fprintf(stderr, "lotspeed_capture: lotspeed is not loaded or has no capture support\n");
+        return 1;
+    }
+
+    // 先设端口再打开采集；写 lotserver_capture 时分配环形缓冲区
+    snprintf(val, sizeof(val), "%u", opts.port);
+    if (param_write("lotserver_capture_port", val))
+        goto restore;
+    snprintf(val, sizeof(val), "%u", opts.sample);
+    err = param_write("lotserver_capture", val);
+    if (err) {
+        fprintf(stderr, "lotspeed_capture: cannot enable capture: %s\n", strerror(-err));
+        goto restore;
+    }
+
+    fd = open(CAPTURE_PATH, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "lotspeed_capture: %s: %s (debugfs mounted?)\n", CAPTURE_PATH,
+                strerror(errno));
+        goto restore;
+    }
+    hdr = mmap(NULL, LOTSPEED_CAPTURE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        fprintf(stderr, "lotspeed_capture: mmap: %s\n", strerror(errno));
+        goto restore;
+    }
+    if (hdr->magic != LOTSPEED_CAPTURE_MAGIC || hdr->version != LOTSPEED_CAPTURE_VERSION ||
+        hdr->rec_size != sizeof(struct lotspeed_capture_rec)) {
+        fprintf(stderr, "lotspeed_capture: ring version %u, expected %u\n", hdr->version,
+                LOTSPEED_CAPTURE_VERSION);
+        goto unmap;
+    }
+
+    out = fopen(opts.out, "wb");
+    if (!out) {
+        fprintf(stderr, "lotspeed_capture: %s: %s\n", opts.out, strerror(errno));
+        goto unmap;
+    }
+    params = params_dump(&params_len);
+    fh.hz = hdr->hz;
+    fh.params_len = params ? (uint32_t)params_len : 0;
+    fwrite(&fh, sizeof(fh), 1, out);
+    if (params)
+        fwrite(params, 1, params_len, out);
+    free(params);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    // 从当前位置开始：环里已有的旧记录所属的连接缺少 INIT，回放时也只会被跳过
+    tail = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tick.tv_sec = opts.interval_ms / 1000;
+    tick.tv_nsec = (long)(opts.interval_ms % 1000) * 1000000L;
+    while (!stop) {
+        nanosleep(&tick, NULL);
+        lost += lotspeed_capture_drain(hdr, &tail, emit, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (opts.duration > 0 &&
+            (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 >= opts.duration)
+            break;
+    }
+    lost += lotspeed_capture_drain(hdr, &tail, emit, NULL);
+    fclose(out);
+
+    fprintf(stderr, "lotspeed_capture: %llu records, %llu lost -> %s\n",
+            (unsigned long long)written, (unsigned long long)lost, opts.out);
+    if (lost)
+        fprintf(stderr, "lotspeed_capture: lower -i or raise -n to avoid losing records\n");
+    ret = 0;
+
+unmap:
+    munmap(hdr, LOTSPEED_CAPTURE_SIZE);
+restore:
+    param_write("lotserver_capture", old_sample);
+    param_write("lotserver_capture_port", old_port);
+    return ret;
+}
@@ -0,0 +1,403 @@
+#!/usr/bin/env python3
+"""Closed-loop tuner for lotspeed gain and rate.
+
+Every --sample seconds it reads the per-destination summary of
+`lotspeed_diag -j` and /sys/kernel/debug/lotspeed/stats.  Every --interval
+seconds it makes one decision per path class, hill-climbing gain and rate
+to maximise goodput (sum of tcpi_delivery_rate) while keeping the
+retransmit rate (delta total_retrans / delta segs_out) under a ceiling.
+
+Scopes:
+    global    one class for all lotspeed flows; writes lotserver_rate /
+              lotserver_gain, which established flows pick up on their
+              next ACK (parameter snapshot generation)
+    profiles  destinations are classified by rtt_min band and loss into
+              profiles tune_<band>_<loss>; writes lotserver_profiles and
+              lotserver_rules.  Profiles only apply to new connections,
+              so this scope needs connection churn to converge.
+
+Hill climbing, per class:
+    measure the accepted settings, try one move (gain +/-, rate x/÷),
+    keep it if goodput rose by more than --min-improve and the retransmit
+    rate stayed under the ceiling, otherwise revert and try the next move.
+    When every move failed the class is converged and rests for --settle
+    intervals.  A class over its ceiling backs off immediately.
+
+--dry-run never writes a parameter; it logs what it would set and keeps
+climbing from the recommended settings as if they had been applied.
+
+Usage:
+    lotspeed_tune.py [options]
+    ip netns exec lsb-snd lotspeed_tune.py --scope global   # bench topology
+"""
+
+import argparse
+import json
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import time
+
+PARAM_DIR = "/sys/module/lotspeed/parameters"
+STATS_FILE = "/sys/kernel/debug/lotspeed/stats"
+PROFILE_PREFIX = "tune_"
+MAX_RULES = 64                 # LOTSPEED_MAX_RULES
+GAIN_MIN, GAIN_MAX = 10, 50    # lotserver_gain 的合法范围（x10）
+
+# (坐标, 方向)，依次尝试
+MOVES = [("gain", 1), ("rate", 1), ("gain", -1), ("rate", -1)]
+
+
+def log(msg):
+    print("%s %s" % (time.strftime("%H:%M:%S"), msg), flush=True)
+
+
+def fmt_rate(rate):
+    return "%.1fMbps" % (rate * 8 / 1e6)
+
+
+# ---------------------------------------------------------------------------
+# 数据源
+# ---------------------------------------------------------------------------
+
+def find_diag(path):
+    if path:
+        return path
+    here = os.path.dirname(os.path.abspath(__file__))
+    for cand in (os.path.join(here, "lotspeed_diag"), "/opt/lotspeed/lotspeed_diag"):
+        if os.access(cand, os.X_OK):
+            return cand
+    return shutil.which("lotspeed_diag")
+
+
+def read_diag(diag, prefix4, prefix6):
+    out = subprocess.run([diag, "-j", "-n", "0", "-p", str(prefix4), "-P", str(prefix6)],
+                         check=True, capture_output=True, text=True).stdout
+    return json.loads(out).get("destinations", [])
+
+
+def read_stats():
+    stats = {}
+    try:
+        with open(STATS_FILE) as f:
+            for line in f:
+                fields = line.split()
+                if len(fields) == 2 and fields[1].isdigit():
+                    stats[fields[0]] = int(fields[1])
+    except OSError:
+        pass
+    return stats
+
+
+class Params:
+    """lotspeed 模块参数；dry-run 时只记录不写入"""
+
+    def __init__(self, directory, dry_run):
+        self.dir = directory
+        self.dry_run = dry_run
+
+    def get(self, name):
+        with open(os.path.join(self.dir, name)) as f:
+            return f.read().strip()
+
+    def set(self, values):
+        for name, val in values:
+            log("%sset %s = %s" % ("[dry-run] would " if self.dry_run else "", name, val))
+        if self.dry_run:
+            return
+        # 多个参数作为一份快照同时生效
+        self._write("lotserver_hold", "1")
+        try:
+            for name, val in values:
+                self._write(name, val)
+        finally:
+            self._write("lotserver_hold", "0")
+
+    def _write(self, name, val):
+        path = os.path.join(self.dir, name)
+        if name == "lotserver_hold" and not os.path.exists(path):
+            return
+        with open(path, "w") as f:
+            f.write("%s\n" % val)
+
+
+# ---------------------------------------------------------------------------
+# 分类
+# ---------------------------------------------------------------------------
+
+class Classifier:
+    """按 rtt_min 分段，按重传率分 ok / lossy；lossy 带迟滞，避免在阈值附近来回切换"""
+
+    BANDS = ("lan", "rgn", "wan")
+
+    def __init__(self, rtt_bands_ms, lossy_pct):
+        self.bands = rtt_bands_ms
+        self.lossy = lossy_pct / 100.0
+        self.lossy_dests = set()
+
+    def classify(self, dest, rtt_us, retx):
+        band = self.BANDS[-1]
+        for name, limit in zip(self.BANDS, self.bands):
+            if rtt_us < limit * 1000:
+                band = name
+                break
+        if retx is not None:
+            if retx > self.lossy:
+                self.lossy_dests.add(dest)
+            elif retx < self.lossy / 2:
+                self.lossy_dests.discard(dest)
+        return "%s_%s" % (band, "lossy" if dest in self.lossy_dests else "ok")
+
+
+# ---------------------------------------------------------------------------
+# 爬山
+# ---------------------------------------------------------------------------
+
+class Climber:
+    def __init__(self, name, gain, rate, args):
+        self.name = name
+        self.args = args
+        self.gain, self.rate = gain, rate          # 当前下发的设置
+        self.base = (gain, rate)                   # 已接受的设置
+        self.base_score = None
+        self.pending = None                        # 正在试探的 MOVES 下标
+        self.move = 0
+        self.fails = 0
+        self.rest = 0
+
+    def ceiling(self):
+        lossy = self.name.endswith("_lossy")
+        return (self.args.lossy_ceiling if lossy else self.args.retx_ceiling) / 100.0
+
+    def _step(self, move):
+        coord, sign = MOVES[move]
+        gain, rate = self.base
+        if coord == "gain":
+            gain += sign * self.args.gain_step
+            if not GAIN_MIN <= gain <= GAIN_MAX:
+                return None
+        else:
+            rate = int(rate * self.args.rate_step if sign > 0 else rate / self.args.rate_step)
+            if not self.args.min_rate <= rate <= self.args.max_rate:
+                return None
+        return gain, rate
+
+    def _try_next(self):
+        # 越界的移动直接记为失败
+        for _ in MOVES:
+            step = self._step(self.move)
+            if step:
+                self.pending = self.move
+                self.gain, self.rate = step
+                return "try %s%s" % (MOVES[self.move][0], "+" if MOVES[self.move][1] > 0 else "-")
+            self.fails += 1
+            self.move = (self.move + 1) % len(MOVES)
+        return "hold (no move in bounds)"
+
+    def decide(self, goodput, retx):
+        """返回动作说明；self.gain / self.rate 为下一周期的设置"""
+        over = retx is not None and retx > self.ceiling()
+
+        if self.pending is not None:
+            improved = goodput > self.base_score * (1 + self.args.min_improve / 100.0)
+            self.pending = None
+            if improved and not over:
+                self.base, self.base_score, self.fails = (self.gain, self.rate), goodput, 0
+                return self._try_next()
+            self.gain, self.rate = self.base
+            self.fails += 1
+            self.move = (self.move + 1) % len(MOVES)
+            self.base_score = None
+            return "revert (%s)" % ("retx over ceiling" if over else "no gain")
+
+        self.base_score = goodput
+        if over:
+            # 已接受的设置本身超限：先降增益，增益到底再降速率
+            for move in (2, 3):
+                step = self._step(move)
+                if step:
+                    self.base = step
+                    self.gain, self.rate = step
+                    self.base_score, self.fails, self.move = None, 0, 0
+                    return "back off %s" % MOVES[move][0]
+            return "back off (at floor)"
+        if self.fails >= len(MOVES):
+            if self.rest < self.args.settle:
+                self.rest += 1
+                return "converged"
+            self.rest, self.fails = 0, 0
+        return self._try_next()
+
+
+# ---------------------------------------------------------------------------
+# 主循环
+# ---------------------------------------------------------------------------
+
+class Sample:
+    """一个决策周期内同一类的采样累加"""
+
+    def __init__(self):
+        self.goodput = []
+        self.retrans = 0
+        self.segs_out = 0
+        self.conns = 0
+
+
+class Tuner:
+    def __init__(self, args):
+        self.args = args
+        self.params = Params(args.param_dir, args.dry_run)
+        self.diag = find_diag(args.diag)
+        if not self.diag:
+            sys.exit("lotspeed_tune: lotspeed_diag not found (make tools, or --diag PATH)")
+        self.classifier = Classifier(args.rtt_bands, args.lossy_pct)
+        self.climbers = {}
+        self.counters = {}         # dest -> (retrans, segs_out)，上一次采样
+        self.dest_class = {}
+        self.last_stats = read_stats()
+        self.gain0 = int(self.params.get("lotserver_gain"))
+        self.rate0 = int(self.params.get("lotserver_rate"))
+        self.user_profiles, self.user_rules = self._user_policy()
+
+    def _user_policy(self):
+        if self.args.scope != "profiles":
+            return [], []
+        keep = lambda text, pred: [e.strip() for e in text.split(";") if e.strip() and pred(e)]
+        profiles = keep(self.params.get("lotserver_profiles"),
+                        lambda e: not e.strip().startswith(PROFILE_PREFIX))
+        rules = keep(self.params.get("lotserver_rules"),
+                     lambda e: "profile=" + PROFILE_PREFIX not in e)
+        return profiles, rules
+
+    def _retx(self, dest, d):
+        """本次采样间隔的重传率；连接有进出导致计数回退时退回整个生命周期的比例"""
+        prev = self.counters.get(dest)
+        self.counters[dest] = (d["retrans"], d["segs_out"])
+        if prev and d["retrans"] >= prev[0] and d["segs_out"] > prev[1]:
+            return d["retrans"] - prev[0], d["segs_out"] - prev[1]
+        return d["retrans"], d["segs_out"]
+
+    def sample(self, acc):
+        for d in read_diag(self.diag, self.args.prefix4, self.args.prefix6):
+            if "segs_out" not in d:
+                sys.exit("lotspeed_tune: lotspeed_diag too old (no segs_out), rebuild it")
+            retrans, segs = self._retx(d["dest"], d)
+            if self.args.scope == "global":
+                cls = "all"
+            else:
+                ratio = retrans / segs if segs else None
+                cls = self.classifier.classify(d["dest"], d["rtt_min_avg_us"], ratio)
+                self.dest_class[d["dest"]] = (cls, d["conns"])
+            s = acc.setdefault(cls, Sample())
+            s.goodput.append(d["delivery_bps"] / 8)
+            s.retrans += retrans
+            s.segs_out += segs
+            s.conns += d["conns"]
+            # 自动速率（0）时从连接当前的目标速率起步
+            if cls not in self.climbers:
+                rate = self.rate0 or d["target_bps"] // 8 // max(d["conns"], 1)
+                self.climbers[cls] = Climber(cls, self.gain0, rate, self.args)
+
+    def decide(self, acc, samples):
+        stats = read_stats()
+        ignored = stats.get("turbo_ignored_losses", 0) - self.last_stats.get("turbo_ignored_losses", 0)
+        self.last_stats = stats
+        changed = False
+        for cls, s in sorted(acc.items()):
+            c = self.climbers[cls]
+            # 每次采样按目的地追加，取周期内的平均总吞吐
+            goodput = sum(s.goodput) / samples
+            retx = s.retrans / s.segs_out if s.segs_out else None
+            old = (c.gain, c.rate)
+            action = c.decide(goodput, retx)
+            changed |= old != (c.gain, c.rate)
+            log("%-10s conns=%-5d goodput=%-12s retx=%-7s gain=%d rate=%s  %s" % (
+                cls, s.conns // samples, fmt_rate(goodput),
+                "-" if retx is None else "%.2f%%" % (retx * 100),
+                c.gain, fmt_rate(c.rate), action))
+        if ignored:
+            log("turbo ignored %d loss signals this interval" % ignored)
+        if changed:
+            self.apply()
+
+    def apply(self):
+        if self.args.scope == "global":
+            c = self.climbers["all"]
+            self.params.set([("lotserver_gain", c.gain), ("lotserver_rate", c.rate)])
+            return
+        profiles = list(self.user_profiles)
+        for cls, c in sorted(self.climbers.items()):
+            profiles.append("%s%s:rate=%d,gain=%d" % (PROFILE_PREFIX, cls, c.rate, c.gain))
+        # 用户规则优先；规则表放不下时保留连接数多的目的地
+        rules = list(self.user_rules)
+        dests = sorted(self.dest_class.items(), key=lambda kv: -kv[1][1])
+        for dest, (cls, _) in dests[:MAX_RULES - len(rules)]:
+            rules.append("dst=%s profile=%s%s" % (dest, PROFILE_PREFIX, cls))
+        self.params.set([("lotserver_profiles", ";".join(profiles)),
+                         ("lotserver_rules", ";".join(rules))])
+
+    def run(self):
+        log("tuning %s scope every %ds (sample %ds), retx ceiling %.2f%%%s" % (
+            self.args.scope, self.args.interval, self.args.sample, self.args.retx_ceiling,
+            ", dry-run" if self.args.dry_run else ""))
+        decisions = 0
+        while not self.args.iterations or decisions < self.args.iterations:
+            acc, samples = {}, 0
+            deadline = time.monotonic() + self.args.interval
+            while True:
+                self.sample(acc)
+                samples += 1
+                if time.monotonic() + self.args.sample > deadline:
+                    break
+                time.sleep(self.args.sample)
+            if acc:
+                self.decide(acc, samples)
+            else:
+                log("no lotspeed connections")
+            decisions += 1
+            time.sleep(max(0.0, deadline - time.monotonic()))
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--scope", choices=("global", "profiles"), default="profiles")
+    p.add_argument("--interval", type=int, default=30, help="seconds per decision (default 30)")
+    p.add_argument("--sample", type=int, default=5, help="seconds between samples (default 5)")
+    p.add_argument("--iterations", type=int, default=0, help="stop after N decisions (0 = run forever)")
+    p.add_argument("--dry-run", action="store_true", help="log recommendations, write nothing")
+    p.add_argument("--retx-ceiling", type=float, default=1.0, help="retransmit %% ceiling (default 1.0)")
+    p.add_argument("--lossy-pct", type=float, default=2.0,
+                   help="retransmit %% above which a destination is lossy (default 2.0)")
+    p.add_argument("--lossy-ceiling", type=float, default=5.0,
+                   help="retransmit %% ceiling for lossy classes (default 5.0)")
+    p.add_argument("--rtt-bands", type=lambda v: [int(x) for x in v.split(",")], default=[5, 50],
+                   help="rtt_min band limits in ms for lan,rgn (default 5,50)")
+    p.add_argument("--gain-step", type=int, default=5, help="gain step, x10 (default 5)")
+    p.add_argument("--rate-step", type=float, default=1.25, help="rate step factor (default 1.25)")
+    p.add_argument("--min-rate", type=int, default=1250000, help="bytes/s (default 10Mbps)")
+    p.add_argument("--max-rate", type=int, default=5000000000, help="bytes/s (default 40Gbps)")
+    p.add_argument("--min-improve", type=float, default=2.0,
+                   help="goodput gain %% needed to keep a move (default 2.0)")
+    p.add_argument("--settle", type=int, default=10, help="intervals to rest once converged (default 10)")
+    p.add_argument("--prefix4", type=int, default=24)
+    p.add_argument("--prefix6", type=int, default=48)
+    p.add_argument("--diag", help="lotspeed_diag binary")
+    p.add_argument("--param-dir", default=PARAM_DIR)
+    args = p.parse_args()
+
+    if args.sample > args.interval:
+        p.error("--sample must not exceed --interval")
+    if len(args.rtt_bands) != 2:
+        p.error("--rtt-bands takes two limits")
+
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    try:
+        Tuner(args).run()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()